@@ -0,0 +1,147 @@
+#include "arena.h"
+#include "memory.h"
+#include <assert.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT alignof(max_align_t)
+
+typedef struct ArenaBlock {
+  struct ArenaBlock *next;
+  size_t size; // bytes in data
+  alignas(max_align_t) char data[];
+} ArenaBlock;
+
+// rounds size up to ARENA_ALIGNMENT, 0 when that overflows
+static size_t _arena_align(size_t size) {
+  if (size > SIZE_MAX - (ARENA_ALIGNMENT - 1)) {
+    return 0;
+  }
+  return (size + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static bool _arena_add_block(Arena *this, size_t min_size) {
+  size_t size = this->_inner_block_size > min_size ? this->_inner_block_size
+                                                   : min_size;
+  if (size > SIZE_MAX - sizeof(ArenaBlock)) {
+    return false;
+  }
+
+  ArenaBlock *block = memory_alloc(sizeof(ArenaBlock) + size);
+  if (block == NULL) {
+    return false;
+  }
+
+  block->next = this->_inner_blocks;
+  block->size = size;
+  this->_inner_blocks = block;
+  this->_inner_position = block->data;
+  this->_inner_end = block->data + size;
+  this->_inner_block_size = size > SIZE_MAX / 2 ? size : size * 2;
+  return true;
+}
+
+static void _arena_free_blocks(Arena *this) {
+  ArenaBlock *block = this->_inner_blocks;
+  while (block != NULL) {
+    ArenaBlock *next = block->next;
+    memory_free(block);
+    block = next;
+  }
+
+  this->_inner_blocks = NULL;
+  this->_inner_position = NULL;
+  this->_inner_end = NULL;
+  this->_inner_last = NULL;
+}
+
+bool arena_init(Arena *arena, size_t block_size) {
+  assert(arena && "arena_init(): arg arena was null");
+  assert(block_size && "arena_init(): block_size can not be zero");
+  arena->_inner_blocks = NULL;
+  arena->_inner_position = NULL;
+  arena->_inner_end = NULL;
+  arena->_inner_last = NULL;
+  arena->_inner_block_size = _arena_align(block_size);
+  return arena->_inner_block_size != 0 && _arena_add_block(arena, 0);
+}
+
+void arena_destroy(Arena *arena) {
+  assert(arena && "arena_destroy(): arg arena was null");
+  _arena_free_blocks(arena);
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+  assert(arena && "arena_alloc(): arg arena was null");
+  size_t aligned_size = _arena_align(size == 0 ? 1 : size);
+  if (aligned_size == 0) {
+    return NULL;
+  }
+
+  if (arena->_inner_blocks == NULL ||
+      (size_t)(arena->_inner_end - arena->_inner_position) < aligned_size) {
+    if (!_arena_add_block(arena, aligned_size)) {
+      return NULL;
+    }
+  }
+
+  void *allocation = arena->_inner_position;
+  arena->_inner_position += aligned_size;
+  arena->_inner_last = allocation;
+  return allocation;
+}
+
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size,
+                    size_t new_size) {
+  assert(arena && "arena_realloc(): arg arena was null");
+  if (ptr == NULL) {
+    return arena_alloc(arena, new_size);
+  }
+
+  if (ptr == arena->_inner_last) {
+    size_t aligned_size = _arena_align(new_size == 0 ? 1 : new_size);
+    if (aligned_size != 0 &&
+        aligned_size <= (size_t)(arena->_inner_end - (char *)ptr)) {
+      arena->_inner_position = (char *)ptr + aligned_size;
+      return ptr;
+    }
+  } else if (new_size <= old_size) {
+    return ptr;
+  }
+
+  void *allocation = arena_alloc(arena, new_size);
+  if (allocation == NULL) {
+    return NULL;
+  }
+  memcpy(allocation, ptr, old_size < new_size ? old_size : new_size);
+  return allocation;
+}
+
+void arena_reset(Arena *arena) {
+  assert(arena && "arena_reset(): arg arena was null");
+  ArenaBlock *blocks = arena->_inner_blocks;
+  if (blocks != NULL && blocks->next == NULL) {
+    arena->_inner_position = blocks->data;
+    arena->_inner_last = NULL;
+    return;
+  }
+
+  size_t total_size = arena_get_capacity(arena);
+  _arena_free_blocks(arena);
+  if (total_size > arena->_inner_block_size) {
+    arena->_inner_block_size = total_size;
+  }
+  // when this fails the arena stays empty and the next allocation retries
+  _arena_add_block(arena, 0);
+}
+
+size_t arena_get_capacity(const Arena *arena) {
+  assert(arena && "arena_get_capacity(): arg arena was null");
+  size_t capacity = 0;
+  for (const ArenaBlock *block = arena->_inner_blocks; block != NULL;
+       block = block->next) {
+    capacity += block->size;
+  }
+  return capacity;
+}
@@ -0,0 +1,32 @@
+#ifndef ARENA
+#define ARENA
+#include <stdbool.h>
+#include <stddef.h>
+
+// Bump allocator. Allocations are never freed one by one, arena_reset
+// releases all of them at once and keeps the memory for the next round.
+// Every allocation is aligned like malloc.
+typedef struct Arena {
+  struct ArenaBlock *_inner_blocks; // the block allocations come from first
+  char *_inner_position;
+  char *_inner_end;
+  void *_inner_last; // the latest allocation, the only one that grows in place
+  size_t _inner_block_size;
+} Arena;
+
+// block_size is the size of the first block, later blocks grow from it
+bool arena_init(Arena *arena, size_t block_size);
+void arena_destroy(Arena *arena);
+// returns NULL when out of memory
+void *arena_alloc(Arena *arena, size_t size);
+// grows in place when ptr is the latest allocation and the block has room,
+// otherwise copies. ptr may be NULL. The old allocation is not reclaimed.
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size,
+                    size_t new_size);
+// Releases every allocation. When the last round needed more than one block
+// they are merged into a single block, so a steady workload stops calling
+// malloc after the first round.
+void arena_reset(Arena *arena);
+size_t arena_get_capacity(const Arena *arena);
+
+#endif
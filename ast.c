@@ -0,0 +1,64 @@
+#include "ast.h"
+#include "list.h"
+#include <assert.h>
+
+bool ast_init(Ast *ast) {
+  assert(ast && "ast_init(): arg ast was null");
+  return ast_init_in(ast, NULL);
+}
+
+bool ast_init_in(Ast *ast, Arena *arena) {
+  assert(ast && "ast_init_in(): arg ast was null");
+  ast->_inner_nodes = list_in(arena, AstNode, 32);
+  return ast->_inner_nodes != NULL;
+}
+
+void ast_destroy(Ast *ast) {
+  assert(ast && "ast_destroy(): arg ast was null");
+  if (ast->_inner_nodes != NULL) {
+    list_free(ast->_inner_nodes);
+  }
+  ast->_inner_nodes = NULL;
+}
+
+void ast_clear(Ast *ast) {
+  assert(ast && "ast_clear(): arg ast was null");
+  list_clear(ast->_inner_nodes);
+}
+
+bool ast_add_node(Ast *ast, AstNode node, uint32_t *index) {
+  assert(ast && "ast_add_node(): arg ast was null");
+  assert(index && "ast_add_node(): arg index was null");
+  size_t count = list_get_count(ast->_inner_nodes);
+  if (count == AST_MAX_NODE_COUNT) {
+    return false;
+  }
+
+  AstNode *nodes = list_add(ast->_inner_nodes, &node);
+  if (nodes == NULL) {
+    return false;
+  }
+
+  ast->_inner_nodes = nodes;
+  *index = (uint32_t)count;
+  return true;
+}
+
+size_t ast_get_node_count(const Ast *ast) {
+  assert(ast && "ast_get_node_count(): arg ast was null");
+  return list_get_count(ast->_inner_nodes);
+}
+
+const AstNode *ast_get_node(const Ast *ast, uint32_t index) {
+  assert(ast && "ast_get_node(): arg ast was null");
+  assert(index < list_get_count(ast->_inner_nodes) &&
+         "ast_get_node(): index out of bounds");
+  return &ast->_inner_nodes[index];
+}
+
+uint32_t ast_get_root(const Ast *ast) {
+  assert(ast && "ast_get_root(): arg ast was null");
+  size_t count = list_get_count(ast->_inner_nodes);
+  assert(count && "ast_get_root(): ast is empty");
+  return (uint32_t)(count - 1);
+}
@@ -0,0 +1,62 @@
+#ifndef AST
+#define AST
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct Arena Arena;
+
+typedef enum AstNodeType {
+  AST_NUMBER,   // number
+  AST_VARIABLE, // the identifier at token_index
+  AST_NEGATE,   // -operand
+  AST_ADD,      // lhs + rhs
+  AST_SUBTRACT, // lhs - rhs
+  AST_MULTIPLY, // lhs * rhs
+  AST_DIVIDE,   // lhs / rhs
+  AST_MODULO,   // lhs % rhs
+  AST_POWER,    // lhs ^ rhs, lhs ** rhs
+  AST_CALL,     // the identifier at token_index applied to operand
+  AST_NODE_TYPE_COUNT
+} AstNodeType;
+
+#define AST_MAX_NODE_COUNT UINT32_MAX
+
+// Children are indices into the node array and always smaller than the index
+// of their parent, so walking the array front to back visits the expression
+// in postfix order and the root is the last node.
+typedef struct AstNode {
+  AstNodeType type;
+  uint32_t token_index; // the token the node was parsed from
+  union {
+    double number; // AST_NUMBER
+    uint32_t operand; // AST_NEGATE, AST_CALL
+    struct {
+      uint32_t lhs;
+      uint32_t rhs;
+    } binary; // AST_ADD ... AST_POWER
+  };
+} AstNode;
+
+// Nodes of one expression in one contiguous array. Parsing into an ast
+// replaces its nodes and keeps the capacity.
+typedef struct Ast {
+  AstNode *_inner_nodes;
+} Ast;
+
+bool ast_init(Ast *ast);
+// the nodes grow inside arena and are released by its reset
+bool ast_init_in(Ast *ast, Arena *arena);
+void ast_destroy(Ast *ast);
+void ast_clear(Ast *ast);
+// false when out of memory or the ast already has AST_MAX_NODE_COUNT nodes
+bool ast_add_node(Ast *ast, AstNode node, uint32_t *index);
+size_t ast_get_node_count(const Ast *ast);
+const AstNode *ast_get_node(const Ast *ast, uint32_t index);
+// the root is the last node, the ast must not be empty
+uint32_t ast_get_root(const Ast *ast);
+static inline bool ast_node_is_binary(AstNodeType type) {
+  return type >= AST_ADD && type <= AST_POWER;
+}
+
+#endif
@@ -0,0 +1,681 @@
+#include "binding.h"
+#include "char_reader.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "list.h"
+#include "parser.h"
+#include "token_list.h"
+#include "vm.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Times lex_char_reader, char_reader_add, list_add, scans over the token
+// layouts and variable binding over synthetic corpora
+// of growing size and prints the results as JSON on stdout. Every benchmark
+// runs over a ladder of sizes, and the scaling section fits how its time
+// grows with the token count. Exits with 1 when any of them grows faster
+// than BENCH_SUPERLINEAR_EXPONENT, such as a loop over all earlier tokens
+// on every token.
+//
+//   bench.exe [--max-bytes <bytes>]
+//
+// Corpora go up to --max-bytes, 16 MB by default and at most 1 GB. The
+// tokens of a corpus take about 24 bytes each on top of its bytes, so the
+// operator dense corpus needs about 25 times its size in memory.
+
+#define BENCH_MIN_BYTES (1ull << 20)
+#define BENCH_DEFAULT_MAX_BYTES (16ull << 20)
+#define BENCH_LIMIT_MAX_BYTES (1ull << 30)
+// corpora and counts grow by this factor from one size to the next
+#define BENCH_SIZE_STEP 4
+// characters of every char_reader_add call of the chunked benchmarks
+#define BENCH_CHUNK_SIZE 4095
+#define BENCH_SUPERLINEAR_EXPONENT 1.5
+
+typedef struct BenchResult {
+  const char *benchmark;
+  const char *corpus;
+  size_t bytes;
+  size_t tokens;
+  double seconds; // the fastest of the repeats
+} BenchResult;
+
+static double now_seconds(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void *checked_malloc(size_t size) {
+  void *ptr = malloc(size);
+  if (ptr == NULL) {
+    fprintf(stderr, "checked_malloc(): out of memory\n");
+    exit(1);
+  }
+  return ptr;
+}
+
+// xorshift, so every run lexes the same corpora
+static uint64_t bench_random_state = 0x9e3779b97f4a7c15ull;
+
+static size_t random_below(size_t bound) {
+  bench_random_state ^= bench_random_state << 13;
+  bench_random_state ^= bench_random_state >> 7;
+  bench_random_state ^= bench_random_state << 17;
+  return (size_t)(bench_random_state % bound);
+}
+
+// generators append to chars[0..capacity), the last piece is cut short
+typedef struct Corpus {
+  char *chars;
+  size_t size;
+  size_t capacity;
+} Corpus;
+
+static void append_char(Corpus *corpus, char c) {
+  if (corpus->size < corpus->capacity) {
+    corpus->chars[corpus->size++] = c;
+  }
+}
+
+static void append_string(Corpus *corpus, const char *str) {
+  for (; *str != '\0'; str++) {
+    append_char(corpus, *str);
+  }
+}
+
+static void append_random_chars(Corpus *corpus, const char *alphabet,
+                                size_t count) {
+  size_t alphabet_size = strlen(alphabet);
+  for (size_t i = 0; i < count; i++) {
+    append_char(corpus, alphabet[random_below(alphabet_size)]);
+  }
+}
+
+static const char *const binary_operators[] = {" + ", " - ", "*", "/",
+                                               " % ", "^",   "**"};
+
+static void append_operator(Corpus *corpus) {
+  append_string(corpus, binary_operators[random_below(7)]);
+}
+
+static void generate_long_numbers(Corpus *corpus) {
+  while (corpus->size < corpus->capacity) {
+    append_char(corpus, "123456789"[random_below(9)]);
+    append_random_chars(corpus, "0123456789", 30 + random_below(50));
+    if (random_below(2)) {
+      append_char(corpus, '.');
+      append_random_chars(corpus, "0123456789", 10 + random_below(30));
+    }
+    append_operator(corpus);
+  }
+}
+
+static void generate_long_identifiers(Corpus *corpus) {
+  while (corpus->size < corpus->capacity) {
+    append_random_chars(corpus, "abcdefghijklmnopqrstuvwxyz_", 1);
+    append_random_chars(corpus, "abcdefghijklmnopqrstuvwxyz_0123456789",
+                        30 + random_below(170));
+    append_operator(corpus);
+  }
+}
+
+// single character operands and operators without any whitespace
+static void generate_operator_dense(Corpus *corpus) {
+  static const char *const operators[] = {"+", "-", "*", "/", "%",
+                                          "^", "**", "-(", ")"};
+  while (corpus->size < corpus->capacity) {
+    append_random_chars(corpus, "xyzk1279", 1);
+    append_string(corpus, operators[random_below(9)]);
+  }
+}
+
+static void generate_nested_brackets(Corpus *corpus) {
+  static const char opening[] = "([{";
+  static const char closing[] = ")]}";
+  char kinds[2000];
+  while (corpus->size < corpus->capacity) {
+    size_t depth = 1 + random_below(sizeof(kinds));
+    for (size_t i = 0; i < depth; i++) {
+      kinds[i] = (char)random_below(3);
+      append_char(corpus, opening[(size_t)kinds[i]]);
+    }
+    append_char(corpus, 'x');
+    for (size_t i = depth; i-- > 0;) {
+      append_char(corpus, closing[(size_t)kinds[i]]);
+    }
+    append_operator(corpus);
+  }
+}
+
+static void generate_mixed(Corpus *corpus) {
+  static const char *const pieces[] = {
+      "(x12*3.25+y_7)", "(4e-2-z)", "2",   "k",        "[a-b]",
+      "{c}",            "123,456.789", ".5", "alpha_beta", "1E10"};
+  while (corpus->size < corpus->capacity) {
+    append_string(corpus, pieces[random_below(10)]);
+    append_operator(corpus);
+  }
+}
+
+// A whole expression the parser accepts: left associative operators only, so
+// the parser never nests deeper than the brackets, and it ends with an operand
+static void generate_expression(Corpus *corpus) {
+  static const char *const pieces[] = {
+      "(x12*3.25+y_7)", "(4e-2-z)", "2",   "k", "[a-b]",
+      "{c}",            "sin(t)",   ".5", "alpha_beta", "1E10"};
+  static const char *const operators[] = {" + ", " - ", "*", "/", " % "};
+  // the longest piece and operator always fit after the loop
+  while (corpus->size + 20 < corpus->capacity) {
+    append_string(corpus, pieces[random_below(10)]);
+    append_string(corpus, operators[random_below(5)]);
+  }
+  append_char(corpus, 'x');
+}
+
+static const struct {
+  const char *name;
+  void (*generate)(Corpus *corpus);
+} corpora[] = {
+    {"long_numbers", generate_long_numbers},
+    {"long_identifiers", generate_long_identifiers},
+    {"operator_dense", generate_operator_dense},
+    {"nested_brackets", generate_nested_brackets},
+    {"mixed", generate_mixed},
+};
+
+static int repeats_for(size_t bytes) {
+  return bytes <= (4u << 20) ? 5 : bytes <= (64u << 20) ? 2 : 1;
+}
+
+static BenchResult bench_lex(const char *corpus, const char *chars,
+                             size_t size) {
+  BenchResult result = {"lex_char_reader", corpus, size, 0, 0};
+  for (int r = 0; r < repeats_for(size); r++) {
+    CharReader reader;
+    char_reader_init(&reader);
+    if (!char_reader_add_view(&reader, chars, size)) {
+      fprintf(stderr, "bench_lex(): out of memory\n");
+      exit(1);
+    }
+
+    double start = now_seconds();
+    TokenList tokens = lex_char_reader(&reader);
+    double elapsed = now_seconds() - start;
+
+    result.tokens = token_list_get_count(&tokens);
+    token_list_distroy(&tokens);
+    char_reader_destroy(&reader);
+    if (r == 0 || elapsed < result.seconds) {
+      result.seconds = elapsed;
+    }
+  }
+  return result;
+}
+
+// Adds the corpus as NUL terminated chunks of BENCH_CHUNK_SIZE characters
+// and lexes the copies, where lexemes that cross chunks are copied together.
+// chunks holds the chunks one after another. Both results count the tokens
+// of the copies.
+static void bench_chunked(const char *corpus, const char *chunks,
+                          size_t size, BenchResult *add, BenchResult *lex) {
+  // whole chunks only, so a little less than size
+  size_t chunk_count = size / BENCH_CHUNK_SIZE;
+  size = chunk_count * BENCH_CHUNK_SIZE;
+  *add = (BenchResult){"char_reader_add", corpus, size, 0, 0};
+  *lex = (BenchResult){"lex_char_reader_copied", corpus, size, 0, 0};
+  for (int r = 0; r < repeats_for(size); r++) {
+    CharReader reader;
+    char_reader_init(&reader);
+
+    double start = now_seconds();
+    for (size_t i = 0; i < chunk_count; i++) {
+      if (!char_reader_add(&reader, chunks + i * (BENCH_CHUNK_SIZE + 1))) {
+        fprintf(stderr, "bench_chunked(): out of memory\n");
+        exit(1);
+      }
+    }
+    double added = now_seconds();
+    TokenList token_list = lex_char_reader(&reader);
+    double lexed = now_seconds();
+
+    lex->tokens = add->tokens = token_list_get_count(&token_list);
+    token_list_distroy(&token_list);
+    char_reader_destroy(&reader);
+    if (r == 0 || added - start < add->seconds) {
+      add->seconds = added - start;
+    }
+    if (r == 0 || lexed - added < lex->seconds) {
+      lex->seconds = lexed - added;
+    }
+  }
+}
+
+static BenchResult bench_list_add(size_t count) {
+  BenchResult result = {"list_add", "tokens", count * sizeof(Token), count, 0};
+  for (int r = 0; r < repeats_for(result.bytes); r++) {
+    Token *list = list(Token, 16);
+    if (list == NULL) {
+      fprintf(stderr, "bench_list_add(): out of memory\n");
+      exit(1);
+    }
+
+    double start = now_seconds();
+    for (size_t i = 0; i < count; i++) {
+      Token token = {.type = (TokenType)(i % EOI_TOKEN),
+                     .lexeme_length = 1,
+                     .lexeme_offset = i};
+      Token *grown = list_add(list, &token);
+      if (grown == NULL) {
+        fprintf(stderr, "bench_list_add(): out of memory\n");
+        exit(1);
+      }
+      list = grown;
+    }
+    double elapsed = now_seconds() - start;
+
+    list_free(list);
+    if (r == 0 || elapsed < result.seconds) {
+      result.seconds = elapsed;
+    }
+  }
+  return result;
+}
+
+// every expression is lexed with its own reader, like a request would
+static BenchResult bench_tiny_expressions(size_t count) {
+  static const char *const expressions[] = {"x*2+y", "(a-b)/c", "3.5^k",
+                                            "price*qty - discount", "1e-3*t"};
+  size_t lengths[5];
+  for (size_t i = 0; i < 5; i++) {
+    lengths[i] = strlen(expressions[i]);
+  }
+
+  BenchResult result = {"lex_char_reader", "tiny_expressions", 0, 0, 0};
+  double start = now_seconds();
+  for (size_t i = 0; i < count; i++) {
+    CharReader reader;
+    char_reader_init(&reader);
+    if (!char_reader_add_view(&reader, expressions[i % 5], lengths[i % 5])) {
+      fprintf(stderr, "bench_tiny_expressions(): out of memory\n");
+      exit(1);
+    }
+    TokenList tokens = lex_char_reader(&reader);
+    result.bytes += lengths[i % 5];
+    result.tokens += token_list_get_count(&tokens);
+    token_list_distroy(&tokens);
+    char_reader_destroy(&reader);
+  }
+  result.seconds = now_seconds() - start;
+  return result;
+}
+
+// the bracket depth never drops below 0 and ends at 0
+static bool brackets_match(const uint8_t *types, size_t count) {
+  size_t depth = 0;
+  for (size_t i = 0; i < count; i++) {
+    TokenType type = (TokenType)types[i];
+    if (type == LPAREN_TOKEN || type == LBRACKET_TOKEN ||
+        type == LBRACE_TOKEN) {
+      depth++;
+    } else if (type == RPAREN_TOKEN || type == RBRACKET_TOKEN ||
+               type == RBRACE_TOKEN) {
+      if (depth-- == 0) {
+        return false;
+      }
+    }
+  }
+  return depth == 0;
+}
+
+// brackets_match over whole Tokens
+static bool brackets_match_tokens(const Token *tokens, size_t count) {
+  size_t depth = 0;
+  for (size_t i = 0; i < count; i++) {
+    TokenType type = tokens[i].type;
+    if (type == LPAREN_TOKEN || type == LBRACKET_TOKEN ||
+        type == LBRACE_TOKEN) {
+      depth++;
+    } else if (type == RPAREN_TOKEN || type == RBRACKET_TOKEN ||
+               type == RBRACE_TOKEN) {
+      if (depth-- == 0) {
+        return false;
+      }
+    }
+  }
+  return depth == 0;
+}
+
+static bool parse_layout(TokenList *tokens, const TokenColumns *columns,
+                         Ast *ast) {
+  ParseError error;
+  return tokens != NULL ? parse_token_list(tokens, ast, &error)
+                        : parse_token_columns(columns, ast, &error);
+}
+
+// Runs the same scans over the tokens of an expression stored as a TokenList
+// (AoS, 24 bytes per token) and as TokenColumns (SoA, the types take 1 byte
+// per token), in order match_brackets_aos, match_brackets_soa,
+// parse_token_list and parse_token_columns.
+static void bench_token_layouts(const char *chars, size_t size,
+                                BenchResult out[4]) {
+  CharReader list_reader, columns_reader;
+  char_reader_init(&list_reader);
+  char_reader_init(&columns_reader);
+  if (!char_reader_add_view(&list_reader, chars, size) ||
+      !char_reader_add_view(&columns_reader, chars, size)) {
+    fprintf(stderr, "bench_token_layouts(): out of memory\n");
+    exit(1);
+  }
+  TokenList tokens = lex_char_reader(&list_reader);
+  TokenColumns columns = lex_char_reader_columns(&columns_reader);
+  size_t count = token_list_get_count(&tokens);
+  Ast ast;
+  if (!ast_init(&ast)) {
+    fprintf(stderr, "bench_token_layouts(): out of memory\n");
+    exit(1);
+  }
+
+  static const char *const names[4] = {
+      "match_brackets_aos", "match_brackets_soa", "parse_token_list",
+      "parse_token_columns"};
+  for (int b = 0; b < 4; b++) {
+    out[b] = (BenchResult){names[b], "expression", size, count, 0};
+    for (int r = 0; r < repeats_for(size); r++) {
+      double start = now_seconds();
+      bool ok;
+      switch (b) {
+      case 0:
+        // straight over the array, token_list_get_token_at copies a Token
+        ok = brackets_match_tokens(tokens._inner_token_list, count);
+        break;
+      case 1:
+        ok = brackets_match(token_columns_get_types(&columns), count);
+        break;
+      case 2:
+        ok = parse_layout(&tokens, NULL, &ast);
+        break;
+      default:
+        ok = parse_layout(NULL, &columns, &ast);
+        break;
+      }
+      double elapsed = now_seconds() - start;
+
+      if (!ok) {
+        fprintf(stderr, "bench_token_layouts(): %s failed\n", names[b]);
+        exit(1);
+      }
+      if (r == 0 || elapsed < out[b].seconds) {
+        out[b].seconds = elapsed;
+      }
+    }
+  }
+
+  ast_destroy(&ast);
+  token_columns_destroy(&columns);
+  token_list_distroy(&tokens);
+  char_reader_destroy(&columns_reader);
+  char_reader_destroy(&list_reader);
+}
+
+#define BENCH_CANDIDATES 256
+#define BENCH_ROW_POOL 64
+
+// Evaluates an expression of 3 variables over rows of BENCH_CANDIDATES named
+// columns, binding every row by comparing names (bind_by_name, what a caller
+// without slots does) or through columns resolved once (bind_resolved).
+// Rows are cycled from a small pool, so the bytes are the bytes bound.
+static void bench_binding(size_t row_count, BenchResult *by_name,
+                          BenchResult *resolved) {
+  static char name_chars[BENCH_CANDIDATES][8];
+  static const char *names[BENCH_CANDIDATES];
+  static double rows[BENCH_ROW_POOL][BENCH_CANDIDATES];
+  for (size_t i = 0; i < BENCH_CANDIDATES; i++) {
+    sprintf(name_chars[i], "c%zu", i);
+    names[i] = name_chars[i];
+    for (size_t r = 0; r < BENCH_ROW_POOL; r++) {
+      rows[r][i] = (double)(r + i);
+    }
+  }
+
+  CharReader reader;
+  char_reader_init(&reader);
+  if (!char_reader_add(&reader, "c201 * c7 - c160 / 2")) {
+    fprintf(stderr, "bench_binding(): out of memory\n");
+    exit(1);
+  }
+  TokenList tokens = lex_char_reader(&reader);
+  Bytecode bytecode;
+  Binding binding;
+  CompileError error;
+  size_t columns[3];
+  if (!bytecode_init(&bytecode) ||
+      !compile_token_list(&tokens, &bytecode, &error) ||
+      !binding_init(&binding, &bytecode)) {
+    fprintf(stderr, "bench_binding(): failed to compile\n");
+    exit(1);
+  }
+
+  size_t bytes = row_count * BENCH_CANDIDATES * sizeof(double);
+  *by_name = (BenchResult){"bind_by_name", "candidates_256", bytes, row_count,
+                           0};
+  *resolved = (BenchResult){"bind_resolved", "candidates_256", bytes,
+                            row_count, 0};
+  double vars[3];
+  double sums[2] = {0, 0};
+  for (int r = 0; r < repeats_for(bytes); r++) {
+    double start = now_seconds();
+    for (size_t row = 0; row < row_count; row++) {
+      const double *values = rows[row % BENCH_ROW_POOL];
+      for (size_t slot = 0; slot < 3; slot++) {
+        const char *name = bytecode_get_variable_name(&bytecode, slot);
+        vars[slot] = NAN;
+        for (size_t i = 0; i < BENCH_CANDIDATES; i++) {
+          if (strcmp(names[i], name) == 0) {
+            vars[slot] = values[i];
+            break;
+          }
+        }
+      }
+      sums[0] += vm_evaluate(&bytecode, vars);
+    }
+    double named = now_seconds();
+    // resolved once per pass, the time includes it
+    binding_resolve_columns(&binding, names, BENCH_CANDIDATES, columns);
+    for (size_t row = 0; row < row_count; row++) {
+      binding_set_row(&binding, columns, rows[row % BENCH_ROW_POOL]);
+      sums[1] += vm_evaluate(&bytecode, binding_get_values(&binding));
+    }
+    double bound = now_seconds();
+
+    if (r == 0 || named - start < by_name->seconds) {
+      by_name->seconds = named - start;
+    }
+    if (r == 0 || bound - named < resolved->seconds) {
+      resolved->seconds = bound - named;
+    }
+  }
+  if (sums[0] != sums[1]) {
+    fprintf(stderr, "bench_binding(): the bindings disagree\n");
+    exit(1);
+  }
+
+  binding_destroy(&binding);
+  bytecode_destroy(&bytecode);
+  token_list_distroy(&tokens);
+  char_reader_destroy(&reader);
+}
+
+static void add_result(BenchResult **results, BenchResult result) {
+  BenchResult *grown = list_add(*results, &result);
+  if (grown == NULL) {
+    fprintf(stderr, "add_result(): out of memory\n");
+    exit(1);
+  }
+  *results = grown;
+}
+
+// results of the same benchmark and corpus are next to each other, by size
+static bool print_scaling(const BenchResult *results, size_t count) {
+  bool any_superlinear = false;
+  bool first = true;
+  printf("  \"scaling\": [");
+  for (size_t begin = 0; begin < count;) {
+    size_t end = begin + 1;
+    while (end < count &&
+           strcmp(results[end].benchmark, results[begin].benchmark) == 0 &&
+           strcmp(results[end].corpus, results[begin].corpus) == 0) {
+      end++;
+    }
+    const BenchResult *smallest = &results[begin];
+    const BenchResult *largest = &results[end - 1];
+    begin = end;
+    if (smallest == largest || smallest->tokens == 0 ||
+        smallest->seconds <= 0 || largest->tokens <= smallest->tokens) {
+      continue;
+    }
+
+    // time ~ tokens ^ exponent between the smallest and the largest size
+    double exponent =
+        log(largest->seconds / smallest->seconds) /
+        log((double)largest->tokens / (double)smallest->tokens);
+    bool superlinear = exponent > BENCH_SUPERLINEAR_EXPONENT;
+    any_superlinear |= superlinear;
+    printf("%s\n    {\"benchmark\": \"%s\", \"corpus\": \"%s\", "
+           "\"min_tokens\": %zu, \"max_tokens\": %zu, \"exponent\": %.3f, "
+           "\"superlinear\": %s}",
+           first ? "" : ",", smallest->benchmark, smallest->corpus,
+           smallest->tokens, largest->tokens, exponent,
+           superlinear ? "true" : "false");
+    first = false;
+  }
+  printf("\n  ],\n");
+  return any_superlinear;
+}
+
+static void print_results(const BenchResult *results, size_t count) {
+  printf("  \"results\": [");
+  for (size_t i = 0; i < count; i++) {
+    const BenchResult *r = &results[i];
+    printf("%s\n    {\"benchmark\": \"%s\", \"corpus\": \"%s\", "
+           "\"bytes\": %zu, \"tokens\": %zu, \"seconds\": %.9f, "
+           "\"bytes_per_second\": %.1f, \"tokens_per_second\": %.1f, "
+           "\"ns_per_token\": %.3f}",
+           i == 0 ? "" : ",", r->benchmark, r->corpus, r->bytes, r->tokens,
+           r->seconds, (double)r->bytes / r->seconds,
+           (double)r->tokens / r->seconds,
+           r->tokens ? r->seconds * 1e9 / (double)r->tokens : 0.0);
+  }
+  printf("\n  ],\n");
+}
+
+int main(int argc, const char *argv[]) {
+  size_t max_bytes = BENCH_DEFAULT_MAX_BYTES;
+  for (int i = 1; i < argc; i++) {
+    char *end = NULL;
+    if (strcmp(argv[i], "--max-bytes") == 0 && i + 1 < argc) {
+      max_bytes = (size_t)strtoull(argv[++i], &end, 10);
+    }
+    if (end == NULL || *end != '\0' || max_bytes < BENCH_MIN_BYTES ||
+        max_bytes > BENCH_LIMIT_MAX_BYTES) {
+      fprintf(stderr, "usage: %s [--max-bytes <%llu..%llu>]\n", argv[0],
+              BENCH_MIN_BYTES, BENCH_LIMIT_MAX_BYTES);
+      return 1;
+    }
+  }
+
+  BenchResult *results = list(BenchResult, 64);
+  if (results == NULL) {
+    fprintf(stderr, "main(): out of memory\n");
+    return 1;
+  }
+
+  char *chars = checked_malloc(max_bytes);
+  size_t chunk_count = max_bytes / BENCH_CHUNK_SIZE;
+  char *chunks = checked_malloc(chunk_count * (BENCH_CHUNK_SIZE + 1));
+  for (size_t c = 0; c < sizeof(corpora) / sizeof(corpora[0]); c++) {
+    Corpus corpus = {chars, 0, max_bytes};
+    corpora[c].generate(&corpus);
+    // the smaller sizes are prefixes of the largest one
+    for (size_t i = 0; i < chunk_count; i++) {
+      char *chunk = chunks + i * (BENCH_CHUNK_SIZE + 1);
+      memcpy(chunk, chars + i * BENCH_CHUNK_SIZE, BENCH_CHUNK_SIZE);
+      chunk[BENCH_CHUNK_SIZE] = '\0';
+    }
+
+    for (size_t size = BENCH_MIN_BYTES; size <= max_bytes;
+         size *= BENCH_SIZE_STEP) {
+      add_result(&results, bench_lex(corpora[c].name, chars, size));
+    }
+    // adding and lexing copies end up in two groups of their own
+    BenchResult added[16];
+    BenchResult copied[16];
+    size_t sizes = 0;
+    for (size_t size = BENCH_MIN_BYTES; size <= max_bytes;
+         size *= BENCH_SIZE_STEP) {
+      bench_chunked(corpora[c].name, chunks, size, &added[sizes],
+                    &copied[sizes]);
+      sizes++;
+    }
+    for (size_t i = 0; i < sizes; i++) {
+      add_result(&results, added[i]);
+    }
+    for (size_t i = 0; i < sizes; i++) {
+      add_result(&results, copied[i]);
+    }
+  }
+  free(chunks);
+
+  // every size gets an expression of its own, a prefix could end in an
+  // operator
+  BenchResult layouts[16][4];
+  size_t sizes = 0;
+  for (size_t size = BENCH_MIN_BYTES; size <= max_bytes;
+       size *= BENCH_SIZE_STEP) {
+    Corpus corpus = {chars, 0, size};
+    generate_expression(&corpus);
+    bench_token_layouts(chars, corpus.size, layouts[sizes]);
+    sizes++;
+  }
+  for (int b = 0; b < 4; b++) {
+    for (size_t i = 0; i < sizes; i++) {
+      add_result(&results, layouts[i][b]);
+    }
+  }
+  free(chars);
+
+  for (size_t count = 1 << 18; count <= max_bytes / 4;
+       count *= BENCH_SIZE_STEP) {
+    add_result(&results, bench_list_add(count));
+  }
+  for (size_t count = 250000; count <= 4000000; count *= BENCH_SIZE_STEP) {
+    add_result(&results, bench_tiny_expressions(count));
+  }
+  BenchResult by_name[8];
+  BenchResult resolved[8];
+  size_t binding_sizes = 0;
+  for (size_t rows = 1 << 14; rows <= 1 << 18; rows *= BENCH_SIZE_STEP) {
+    bench_binding(rows, &by_name[binding_sizes], &resolved[binding_sizes]);
+    binding_sizes++;
+  }
+  for (size_t i = 0; i < binding_sizes; i++) {
+    add_result(&results, by_name[i]);
+  }
+  for (size_t i = 0; i < binding_sizes; i++) {
+    add_result(&results, resolved[i]);
+  }
+
+  size_t count = list_get_count(results);
+  printf("{\n  \"max_bytes\": %zu,\n", max_bytes);
+  print_results(results, count);
+  bool superlinear = print_scaling(results, count);
+  printf("  \"superlinear\": %s\n}\n", superlinear ? "true" : "false");
+
+  list_free(results);
+  return superlinear ? 1 : 0;
+}
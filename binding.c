@@ -0,0 +1,246 @@
+#include "binding.h"
+#include "hash.h"
+#include "memory.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+// seeds tried for one bucket before the entries are doubled
+#define BINDING_MAX_SEED 4096
+// times the entries are doubled before binding_init gives up
+#define BINDING_MAX_DOUBLINGS 8
+
+// the entry of a name with hash in a bucket with seed
+static size_t _binding_entry(uint64_t hash, uint32_t seed, size_t mask) {
+  hash ^= (uint64_t)seed * 0x9e3779b97f4a7c15u;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdu;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53u;
+  hash ^= hash >> 33;
+  return (size_t)hash & mask;
+}
+
+static size_t _binding_power_of_two(size_t at_least) {
+  size_t size = 1;
+  while (size < at_least) {
+    size *= 2;
+  }
+  return size;
+}
+
+// Finds a seed for every bucket, biggest buckets first while most entries are
+// still free. members lists the slots of each bucket from starts[bucket] to
+// starts[bucket + 1]. Returns false when some bucket ran out of seeds.
+static bool _binding_place(Binding *this, const uint64_t *hashes,
+                           const size_t *members, const size_t *starts,
+                           size_t largest) {
+  size_t bucket_count = this->_inner_bucket_mask + 1;
+  memset(this->_inner_entries, 0,
+         (this->_inner_entry_mask + 1) * sizeof(uint32_t));
+  for (size_t size = largest; size > 0; size--) {
+    for (size_t bucket = 0; bucket < bucket_count; bucket++) {
+      if (starts[bucket + 1] - starts[bucket] != size) {
+        continue;
+      }
+
+      uint32_t seed = 0;
+      for (size_t placed = 0; placed < size;) {
+        size_t slot = members[starts[bucket] + placed];
+        size_t entry =
+            _binding_entry(hashes[slot], seed, this->_inner_entry_mask);
+        if (this->_inner_entries[entry] == 0) {
+          this->_inner_entries[entry] = (uint32_t)(slot + 1);
+          placed++;
+          continue;
+        }
+
+        // take the bucket out again and try the next seed
+        while (placed-- > 0) {
+          size_t taken = members[starts[bucket] + placed];
+          this->_inner_entries[_binding_entry(hashes[taken], seed,
+                                              this->_inner_entry_mask)] = 0;
+        }
+        placed = 0;
+        if (++seed == BINDING_MAX_SEED) {
+          return false;
+        }
+      }
+      this->_inner_seeds[bucket] = seed;
+    }
+  }
+  return true;
+}
+
+static bool _binding_build(Binding *this, size_t variable_count) {
+  size_t bucket_count = _binding_power_of_two(variable_count / 2 + 1);
+  size_t entry_count = _binding_power_of_two(variable_count * 2 + 1);
+  uint64_t *hashes = memory_alloc(variable_count * sizeof(uint64_t));
+  size_t *members = memory_alloc(variable_count * sizeof(size_t));
+  size_t *starts = memory_alloc((bucket_count + 2) * sizeof(size_t));
+  this->_inner_seeds = memory_alloc(bucket_count * sizeof(uint32_t));
+  bool built = hashes != NULL && members != NULL && starts != NULL &&
+               this->_inner_seeds != NULL;
+  this->_inner_bucket_mask = bucket_count - 1;
+
+  if (built) {
+    // empty buckets keep seed 0, lookups still read it
+    memset(this->_inner_seeds, 0, bucket_count * sizeof(uint32_t));
+    // counting sort of the slots by bucket, starts[b + 1] counts bucket b
+    memset(starts, 0, (bucket_count + 2) * sizeof(size_t));
+    for (size_t slot = 0; slot < variable_count; slot++) {
+      const char *name = bytecode_get_variable_name(this->_inner_bytecode, slot);
+      hashes[slot] = hash_fnv1a(HASH_FNV1A_OFFSET, name, strlen(name));
+      starts[(hashes[slot] & this->_inner_bucket_mask) + 2]++;
+    }
+    size_t largest = 0;
+    for (size_t bucket = 0; bucket < bucket_count; bucket++) {
+      largest = starts[bucket + 2] > largest ? starts[bucket + 2] : largest;
+      starts[bucket + 2] += starts[bucket + 1];
+    }
+    for (size_t slot = 0; slot < variable_count; slot++) {
+      members[starts[(hashes[slot] & this->_inner_bucket_mask) + 1]++] = slot;
+    }
+
+    // More entries make every seed likelier to fit. Only two names with the
+    // same 64-bit hash never fit, the limit keeps that from looping forever.
+    size_t max_entry_count = entry_count << BINDING_MAX_DOUBLINGS;
+    for (;; entry_count *= 2) {
+      memory_free(this->_inner_entries);
+      this->_inner_entries = entry_count <= max_entry_count
+                                 ? memory_alloc(entry_count * sizeof(uint32_t))
+                                 : NULL;
+      this->_inner_entry_mask = entry_count - 1;
+      if (this->_inner_entries == NULL) {
+        built = false;
+        break;
+      }
+      if (_binding_place(this, hashes, members, starts, largest)) {
+        break;
+      }
+    }
+  }
+
+  memory_free(starts);
+  memory_free(members);
+  memory_free(hashes);
+  return built;
+}
+
+bool binding_init(Binding *binding, const Bytecode *bytecode) {
+  assert(binding && "binding_init(): arg binding was null");
+  assert(bytecode && "binding_init(): arg bytecode was null");
+  *binding = (Binding){._inner_bytecode = bytecode};
+  size_t variable_count = bytecode_get_variable_count(bytecode);
+  // nothing to look up or set, every array stays NULL
+  if (variable_count == 0) {
+    return true;
+  }
+  binding->_inner_values = memory_alloc(variable_count * sizeof(double));
+  if (binding->_inner_values == NULL ||
+      !_binding_build(binding, variable_count)) {
+    binding_destroy(binding);
+    return false;
+  }
+  binding_clear(binding);
+  return true;
+}
+
+void binding_destroy(Binding *binding) {
+  assert(binding && "binding_destroy(): arg binding was null");
+  memory_free(binding->_inner_values);
+  memory_free(binding->_inner_entries);
+  memory_free(binding->_inner_seeds);
+  *binding = (Binding){0};
+}
+
+bool binding_find_slot(const Binding *binding, const char *name,
+                       size_t length, size_t *slot) {
+  assert(binding && "binding_find_slot(): arg binding was null");
+  assert((name || length == 0) && "binding_find_slot(): arg name was null");
+  assert(slot && "binding_find_slot(): arg slot was null");
+  if (binding->_inner_entries == NULL) {
+    return false;
+  }
+  uint64_t hash = hash_fnv1a(HASH_FNV1A_OFFSET, name, length);
+  uint32_t seed = binding->_inner_seeds[hash & binding->_inner_bucket_mask];
+  uint32_t entry = binding->_inner_entries[_binding_entry(
+      hash, seed, binding->_inner_entry_mask)];
+  if (entry == 0) {
+    return false;
+  }
+
+  const char *variable =
+      bytecode_get_variable_name(binding->_inner_bytecode, entry - 1);
+  if (strncmp(variable, name, length) != 0 || variable[length] != '\0') {
+    return false;
+  }
+  *slot = entry - 1;
+  return true;
+}
+
+bool binding_set(Binding *binding, const char *name, size_t length,
+                 double value) {
+  assert(binding && "binding_set(): arg binding was null");
+  size_t slot;
+  if (!binding_find_slot(binding, name, length, &slot)) {
+    return false;
+  }
+  binding->_inner_values[slot] = value;
+  return true;
+}
+
+void binding_set_slot(Binding *binding, size_t slot, double value) {
+  assert(binding && "binding_set_slot(): arg binding was null");
+  assert(slot < bytecode_get_variable_count(binding->_inner_bytecode) &&
+         "binding_set_slot(): slot out of range");
+  binding->_inner_values[slot] = value;
+}
+
+void binding_clear(Binding *binding) {
+  assert(binding && "binding_clear(): arg binding was null");
+  size_t count = bytecode_get_variable_count(binding->_inner_bytecode);
+  for (size_t slot = 0; slot < count; slot++) {
+    binding->_inner_values[slot] = NAN;
+  }
+}
+
+const double *binding_get_values(const Binding *binding) {
+  assert(binding && "binding_get_values(): arg binding was null");
+  return binding->_inner_values;
+}
+
+bool binding_resolve_columns(const Binding *binding, const char *const *names,
+                             size_t name_count, size_t *columns) {
+  assert(binding && "binding_resolve_columns(): arg binding was null");
+  assert((names || name_count == 0) &&
+         "binding_resolve_columns(): arg names was null");
+  size_t variable_count = bytecode_get_variable_count(binding->_inner_bytecode);
+  assert((columns || variable_count == 0) &&
+         "binding_resolve_columns(): arg columns was null");
+  for (size_t slot = 0; slot < variable_count; slot++) {
+    columns[slot] = BINDING_NO_COLUMN;
+  }
+
+  // the first of repeated names wins, like a linear search would pick it
+  size_t resolved = 0;
+  for (size_t i = 0; i < name_count && resolved < variable_count; i++) {
+    size_t slot;
+    if (binding_find_slot(binding, names[i], strlen(names[i]), &slot) &&
+        columns[slot] == BINDING_NO_COLUMN) {
+      columns[slot] = i;
+      resolved++;
+    }
+  }
+  return resolved == variable_count;
+}
+
+void binding_set_row(Binding *binding, const size_t *columns,
+                     const double *row) {
+  assert(binding && "binding_set_row(): arg binding was null");
+  size_t count = bytecode_get_variable_count(binding->_inner_bytecode);
+  for (size_t slot = 0; slot < count; slot++) {
+    binding->_inner_values[slot] =
+        columns[slot] == BINDING_NO_COLUMN ? NAN : row[columns[slot]];
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef BINDING
+#define BINDING
+#include "bytecode.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// the column of a variable that none of the names given to
+// binding_resolve_columns matched
+#define BINDING_NO_COLUMN SIZE_MAX
+
+// The values of the variables of one Bytecode, ready to pass to vm_evaluate.
+// Values are set by slot, or by name through a perfect hash built once over
+// the expression's variables: a name hashes to the one entry its variable
+// can be in, so a lookup compares at most one name and names the expression
+// does not use are rejected as fast. Rows with many more columns than the
+// expression has variables resolve their columns once with
+// binding_resolve_columns and then only copy the columns that are used.
+typedef struct Binding {
+  const Bytecode *_inner_bytecode;
+  // a name's hash picks a bucket, and the seed of the bucket picks the entry,
+  // the seeds are chosen so that no two variables share an entry
+  uint32_t *_inner_seeds;
+  size_t _inner_bucket_mask; // bucket count - 1
+  uint32_t *_inner_entries;  // slot + 1 of the variable in each entry, 0 empty
+  size_t _inner_entry_mask;  // entry count - 1
+  double *_inner_values;     // one per slot, NAN until set
+} Binding;
+
+// bytecode has to outlive the binding. Returns false when out of memory, or
+// in the unlikely case that two variables share their whole 64-bit hash.
+bool binding_init(Binding *binding, const Bytecode *bytecode);
+void binding_destroy(Binding *binding);
+// returns false when the expression has no variable called name[0..length)
+bool binding_find_slot(const Binding *binding, const char *name,
+                       size_t length, size_t *slot);
+// returns false and ignores value when the expression does not use the name
+bool binding_set(Binding *binding, const char *name, size_t length,
+                 double value);
+void binding_set_slot(Binding *binding, size_t slot, double value);
+// sets every variable to NAN again
+void binding_clear(Binding *binding);
+// bytecode_get_variable_count values, the vars of vm_evaluate, NULL when the
+// expression has no variables
+const double *binding_get_values(const Binding *binding);
+// Writes the index in names[0..name_count) of each variable to
+// columns[slot], BINDING_NO_COLUMN for variables none of the names match.
+// columns holds bytecode_get_variable_count entries. Returns false when a
+// variable is missing.
+bool binding_resolve_columns(const Binding *binding, const char *const *names,
+                             size_t name_count, size_t *columns);
+// sets each variable to row[columns[slot]], NAN for BINDING_NO_COLUMN
+void binding_set_row(Binding *binding, const size_t *columns,
+                     const double *row);
+
+#endif
@@ -0,0 +1,132 @@
+#include "binding.h"
+#include "bytecode.h"
+#include "char_reader.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "test_helpers.h"
+#include "token_list.h"
+#include "vm.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static void test_set_by_name(void) {
+  Bytecode bytecode;
+  compile_string("price * qty - discount", &bytecode);
+  Binding binding;
+  assert(binding_init(&binding, &bytecode));
+
+  size_t slot;
+  assert(binding_find_slot(&binding, "qty", 3, &slot) && slot == 1);
+  assert(!binding_find_slot(&binding, "qt", 2, &slot));
+  assert(!binding_find_slot(&binding, "qtys", 4, &slot));
+  assert(!binding_find_slot(&binding, "tax", 3, &slot));
+
+  // unset variables are NAN
+  assert(isnan(vm_evaluate(&bytecode, binding_get_values(&binding))));
+  assert(binding_set(&binding, "price", 5, 2.5));
+  assert(binding_set(&binding, "qty", 3, 4));
+  assert(!binding_set(&binding, "tax", 3, 100));
+  binding_set_slot(&binding, 2, 1);
+  assert(vm_evaluate(&bytecode, binding_get_values(&binding)) == 9);
+
+  binding_clear(&binding);
+  assert(isnan(binding_get_values(&binding)[0]));
+
+  binding_destroy(&binding);
+  bytecode_destroy(&bytecode);
+}
+
+// an expression of few variables over rows of many columns
+static void test_resolve_columns(void) {
+  Bytecode bytecode;
+  compile_string("c250 * c3 + c17", &bytecode);
+  Binding binding;
+  assert(binding_init(&binding, &bytecode));
+
+  char name_chars[300][8];
+  const char *names[300];
+  double row[300];
+  for (size_t i = 0; i < 300; i++) {
+    sprintf(name_chars[i], "c%zu", i);
+    names[i] = name_chars[i];
+    row[i] = (double)i;
+  }
+
+  size_t columns[3];
+  assert(binding_resolve_columns(&binding, names, 300, columns));
+  assert(columns[0] == 250 && columns[1] == 3 && columns[2] == 17);
+  binding_set_row(&binding, columns, row);
+  assert(vm_evaluate(&bytecode, binding_get_values(&binding)) ==
+         250 * 3 + 17);
+
+  // c250 is missing from the first 100 names
+  assert(!binding_resolve_columns(&binding, names, 100, columns));
+  assert(columns[0] == BINDING_NO_COLUMN && columns[1] == 3);
+  binding_set_row(&binding, columns, row);
+  assert(isnan(binding_get_values(&binding)[0]));
+  assert(binding_get_values(&binding)[2] == 17);
+
+  binding_destroy(&binding);
+  bytecode_destroy(&bytecode);
+}
+
+// every variable of a large set gets an entry of its own
+static void test_many_variables(void) {
+  char input[40000];
+  size_t length = 0;
+  // (v0+...+v49)+(v50+...), a flat sum would nest too deep to compile
+  for (int i = 0; i < 2000; i++) {
+    const char *before = i % 50 == 0 ? (i == 0 ? "(" : "+(") : "+";
+    const char *after = i % 50 == 49 ? ")" : "";
+    length += (size_t)sprintf(input + length, "%sv%d%s", before, i, after);
+  }
+  Bytecode bytecode;
+  compile_string(input, &bytecode);
+  Binding binding;
+  assert(binding_init(&binding, &bytecode));
+
+  char name[16];
+  for (size_t i = 0; i < 2000; i++) {
+    sprintf(name, "v%zu", i);
+    size_t slot;
+    assert(binding_find_slot(&binding, name, strlen(name), &slot) &&
+           slot == i);
+    binding_set_slot(&binding, slot, 1);
+    sprintf(name, "w%zu", i);
+    assert(!binding_find_slot(&binding, name, strlen(name), &slot));
+  }
+  assert(vm_evaluate(&bytecode, binding_get_values(&binding)) == 2000);
+
+  binding_destroy(&binding);
+  bytecode_destroy(&bytecode);
+}
+
+static void test_no_variables(void) {
+  Bytecode bytecode;
+  compile_string("1 + 2", &bytecode);
+  Binding binding;
+  assert(binding_init(&binding, &bytecode));
+  assert(binding_get_values(&binding) == NULL);
+  size_t slot;
+  assert(!binding_find_slot(&binding, "x", 1, &slot));
+  assert(!binding_set(&binding, "x", 1, 1));
+  binding_clear(&binding);
+  binding_set_row(&binding, NULL, NULL);
+  const char *names[] = {"x"};
+  assert(binding_resolve_columns(&binding, names, 1, NULL));
+  assert(vm_evaluate(&bytecode, binding_get_values(&binding)) == 3);
+  binding_destroy(&binding);
+  bytecode_destroy(&bytecode);
+}
+
+int main(void) {
+  test_set_by_name();
+  test_resolve_columns();
+  test_many_variables();
+  test_no_variables();
+
+  printf("All binding tests passed\n");
+  return 0;
+}
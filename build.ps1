@@ -1,13 +1,100 @@
 $ErrorActionPreference = "Stop"
 
-$commonFlags = @("-std=c11", "-Wall", "-Wextra", "-Werror")
-$sharedSources = @("lexer.c", "char_reader.c", "token_list.c", "list.c")
+$commonFlags = @("-std=c11", "-Wall", "-Wextra", "-Werror", "-pthread")
+$sharedSources = @("memory.c", "number.c", "symbol_table.c", "lexer.c", "cpu_dispatch.c", "char_scan.c", "char_reader.c", "token_list.c", "list.c", "arena.c", "ast.c", "parser.c", "bytecode.c", "compiler.c", "binding.c", "value.c", "vm.c", "jit.c", "columns.c", "thread_pool.c", "parallel.c", "expression_cache.c", "optimizer.c", "formula_batch.c")
 
 Write-Host "Building main.exe..."
-& gcc @commonFlags @sharedSources "main.c" -o "main.exe"
+& gcc @commonFlags @sharedSources "main.c" "-lm" -o "main.exe"
+
+Write-Host "Building memory_test.exe..."
+& gcc @commonFlags @sharedSources "memory_test.c" "-lm" -o "memory_test.exe"
+
+Write-Host "Building number_test.exe..."
+& gcc @commonFlags @sharedSources "number_test.c" "-lm" -o "number_test.exe"
+
+Write-Host "Building symbol_table_test.exe..."
+& gcc @commonFlags @sharedSources "symbol_table_test.c" "-lm" -o "symbol_table_test.exe"
 
 Write-Host "Building lexer_test.exe..."
-& gcc @commonFlags @sharedSources "lexer_test.c" -o "lexer_test.exe"
+& gcc @commonFlags @sharedSources "lexer_test.c" "-lm" -o "lexer_test.exe"
+
+Write-Host "Building lexer_stats_test.exe..."
+& gcc @commonFlags "-DLEXER_STATS" @sharedSources "lexer_stats_test.c" "-lm" -o "lexer_stats_test.exe"
+
+Write-Host "Building parser_test.exe..."
+& gcc @commonFlags @sharedSources "parser_test.c" "-lm" -o "parser_test.exe"
+
+Write-Host "Building vm_test.exe..."
+& gcc @commonFlags @sharedSources "vm_test.c" "-lm" -o "vm_test.exe"
+
+Write-Host "Building binding_test.exe..."
+& gcc @commonFlags @sharedSources "binding_test.c" "-lm" -o "binding_test.exe"
+
+Write-Host "Building jit_test.exe..."
+& gcc @commonFlags @sharedSources "jit_test.c" "-lm" -o "jit_test.exe"
+
+Write-Host "Building columns_test.exe..."
+& gcc @commonFlags @sharedSources "columns_test.c" "-lm" -o "columns_test.exe"
+
+Write-Host "Building thread_pool_test.exe..."
+& gcc @commonFlags @sharedSources "thread_pool_test.c" "-lm" -o "thread_pool_test.exe"
+
+Write-Host "Building expression_cache_test.exe..."
+& gcc @commonFlags @sharedSources "expression_cache_test.c" "-lm" -o "expression_cache_test.exe"
+
+Write-Host "Building optimizer_test.exe..."
+& gcc @commonFlags @sharedSources "optimizer_test.c" "-lm" -o "optimizer_test.exe"
+
+Write-Host "Building formula_batch_test.exe..."
+& gcc @commonFlags @sharedSources "formula_batch_test.c" "-lm" -o "formula_batch_test.exe"
+
+Write-Host "Building lexer_bench.exe..."
+& gcc @commonFlags "-O2" "-DNDEBUG" @sharedSources "lexer_bench.c" "-lm" -o "lexer_bench.exe"
+
+Write-Host "Building parallel_bench.exe..."
+& gcc @commonFlags "-O2" "-DNDEBUG" @sharedSources "parallel_bench.c" "-lm" -o "parallel_bench.exe"
+
+Write-Host "Building bench.exe..."
+& gcc @commonFlags "-O2" "-DNDEBUG" @sharedSources "bench.c" "-lm" -o "bench.exe"
+
+Write-Host "Running memory_test.exe..."
+& "./memory_test.exe"
+
+Write-Host "Running number_test.exe..."
+& "./number_test.exe"
+
+Write-Host "Running symbol_table_test.exe..."
+& "./symbol_table_test.exe"
 
 Write-Host "Running lexer_test.exe..."
-& "./lexer_test.exe"
\ No newline at end of file
+& "./lexer_test.exe"
+
+Write-Host "Running lexer_stats_test.exe..."
+& "./lexer_stats_test.exe"
+
+Write-Host "Running parser_test.exe..."
+& "./parser_test.exe"
+
+Write-Host "Running vm_test.exe..."
+& "./vm_test.exe"
+
+Write-Host "Running binding_test.exe..."
+& "./binding_test.exe"
+
+Write-Host "Running jit_test.exe..."
+& "./jit_test.exe"
+
+Write-Host "Running columns_test.exe..."
+& "./columns_test.exe"
+
+Write-Host "Running thread_pool_test.exe..."
+& "./thread_pool_test.exe"
+
+Write-Host "Running expression_cache_test.exe..."
+& "./expression_cache_test.exe"
+
+Write-Host "Running optimizer_test.exe..."
+& "./optimizer_test.exe"
+
+Write-Host "Running formula_batch_test.exe..."
+& "./formula_batch_test.exe"
\ No newline at end of file
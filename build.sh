@@ -1,14 +1,101 @@
 #!/usr/bin/env sh
 set -e
 
-CFLAGS="-std=c11 -Wall -Wextra -Werror"
-SHARED_SOURCES="lexer.c char_reader.c token_list.c list.c"
+CFLAGS="-std=c11 -Wall -Wextra -Werror -pthread"
+SHARED_SOURCES="memory.c number.c symbol_table.c lexer.c cpu_dispatch.c char_scan.c char_reader.c token_list.c list.c arena.c ast.c parser.c bytecode.c compiler.c binding.c value.c vm.c jit.c columns.c thread_pool.c parallel.c expression_cache.c optimizer.c formula_batch.c"
 
 echo "Building main.exe..."
-gcc $CFLAGS main.c $SHARED_SOURCES -o main.exe
+gcc $CFLAGS main.c $SHARED_SOURCES -lm -o main.exe
+
+echo "Building memory_test.exe..."
+gcc $CFLAGS memory_test.c $SHARED_SOURCES -lm -o memory_test.exe
+
+echo "Building number_test.exe..."
+gcc $CFLAGS number_test.c $SHARED_SOURCES -lm -o number_test.exe
+
+echo "Building symbol_table_test.exe..."
+gcc $CFLAGS symbol_table_test.c $SHARED_SOURCES -lm -o symbol_table_test.exe
 
 echo "Building lexer_test.exe..."
-gcc $CFLAGS lexer_test.c $SHARED_SOURCES -o lexer_test.exe
+gcc $CFLAGS lexer_test.c $SHARED_SOURCES -lm -o lexer_test.exe
+
+echo "Building lexer_stats_test.exe..."
+gcc $CFLAGS -DLEXER_STATS lexer_stats_test.c $SHARED_SOURCES -lm -o lexer_stats_test.exe
+
+echo "Building parser_test.exe..."
+gcc $CFLAGS parser_test.c $SHARED_SOURCES -lm -o parser_test.exe
+
+echo "Building vm_test.exe..."
+gcc $CFLAGS vm_test.c $SHARED_SOURCES -lm -o vm_test.exe
+
+echo "Building binding_test.exe..."
+gcc $CFLAGS binding_test.c $SHARED_SOURCES -lm -o binding_test.exe
+
+echo "Building jit_test.exe..."
+gcc $CFLAGS jit_test.c $SHARED_SOURCES -lm -o jit_test.exe
+
+echo "Building columns_test.exe..."
+gcc $CFLAGS columns_test.c $SHARED_SOURCES -lm -o columns_test.exe
+
+echo "Building thread_pool_test.exe..."
+gcc $CFLAGS thread_pool_test.c $SHARED_SOURCES -lm -o thread_pool_test.exe
+
+echo "Building expression_cache_test.exe..."
+gcc $CFLAGS expression_cache_test.c $SHARED_SOURCES -lm -o expression_cache_test.exe
+
+echo "Building optimizer_test.exe..."
+gcc $CFLAGS optimizer_test.c $SHARED_SOURCES -lm -o optimizer_test.exe
+
+echo "Building formula_batch_test.exe..."
+gcc $CFLAGS formula_batch_test.c $SHARED_SOURCES -lm -o formula_batch_test.exe
+
+echo "Building lexer_bench.exe..."
+gcc $CFLAGS -O2 -DNDEBUG lexer_bench.c $SHARED_SOURCES -lm -o lexer_bench.exe
+
+echo "Building parallel_bench.exe..."
+gcc $CFLAGS -O2 -DNDEBUG parallel_bench.c $SHARED_SOURCES -lm -o parallel_bench.exe
+
+echo "Building bench.exe..."
+gcc $CFLAGS -O2 -DNDEBUG bench.c $SHARED_SOURCES -lm -o bench.exe
+
+echo "Running memory_test.exe..."
+./memory_test.exe
+
+echo "Running number_test.exe..."
+./number_test.exe
+
+echo "Running symbol_table_test.exe..."
+./symbol_table_test.exe
 
 echo "Running lexer_test.exe..."
-./lexer_test.exe
\ No newline at end of file
+./lexer_test.exe
+
+echo "Running lexer_stats_test.exe..."
+./lexer_stats_test.exe
+
+echo "Running parser_test.exe..."
+./parser_test.exe
+
+echo "Running vm_test.exe..."
+./vm_test.exe
+
+echo "Running binding_test.exe..."
+./binding_test.exe
+
+echo "Running jit_test.exe..."
+./jit_test.exe
+
+echo "Running columns_test.exe..."
+./columns_test.exe
+
+echo "Running thread_pool_test.exe..."
+./thread_pool_test.exe
+
+echo "Running expression_cache_test.exe..."
+./expression_cache_test.exe
+
+echo "Running optimizer_test.exe..."
+./optimizer_test.exe
+
+echo "Running formula_batch_test.exe..."
+./formula_batch_test.exe
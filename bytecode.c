@@ -0,0 +1,210 @@
+#include "bytecode.h"
+#include "list.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+const BytecodeFunctionInfo bytecode_functions[] = {
+    {"abs", fabs},   {"sqrt", sqrt},   {"cbrt", cbrt},   {"exp", exp},
+    {"log", log},    {"log2", log2},   {"log10", log10}, {"sin", sin},
+    {"cos", cos},    {"tan", tan},     {"asin", asin},   {"acos", acos},
+    {"atan", atan},  {"sinh", sinh},   {"cosh", cosh},   {"tanh", tanh},
+    {"floor", floor}, {"ceil", ceil},  {"round", round}, {"trunc", trunc},
+};
+
+const size_t bytecode_function_count =
+    sizeof(bytecode_functions) / sizeof(bytecode_functions[0]);
+
+bool bytecode_find_function(const char *name, size_t length,
+                            uint32_t *function) {
+  assert((name || length == 0) && "bytecode_find_function(): name was null");
+  assert(function && "bytecode_find_function(): function was null");
+  for (size_t i = 0; i < bytecode_function_count; i++) {
+    if (strlen(bytecode_functions[i].name) == length &&
+        memcmp(bytecode_functions[i].name, name, length) == 0) {
+      *function = (uint32_t)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool bytecode_init(Bytecode *bytecode) {
+  assert(bytecode && "bytecode_init(): arg bytecode was null");
+  bytecode->_inner_instructions = list(Instruction, 32);
+  bytecode->_inner_constants = list(double, 8);
+  bytecode->_inner_variable_names = list(char, 32);
+  bytecode->_inner_variable_name_starts = list(size_t, 8);
+  bytecode->_inner_max_stack = 0;
+  if (bytecode->_inner_instructions == NULL ||
+      bytecode->_inner_constants == NULL ||
+      bytecode->_inner_variable_names == NULL ||
+      bytecode->_inner_variable_name_starts == NULL) {
+    bytecode_destroy(bytecode);
+    return false;
+  }
+  return true;
+}
+
+void bytecode_destroy(Bytecode *bytecode) {
+  assert(bytecode && "bytecode_destroy(): arg bytecode was null");
+  if (bytecode->_inner_instructions != NULL) {
+    list_free(bytecode->_inner_instructions);
+  }
+  if (bytecode->_inner_constants != NULL) {
+    list_free(bytecode->_inner_constants);
+  }
+  if (bytecode->_inner_variable_names != NULL) {
+    list_free(bytecode->_inner_variable_names);
+  }
+  if (bytecode->_inner_variable_name_starts != NULL) {
+    list_free(bytecode->_inner_variable_name_starts);
+  }
+  bytecode->_inner_instructions = NULL;
+  bytecode->_inner_constants = NULL;
+  bytecode->_inner_variable_names = NULL;
+  bytecode->_inner_variable_name_starts = NULL;
+}
+
+void bytecode_clear(Bytecode *bytecode) {
+  assert(bytecode && "bytecode_clear(): arg bytecode was null");
+  list_clear(bytecode->_inner_instructions);
+  list_clear(bytecode->_inner_constants);
+  list_clear(bytecode->_inner_variable_names);
+  list_clear(bytecode->_inner_variable_name_starts);
+  bytecode->_inner_max_stack = 0;
+}
+
+bool bytecode_add_instruction(Bytecode *bytecode, Instruction instruction) {
+  assert(bytecode && "bytecode_add_instruction(): arg bytecode was null");
+  Instruction *instructions =
+      list_add(bytecode->_inner_instructions, &instruction);
+  if (instructions == NULL) {
+    return false;
+  }
+  bytecode->_inner_instructions = instructions;
+  return true;
+}
+
+bool bytecode_add_constant(Bytecode *bytecode, double value, uint32_t *index) {
+  assert(bytecode && "bytecode_add_constant(): arg bytecode was null");
+  assert(index && "bytecode_add_constant(): arg index was null");
+  size_t count = list_get_count(bytecode->_inner_constants);
+  if (count > INSTRUCTION_MAX_OPERAND) {
+    return false;
+  }
+
+  double *constants = list_add(bytecode->_inner_constants, &value);
+  if (constants == NULL) {
+    return false;
+  }
+  bytecode->_inner_constants = constants;
+  *index = (uint32_t)count;
+  return true;
+}
+
+static bool _bytecode_variable_equals(const Bytecode *this, size_t slot,
+                                      const char *name, size_t length) {
+  const char *variable =
+      &this->_inner_variable_names[this->_inner_variable_name_starts[slot]];
+  return strncmp(variable, name, length) == 0 && variable[length] == '\0';
+}
+
+bool bytecode_add_variable(Bytecode *bytecode, const char *name, size_t length,
+                           uint32_t *slot) {
+  assert(bytecode && "bytecode_add_variable(): arg bytecode was null");
+  assert(name && "bytecode_add_variable(): arg name was null");
+  assert(slot && "bytecode_add_variable(): arg slot was null");
+  size_t count = list_get_count(bytecode->_inner_variable_name_starts);
+  for (size_t i = 0; i < count; i++) {
+    if (_bytecode_variable_equals(bytecode, i, name, length)) {
+      *slot = (uint32_t)i;
+      return true;
+    }
+  }
+  if (count > INSTRUCTION_MAX_OPERAND) {
+    return false;
+  }
+
+  size_t start = list_get_count(bytecode->_inner_variable_names);
+  size_t *starts = list_add(bytecode->_inner_variable_name_starts, &start);
+  if (starts == NULL) {
+    return false;
+  }
+  bytecode->_inner_variable_name_starts = starts;
+
+  // a failure removes the half added name again
+  char *names = list_add_many(bytecode->_inner_variable_names, name, length);
+  if (names != NULL) {
+    bytecode->_inner_variable_names = names;
+    names = list_add(names, "");
+  }
+  if (names == NULL) {
+    list_remove_range(bytecode->_inner_variable_names, start,
+                      list_get_count(bytecode->_inner_variable_names) - start);
+    list_remove_range(bytecode->_inner_variable_name_starts, count, 1);
+    return false;
+  }
+  bytecode->_inner_variable_names = names;
+  *slot = (uint32_t)count;
+  return true;
+}
+
+size_t bytecode_get_instruction_count(const Bytecode *bytecode) {
+  assert(bytecode && "bytecode_get_instruction_count(): arg bytecode was null");
+  return list_get_count(bytecode->_inner_instructions);
+}
+
+const Instruction *bytecode_get_instructions(const Bytecode *bytecode) {
+  assert(bytecode && "bytecode_get_instructions(): arg bytecode was null");
+  return bytecode->_inner_instructions;
+}
+
+const double *bytecode_get_constants(const Bytecode *bytecode) {
+  assert(bytecode && "bytecode_get_constants(): arg bytecode was null");
+  return bytecode->_inner_constants;
+}
+
+size_t bytecode_get_max_stack(const Bytecode *bytecode) {
+  assert(bytecode && "bytecode_get_max_stack(): arg bytecode was null");
+  return bytecode->_inner_max_stack;
+}
+
+size_t bytecode_get_memory_size(const Bytecode *bytecode) {
+  assert(bytecode && "bytecode_get_memory_size(): arg bytecode was null");
+  return list_get_capacity(bytecode->_inner_instructions) *
+             sizeof(Instruction) +
+         list_get_capacity(bytecode->_inner_constants) * sizeof(double) +
+         list_get_capacity(bytecode->_inner_variable_names) +
+         list_get_capacity(bytecode->_inner_variable_name_starts) *
+             sizeof(size_t);
+}
+
+size_t bytecode_get_variable_count(const Bytecode *bytecode) {
+  assert(bytecode && "bytecode_get_variable_count(): arg bytecode was null");
+  return list_get_count(bytecode->_inner_variable_name_starts);
+}
+
+const char *bytecode_get_variable_name(const Bytecode *bytecode, size_t slot) {
+  assert(bytecode && "bytecode_get_variable_name(): arg bytecode was null");
+  assert(slot < list_get_count(bytecode->_inner_variable_name_starts) &&
+         "bytecode_get_variable_name(): slot out of bounds");
+  return &bytecode->_inner_variable_names
+              [bytecode->_inner_variable_name_starts[slot]];
+}
+
+bool bytecode_find_variable(const Bytecode *bytecode, const char *name,
+                            size_t *slot) {
+  assert(bytecode && "bytecode_find_variable(): arg bytecode was null");
+  assert(name && "bytecode_find_variable(): arg name was null");
+  assert(slot && "bytecode_find_variable(): arg slot was null");
+  size_t length = strlen(name);
+  size_t count = list_get_count(bytecode->_inner_variable_name_starts);
+  for (size_t i = 0; i < count; i++) {
+    if (_bytecode_variable_equals(bytecode, i, name, length)) {
+      *slot = i;
+      return true;
+    }
+  }
+  return false;
+}
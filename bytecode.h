@@ -0,0 +1,81 @@
+#ifndef BYTECODE
+#define BYTECODE
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum Opcode {
+  OP_PUSH_CONSTANT, // push constants[operand]
+  OP_LOAD_VARIABLE, // push vars[operand]
+  OP_NEGATE,
+  OP_ADD,
+  OP_SUBTRACT,
+  OP_MULTIPLY,
+  OP_DIVIDE,
+  OP_MODULO, // fmod
+  OP_POWER,  // pow
+  OP_CALL,   // apply bytecode_functions[operand] to the top of the stack
+  OP_RETURN, // the top of the stack is the result
+  OPCODE_COUNT
+} Opcode;
+
+// an instruction is the opcode in the low 8 bits and the operand above them
+typedef uint32_t Instruction;
+#define INSTRUCTION(opcode, operand) ((Instruction)(opcode) | ((operand) << 8))
+#define INSTRUCTION_OPCODE(instruction) ((Opcode)((instruction) & 0xffu))
+#define INSTRUCTION_OPERAND(instruction) ((instruction) >> 8)
+#define INSTRUCTION_MAX_OPERAND 0xffffffu
+
+// deeper expressions fail to compile, evaluation keeps its stack in a local
+// array of this size
+#define BYTECODE_MAX_STACK 1024
+
+typedef double (*BytecodeFunction)(double);
+
+typedef struct BytecodeFunctionInfo {
+  const char *name;
+  BytecodeFunction function;
+} BytecodeFunctionInfo;
+
+// the functions an expression can call, sqrt(x) abs(x) sin(x) ...
+extern const BytecodeFunctionInfo bytecode_functions[];
+extern const size_t bytecode_function_count;
+// returns false when there is no function called name[0..length)
+bool bytecode_find_function(const char *name, size_t length,
+                            uint32_t *function);
+
+// One compiled expression. Variables are numbered in the order they first
+// appear in the expression, evaluation reads variable i from vars[i]. Once
+// compiled it is only read, so one Bytecode can be evaluated from many
+// threads at the same time.
+typedef struct Bytecode {
+  Instruction *_inner_instructions;
+  double *_inner_constants;
+  char *_inner_variable_names;        // NUL terminated names, one after another
+  size_t *_inner_variable_name_starts; // index of each name in the names
+  size_t _inner_max_stack;
+} Bytecode;
+
+bool bytecode_init(Bytecode *bytecode);
+void bytecode_destroy(Bytecode *bytecode);
+void bytecode_clear(Bytecode *bytecode);
+bool bytecode_add_instruction(Bytecode *bytecode, Instruction instruction);
+// false when out of memory or there are more than INSTRUCTION_MAX_OPERAND
+bool bytecode_add_constant(Bytecode *bytecode, double value, uint32_t *index);
+// returns the slot of name[0..length), adding the variable when it is new
+bool bytecode_add_variable(Bytecode *bytecode, const char *name, size_t length,
+                           uint32_t *slot);
+
+size_t bytecode_get_instruction_count(const Bytecode *bytecode);
+const Instruction *bytecode_get_instructions(const Bytecode *bytecode);
+const double *bytecode_get_constants(const Bytecode *bytecode);
+size_t bytecode_get_max_stack(const Bytecode *bytecode);
+// the bytes allocated for the items of the lists, spare capacity included
+size_t bytecode_get_memory_size(const Bytecode *bytecode);
+size_t bytecode_get_variable_count(const Bytecode *bytecode);
+const char *bytecode_get_variable_name(const Bytecode *bytecode, size_t slot);
+// returns false when the expression does not use a variable called name
+bool bytecode_find_variable(const Bytecode *bytecode, const char *name,
+                            size_t *slot);
+
+#endif
@@ -1,89 +1,323 @@
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L
+#define CHAR_READER_POSIX
+#endif
+
 #include "char_reader.h"
+#include "arena.h"
+#include "memory.h"
 #include <assert.h>
-#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 
+#ifdef CHAR_READER_POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 void char_reader_init(CharReader *reader) {
   assert(reader && "char_reader_init(): parameter reader was null");
+  char_reader_init_in(reader, NULL);
+}
+
+void char_reader_init_in(CharReader *reader, Arena *arena) {
+  assert(reader && "char_reader_init_in(): parameter reader was null");
   reader->current_read_position = 0;
   reader->head = NULL;
   reader->tail = NULL;
+  reader->read_mappings = NULL;
+  reader->arena = arena;
 }
 
-void char_reader_destroy(CharReader *reader) {
-  assert(reader && "char_reader_destroy(): parameter reader was null");
-  reader->current_read_position = 0;
+static void *_char_reader_alloc(CharReader *reader, size_t size) {
+  return reader->arena != NULL ? arena_alloc(reader->arena, size)
+                               : memory_alloc(size);
+}
+
+static void *_char_reader_realloc(CharReader *reader, void *ptr,
+                                  size_t old_size, size_t new_size) {
+  return reader->arena != NULL
+             ? arena_realloc(reader->arena, ptr, old_size, new_size)
+             : memory_realloc(ptr, new_size);
+}
+
+// arena memory is only released by the arena reset
+static void _char_reader_free(CharReader *reader, void *ptr) {
+  if (reader->arena == NULL) {
+    memory_free(ptr);
+  }
+}
 
-  CharReaderNode *current = reader->head;
+static void _char_reader_free_node(CharReader *reader, CharReaderNode *node) {
+  switch (node->source) {
+  case CHAR_READER_COPY:
+    _char_reader_free(reader, (char *)node->str_buffer);
+    break;
+  case CHAR_READER_VIEW:
+    break;
+  case CHAR_READER_MAPPED:
+#ifdef CHAR_READER_POSIX
+    munmap((void *)node->str_buffer, node->str_length);
+#endif
+    break;
+  }
+  _char_reader_free(reader, node);
+}
+
+static void _char_reader_free_nodes(CharReader *reader,
+                                    CharReaderNode *current) {
   while (current != NULL) {
     CharReaderNode *next = current->next;
-    free(current->str_buffer);
-    free(current);
+    _char_reader_free_node(reader, current);
     current = next;
   }
+}
+
+void char_reader_destroy(CharReader *reader) {
+  assert(reader && "char_reader_destroy(): parameter reader was null");
+  reader->current_read_position = 0;
+
+  _char_reader_free_nodes(reader, reader->head);
+  _char_reader_free_nodes(reader, reader->read_mappings);
 
   reader->head = NULL;
   reader->tail = NULL;
+  reader->read_mappings = NULL;
+}
+
+static bool _char_reader_append_node(CharReader *reader, const char *str,
+                                     size_t length, CharReaderSource source) {
+  CharReaderNode *new_node = _char_reader_alloc(reader, sizeof(CharReaderNode));
+  if(new_node == NULL) {
+    return false;
+  }
+
+  new_node->str_buffer = str;
+  new_node->str_length = length;
+  new_node->source = source;
+  new_node->next = NULL;
+
+  CharReaderNode *prev = reader->tail;
+  if(prev == NULL) {
+    reader->head = new_node;
+    reader->tail = new_node;
+    return true;
+  }
+
+  prev->next = new_node;
+  reader->tail = new_node;
+  return true;
 }
 
 bool char_reader_add(CharReader *reader, const char *str) {
   assert(reader && "char_reader_add(): parameter reader was null");
   assert(str && "char_reader_add(): parameter str was null");
 
-  size_t str_size = strlen(str) + 1;
-  char* str_cpy = malloc(str_size * sizeof(char));
+  size_t str_length = strlen(str);
+  char* str_cpy = _char_reader_alloc(reader, (str_length + 1) * sizeof(char));
   if(str_cpy == NULL) {
     return false;
   }
 
-  memcpy(str_cpy, str, str_size * sizeof(char));
+  memcpy(str_cpy, str, (str_length + 1) * sizeof(char));
 
-  CharReaderNode *new_node = malloc(sizeof(CharReaderNode));
-  if(new_node == NULL) {
-    free(str_cpy);
+  if(!_char_reader_append_node(reader, str_cpy, str_length,
+                               CHAR_READER_COPY)) {
+    _char_reader_free(reader, str_cpy);
     return false;
   }
+  return true;
+}
 
-  new_node->str_buffer = str_cpy;
-  new_node->next = NULL;
+bool char_reader_add_view(CharReader *reader, const char *str, size_t length) {
+  assert(reader && "char_reader_add_view(): parameter reader was null");
+  assert((str || length == 0) &&
+         "char_reader_add_view(): parameter str was null");
 
-  CharReaderNode *prev = reader->tail;
-  if(prev == NULL) {
-    reader->head = new_node;
-    reader->tail = new_node;
+  return _char_reader_append_node(reader, str, length, CHAR_READER_VIEW);
+}
+
+#ifdef CHAR_READER_POSIX
+static bool _char_reader_add_read_fd(CharReader *reader, int fd) {
+  size_t capacity = 4096;
+  size_t length = 0;
+  char *buffer = _char_reader_alloc(reader, capacity);
+  if (buffer == NULL) {
+    return false;
+  }
+
+  for (;;) {
+    if (length == capacity) {
+      char *new_buffer =
+          capacity > SIZE_MAX / 2
+              ? NULL
+              : _char_reader_realloc(reader, buffer, capacity, capacity * 2);
+      if (new_buffer == NULL) {
+        _char_reader_free(reader, buffer);
+        return false;
+      }
+      buffer = new_buffer;
+      capacity *= 2;
+    }
+
+    ssize_t read_count = read(fd, buffer + length, capacity - length);
+    if (read_count == 0) {
+      break;
+    }
+    if (read_count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      _char_reader_free(reader, buffer);
+      return false;
+    }
+    length += (size_t)read_count;
+  }
+
+  if (!_char_reader_append_node(reader, buffer, length, CHAR_READER_COPY)) {
+    _char_reader_free(reader, buffer);
+    return false;
+  }
+  return true;
+}
+
+bool char_reader_add_fd(CharReader *reader, int fd) {
+  assert(reader && "char_reader_add_fd(): parameter reader was null");
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    return false;
+  }
+
+  if (!S_ISREG(file_stat.st_mode)) {
+    return _char_reader_add_read_fd(reader, fd);
+  }
+  if (file_stat.st_size == 0) {
     return true;
   }
+  if ((uintmax_t)file_stat.st_size > SIZE_MAX) {
+    return false;
+  }
 
-  prev->next = new_node;
-  reader->tail = new_node;
+  size_t length = (size_t)file_stat.st_size;
+  void *mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+  // only a hint, lexing reads the file once from start to end
+  posix_madvise(mapping, length, POSIX_MADV_SEQUENTIAL);
+
+  if (!_char_reader_append_node(reader, mapping, length, CHAR_READER_MAPPED)) {
+    munmap(mapping, length);
+    return false;
+  }
+  return true;
+}
+
+bool char_reader_add_file(CharReader *reader, const char *path) {
+  assert(reader && "char_reader_add_file(): parameter reader was null");
+  assert(path && "char_reader_add_file(): parameter path was null");
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  bool added = char_reader_add_fd(reader, fd);
+  close(fd);
+  return added;
+}
+#else
+bool char_reader_add_file(CharReader *reader, const char *path) {
+  assert(reader && "char_reader_add_file(): parameter reader was null");
+  assert(path && "char_reader_add_file(): parameter path was null");
+
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return false;
+  }
+
+  size_t capacity = 4096;
+  size_t length = 0;
+  char *buffer = _char_reader_alloc(reader, capacity);
+  while (buffer != NULL) {
+    length += fread(buffer + length, 1, capacity - length, file);
+    if (length < capacity) {
+      break;
+    }
+
+    char *new_buffer =
+        capacity > SIZE_MAX / 2
+            ? NULL
+            : _char_reader_realloc(reader, buffer, capacity, capacity * 2);
+    if (new_buffer == NULL) {
+      _char_reader_free(reader, buffer);
+    }
+    buffer = new_buffer;
+    capacity *= 2;
+  }
+
+  bool failed = buffer == NULL || ferror(file);
+  fclose(file);
+  if (failed ||
+      !_char_reader_append_node(reader, buffer, length, CHAR_READER_COPY)) {
+    _char_reader_free(reader, buffer);
+    return false;
+  }
   return true;
 }
+#endif
 
 char char_reader_read(CharReader *reader) {
   assert(reader && "char_reader_read(): parameter reader was null");
-  if(reader->head == NULL) {
+  CharReaderSpan span = char_reader_peek_span(reader);
+  if(span.length == 0) {
     return '\0';
   }
 
-  char current_char = reader->head->str_buffer[reader->current_read_position];
-  while(current_char == '\0') {
-    CharReaderNode *next = reader->head->next;
+  char_reader_consume(reader, 1);
+  return span.chars[0];
+}
 
-    free(reader->head->str_buffer);
-    free(reader->head);
+CharReaderSpan char_reader_peek_span(CharReader *reader) {
+  assert(reader && "char_reader_peek_span(): parameter reader was null");
 
-    reader->head = next;
+  // drop the nodes that were read to the end, once per node. Mappings stay
+  // alive since lexemes may still point into them.
+  while(reader->head != NULL &&
+        reader->current_read_position == reader->head->str_length) {
+    CharReaderNode *read_node = reader->head;
+    reader->head = read_node->next;
+    reader->current_read_position = 0;
 
-    if(next == NULL) {
-      reader->tail = NULL;
-      reader->current_read_position = 0;
-      return '\0';
+    if(read_node->source == CHAR_READER_MAPPED) {
+      read_node->next = reader->read_mappings;
+      reader->read_mappings = read_node;
+    } else {
+      _char_reader_free_node(reader, read_node);
     }
+  }
 
-    reader->current_read_position = 0;
-    current_char = reader->head->str_buffer[reader->current_read_position];
+  if(reader->head == NULL) {
+    reader->tail = NULL;
+    return (CharReaderSpan){.chars = NULL, .length = 0, .is_borrowed = false};
   }
 
-  reader->current_read_position++;
-  return current_char;
+  CharReaderNode *head = reader->head;
+  return (CharReaderSpan){
+      .chars = &head->str_buffer[reader->current_read_position],
+      .length = head->str_length - reader->current_read_position,
+      .is_borrowed = head->source != CHAR_READER_COPY};
+}
+
+void char_reader_consume(CharReader *reader, size_t count) {
+  assert(reader && "char_reader_consume(): parameter reader was null");
+  assert((count == 0 || (reader->head && reader->head->str_length -
+                                               reader->current_read_position >=
+                                           count)) &&
+         "char_reader_consume(): consumed past the current span");
+  reader->current_read_position += count;
 }
@@ -3,20 +3,59 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+typedef struct Arena Arena;
+
+typedef enum CharReaderSource {
+  CHAR_READER_COPY,   // str_buffer is a copy owned by the reader
+  CHAR_READER_VIEW,   // str_buffer belongs to the caller, never freed
+  CHAR_READER_MAPPED, // str_buffer is a file mapping owned by the reader
+} CharReaderSource;
+
 typedef struct CharReaderNode {
-  char *str_buffer;
+  const char *str_buffer;
+  size_t str_length;
+  CharReaderSource source;
   struct CharReaderNode* next;
 } CharReaderNode;
 
+typedef struct CharReaderSpan {
+  const char *chars;
+  size_t length;
+  bool is_borrowed; // chars stays valid after the span was consumed
+} CharReaderSpan;
+
 typedef struct CharReader {
   size_t current_read_position;
   CharReaderNode *head;
   CharReaderNode *tail;
+  CharReaderNode *read_mappings; // mapped nodes already read, kept mapped
+  Arena *arena; // nodes and copies come from here when not NULL
 } CharReader;
 
 void char_reader_init(CharReader *reader);
+// nodes and copied strings are allocated from arena and released by its
+// reset. The reader still has to be destroyed, before the reset, to unmap
+// the files it mapped.
+void char_reader_init_in(CharReader *reader, Arena *arena);
 void char_reader_destroy(CharReader *reader);
 bool char_reader_add(CharReader *reader, const char *str);
+// borrows str[0..length) without copying, the caller keeps it alive and
+// unchanged until the reader and every token lexed from it are destroyed
+bool char_reader_add_view(CharReader *reader, const char *str, size_t length);
+// maps the whole file read only (or reads it where mmap is not available).
+// The mapping lives until char_reader_destroy, so tokens lexed from it have
+// to be destroyed before the reader.
+bool char_reader_add_file(CharReader *reader, const char *path);
+#if defined(__unix__) || defined(__APPLE__)
+// like char_reader_add_file, fd is left open. Files that can not be mapped,
+// such as pipes, are read to the end into a copy.
+bool char_reader_add_fd(CharReader *reader, int fd);
+#endif
 char char_reader_read(CharReader *reader);
+// the largest contiguous unread span of the current node, length 0 once all
+// input was read. chars stays valid until the span is fully consumed.
+CharReaderSpan char_reader_peek_span(CharReader *reader);
+// marks the first count chars of the current span as read
+void char_reader_consume(CharReader *reader, size_t count);
 
 #endif
@@ -0,0 +1,185 @@
+#include "char_scan.h"
+#include <assert.h>
+#include <stdint.h>
+
+#ifdef CPU_DISPATCH_X86
+#include <immintrin.h>
+#endif
+
+typedef struct CharScanFunctions {
+  size_t (*digits)(const char *chars, size_t length);
+  size_t (*identifier)(const char *chars, size_t length);
+  size_t (*whitespace)(const char *chars, size_t length);
+} CharScanFunctions;
+
+static inline bool _char_scan_is_digit(unsigned char c) {
+  return (unsigned char)(c - '0') <= 9;
+}
+
+static inline bool _char_scan_is_identifier(unsigned char c) {
+  return _char_scan_is_digit(c) || (unsigned char)((c | 0x20) - 'a') <= 25 ||
+         c == '_';
+}
+
+static inline bool _char_scan_is_whitespace(unsigned char c) {
+  return c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t';
+}
+
+#define CHAR_SCAN_DEFINE_SCALAR(name)                                          \
+  static size_t _char_scan_##name##_scalar(const char *chars, size_t length) { \
+    size_t i = 0;                                                              \
+    while (i < length && _char_scan_is_##name((unsigned char)chars[i])) {      \
+      i++;                                                                     \
+    }                                                                          \
+    return i;                                                                  \
+  }
+
+CHAR_SCAN_DEFINE_SCALAR(digit)
+CHAR_SCAN_DEFINE_SCALAR(identifier)
+CHAR_SCAN_DEFINE_SCALAR(whitespace)
+
+#ifdef CPU_DISPATCH_X86
+// the masks set every byte of the run to 0xff, "x <= max" on unsigned bytes
+// is computed as "min(x, max) == x" since SSE2 has no unsigned compare
+static inline __m128i _char_scan_below_sse2(__m128i x, char max) {
+  return _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(max)), x);
+}
+
+static inline __m128i _char_scan_digit_mask_sse2(__m128i v) {
+  return _char_scan_below_sse2(_mm_sub_epi8(v, _mm_set1_epi8('0')), 9);
+}
+
+static inline __m128i _char_scan_identifier_mask_sse2(__m128i v) {
+  __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  __m128i letter =
+      _char_scan_below_sse2(_mm_sub_epi8(lower, _mm_set1_epi8('a')), 25);
+  __m128i underscore = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+  return _mm_or_si128(_mm_or_si128(letter, underscore),
+                      _char_scan_digit_mask_sse2(v));
+}
+
+static inline __m128i _char_scan_whitespace_mask_sse2(__m128i v) {
+  __m128i control = _char_scan_below_sse2(
+      _mm_sub_epi8(v, _mm_set1_epi8('\t')), '\r' - '\t');
+  return _mm_or_si128(control, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+}
+
+#define CHAR_SCAN_DEFINE_SSE2(name)                                            \
+  static size_t _char_scan_##name##_sse2(const char *chars, size_t length) {   \
+    size_t i = 0;                                                              \
+    for (; i + 16 <= length; i += 16) {                                        \
+      __m128i v = _mm_loadu_si128((const __m128i *)(chars + i));               \
+      unsigned mismatch =                                                      \
+          ~(unsigned)_mm_movemask_epi8(_char_scan_##name##_mask_sse2(v)) &     \
+          0xffffu;                                                             \
+      if (mismatch) {                                                          \
+        return i + (size_t)__builtin_ctz(mismatch);                            \
+      }                                                                        \
+    }                                                                          \
+    return i + _char_scan_##name##_scalar(chars + i, length - i);              \
+  }
+
+CHAR_SCAN_DEFINE_SSE2(digit)
+CHAR_SCAN_DEFINE_SSE2(identifier)
+CHAR_SCAN_DEFINE_SSE2(whitespace)
+
+#define CHAR_SCAN_TARGET_AVX2 __attribute__((target("avx2")))
+
+CHAR_SCAN_TARGET_AVX2 static inline __m256i
+_char_scan_below_avx2(__m256i x, char max) {
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(max)), x);
+}
+
+CHAR_SCAN_TARGET_AVX2 static inline __m256i
+_char_scan_digit_mask_avx2(__m256i v) {
+  return _char_scan_below_avx2(_mm256_sub_epi8(v, _mm256_set1_epi8('0')), 9);
+}
+
+CHAR_SCAN_TARGET_AVX2 static inline __m256i
+_char_scan_identifier_mask_avx2(__m256i v) {
+  __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+  __m256i letter =
+      _char_scan_below_avx2(_mm256_sub_epi8(lower, _mm256_set1_epi8('a')), 25);
+  __m256i underscore = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+  return _mm256_or_si256(_mm256_or_si256(letter, underscore),
+                         _char_scan_digit_mask_avx2(v));
+}
+
+CHAR_SCAN_TARGET_AVX2 static inline __m256i
+_char_scan_whitespace_mask_avx2(__m256i v) {
+  __m256i control = _char_scan_below_avx2(
+      _mm256_sub_epi8(v, _mm256_set1_epi8('\t')), '\r' - '\t');
+  return _mm256_or_si256(control, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+}
+
+#define CHAR_SCAN_DEFINE_AVX2(name)                                            \
+  CHAR_SCAN_TARGET_AVX2 static size_t _char_scan_##name##_avx2(               \
+      const char *chars, size_t length) {                                      \
+    size_t i = 0;                                                              \
+    for (; i + 32 <= length; i += 32) {                                        \
+      __m256i v = _mm256_loadu_si256((const __m256i *)(chars + i));            \
+      uint32_t mismatch = ~(uint32_t)_mm256_movemask_epi8(                     \
+          _char_scan_##name##_mask_avx2(v));                                   \
+      if (mismatch) {                                                          \
+        return i + (size_t)__builtin_ctz(mismatch);                            \
+      }                                                                        \
+    }                                                                          \
+    /* gcc leaves the upper halves dirty on this path, which would slow */    \
+    /* down every following SSE instruction */                                \
+    _mm256_zeroupper();                                                        \
+    return i + _char_scan_##name##_sse2(chars + i, length - i);                \
+  }
+
+CHAR_SCAN_DEFINE_AVX2(digit)
+CHAR_SCAN_DEFINE_AVX2(identifier)
+CHAR_SCAN_DEFINE_AVX2(whitespace)
+#endif
+
+static const CharScanFunctions
+    _char_scan_implementations[CHAR_SCAN_IMPLEMENTATION_COUNT] = {
+        [CHAR_SCAN_SCALAR] = {_char_scan_digit_scalar,
+                              _char_scan_identifier_scalar,
+                              _char_scan_whitespace_scalar},
+#ifdef CPU_DISPATCH_X86
+        [CHAR_SCAN_SSE2] = {_char_scan_digit_sse2, _char_scan_identifier_sse2,
+                            _char_scan_whitespace_sse2},
+        [CHAR_SCAN_AVX2] = {_char_scan_digit_avx2, _char_scan_identifier_avx2,
+                            _char_scan_whitespace_avx2},
+#endif
+};
+
+static CpuDispatch _char_scan_dispatch =
+    CPU_DISPATCH_INIT(_char_scan_implementations);
+
+static inline const CharScanFunctions *_char_scan_resolve(void) {
+  return cpu_dispatch_resolve(&_char_scan_dispatch);
+}
+
+bool char_scan_is_supported(CharScanImplementation implementation) {
+  return cpu_level_is_supported((CpuLevel)implementation);
+}
+
+CharScanImplementation char_scan_get_implementation(void) {
+  return (CharScanImplementation)cpu_dispatch_get_level(&_char_scan_dispatch);
+}
+
+bool char_scan_set_implementation(CharScanImplementation implementation) {
+  assert(implementation < CHAR_SCAN_IMPLEMENTATION_COUNT &&
+         "char_scan_set_implementation(): unknown implementation");
+  return cpu_dispatch_set_level(&_char_scan_dispatch, (CpuLevel)implementation);
+}
+
+size_t char_scan_digits(const char *chars, size_t length) {
+  assert((chars || length == 0) && "char_scan_digits(): chars was null");
+  return _char_scan_resolve()->digits(chars, length);
+}
+
+size_t char_scan_identifier(const char *chars, size_t length) {
+  assert((chars || length == 0) && "char_scan_identifier(): chars was null");
+  return _char_scan_resolve()->identifier(chars, length);
+}
+
+size_t char_scan_whitespace(const char *chars, size_t length) {
+  assert((chars || length == 0) && "char_scan_whitespace(): chars was null");
+  return _char_scan_resolve()->whitespace(chars, length);
+}
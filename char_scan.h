@@ -0,0 +1,27 @@
+#ifndef CHAR_SCAN
+#define CHAR_SCAN
+#include "cpu_dispatch.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum CharScanImplementation {
+  CHAR_SCAN_SCALAR = CPU_LEVEL_SCALAR,
+  CHAR_SCAN_SSE2 = CPU_LEVEL_SSE2,
+  CHAR_SCAN_AVX2 = CPU_LEVEL_AVX2,
+  CHAR_SCAN_IMPLEMENTATION_COUNT = CPU_LEVEL_COUNT
+} CharScanImplementation;
+
+// Each scanner returns the length of the run of matching chars at the start
+// of chars[0..length), so the run ends at chars[result] when result < length.
+size_t char_scan_digits(const char *chars, size_t length);     // 0-9
+size_t char_scan_identifier(const char *chars, size_t length); // a-z A-Z 0-9 _
+size_t char_scan_whitespace(const char *chars, size_t length); // " \t\n\v\f\r"
+
+// The scanners the lexer runs, the widest the cpu supports unless tests or
+// benchmarks pin another one to compare them.
+CharScanImplementation char_scan_get_implementation(void);
+bool char_scan_is_supported(CharScanImplementation implementation);
+// pins the scanners, false when the cpu can not run them
+bool char_scan_set_implementation(CharScanImplementation implementation);
+
+#endif
@@ -0,0 +1,397 @@
+#include "columns.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CPU_DISPATCH_X86
+#include <immintrin.h>
+#endif
+
+typedef void (*ColumnsBinaryKernel)(double *out, const double *a,
+                                    const double *b, size_t count);
+typedef void (*ColumnsUnaryKernel)(double *out, const double *a,
+                                   size_t count);
+
+typedef struct ColumnsKernels {
+  ColumnsBinaryKernel add;
+  ColumnsBinaryKernel subtract;
+  ColumnsBinaryKernel multiply;
+  ColumnsBinaryKernel divide;
+  ColumnsUnaryKernel negate;
+} ColumnsKernels;
+
+// out may be a or b, every kernel reads a value before it writes it
+#define COLUMNS_DEFINE_SCALAR(name, op)                                        \
+  static void _columns_##name##_scalar(double *out, const double *a,           \
+                                       const double *b, size_t count) {        \
+    for (size_t i = 0; i < count; i++) {                                       \
+      out[i] = a[i] op b[i];                                                   \
+    }                                                                          \
+  }
+
+COLUMNS_DEFINE_SCALAR(add, +)
+COLUMNS_DEFINE_SCALAR(subtract, -)
+COLUMNS_DEFINE_SCALAR(multiply, *)
+COLUMNS_DEFINE_SCALAR(divide, /)
+
+static void _columns_negate_scalar(double *out, const double *a,
+                                   size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    out[i] = -a[i];
+  }
+}
+
+#ifdef CPU_DISPATCH_X86
+#define COLUMNS_DEFINE_SSE2(name, instruction)                                 \
+  static void _columns_##name##_sse2(double *out, const double *a,             \
+                                     const double *b, size_t count) {          \
+    size_t i = 0;                                                              \
+    for (; i + 2 <= count; i += 2) {                                           \
+      _mm_storeu_pd(out + i, instruction(_mm_loadu_pd(a + i),                  \
+                                         _mm_loadu_pd(b + i)));                \
+    }                                                                          \
+    _columns_##name##_scalar(out + i, a + i, b + i, count - i);                \
+  }
+
+COLUMNS_DEFINE_SSE2(add, _mm_add_pd)
+COLUMNS_DEFINE_SSE2(subtract, _mm_sub_pd)
+COLUMNS_DEFINE_SSE2(multiply, _mm_mul_pd)
+COLUMNS_DEFINE_SSE2(divide, _mm_div_pd)
+
+static void _columns_negate_sse2(double *out, const double *a, size_t count) {
+  __m128d sign = _mm_set1_pd(-0.0);
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    _mm_storeu_pd(out + i, _mm_xor_pd(_mm_loadu_pd(a + i), sign));
+  }
+  _columns_negate_scalar(out + i, a + i, count - i);
+}
+
+#define COLUMNS_TARGET_AVX2 __attribute__((target("avx2")))
+
+#define COLUMNS_DEFINE_AVX2(name, instruction)                                 \
+  COLUMNS_TARGET_AVX2 static void _columns_##name##_avx2(                      \
+      double *out, const double *a, const double *b, size_t count) {           \
+    size_t i = 0;                                                              \
+    for (; i + 4 <= count; i += 4) {                                           \
+      _mm256_storeu_pd(out + i, instruction(_mm256_loadu_pd(a + i),            \
+                                            _mm256_loadu_pd(b + i)));          \
+    }                                                                          \
+    _mm256_zeroupper();                                                        \
+    _columns_##name##_sse2(out + i, a + i, b + i, count - i);                  \
+  }
+
+COLUMNS_DEFINE_AVX2(add, _mm256_add_pd)
+COLUMNS_DEFINE_AVX2(subtract, _mm256_sub_pd)
+COLUMNS_DEFINE_AVX2(multiply, _mm256_mul_pd)
+COLUMNS_DEFINE_AVX2(divide, _mm256_div_pd)
+
+COLUMNS_TARGET_AVX2 static void _columns_negate_avx2(double *out,
+                                                     const double *a,
+                                                     size_t count) {
+  __m256d sign = _mm256_set1_pd(-0.0);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    _mm256_storeu_pd(out + i, _mm256_xor_pd(_mm256_loadu_pd(a + i), sign));
+  }
+  _mm256_zeroupper();
+  _columns_negate_sse2(out + i, a + i, count - i);
+}
+#endif
+
+static const ColumnsKernels
+    _columns_implementations[COLUMNS_IMPLEMENTATION_COUNT] = {
+        [COLUMNS_SCALAR] = {_columns_add_scalar, _columns_subtract_scalar,
+                            _columns_multiply_scalar, _columns_divide_scalar,
+                            _columns_negate_scalar},
+#ifdef CPU_DISPATCH_X86
+        [COLUMNS_SSE2] = {_columns_add_sse2, _columns_subtract_sse2,
+                          _columns_multiply_sse2, _columns_divide_sse2,
+                          _columns_negate_sse2},
+        [COLUMNS_AVX2] = {_columns_add_avx2, _columns_subtract_avx2,
+                          _columns_multiply_avx2, _columns_divide_avx2,
+                          _columns_negate_avx2},
+#endif
+};
+
+static CpuDispatch _columns_dispatch =
+    CPU_DISPATCH_INIT(_columns_implementations);
+
+static inline const ColumnsKernels *_columns_resolve(void) {
+  return cpu_dispatch_resolve(&_columns_dispatch);
+}
+
+bool columns_is_supported(ColumnsImplementation implementation) {
+  return cpu_level_is_supported((CpuLevel)implementation);
+}
+
+ColumnsImplementation columns_get_implementation(void) {
+  return (ColumnsImplementation)cpu_dispatch_get_level(&_columns_dispatch);
+}
+
+bool columns_set_implementation(ColumnsImplementation implementation) {
+  assert(implementation < COLUMNS_IMPLEMENTATION_COUNT &&
+         "columns_set_implementation(): unknown implementation");
+  return cpu_dispatch_set_level(&_columns_dispatch, (CpuLevel)implementation);
+}
+
+// the buffers of the stack slots, slot 0 writes straight into out
+#define COLUMNS_LOCAL_SLOTS 8
+
+// Runs every instruction over rows [0, count) of one block. Each stack slot
+// is a pointer to count values: into a column for loaded variables, or to
+// the buffer of the slot for computed values.
+static void _columns_run_block(const ColumnsKernels *kernels,
+                               const Bytecode *compiled,
+                               const double *const *cols, size_t first_row,
+                               size_t count, double *const *buffers,
+                               const double **slots, double *out) {
+  const Instruction *instructions = bytecode_get_instructions(compiled);
+  const double *constants = bytecode_get_constants(compiled);
+  size_t depth = 0;
+
+  for (const Instruction *ip = instructions;; ip++) {
+    Opcode opcode = INSTRUCTION_OPCODE(*ip);
+    uint32_t operand = INSTRUCTION_OPERAND(*ip);
+    double *result;
+
+    switch (opcode) {
+    case OP_PUSH_CONSTANT:
+      for (size_t i = 0; i < count; i++) {
+        buffers[depth][i] = constants[operand];
+      }
+      slots[depth] = buffers[depth];
+      depth++;
+      break;
+    case OP_LOAD_VARIABLE:
+      slots[depth++] = cols[operand] + first_row;
+      break;
+    case OP_NEGATE:
+      result = buffers[depth - 1];
+      kernels->negate(result, slots[depth - 1], count);
+      slots[depth - 1] = result;
+      break;
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_MULTIPLY:
+    case OP_DIVIDE: {
+      ColumnsBinaryKernel kernel = opcode == OP_ADD        ? kernels->add
+                                   : opcode == OP_SUBTRACT ? kernels->subtract
+                                   : opcode == OP_MULTIPLY ? kernels->multiply
+                                                           : kernels->divide;
+      result = buffers[depth - 2];
+      kernel(result, slots[depth - 2], slots[depth - 1], count);
+      slots[depth - 2] = result;
+      depth--;
+      break;
+    }
+    case OP_MODULO:
+    case OP_POWER: {
+      result = buffers[depth - 2];
+      const double *a = slots[depth - 2];
+      const double *b = slots[depth - 1];
+      for (size_t i = 0; i < count; i++) {
+        result[i] = opcode == OP_MODULO ? fmod(a[i], b[i]) : pow(a[i], b[i]);
+      }
+      slots[depth - 2] = result;
+      depth--;
+      break;
+    }
+    case OP_CALL: {
+      BytecodeFunction function = bytecode_functions[operand].function;
+      result = buffers[depth - 1];
+      const double *a = slots[depth - 1];
+      for (size_t i = 0; i < count; i++) {
+        result[i] = function(a[i]);
+      }
+      slots[depth - 1] = result;
+      break;
+    }
+    case OP_RETURN:
+      if (slots[0] != out) {
+        memcpy(out, slots[0], count * sizeof(double));
+      }
+      return;
+    default:
+      assert(0 && "_columns_run_block(): unknown opcode");
+      return;
+    }
+  }
+}
+
+bool eval_columns(const Bytecode *compiled, const double *cols[],
+                  size_t nrows, double *out) {
+  assert(compiled && "eval_columns(): arg compiled was null");
+  assert((cols || bytecode_get_variable_count(compiled) == 0) &&
+         "eval_columns(): arg cols was null");
+  assert((out || nrows == 0) && "eval_columns(): arg out was null");
+  assert(bytecode_get_instruction_count(compiled) &&
+         "eval_columns(): bytecode is empty");
+  if (nrows == 0) {
+    return true;
+  }
+
+  size_t slot_count = bytecode_get_max_stack(compiled);
+  _Alignas(32) double local[COLUMNS_LOCAL_SLOTS - 1][COLUMNS_BLOCK_ROWS];
+  double *local_buffers[COLUMNS_LOCAL_SLOTS];
+  const double *local_slots[COLUMNS_LOCAL_SLOTS];
+  double *heap = NULL;
+  double **buffers = local_buffers;
+  const double **slots = local_slots;
+
+  if (slot_count > COLUMNS_LOCAL_SLOTS) {
+    heap = malloc((slot_count - 1) * COLUMNS_BLOCK_ROWS * sizeof(double) +
+                  slot_count * (sizeof(double *) + sizeof(const double *)));
+    if (heap == NULL) {
+      return false;
+    }
+    buffers = (double **)(heap + (slot_count - 1) * COLUMNS_BLOCK_ROWS);
+    slots = (const double **)(buffers + slot_count);
+  }
+  for (size_t slot = 1; slot < slot_count; slot++) {
+    buffers[slot] = heap != NULL ? heap + (slot - 1) * COLUMNS_BLOCK_ROWS
+                                 : local[slot - 1];
+  }
+
+  const ColumnsKernels *kernels = _columns_resolve();
+  for (size_t row = 0; row < nrows; row += COLUMNS_BLOCK_ROWS) {
+    size_t count = nrows - row < COLUMNS_BLOCK_ROWS ? nrows - row
+                                                    : COLUMNS_BLOCK_ROWS;
+    buffers[0] = out + row;
+    _columns_run_block(kernels, compiled, cols, row, count, buffers, slots,
+                       out + row);
+  }
+
+  free(heap);
+  return true;
+}
+
+// applies function to each value of the top two slots into the lower one
+#define COLUMNS_VALUE_BINARY(function)                                         \
+  for (size_t i = 0; i < count; i++) {                                         \
+    result[i] = function(a[i], b[i]);                                          \
+  }
+
+// _columns_run_block over values, without kernels
+static void _columns_run_value_block(const Bytecode *compiled,
+                                     const Value *const *cols,
+                                     size_t first_row, size_t count,
+                                     Value *const *buffers,
+                                     const Value **slots, Value *out) {
+  const Instruction *instructions = bytecode_get_instructions(compiled);
+  const double *constants = bytecode_get_constants(compiled);
+  size_t depth = 0;
+
+  for (const Instruction *ip = instructions;; ip++) {
+    Opcode opcode = INSTRUCTION_OPCODE(*ip);
+    uint32_t operand = INSTRUCTION_OPERAND(*ip);
+    Value *result;
+
+    switch (opcode) {
+    case OP_PUSH_CONSTANT: {
+      Value constant = value_from_double(constants[operand]);
+      for (size_t i = 0; i < count; i++) {
+        buffers[depth][i] = constant;
+      }
+      slots[depth] = buffers[depth];
+      depth++;
+      break;
+    }
+    case OP_LOAD_VARIABLE:
+      slots[depth++] = cols[operand] + first_row;
+      break;
+    case OP_NEGATE: {
+      result = buffers[depth - 1];
+      const Value *a = slots[depth - 1];
+      for (size_t i = 0; i < count; i++) {
+        result[i] = value_negate(a[i]);
+      }
+      slots[depth - 1] = result;
+      break;
+    }
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_MULTIPLY:
+    case OP_DIVIDE:
+    case OP_MODULO:
+    case OP_POWER: {
+      result = buffers[depth - 2];
+      const Value *a = slots[depth - 2];
+      const Value *b = slots[depth - 1];
+      if (opcode == OP_ADD) {
+        COLUMNS_VALUE_BINARY(value_add)
+      } else if (opcode == OP_SUBTRACT) {
+        COLUMNS_VALUE_BINARY(value_subtract)
+      } else if (opcode == OP_MULTIPLY) {
+        COLUMNS_VALUE_BINARY(value_multiply)
+      } else if (opcode == OP_DIVIDE) {
+        COLUMNS_VALUE_BINARY(value_divide)
+      } else if (opcode == OP_MODULO) {
+        COLUMNS_VALUE_BINARY(value_modulo)
+      } else {
+        COLUMNS_VALUE_BINARY(value_power)
+      }
+      slots[depth - 2] = result;
+      depth--;
+      break;
+    }
+    case OP_CALL: {
+      BytecodeFunction function = bytecode_functions[operand].function;
+      result = buffers[depth - 1];
+      const Value *a = slots[depth - 1];
+      for (size_t i = 0; i < count; i++) {
+        result[i] = value_number(function(value_to_double(a[i])));
+      }
+      slots[depth - 1] = result;
+      break;
+    }
+    case OP_RETURN:
+      if (slots[0] != out) {
+        memcpy(out, slots[0], count * sizeof(Value));
+      }
+      return;
+    default:
+      assert(0 && "_columns_run_value_block(): unknown opcode");
+      return;
+    }
+  }
+}
+
+bool eval_value_columns(const Bytecode *compiled, const Value *cols[],
+                        size_t nrows, Value *out) {
+  assert(compiled && "eval_value_columns(): arg compiled was null");
+  assert((cols || bytecode_get_variable_count(compiled) == 0) &&
+         "eval_value_columns(): arg cols was null");
+  assert((out || nrows == 0) && "eval_value_columns(): arg out was null");
+  assert(bytecode_get_instruction_count(compiled) &&
+         "eval_value_columns(): bytecode is empty");
+  if (nrows == 0) {
+    return true;
+  }
+
+  // the buffers of slots 1.., then the buffer and slot pointers
+  size_t slot_count = bytecode_get_max_stack(compiled);
+  Value *heap =
+      malloc((slot_count - 1) * COLUMNS_BLOCK_ROWS * sizeof(Value) +
+             slot_count * (sizeof(Value *) + sizeof(const Value *)));
+  if (heap == NULL) {
+    return false;
+  }
+  Value **buffers = (Value **)(heap + (slot_count - 1) * COLUMNS_BLOCK_ROWS);
+  const Value **slots = (const Value **)(buffers + slot_count);
+  for (size_t slot = 1; slot < slot_count; slot++) {
+    buffers[slot] = heap + (slot - 1) * COLUMNS_BLOCK_ROWS;
+  }
+
+  for (size_t row = 0; row < nrows; row += COLUMNS_BLOCK_ROWS) {
+    size_t count = nrows - row < COLUMNS_BLOCK_ROWS ? nrows - row
+                                                    : COLUMNS_BLOCK_ROWS;
+    buffers[0] = out + row;
+    _columns_run_value_block(compiled, cols, row, count, buffers, slots,
+                             out + row);
+  }
+
+  free(heap);
+  return true;
+}
@@ -0,0 +1,41 @@
+#ifndef COLUMNS
+#define COLUMNS
+#include "bytecode.h"
+#include "cpu_dispatch.h"
+#include "value.h"
+
+typedef enum ColumnsImplementation {
+  COLUMNS_SCALAR = CPU_LEVEL_SCALAR,
+  COLUMNS_SSE2 = CPU_LEVEL_SSE2,
+  COLUMNS_AVX2 = CPU_LEVEL_AVX2,
+  COLUMNS_IMPLEMENTATION_COUNT = CPU_LEVEL_COUNT
+} ColumnsImplementation;
+
+// rows evaluated per instruction, so the intermediate values of a block stay
+// in the L1 cache
+#define COLUMNS_BLOCK_ROWS 256
+
+// Evaluates compiled for every row, cols[i][row] is the value of variable i
+// in that row and out[row] receives the result. out must not overlap the
+// columns. + - * / and negation run as SIMD kernels over whole blocks, % ^
+// and calls apply fmod, pow and the function to each value of the block.
+// Returns false when out of memory.
+bool eval_columns(const Bytecode *compiled, const double *cols[],
+                  size_t nrows, double *out);
+
+// eval_columns with the exact integers of vm_evaluate_value, cols[i][row]
+// and out[row] are Values. Runs each instruction over a block like
+// eval_columns but one value at a time, the SIMD kernels only know doubles.
+// Returns false when out of memory.
+bool eval_value_columns(const Bytecode *compiled, const Value *cols[],
+                        size_t nrows, Value *out);
+
+// The kernels eval_columns runs the arithmetic of a block with, 4 doubles
+// wide with AVX2, 2 with SSE2 or 1 at a time.
+ColumnsImplementation columns_get_implementation(void);
+bool columns_is_supported(ColumnsImplementation implementation);
+// switches the kernels of every later eval_columns, false when the cpu can
+// not run them
+bool columns_set_implementation(ColumnsImplementation implementation);
+
+#endif
@@ -0,0 +1,198 @@
+#include "bytecode.h"
+#include "char_reader.h"
+#include "columns.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "test_helpers.h"
+#include "token_list.h"
+#include "vm.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VARIABLE_COUNT 4
+
+static bool same_bits(double a, double b) {
+  return (isnan(a) && isnan(b)) || memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+// evaluates input over nrows rows with every implementation and compares
+// each row with vm_evaluate
+static void run_columns_test(const char *input, size_t nrows) {
+  Bytecode bytecode;
+  compile_string(input, &bytecode);
+  size_t variable_count = bytecode_get_variable_count(&bytecode);
+  assert(variable_count <= VARIABLE_COUNT);
+
+  double *values = malloc((nrows * VARIABLE_COUNT + 1) * sizeof(double));
+  double *out = malloc((nrows + 1) * sizeof(double));
+  assert(values && out);
+  const double *cols[VARIABLE_COUNT];
+  for (size_t v = 0; v < VARIABLE_COUNT; v++) {
+    cols[v] = values + v * nrows;
+  }
+  for (size_t i = 0; i < nrows * VARIABLE_COUNT; i++) {
+    values[i] = (double)(rand() % 4001) / 100.0 - 20.0;
+  }
+
+  ColumnsImplementation default_implementation = columns_get_implementation();
+  for (int impl = 0; impl < COLUMNS_IMPLEMENTATION_COUNT; impl++) {
+    if (!columns_set_implementation((ColumnsImplementation)impl)) {
+      continue;
+    }
+
+    out[nrows] = 12345; // must stay untouched
+    assert(eval_columns(&bytecode, cols, nrows, out));
+    assert(out[nrows] == 12345);
+    for (size_t row = 0; row < nrows; row++) {
+      double vars[VARIABLE_COUNT];
+      for (size_t v = 0; v < variable_count; v++) {
+        vars[v] = cols[v][row];
+      }
+      double expected = vm_evaluate(&bytecode, vars);
+      if (!same_bits(out[row], expected)) {
+        fprintf(stderr, "\"%s\" row %zu: %.17g, expected %.17g\n", input, row,
+                out[row], expected);
+      }
+      assert(same_bits(out[row], expected));
+    }
+  }
+  assert(columns_set_implementation(default_implementation));
+
+  free(values);
+  free(out);
+  bytecode_destroy(&bytecode);
+}
+
+static void test_block_boundaries(void) {
+  size_t sizes[] = {0, 1, 3, COLUMNS_BLOCK_ROWS - 1, COLUMNS_BLOCK_ROWS,
+                    COLUMNS_BLOCK_ROWS + 1, 3 * COLUMNS_BLOCK_ROWS + 7};
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    run_columns_test("x * 2 + y / -z - 0.5", sizes[i]);
+  }
+}
+
+static void test_operators(void) {
+  run_columns_test("x", 100);
+  run_columns_test("3.25", 100);
+  run_columns_test("-x", 100);
+  run_columns_test("x % y + y ^ 2 - abs(z) ** 0.5", 1000);
+  run_columns_test("sqrt(abs(x * y)) / (w - x)", 1000);
+}
+
+static void test_deep_stack_uses_heap_buffers(void) {
+  char input[512] = "";
+  for (int i = 0; i < 12; i++) {
+    strcat(input, "x - (");
+  }
+  strcat(input, "y");
+  for (int i = 0; i < 12; i++) {
+    strcat(input, ")");
+  }
+  run_columns_test(input, 2 * COLUMNS_BLOCK_ROWS + 5);
+}
+
+static bool same_value(Value a, Value b) {
+  return a.type == b.type && (a.type == VALUE_INTEGER
+                                  ? a.integer == b.integer
+                                  : same_bits(a.number, b.number));
+}
+
+// eval_value_columns over mostly integer columns, compared with
+// vm_evaluate_value row by row
+static void run_value_columns_test(const char *input, size_t nrows) {
+  Bytecode bytecode;
+  compile_string(input, &bytecode);
+  size_t variable_count = bytecode_get_variable_count(&bytecode);
+  assert(variable_count <= VARIABLE_COUNT);
+
+  Value *values = malloc((nrows * VARIABLE_COUNT + 1) * sizeof(Value));
+  Value *out = malloc((nrows + 1) * sizeof(Value));
+  assert(values && out);
+  const Value *cols[VARIABLE_COUNT];
+  for (size_t v = 0; v < VARIABLE_COUNT; v++) {
+    cols[v] = values + v * nrows;
+  }
+  // a few doubles and large integers, whose products overflow int64
+  for (size_t i = 0; i < nrows * VARIABLE_COUNT; i++) {
+    int64_t integer = rand() % 41 - 20;
+    values[i] = rand() % 8 == 0   ? value_number((double)integer / 4)
+                : rand() % 8 == 0 ? value_integer(integer * 1000000007)
+                                  : value_integer(integer);
+  }
+
+  out[nrows] = value_integer(12345); // must stay untouched
+  assert(eval_value_columns(&bytecode, cols, nrows, out));
+  assert(same_value(out[nrows], value_integer(12345)));
+  for (size_t row = 0; row < nrows; row++) {
+    Value vars[VARIABLE_COUNT];
+    for (size_t v = 0; v < variable_count; v++) {
+      vars[v] = cols[v][row];
+    }
+    Value expected = vm_evaluate_value(&bytecode, vars);
+    if (!same_value(out[row], expected)) {
+      fprintf(stderr, "\"%s\" row %zu: %.17g, expected %.17g\n", input, row,
+              value_to_double(out[row]), value_to_double(expected));
+    }
+    assert(same_value(out[row], expected));
+  }
+
+  free(values);
+  free(out);
+  bytecode_destroy(&bytecode);
+}
+
+static void test_value_columns(void) {
+  run_value_columns_test("x * 2 + y / -z - 0.5", 0);
+  run_value_columns_test("x", 3 * COLUMNS_BLOCK_ROWS + 7);
+  run_value_columns_test("3", COLUMNS_BLOCK_ROWS);
+  run_value_columns_test("x * y * z * w - x / y", 2 * COLUMNS_BLOCK_ROWS + 1);
+  run_value_columns_test("x % y + y ^ 3 - abs(z) ** 0.5", 1000);
+
+  // 2 ^ 62 * 2 overflows into a double, 2 ^ 62 stays exact
+  Bytecode bytecode;
+  compile_string("x ^ 62 * y", &bytecode);
+  Value xs[2] = {value_integer(2), value_integer(2)};
+  Value ys[2] = {value_integer(1), value_integer(2)};
+  const Value *cols[2] = {xs, ys};
+  Value out[2];
+  assert(eval_value_columns(&bytecode, cols, 2, out));
+  assert(same_value(out[0], value_integer(INT64_C(1) << 62)));
+  assert(same_value(out[1], value_number(9223372036854775808.0)));
+  bytecode_destroy(&bytecode);
+}
+
+// variables w x y z, operations without calls
+static const char *const random_operators[] = {" + ", " - ", " * ",
+                                               " / ", " % ", " ^ "};
+static const char *const random_variables[] = {"w", "x", "y", "z"};
+static const ExpressionShape random_shape = {
+    random_operators, TEST_COUNT_OF(random_operators),
+    random_variables, TEST_COUNT_OF(random_variables),
+    NULL,             0,
+    NULL,             0,
+    .fractions = 100, .negates = true, .mixes_brackets = false};
+
+static void test_random_expressions(void) {
+  for (int i = 0; i < 300; i++) {
+    char input[4096];
+    size_t length = generate_expression(&random_shape, input, 0, 1 + rand() % 6);
+    input[length] = '\0';
+    run_columns_test(input, (size_t)(rand() % (3 * COLUMNS_BLOCK_ROWS)));
+    run_value_columns_test(input, (size_t)(rand() % (3 * COLUMNS_BLOCK_ROWS)));
+  }
+}
+
+int main(void) {
+  srand(7);
+  test_block_boundaries();
+  test_operators();
+  test_deep_stack_uses_heap_buffers();
+  test_value_columns();
+  test_random_expressions();
+
+  printf("All columns tests passed\n");
+  return 0;
+}
@@ -0,0 +1,224 @@
+#include "compiler.h"
+#include "list.h"
+#include "symbol_table.h"
+#include <assert.h>
+
+typedef struct Compiler {
+  const Ast *ast;
+  TokenList *tokens;
+  size_t first_token;
+  Bytecode *bytecode;
+  CompileError *error;
+  size_t depth;       // of the recursion
+  size_t stack_count; // values on the evaluation stack at this point
+  // slot + 1 of each symbol bound so far, 0 when it is not bound yet. NULL
+  // until the first interned identifier.
+  uint32_t *symbol_slots;
+} Compiler;
+
+static const Opcode _compiler_binary_opcodes[AST_NODE_TYPE_COUNT] = {
+    [AST_ADD] = OP_ADD,           [AST_SUBTRACT] = OP_SUBTRACT,
+    [AST_MULTIPLY] = OP_MULTIPLY, [AST_DIVIDE] = OP_DIVIDE,
+    [AST_MODULO] = OP_MODULO,     [AST_POWER] = OP_POWER,
+};
+
+static bool _compiler_fail(Compiler *this, CompileErrorType type,
+                           const AstNode *node) {
+  this->error->type = type;
+  this->error->token_index = this->first_token + node->token_index;
+  return false;
+}
+
+static bool _compiler_emit_instruction(Compiler *this, Opcode opcode,
+                                       uint32_t operand, int stack_change,
+                                       const AstNode *node) {
+  assert(operand <= INSTRUCTION_MAX_OPERAND &&
+         "_compiler_emit_instruction(): operand does not fit");
+  if (!bytecode_add_instruction(this->bytecode,
+                                INSTRUCTION(opcode, operand))) {
+    return _compiler_fail(this, COMPILE_OUT_OF_MEMORY, node);
+  }
+
+  this->stack_count += (size_t)stack_change;
+  if (this->stack_count > BYTECODE_MAX_STACK) {
+    return _compiler_fail(this, COMPILE_TOO_DEEP, node);
+  }
+  if (this->stack_count > this->bytecode->_inner_max_stack) {
+    this->bytecode->_inner_max_stack = this->stack_count;
+  }
+  return true;
+}
+
+static Lexeme _compiler_get_name(Compiler *this, const AstNode *node) {
+  Token token = token_list_get_token_at(this->tokens,
+                                        this->first_token + node->token_index);
+  return token_list_get_lexeme(this->tokens, token);
+}
+
+// Writes the slot of a variable. An interned identifier is bound by indexing
+// with its symbol, only its first use compares names.
+static bool _compiler_bind_variable(Compiler *this, const AstNode *node,
+                                    uint32_t *slot) {
+  Token token = token_list_get_token_at(this->tokens,
+                                        this->first_token + node->token_index);
+  uint32_t symbol = token.symbol;
+  if (symbol != SYMBOL_NONE && this->symbol_slots != NULL &&
+      symbol < list_get_count(this->symbol_slots) &&
+      this->symbol_slots[symbol] != 0) {
+    *slot = this->symbol_slots[symbol] - 1;
+    return true;
+  }
+
+  Lexeme name = token_list_get_lexeme(this->tokens, token);
+  if (!bytecode_add_variable(this->bytecode, name.chars, name.length, slot)) {
+    return false;
+  }
+  if (symbol == SYMBOL_NONE) {
+    return true;
+  }
+
+  if (this->symbol_slots == NULL) {
+    this->symbol_slots = list(uint32_t, 64);
+    if (this->symbol_slots == NULL) {
+      return false;
+    }
+  }
+  static const uint32_t unbound[64] = {0};
+  for (size_t count; (count = list_get_count(this->symbol_slots)) <= symbol;) {
+    size_t added = symbol + 1 - count < 64 ? symbol + 1 - count : 64;
+    uint32_t *grown = list_add_many(this->symbol_slots, unbound, added);
+    if (grown == NULL) {
+      return false;
+    }
+    this->symbol_slots = grown;
+  }
+  this->symbol_slots[symbol] = *slot + 1;
+  return true;
+}
+
+// emits the code that leaves the value of the subtree of index on the stack
+static bool _compiler_emit(Compiler *this, uint32_t index) {
+  const AstNode *node = ast_get_node(this->ast, index);
+  if (++this->depth > BYTECODE_MAX_STACK) {
+    return _compiler_fail(this, COMPILE_TOO_DEEP, node);
+  }
+
+  uint32_t operand;
+  Lexeme name;
+  bool emitted;
+  switch (node->type) {
+  case AST_NUMBER:
+    emitted = (bytecode_add_constant(this->bytecode, node->number, &operand) ||
+               _compiler_fail(this, COMPILE_OUT_OF_MEMORY, node)) &&
+              _compiler_emit_instruction(this, OP_PUSH_CONSTANT, operand, 1,
+                                         node);
+    break;
+  case AST_VARIABLE:
+    emitted = (_compiler_bind_variable(this, node, &operand) ||
+               _compiler_fail(this, COMPILE_OUT_OF_MEMORY, node)) &&
+              _compiler_emit_instruction(this, OP_LOAD_VARIABLE, operand, 1,
+                                         node);
+    break;
+  case AST_NEGATE:
+    emitted = _compiler_emit(this, node->operand) &&
+              _compiler_emit_instruction(this, OP_NEGATE, 0, 0, node);
+    break;
+  case AST_CALL:
+    name = _compiler_get_name(this, node);
+    emitted = (bytecode_find_function(name.chars, name.length, &operand) ||
+               _compiler_fail(this, COMPILE_UNKNOWN_FUNCTION, node)) &&
+              _compiler_emit(this, node->operand) &&
+              _compiler_emit_instruction(this, OP_CALL, operand, 0, node);
+    break;
+  default:
+    assert(ast_node_is_binary(node->type) &&
+           "_compiler_emit(): unknown node type");
+    emitted = _compiler_emit(this, node->binary.lhs) &&
+              _compiler_emit(this, node->binary.rhs) &&
+              _compiler_emit_instruction(
+                  this, _compiler_binary_opcodes[node->type], 0, -1, node);
+    break;
+  }
+
+  this->depth--;
+  return emitted;
+}
+
+bool compile_ast(const Ast *ast, TokenList *tokens, size_t first_token,
+                 Bytecode *bytecode, CompileError *error) {
+  assert(ast && "compile_ast(): arg ast was null");
+  assert(tokens && "compile_ast(): arg tokens was null");
+  assert(bytecode && "compile_ast(): arg bytecode was null");
+  assert(error && "compile_ast(): arg error was null");
+  Compiler compiler = {.ast = ast,
+                       .tokens = tokens,
+                       .first_token = first_token,
+                       .bytecode = bytecode,
+                       .error = error,
+                       .depth = 0,
+                       .stack_count = 0,
+                       .symbol_slots = NULL};
+  bytecode_clear(bytecode);
+  error->type = COMPILE_OK;
+  error->token_index = first_token;
+  error->parse_error = (ParseError){.type = PARSE_OK, .token_index = 0};
+
+  uint32_t root = ast_get_root(ast);
+  bool compiled = _compiler_emit(&compiler, root) &&
+                  _compiler_emit_instruction(&compiler, OP_RETURN, 0, -1,
+                                             ast_get_node(ast, root));
+  if (compiler.symbol_slots != NULL) {
+    list_free(compiler.symbol_slots);
+  }
+  if (!compiled) {
+    bytecode_clear(bytecode);
+  }
+  return compiled;
+}
+
+static bool _compiler_compile_token_list(TokenList *tokens, Bytecode *bytecode,
+                                         CompileError *error,
+                                         OptimizeStats *stats) {
+  Ast ast;
+  if (!ast_init(&ast)) {
+    bytecode_clear(bytecode);
+    error->type = COMPILE_OUT_OF_MEMORY;
+    error->token_index = 0;
+    return false;
+  }
+
+  bool compiled;
+  if (!parse_token_list(tokens, &ast, &error->parse_error)) {
+    bytecode_clear(bytecode);
+    error->type = COMPILE_PARSE_FAILED;
+    error->token_index = error->parse_error.token_index;
+    compiled = false;
+  } else if (stats != NULL && !optimize_ast(&ast, tokens, 0, stats)) {
+    bytecode_clear(bytecode);
+    error->type = COMPILE_OUT_OF_MEMORY;
+    error->token_index = 0;
+    compiled = false;
+  } else {
+    compiled = compile_ast(&ast, tokens, 0, bytecode, error);
+  }
+
+  ast_destroy(&ast);
+  return compiled;
+}
+
+bool compile_token_list(TokenList *tokens, Bytecode *bytecode,
+                        CompileError *error) {
+  assert(tokens && "compile_token_list(): arg tokens was null");
+  assert(bytecode && "compile_token_list(): arg bytecode was null");
+  assert(error && "compile_token_list(): arg error was null");
+  return _compiler_compile_token_list(tokens, bytecode, error, NULL);
+}
+
+bool compile_token_list_optimized(TokenList *tokens, Bytecode *bytecode,
+                                  CompileError *error, OptimizeStats *stats) {
+  assert(tokens && "compile_token_list_optimized(): arg tokens was null");
+  assert(bytecode && "compile_token_list_optimized(): arg bytecode was null");
+  assert(error && "compile_token_list_optimized(): arg error was null");
+  assert(stats && "compile_token_list_optimized(): arg stats was null");
+  return _compiler_compile_token_list(tokens, bytecode, error, stats);
+}
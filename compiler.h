@@ -0,0 +1,37 @@
+#ifndef COMPILER
+#define COMPILER
+#include "ast.h"
+#include "bytecode.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "token_list.h"
+
+typedef enum CompileErrorType {
+  COMPILE_OK,
+  COMPILE_PARSE_FAILED,     // parse_error tells why
+  COMPILE_UNKNOWN_FUNCTION, // a call of a function bytecode_functions lacks
+  COMPILE_TOO_DEEP,         // needs more than BYTECODE_MAX_STACK
+  COMPILE_OUT_OF_MEMORY,
+} CompileErrorType;
+
+typedef struct CompileError {
+  CompileErrorType type;
+  size_t token_index; // the token the error was found at
+  ParseError parse_error;
+} CompileError;
+
+// Replaces the content of bytecode with ast. first_token is the index in
+// tokens of the first token of the expression, the token_index of the nodes
+// is relative to it. Returns false and fills error when the ast can not be
+// compiled, bytecode is left empty then.
+bool compile_ast(const Ast *ast, TokenList *tokens, size_t first_token,
+                 Bytecode *bytecode, CompileError *error);
+// parses and compiles the expression that ends at the first EOI_TOKEN
+bool compile_token_list(TokenList *tokens, Bytecode *bytecode,
+                        CompileError *error);
+// compile_token_list with optimize_ast run between parsing and compiling,
+// stats tells what the optimizer changed
+bool compile_token_list_optimized(TokenList *tokens, Bytecode *bytecode,
+                                  CompileError *error, OptimizeStats *stats);
+
+#endif
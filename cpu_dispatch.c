@@ -0,0 +1,66 @@
+#include "cpu_dispatch.h"
+#include <assert.h>
+
+bool cpu_level_is_supported(CpuLevel level) {
+  switch (level) {
+  case CPU_LEVEL_SCALAR:
+    return true;
+#ifdef CPU_DISPATCH_X86
+  case CPU_LEVEL_SSE2:
+    return true;
+  case CPU_LEVEL_AVX2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+static const void *_cpu_dispatch_set_at(const CpuDispatch *this,
+                                        CpuLevel level) {
+  return (const char *)this->_inner_sets + level * this->_inner_set_size;
+}
+
+const void *cpu_dispatch_resolve(CpuDispatch *dispatch) {
+  assert(dispatch && "cpu_dispatch_resolve(): arg dispatch was null");
+  const void *current =
+      atomic_load_explicit(&dispatch->_inner_current, memory_order_acquire);
+  if (current != NULL) {
+    return current;
+  }
+
+  CpuLevel best = CPU_LEVEL_SCALAR;
+  for (int level = CPU_LEVEL_COUNT - 1; level > CPU_LEVEL_SCALAR; level--) {
+    if (cpu_level_is_supported((CpuLevel)level)) {
+      best = (CpuLevel)level;
+      break;
+    }
+  }
+
+  current = _cpu_dispatch_set_at(dispatch, best);
+  atomic_store_explicit(&dispatch->_inner_current, current,
+                        memory_order_release);
+  return current;
+}
+
+CpuLevel cpu_dispatch_get_level(CpuDispatch *dispatch) {
+  assert(dispatch && "cpu_dispatch_get_level(): arg dispatch was null");
+  return (CpuLevel)(((const char *)cpu_dispatch_resolve(dispatch) -
+                     (const char *)dispatch->_inner_sets) /
+                    dispatch->_inner_set_size);
+}
+
+bool cpu_dispatch_set_level(CpuDispatch *dispatch, CpuLevel level) {
+  assert(dispatch && "cpu_dispatch_set_level(): arg dispatch was null");
+  assert(level < CPU_LEVEL_COUNT &&
+         "cpu_dispatch_set_level(): unknown level");
+  if (!cpu_level_is_supported(level)) {
+    return false;
+  }
+
+  atomic_store_explicit(&dispatch->_inner_current,
+                        _cpu_dispatch_set_at(dispatch, level),
+                        memory_order_release);
+  return true;
+}
@@ -0,0 +1,43 @@
+#ifndef CPU_DISPATCH
+#define CPU_DISPATCH
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// builds where SSE2 and AVX2 kernels can be compiled and probed for
+#if defined(__GNUC__) && defined(__SSE2__) &&                                 \
+    (defined(__x86_64__) || defined(__i386__))
+#define CPU_DISPATCH_X86
+#endif
+
+// instruction sets a kernel can be written for, later ones are preferred
+typedef enum CpuLevel {
+  CPU_LEVEL_SCALAR,
+  CPU_LEVEL_SSE2,
+  CPU_LEVEL_AVX2,
+  CPU_LEVEL_COUNT
+} CpuLevel;
+
+// true when this build has the level and the cpu running it can execute it
+bool cpu_level_is_supported(CpuLevel level);
+
+// A module's table with one set of kernels per CpuLevel and the set picked
+// from it. The pick is made once, on the first cpu_dispatch_resolve, and
+// every thread that races to make it picks the same set.
+typedef struct CpuDispatch {
+  const void *_inner_sets; // CPU_LEVEL_COUNT sets, one after another
+  size_t _inner_set_size;  // bytes of one set
+  _Atomic(const void *) _inner_current;
+} CpuDispatch;
+
+#define CPU_DISPATCH_INIT(sets)                                                \
+  {._inner_sets = (sets), ._inner_set_size = sizeof((sets)[0]),                \
+   ._inner_current = NULL}
+
+// the picked set, the one of the best supported level unless one was set
+const void *cpu_dispatch_resolve(CpuDispatch *dispatch);
+CpuLevel cpu_dispatch_get_level(CpuDispatch *dispatch);
+// returns false and keeps the current set when level is not supported
+bool cpu_dispatch_set_level(CpuDispatch *dispatch, CpuLevel level);
+
+#endif
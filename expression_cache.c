@@ -0,0 +1,411 @@
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "expression_cache.h"
+#include "char_reader.h"
+#include "hash.h"
+#include "lexer.h"
+#include <assert.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct ExpressionCacheEntry {
+  uint64_t hash;
+  // one for the table while the entry is cached, one for every acquirer
+  atomic_size_t references;
+  atomic_bool is_referenced; // the CLOCK bit, every hit sets it
+  size_t memory_size;
+  Bytecode bytecode;
+  ExpressionCacheEntry *next_evicted; // evicted, waiting for the lookups
+  size_t key_length;
+  char key[]; // the normalized input
+};
+
+// The normalized input, fed to a hash and optionally compared with or copied
+// to a stored key on the way.
+typedef struct ExpressionCacheKey {
+  uint64_t hash;
+  size_t length;
+  const char *expected; // compared against when not NULL
+  size_t expected_length;
+  bool matches;
+  char *out; // copied to when not NULL
+} ExpressionCacheKey;
+
+static void _expression_cache_feed(ExpressionCacheKey *key, const char *chars,
+                                   size_t count) {
+  key->hash = hash_fnv1a(key->hash, chars, count);
+  if (key->expected != NULL) {
+    key->matches = key->matches &&
+                   key->length + count <= key->expected_length &&
+                   memcmp(key->expected + key->length, chars, count) == 0;
+  }
+  if (key->out != NULL) {
+    memcpy(key->out + key->length, chars, count);
+  }
+  key->length += count;
+}
+
+static bool _expression_cache_is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' ||
+         c == '\r';
+}
+
+// chars that continue a number or identifier lexeme
+static bool _expression_cache_is_word(char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+         (c >= 'A' && c <= 'Z') || c == '_' || c == '.' || c == ',';
+}
+
+// Whether whitespace between previous and next can change the tokens: it
+// keeps two lexemes apart, "* *" from "**", and the lexer decides whether
+// an 'e' after a number is an exponent by the byte that follows it.
+static bool _expression_cache_space_matters(char previous, char next) {
+  return (_expression_cache_is_word(previous) &&
+          _expression_cache_is_word(next)) ||
+         (previous == '*' && next == '*') || previous == 'e' ||
+         previous == 'E';
+}
+
+// Feeds input with the whitespace that does not change its tokens dropped
+// and every other run of whitespace as one space, so "x + 1" and "x+1" give
+// the same key without lexing.
+static void _expression_cache_scan(const char *input, size_t length,
+                                   ExpressionCacheKey *key) {
+  key->hash = HASH_FNV1A_OFFSET;
+  key->length = 0;
+  key->matches = true;
+
+  size_t i = 0;
+  char previous = 0; // the last byte fed, 0 before the first
+  while (i < length && key->matches) {
+    size_t space_start = i;
+    while (i < length && _expression_cache_is_space(input[i])) {
+      i++;
+    }
+    if (i == length) {
+      break;
+    }
+    if (i > space_start && previous != 0 &&
+        _expression_cache_space_matters(previous, input[i])) {
+      _expression_cache_feed(key, " ", 1);
+    }
+
+    size_t run_start = i;
+    while (i < length && !_expression_cache_is_space(input[i])) {
+      i++;
+    }
+    _expression_cache_feed(key, input + run_start, i - run_start);
+    previous = input[i - 1];
+  }
+  if (key->expected != NULL && key->length != key->expected_length) {
+    key->matches = false;
+  }
+}
+
+static bool _expression_cache_entry_matches(const ExpressionCacheEntry *entry,
+                                            const char *input, size_t length) {
+  ExpressionCacheKey key = {.expected = entry->key,
+                            .expected_length = entry->key_length};
+  _expression_cache_scan(input, length, &key);
+  return key.matches;
+}
+
+static void _expression_cache_entry_free(ExpressionCacheEntry *entry) {
+  bytecode_destroy(&entry->bytecode);
+  free(entry);
+}
+
+static void _expression_cache_entry_unreference(ExpressionCacheEntry *entry) {
+  if (atomic_fetch_sub_explicit(&entry->references, 1,
+                                memory_order_acq_rel) == 1) {
+    _expression_cache_entry_free(entry);
+  }
+}
+
+bool expression_cache_init(ExpressionCache *cache, size_t max_entries,
+                           size_t memory_budget) {
+  assert(cache && "expression_cache_init(): arg cache was null");
+  assert(max_entries > 0 && "expression_cache_init(): arg max_entries was 0");
+  // at most half of the slots are used, so probes stay short
+  size_t slot_count = 2;
+  while (slot_count < 2 * max_entries) {
+    slot_count *= 2;
+  }
+
+  *cache = (ExpressionCache){0};
+  cache->_inner_slots = malloc(slot_count * sizeof(*cache->_inner_slots));
+  if (cache->_inner_slots == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < slot_count; i++) {
+    atomic_init(&cache->_inner_slots[i], NULL);
+  }
+  cache->_inner_slot_mask = slot_count - 1;
+  cache->_inner_max_entries = max_entries;
+  cache->_inner_memory_budget = memory_budget;
+  pthread_mutex_init(&cache->_inner_mutex, NULL);
+  atomic_init(&cache->_inner_epoch, 0);
+  atomic_init(&cache->_inner_readers[0], 0);
+  atomic_init(&cache->_inner_readers[1], 0);
+  atomic_init(&cache->_inner_hits, 0);
+  atomic_init(&cache->_inner_misses, 0);
+  atomic_init(&cache->_inner_evictions, 0);
+  return true;
+}
+
+void expression_cache_destroy(ExpressionCache *cache) {
+  assert(cache && "expression_cache_destroy(): arg cache was null");
+  if (cache->_inner_slots == NULL) {
+    return;
+  }
+  for (size_t i = 0; i <= cache->_inner_slot_mask; i++) {
+    ExpressionCacheEntry *entry = atomic_load(&cache->_inner_slots[i]);
+    if (entry != NULL) {
+      _expression_cache_entry_unreference(entry);
+    }
+  }
+  pthread_mutex_destroy(&cache->_inner_mutex);
+  free(cache->_inner_slots);
+  cache->_inner_slots = NULL;
+}
+
+// Probes for input and takes a reference on the entry it finds. Lock free:
+// the entries it looks at are not freed before it leaves its epoch. It can
+// miss an entry an eviction is moving at the same time, which only costs a
+// compile.
+static ExpressionCacheEntry *_expression_cache_find(ExpressionCache *this,
+                                                    const char *input,
+                                                    size_t length,
+                                                    uint64_t hash) {
+  size_t parity = atomic_load(&this->_inner_epoch) & 1;
+  atomic_fetch_add(&this->_inner_readers[parity], 1);
+
+  ExpressionCacheEntry *found = NULL;
+  size_t mask = this->_inner_slot_mask;
+  for (size_t i = hash & mask, probes = 0; probes <= mask;
+       i = (i + 1) & mask, probes++) {
+    ExpressionCacheEntry *entry = atomic_load(&this->_inner_slots[i]);
+    if (entry == NULL) {
+      break;
+    }
+    if (entry->hash == hash &&
+        _expression_cache_entry_matches(entry, input, length)) {
+      atomic_fetch_add_explicit(&entry->references, 1, memory_order_relaxed);
+      atomic_store_explicit(&entry->is_referenced, true, memory_order_relaxed);
+      found = entry;
+      break;
+    }
+  }
+
+  atomic_fetch_sub(&this->_inner_readers[parity], 1);
+  return found;
+}
+
+// Returns once every lookup that started before the call left, so nothing
+// removed from the table before the call can still be reached. Flips the
+// epoch twice, as a lookup that read the epoch just before the first flip
+// counts itself in the parity the second flip waits for.
+static void _expression_cache_wait_for_readers(ExpressionCache *this) {
+  for (int flip = 0; flip < 2; flip++) {
+    size_t parity = atomic_fetch_add(&this->_inner_epoch, 1) & 1;
+    while (atomic_load(&this->_inner_readers[parity]) != 0) {
+      sched_yield();
+    }
+  }
+}
+
+// Empties slot hole and moves the entries after it back so no probe sequence
+// has a gap. Every entry is written to its new slot before its old slot is
+// overwritten.
+static void _expression_cache_remove_slot(ExpressionCache *this, size_t hole) {
+  size_t mask = this->_inner_slot_mask;
+  for (size_t i = (hole + 1) & mask;; i = (i + 1) & mask) {
+    ExpressionCacheEntry *entry = atomic_load(&this->_inner_slots[i]);
+    if (entry == NULL) {
+      break;
+    }
+    // the entry may move into the hole unless its home is in (hole, i]
+    size_t home = entry->hash & mask;
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      atomic_store(&this->_inner_slots[hole], entry);
+      hole = i;
+    }
+  }
+  atomic_store(&this->_inner_slots[hole], NULL);
+}
+
+// sweeps the clock hand to the first entry not hit since the last sweep and
+// takes it out of the table
+static ExpressionCacheEntry *_expression_cache_evict(ExpressionCache *this) {
+  assert(this->_inner_entry_count > 0 &&
+         "_expression_cache_evict(): the cache is empty");
+  for (;;) {
+    size_t slot = this->_inner_clock_hand;
+    this->_inner_clock_hand = (slot + 1) & this->_inner_slot_mask;
+    ExpressionCacheEntry *entry = atomic_load(&this->_inner_slots[slot]);
+    if (entry == NULL ||
+        atomic_exchange_explicit(&entry->is_referenced, false,
+                                 memory_order_relaxed)) {
+      continue;
+    }
+
+    _expression_cache_remove_slot(this, slot);
+    this->_inner_entry_count--;
+    this->_inner_memory_used -= entry->memory_size;
+    atomic_fetch_add_explicit(&this->_inner_evictions, 1,
+                              memory_order_relaxed);
+    return entry;
+  }
+}
+
+// Adds entry, or takes a reference on the equal entry another thread added
+// since the lookup and frees entry. Returns the entry the caller holds.
+static ExpressionCacheEntry *_expression_cache_insert(
+    ExpressionCache *this, const char *input, size_t length,
+    ExpressionCacheEntry *entry) {
+  if (entry->memory_size > this->_inner_memory_budget) {
+    return entry;
+  }
+
+  pthread_mutex_lock(&this->_inner_mutex);
+  ExpressionCacheEntry *existing =
+      _expression_cache_find(this, input, length, entry->hash);
+  if (existing != NULL) {
+    pthread_mutex_unlock(&this->_inner_mutex);
+    _expression_cache_entry_free(entry);
+    return existing;
+  }
+
+  ExpressionCacheEntry *evicted = NULL;
+  size_t evicted_count = 0;
+  while (this->_inner_entry_count >= this->_inner_max_entries ||
+         this->_inner_memory_used + entry->memory_size >
+             this->_inner_memory_budget) {
+    ExpressionCacheEntry *victim = _expression_cache_evict(this);
+    victim->next_evicted = evicted;
+    evicted = victim;
+    evicted_count++;
+  }
+
+  size_t mask = this->_inner_slot_mask;
+  size_t slot = entry->hash & mask;
+  while (atomic_load(&this->_inner_slots[slot]) != NULL) {
+    slot = (slot + 1) & mask;
+  }
+  atomic_store_explicit(&entry->references, 2, memory_order_relaxed);
+  atomic_store(&this->_inner_slots[slot], entry);
+  this->_inner_entry_count++;
+  this->_inner_memory_used += entry->memory_size;
+
+  if (evicted_count > 0) {
+    _expression_cache_wait_for_readers(this);
+  }
+  pthread_mutex_unlock(&this->_inner_mutex);
+
+  while (evicted != NULL) {
+    ExpressionCacheEntry *next = evicted->next_evicted;
+    _expression_cache_entry_unreference(evicted);
+    evicted = next;
+  }
+  return entry;
+}
+
+// lexes and compiles input into a new entry that only the caller references
+static ExpressionCacheEntry *_expression_cache_compile(
+    const char *input, size_t length, const ExpressionCacheKey *key,
+    CompileError *error) {
+  ExpressionCacheEntry *entry =
+      malloc(sizeof(ExpressionCacheEntry) + key->length);
+  if (entry == NULL || !bytecode_init(&entry->bytecode)) {
+    free(entry);
+    *error = (CompileError){.type = COMPILE_OUT_OF_MEMORY};
+    return NULL;
+  }
+
+  CharReader reader;
+  char_reader_init(&reader);
+  if (!char_reader_add_view(&reader, input, length)) {
+    char_reader_destroy(&reader);
+    _expression_cache_entry_free(entry);
+    *error = (CompileError){.type = COMPILE_OUT_OF_MEMORY};
+    return NULL;
+  }
+  TokenList tokens = lex_char_reader(&reader);
+  bool compiled = compile_token_list(&tokens, &entry->bytecode, error);
+  token_list_distroy(&tokens);
+  char_reader_destroy(&reader);
+  if (!compiled) {
+    _expression_cache_entry_free(entry);
+    return NULL;
+  }
+
+  ExpressionCacheKey copy = {.out = entry->key};
+  _expression_cache_scan(input, length, &copy);
+  entry->hash = copy.hash;
+  entry->key_length = copy.length;
+  atomic_init(&entry->references, 1);
+  atomic_init(&entry->is_referenced, false);
+  entry->next_evicted = NULL;
+  entry->memory_size = sizeof(ExpressionCacheEntry) + entry->key_length +
+                       bytecode_get_memory_size(&entry->bytecode);
+  return entry;
+}
+
+bool expression_cache_acquire(ExpressionCache *cache, const char *input,
+                              size_t length, ExpressionCacheEntry **entry,
+                              CompileError *error) {
+  assert(cache && "expression_cache_acquire(): arg cache was null");
+  assert((input || length == 0) &&
+         "expression_cache_acquire(): arg input was null");
+  assert(entry && "expression_cache_acquire(): arg entry was null");
+  assert(error && "expression_cache_acquire(): arg error was null");
+  ExpressionCacheKey key = {0};
+  _expression_cache_scan(input, length, &key);
+  *entry = _expression_cache_find(cache, input, length, key.hash);
+  if (*entry != NULL) {
+    atomic_fetch_add_explicit(&cache->_inner_hits, 1, memory_order_relaxed);
+    *error = (CompileError){.type = COMPILE_OK};
+    return true;
+  }
+
+  atomic_fetch_add_explicit(&cache->_inner_misses, 1, memory_order_relaxed);
+  ExpressionCacheEntry *compiled =
+      _expression_cache_compile(input, length, &key, error);
+  if (compiled == NULL) {
+    *entry = NULL;
+    return false;
+  }
+  *entry = _expression_cache_insert(cache, input, length, compiled);
+  *error = (CompileError){.type = COMPILE_OK};
+  return true;
+}
+
+void expression_cache_release(ExpressionCacheEntry *entry) {
+  assert(entry && "expression_cache_release(): arg entry was null");
+  _expression_cache_entry_unreference(entry);
+}
+
+const Bytecode *expression_cache_entry_get_bytecode(
+    const ExpressionCacheEntry *entry) {
+  assert(entry && "expression_cache_entry_get_bytecode(): arg entry was null");
+  return &entry->bytecode;
+}
+
+void expression_cache_get_stats(ExpressionCache *cache,
+                                ExpressionCacheStats *stats) {
+  assert(cache && "expression_cache_get_stats(): arg cache was null");
+  assert(stats && "expression_cache_get_stats(): arg stats was null");
+  stats->hits = atomic_load_explicit(&cache->_inner_hits, memory_order_relaxed);
+  stats->misses =
+      atomic_load_explicit(&cache->_inner_misses, memory_order_relaxed);
+  stats->evictions =
+      atomic_load_explicit(&cache->_inner_evictions, memory_order_relaxed);
+  pthread_mutex_lock(&cache->_inner_mutex);
+  stats->entry_count = cache->_inner_entry_count;
+  stats->memory_used = cache->_inner_memory_used;
+  pthread_mutex_unlock(&cache->_inner_mutex);
+}
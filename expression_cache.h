@@ -0,0 +1,65 @@
+#ifndef EXPRESSION_CACHE
+#define EXPRESSION_CACHE
+#include "bytecode.h"
+#include "compiler.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// One compiled expression of the cache. It stays valid until released, even
+// when the cache evicts it or is destroyed in the meantime.
+typedef struct ExpressionCacheEntry ExpressionCacheEntry;
+
+// Compiled expressions keyed by their input without the whitespace that does
+// not change its tokens, so inputs that only differ in whitespace share one
+// entry. Lookups neither lex nor lock: they hash the input and probe the
+// table with atomic loads. Misses compile outside the lock and take it only
+// to insert, evicting with CLOCK until the entry count and the memory budget
+// fit. Evicted entries are freed once no lookup can still see them and every
+// acquirer released them.
+typedef struct ExpressionCache {
+  _Atomic(ExpressionCacheEntry *) *_inner_slots; // linear probing
+  size_t _inner_slot_mask;                       // slot count - 1
+  size_t _inner_max_entries;
+  size_t _inner_memory_budget;
+  pthread_mutex_t _inner_mutex; // serializes inserts and evictions
+  size_t _inner_entry_count;
+  size_t _inner_memory_used;
+  size_t _inner_clock_hand;
+  // lookups in progress, by the parity of the epoch they started in
+  atomic_size_t _inner_epoch;
+  atomic_size_t _inner_readers[2];
+  atomic_size_t _inner_hits;
+  atomic_size_t _inner_misses;
+  atomic_size_t _inner_evictions;
+} ExpressionCache;
+
+typedef struct ExpressionCacheStats {
+  size_t hits;
+  size_t misses; // every miss compiled the input
+  size_t evictions;
+  size_t entry_count;
+  size_t memory_used; // bytes of the cached entries
+} ExpressionCacheStats;
+
+// Holds at most max_entries expressions taking at most memory_budget bytes,
+// an expression larger than the whole budget is compiled but not cached.
+// Returns false when out of memory.
+bool expression_cache_init(ExpressionCache *cache, size_t max_entries,
+                           size_t memory_budget);
+// releases the cache's hold on every entry, acquired entries stay valid
+void expression_cache_destroy(ExpressionCache *cache);
+// Looks up input[0..length), compiling and caching it on a miss. Returns
+// false and fills error when it does not compile, nothing is cached then.
+// Safe to call from many threads at once.
+bool expression_cache_acquire(ExpressionCache *cache, const char *input,
+                              size_t length, ExpressionCacheEntry **entry,
+                              CompileError *error);
+void expression_cache_release(ExpressionCacheEntry *entry);
+const Bytecode *expression_cache_entry_get_bytecode(
+    const ExpressionCacheEntry *entry);
+void expression_cache_get_stats(ExpressionCache *cache,
+                                ExpressionCacheStats *stats);
+
+#endif
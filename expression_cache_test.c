@@ -0,0 +1,290 @@
+#include "bytecode.h"
+#include "char_reader.h"
+#include "expression_cache.h"
+#include "lexer.h"
+#include "thread_pool.h"
+#include "vm.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool acquire_string(ExpressionCache *cache, const char *input,
+                           ExpressionCacheEntry **entry) {
+  CompileError error;
+  return expression_cache_acquire(cache, input, strlen(input), entry, &error);
+}
+
+static double evaluate_entry(const ExpressionCacheEntry *entry, double x) {
+  const Bytecode *bytecode = expression_cache_entry_get_bytecode(entry);
+  double vars[4] = {x, x + 1, x + 2, x + 3};
+  assert(bytecode_get_variable_count(bytecode) <= 4);
+  return vm_evaluate(bytecode, vars);
+}
+
+static void test_whitespace_shares_an_entry(void) {
+  ExpressionCache cache;
+  assert(expression_cache_init(&cache, 16, 1 << 20));
+  ExpressionCacheEntry *first;
+  ExpressionCacheEntry *second;
+  ExpressionCacheEntry *third;
+  assert(acquire_string(&cache, "x * 2 + sqrt(y)", &first));
+  assert(acquire_string(&cache, "  x*2+\tsqrt ( y )\n", &second));
+  assert(acquire_string(&cache, "x * 2 + sqrt(z)", &third));
+  assert(first == second);
+  assert(first != third);
+  assert(evaluate_entry(first, 4) == 4 * 2 + sqrt(5));
+
+  ExpressionCacheStats stats;
+  expression_cache_get_stats(&cache, &stats);
+  assert(stats.hits == 1);
+  assert(stats.misses == 2);
+  assert(stats.evictions == 0);
+  assert(stats.entry_count == 2);
+  assert(stats.memory_used > 0);
+
+  // tokens that only differ in how they are split are different keys
+  ExpressionCacheEntry *joined;
+  ExpressionCacheEntry *split;
+  assert(acquire_string(&cache, "x ** 2", &joined));
+  assert(!acquire_string(&cache, "x * * 2", &split));
+  assert(split == NULL);
+  assert(acquire_string(&cache, "xy", &split));
+  ExpressionCacheEntry *apart;
+  assert(!acquire_string(&cache, "x y", &apart));
+
+  expression_cache_release(first);
+  expression_cache_release(second);
+  expression_cache_release(third);
+  expression_cache_release(joined);
+  expression_cache_release(split);
+  expression_cache_destroy(&cache);
+}
+
+static bool same_tokens(const char *a, const char *b) {
+  CharReader readers[2];
+  TokenList tokens[2];
+  const char *inputs[2] = {a, b};
+  for (int i = 0; i < 2; i++) {
+    char_reader_init(&readers[i]);
+    assert(char_reader_add(&readers[i], inputs[i]));
+    tokens[i] = lex_char_reader(&readers[i]);
+  }
+
+  bool same = token_list_get_count(&tokens[0]) == token_list_get_count(&tokens[1]);
+  for (size_t i = 0; same && i < token_list_get_count(&tokens[0]); i++) {
+    Token token_a = token_list_get_token_at(&tokens[0], i);
+    Token token_b = token_list_get_token_at(&tokens[1], i);
+    Lexeme lexeme_a = token_list_get_lexeme(&tokens[0], token_a);
+    Lexeme lexeme_b = token_list_get_lexeme(&tokens[1], token_b);
+    same = token_a.type == token_b.type && lexeme_a.length == lexeme_b.length &&
+           (lexeme_a.length == 0 ||
+            memcmp(lexeme_a.chars, lexeme_b.chars, lexeme_a.length) == 0);
+  }
+
+  for (int i = 0; i < 2; i++) {
+    token_list_distroy(&tokens[i]);
+    char_reader_destroy(&readers[i]);
+  }
+  return same;
+}
+
+// Inputs that share an entry must lex to the same tokens. Random inputs are
+// acquired together with a copy that has whitespace between some of its
+// bytes, a shared entry needs equal tokens.
+static void test_shared_entries_have_the_same_tokens(void) {
+  static const char *const pieces[] = {"1", "2", "e", "E", "x", ".", ",",
+                                       "*", "-", "+", "(", ")", "$"};
+  ExpressionCache cache;
+  assert(expression_cache_init(&cache, 64, 1 << 20));
+  size_t shared = 0;
+  for (int round = 0; round < 50000; round++) {
+    char a[32];
+    char b[64];
+    size_t length = 0;
+    size_t b_length = 0;
+    for (int count = 1 + rand() % 6; count > 0; count--) {
+      const char *piece = pieces[rand() % 13];
+      for (size_t i = 0; piece[i] != '\0'; i++) {
+        if (rand() % 3 == 0) {
+          b[b_length++] = " \t\n"[rand() % 3];
+        }
+        a[length++] = piece[i];
+        b[b_length++] = piece[i];
+      }
+    }
+    a[length] = '\0';
+    b[b_length] = '\0';
+
+    ExpressionCacheEntry *entry_a;
+    ExpressionCacheEntry *entry_b;
+    bool compiled_a = acquire_string(&cache, a, &entry_a);
+    bool compiled_b = acquire_string(&cache, b, &entry_b);
+    if (compiled_a && compiled_b && entry_a == entry_b) {
+      if (!same_tokens(a, b)) {
+        fprintf(stderr, "\"%s\" and \"%s\" share an entry\n", a, b);
+      }
+      assert(same_tokens(a, b));
+      shared++;
+    }
+    if (compiled_a) {
+      expression_cache_release(entry_a);
+    }
+    if (compiled_b) {
+      expression_cache_release(entry_b);
+    }
+  }
+  assert(shared > 1000);
+  expression_cache_destroy(&cache);
+}
+
+static void test_compile_errors_are_not_cached(void) {
+  ExpressionCache cache;
+  assert(expression_cache_init(&cache, 4, 1 << 20));
+  ExpressionCacheEntry *entry;
+  CompileError error;
+  assert(!expression_cache_acquire(&cache, "(x +", 4, &entry, &error));
+  assert(error.type == COMPILE_PARSE_FAILED);
+  assert(!expression_cache_acquire(&cache, "nope(x)", 7, &entry, &error));
+  assert(error.type == COMPILE_UNKNOWN_FUNCTION);
+  assert(error.token_index == 0);
+
+  ExpressionCacheStats stats;
+  expression_cache_get_stats(&cache, &stats);
+  assert(stats.misses == 2);
+  assert(stats.entry_count == 0);
+  expression_cache_destroy(&cache);
+}
+
+static void test_clock_keeps_hot_entries(void) {
+  ExpressionCache cache;
+  assert(expression_cache_init(&cache, 4, 1 << 20));
+  char input[32];
+  ExpressionCacheEntry *entry;
+  for (int i = 0; i < 100; i++) {
+    // "x + 0" is hit before every miss, so it is never the victim
+    assert(acquire_string(&cache, "x + 0", &entry));
+    expression_cache_release(entry);
+    sprintf(input, "x + %d", i + 1);
+    assert(acquire_string(&cache, input, &entry));
+    assert(evaluate_entry(entry, 1) == 1 + i + 1);
+    expression_cache_release(entry);
+  }
+
+  ExpressionCacheStats stats;
+  expression_cache_get_stats(&cache, &stats);
+  assert(stats.entry_count == 4);
+  assert(stats.misses == 101);
+  assert(stats.hits == 99);
+  assert(stats.evictions == 97);
+  expression_cache_destroy(&cache);
+}
+
+static void test_memory_budget(void) {
+  ExpressionCache cache;
+  assert(expression_cache_init(&cache, 1000, 4096));
+  char input[64];
+  ExpressionCacheEntry *entry;
+  for (int i = 0; i < 200; i++) {
+    sprintf(input, "x * %d + y / %d - z", i, i + 1);
+    assert(acquire_string(&cache, input, &entry));
+    expression_cache_release(entry);
+    ExpressionCacheStats stats;
+    expression_cache_get_stats(&cache, &stats);
+    assert(stats.memory_used <= 4096);
+  }
+
+  ExpressionCacheStats stats;
+  expression_cache_get_stats(&cache, &stats);
+  assert(stats.evictions > 0);
+  assert(stats.entry_count + stats.evictions == 200);
+  expression_cache_destroy(&cache);
+}
+
+static void test_entries_outlive_eviction_and_cache(void) {
+  ExpressionCache cache;
+  assert(expression_cache_init(&cache, 1, 1 << 20));
+  ExpressionCacheEntry *held;
+  ExpressionCacheEntry *other;
+  assert(acquire_string(&cache, "x * 3", &held));
+  assert(acquire_string(&cache, "x * 4", &other));
+  // held was evicted but still works
+  assert(evaluate_entry(held, 2) == 6);
+  expression_cache_destroy(&cache);
+  assert(evaluate_entry(other, 2) == 8);
+  expression_cache_release(held);
+  expression_cache_release(other);
+
+  // larger than the whole budget, compiled but never cached
+  assert(expression_cache_init(&cache, 4, 16));
+  assert(acquire_string(&cache, "x - 1", &held));
+  assert(evaluate_entry(held, 2) == 1);
+  ExpressionCacheStats stats;
+  expression_cache_get_stats(&cache, &stats);
+  assert(stats.entry_count == 0);
+  expression_cache_release(held);
+  expression_cache_destroy(&cache);
+}
+
+typedef struct ConcurrentJob {
+  ExpressionCache *cache;
+  atomic_int failures;
+} ConcurrentJob;
+
+static void concurrent_task(void *context, size_t worker, size_t begin,
+                            size_t end) {
+  (void)worker;
+  ConcurrentJob *job = context;
+  char input[64];
+  for (size_t i = begin; i < end; i++) {
+    // 40 formulas in two spellings compete for 16 entries
+    int formula = (int)((i * 7919) % 40);
+    if (i % 2 == 0) {
+      sprintf(input, "x*%d+y-%d", formula, formula);
+    } else {
+      sprintf(input, " x * %d + y - %d ", formula, formula);
+    }
+    ExpressionCacheEntry *entry;
+    if (!acquire_string(job->cache, input, &entry) ||
+        evaluate_entry(entry, 2) != 2.0 * formula + 3 - formula) {
+      atomic_fetch_add(&job->failures, 1);
+    }
+    if (entry != NULL) {
+      expression_cache_release(entry);
+    }
+  }
+}
+
+static void test_concurrent_acquires(void) {
+  ExpressionCache cache;
+  assert(expression_cache_init(&cache, 16, 1 << 20));
+  ThreadPool pool;
+  assert(thread_pool_init(&pool, 8));
+  ConcurrentJob job = {.cache = &cache};
+  atomic_init(&job.failures, 0);
+  thread_pool_run(&pool, 20000, 16, concurrent_task, &job);
+  assert(atomic_load(&job.failures) == 0);
+
+  ExpressionCacheStats stats;
+  expression_cache_get_stats(&cache, &stats);
+  assert(stats.hits + stats.misses == 20000);
+  assert(stats.hits > 0 && stats.evictions > 0);
+  assert(stats.entry_count <= 16);
+  thread_pool_destroy(&pool);
+  expression_cache_destroy(&cache);
+}
+
+int main(void) {
+  srand(11);
+  test_whitespace_shares_an_entry();
+  test_shared_entries_have_the_same_tokens();
+  test_compile_errors_are_not_cached();
+  test_clock_keeps_hot_entries();
+  test_memory_budget();
+  test_entries_outlive_eviction_and_cache();
+  test_concurrent_acquires();
+
+  printf("All expression cache tests passed\n");
+  return 0;
+}
@@ -0,0 +1,493 @@
+#include "formula_batch.h"
+#include "list.h"
+#include "parser.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FORMULA_BATCH_INITIAL_SLOTS 64
+
+static const Opcode _formula_batch_binary_opcodes[AST_NODE_TYPE_COUNT] = {
+    [AST_ADD] = OP_ADD,           [AST_SUBTRACT] = OP_SUBTRACT,
+    [AST_MULTIPLY] = OP_MULTIPLY, [AST_DIVIDE] = OP_DIVIDE,
+    [AST_MODULO] = OP_MODULO,     [AST_POWER] = OP_POWER,
+};
+
+bool formula_batch_init(FormulaBatch *batch) {
+  assert(batch && "formula_batch_init(): arg batch was null");
+  batch->_inner_nodes = list(FormulaBatchNode, 64);
+  batch->_inner_outputs = list(uint32_t, 16);
+  batch->_inner_node_ids = list(uint32_t, 64);
+  batch->_inner_slots = calloc(FORMULA_BATCH_INITIAL_SLOTS, sizeof(uint32_t));
+  batch->_inner_slot_mask = FORMULA_BATCH_INITIAL_SLOTS - 1;
+  batch->_inner_added_node_count = 0;
+  bool has_symbols = bytecode_init(&batch->_inner_symbols);
+  if (!has_symbols) {
+    batch->_inner_symbols = (Bytecode){0};
+  }
+  if (batch->_inner_nodes == NULL || batch->_inner_outputs == NULL ||
+      batch->_inner_node_ids == NULL || batch->_inner_slots == NULL ||
+      !has_symbols) {
+    formula_batch_destroy(batch);
+    return false;
+  }
+  return true;
+}
+
+void formula_batch_destroy(FormulaBatch *batch) {
+  assert(batch && "formula_batch_destroy(): arg batch was null");
+  if (batch->_inner_nodes != NULL) {
+    list_free(batch->_inner_nodes);
+  }
+  if (batch->_inner_outputs != NULL) {
+    list_free(batch->_inner_outputs);
+  }
+  if (batch->_inner_node_ids != NULL) {
+    list_free(batch->_inner_node_ids);
+  }
+  free(batch->_inner_slots);
+  bytecode_destroy(&batch->_inner_symbols);
+  batch->_inner_nodes = NULL;
+  batch->_inner_outputs = NULL;
+  batch->_inner_node_ids = NULL;
+  batch->_inner_slots = NULL;
+}
+
+void formula_batch_clear(FormulaBatch *batch) {
+  assert(batch && "formula_batch_clear(): arg batch was null");
+  list_clear(batch->_inner_nodes);
+  list_clear(batch->_inner_outputs);
+  memset(batch->_inner_slots, 0,
+         (batch->_inner_slot_mask + 1) * sizeof(uint32_t));
+  batch->_inner_added_node_count = 0;
+  bytecode_clear(&batch->_inner_symbols);
+}
+
+static uint64_t _formula_batch_bits(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// constants are told apart by their bits, so 0 and -0 stay two nodes
+static uint64_t _formula_batch_hash(const FormulaBatch *this,
+                                    FormulaBatchNode node) {
+  uint64_t hash =
+      node.opcode == OP_PUSH_CONSTANT
+          ? _formula_batch_bits(
+                bytecode_get_constants(&this->_inner_symbols)[node.lhs])
+          : ((uint64_t)node.lhs << 32 | node.rhs);
+  hash ^= (uint64_t)node.opcode * 0x9e3779b97f4a7c15u;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdu;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+static bool _formula_batch_equals(const FormulaBatch *this,
+                                  FormulaBatchNode a, FormulaBatchNode b) {
+  if (a.opcode != b.opcode) {
+    return false;
+  }
+  if (a.opcode == OP_PUSH_CONSTANT) {
+    const double *constants = bytecode_get_constants(&this->_inner_symbols);
+    return _formula_batch_bits(constants[a.lhs]) ==
+           _formula_batch_bits(constants[b.lhs]);
+  }
+  return a.lhs == b.lhs && a.rhs == b.rhs;
+}
+
+// returns the slot that holds node or the empty slot where it belongs
+static size_t _formula_batch_probe(const FormulaBatch *this,
+                                   FormulaBatchNode node) {
+  size_t mask = this->_inner_slot_mask;
+  size_t slot = _formula_batch_hash(this, node) & mask;
+  while (this->_inner_slots[slot] != 0 &&
+         !_formula_batch_equals(
+             this, this->_inner_nodes[this->_inner_slots[slot] - 1], node)) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+// doubles the slots once they are half full
+static bool _formula_batch_grow(FormulaBatch *this) {
+  size_t count = list_get_count(this->_inner_nodes);
+  size_t slot_count = this->_inner_slot_mask + 1;
+  if ((count + 1) * 2 <= slot_count) {
+    return true;
+  }
+
+  uint32_t *slots = calloc(slot_count * 2, sizeof(uint32_t));
+  if (slots == NULL) {
+    return false;
+  }
+  free(this->_inner_slots);
+  this->_inner_slots = slots;
+  this->_inner_slot_mask = slot_count * 2 - 1;
+  for (size_t i = 0; i < count; i++) {
+    this->_inner_slots[_formula_batch_probe(this, this->_inner_nodes[i])] =
+        (uint32_t)i + 1;
+  }
+  return true;
+}
+
+// Finds node or adds it, a constant node is added with lhs as the index the
+// value gets in the constants. Returns false when out of memory.
+static bool _formula_batch_intern(FormulaBatch *this, FormulaBatchNode node,
+                                  uint32_t *id) {
+  if (!_formula_batch_grow(this)) {
+    return false;
+  }
+  size_t slot = _formula_batch_probe(this, node);
+  if (this->_inner_slots[slot] != 0) {
+    *id = this->_inner_slots[slot] - 1;
+    return true;
+  }
+
+  size_t count = list_get_count(this->_inner_nodes);
+  if (count >= UINT32_MAX - 1) {
+    return false;
+  }
+  FormulaBatchNode *nodes = list_add(this->_inner_nodes, &node);
+  if (nodes == NULL) {
+    return false;
+  }
+  this->_inner_nodes = nodes;
+  this->_inner_slots[slot] = (uint32_t)count + 1;
+  *id = (uint32_t)count;
+  return true;
+}
+
+static bool _formula_batch_intern_constant(FormulaBatch *this, double value,
+                                           uint32_t *id) {
+  // the value is appended to look it up and dropped again when it is known
+  Bytecode *symbols = &this->_inner_symbols;
+  size_t constant_count = list_get_count(symbols->_inner_constants);
+  uint32_t constant;
+  if (!bytecode_add_constant(symbols, value, &constant)) {
+    return false;
+  }
+  size_t node_count = list_get_count(this->_inner_nodes);
+  if (!_formula_batch_intern(
+          this,
+          (FormulaBatchNode){.opcode = OP_PUSH_CONSTANT, .lhs = constant},
+          id)) {
+    return false;
+  }
+  if (list_get_count(this->_inner_nodes) == node_count) {
+    list_remove_range(symbols->_inner_constants, constant_count, 1);
+  }
+  return true;
+}
+
+static Lexeme _formula_batch_get_name(TokenList *tokens, size_t first_token,
+                                      const AstNode *node) {
+  Token token =
+      token_list_get_token_at(tokens, first_token + node->token_index);
+  return token_list_get_lexeme(tokens, token);
+}
+
+// fails on the first call of an unknown function before anything is added
+static bool _formula_batch_check_calls(const Ast *ast, TokenList *tokens,
+                                       size_t first_token,
+                                       CompileError *error) {
+  for (uint32_t i = 0; i < ast_get_node_count(ast); i++) {
+    const AstNode *node = ast_get_node(ast, i);
+    uint32_t function;
+    if (node->type != AST_CALL) {
+      continue;
+    }
+    Lexeme name = _formula_batch_get_name(tokens, first_token, node);
+    if (!bytecode_find_function(name.chars, name.length, &function)) {
+      error->type = COMPILE_UNKNOWN_FUNCTION;
+      error->token_index = first_token + node->token_index;
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool _formula_batch_add_node(FormulaBatch *this, const AstNode *node,
+                                    TokenList *tokens, size_t first_token,
+                                    uint32_t *id) {
+  const uint32_t *ids = this->_inner_node_ids;
+  FormulaBatchNode batch_node = {0};
+  Lexeme name;
+  switch (node->type) {
+  case AST_NUMBER:
+    return _formula_batch_intern_constant(this, node->number, id);
+  case AST_VARIABLE:
+    name = _formula_batch_get_name(tokens, first_token, node);
+    batch_node.opcode = OP_LOAD_VARIABLE;
+    if (!bytecode_add_variable(&this->_inner_symbols, name.chars, name.length,
+                               &batch_node.lhs)) {
+      return false;
+    }
+    break;
+  case AST_NEGATE:
+    batch_node.opcode = OP_NEGATE;
+    batch_node.lhs = ids[node->operand];
+    break;
+  case AST_CALL:
+    name = _formula_batch_get_name(tokens, first_token, node);
+    batch_node.opcode = OP_CALL;
+    bytecode_find_function(name.chars, name.length, &batch_node.lhs);
+    batch_node.rhs = ids[node->operand];
+    break;
+  default:
+    assert(ast_node_is_binary(node->type) &&
+           "_formula_batch_add_node(): unknown node type");
+    batch_node.opcode = _formula_batch_binary_opcodes[node->type];
+    batch_node.lhs = ids[node->binary.lhs];
+    batch_node.rhs = ids[node->binary.rhs];
+    // both orders give the same bits, but for the payload of two NaNs
+    if ((batch_node.opcode == OP_ADD || batch_node.opcode == OP_MULTIPLY) &&
+        batch_node.lhs > batch_node.rhs) {
+      batch_node.lhs = ids[node->binary.rhs];
+      batch_node.rhs = ids[node->binary.lhs];
+    }
+    break;
+  }
+  return _formula_batch_intern(this, batch_node, id);
+}
+
+bool formula_batch_add_ast(FormulaBatch *batch, const Ast *ast,
+                           TokenList *tokens, size_t first_token,
+                           CompileError *error) {
+  assert(batch && "formula_batch_add_ast(): arg batch was null");
+  assert(ast && "formula_batch_add_ast(): arg ast was null");
+  assert(tokens && "formula_batch_add_ast(): arg tokens was null");
+  assert(error && "formula_batch_add_ast(): arg error was null");
+  error->type = COMPILE_OK;
+  error->token_index = first_token;
+  error->parse_error = (ParseError){.type = PARSE_OK, .token_index = 0};
+  if (!_formula_batch_check_calls(ast, tokens, first_token, error)) {
+    return false;
+  }
+
+  size_t count = ast_get_node_count(ast);
+  list_clear(batch->_inner_node_ids);
+  bool added = true;
+  for (uint32_t i = 0; i < count && added; i++) {
+    uint32_t id;
+    uint32_t *ids;
+    added = _formula_batch_add_node(batch, ast_get_node(ast, i), tokens,
+                                    first_token, &id) &&
+            (ids = list_add(batch->_inner_node_ids, &id)) != NULL;
+    if (added) {
+      batch->_inner_node_ids = ids;
+    }
+  }
+
+  uint32_t *outputs = NULL;
+  if (added) {
+    outputs = list_add(batch->_inner_outputs,
+                       &batch->_inner_node_ids[ast_get_root(ast)]);
+  }
+  if (outputs == NULL) {
+    formula_batch_clear(batch);
+    error->type = COMPILE_OUT_OF_MEMORY;
+    return false;
+  }
+  batch->_inner_outputs = outputs;
+  batch->_inner_added_node_count += count;
+  return true;
+}
+
+bool formula_batch_add_token_list(FormulaBatch *batch, TokenList *tokens,
+                                  CompileError *error) {
+  assert(batch && "formula_batch_add_token_list(): arg batch was null");
+  assert(tokens && "formula_batch_add_token_list(): arg tokens was null");
+  assert(error && "formula_batch_add_token_list(): arg error was null");
+  Ast ast;
+  if (!ast_init(&ast)) {
+    error->type = COMPILE_OUT_OF_MEMORY;
+    error->token_index = 0;
+    return false;
+  }
+
+  bool added;
+  if (parse_token_list(tokens, &ast, &error->parse_error)) {
+    added = formula_batch_add_ast(batch, &ast, tokens, 0, error);
+  } else {
+    error->type = COMPILE_PARSE_FAILED;
+    error->token_index = error->parse_error.token_index;
+    added = false;
+  }
+
+  ast_destroy(&ast);
+  return added;
+}
+
+size_t formula_batch_get_formula_count(const FormulaBatch *batch) {
+  assert(batch && "formula_batch_get_formula_count(): arg batch was null");
+  return list_get_count(batch->_inner_outputs);
+}
+
+size_t formula_batch_get_node_count(const FormulaBatch *batch) {
+  assert(batch && "formula_batch_get_node_count(): arg batch was null");
+  return list_get_count(batch->_inner_nodes);
+}
+
+size_t formula_batch_get_added_node_count(const FormulaBatch *batch) {
+  assert(batch && "formula_batch_get_added_node_count(): arg batch was null");
+  return batch->_inner_added_node_count;
+}
+
+const FormulaBatchNode *formula_batch_get_nodes(const FormulaBatch *batch) {
+  assert(batch && "formula_batch_get_nodes(): arg batch was null");
+  return batch->_inner_nodes;
+}
+
+size_t formula_batch_get_variable_count(const FormulaBatch *batch) {
+  assert(batch && "formula_batch_get_variable_count(): arg batch was null");
+  return bytecode_get_variable_count(&batch->_inner_symbols);
+}
+
+const char *formula_batch_get_variable_name(const FormulaBatch *batch,
+                                            size_t slot) {
+  assert(batch && "formula_batch_get_variable_name(): arg batch was null");
+  return bytecode_get_variable_name(&batch->_inner_symbols, slot);
+}
+
+// the double evaluator walks with these, the Value one with value_negate and
+// the other value_ functions, so both share FORMULA_BATCH_EVALUATOR
+static inline double _formula_batch_double_from_double(double value) {
+  return value;
+}
+static inline double _formula_batch_double_number(double value) {
+  return value;
+}
+static inline double _formula_batch_double_to_double(double value) {
+  return value;
+}
+static inline double _formula_batch_double_negate(double value) {
+  return -value;
+}
+static inline double _formula_batch_double_add(double lhs, double rhs) {
+  return lhs + rhs;
+}
+static inline double _formula_batch_double_subtract(double lhs, double rhs) {
+  return lhs - rhs;
+}
+static inline double _formula_batch_double_multiply(double lhs, double rhs) {
+  return lhs * rhs;
+}
+static inline double _formula_batch_double_divide(double lhs, double rhs) {
+  return lhs / rhs;
+}
+static inline double _formula_batch_double_modulo(double lhs, double rhs) {
+  return fmod(lhs, rhs);
+}
+static inline double _formula_batch_double_power(double lhs, double rhs) {
+  return pow(lhs, rhs);
+}
+
+// defines name, which evaluates every node of this once per row with values
+// of type Type and the functions ops##_add and so on, constants keep their
+// value across rows and the walk skips them. Returns false when out of memory.
+#define FORMULA_BATCH_EVALUATOR(name, Type, ops)                               \
+  static bool name(const FormulaBatch *this, const Type *vars,                 \
+                   size_t row_count, Type *results) {                          \
+    size_t variable_count = formula_batch_get_variable_count(this);            \
+    size_t node_count = list_get_count(this->_inner_nodes);                    \
+    size_t formula_count = list_get_count(this->_inner_outputs);               \
+    Type *values = malloc(node_count * sizeof(Type));                          \
+    if (values == NULL) {                                                      \
+      return false;                                                            \
+    }                                                                          \
+    const FormulaBatchNode *nodes = this->_inner_nodes;                        \
+    const double *constants = bytecode_get_constants(&this->_inner_symbols);   \
+    for (size_t i = 0; i < node_count; i++) {                                  \
+      if (nodes[i].opcode == OP_PUSH_CONSTANT) {                               \
+        values[i] = ops##_from_double(constants[nodes[i].lhs]);                \
+      }                                                                        \
+    }                                                                          \
+                                                                               \
+    for (size_t row = 0; row < row_count; row++) {                             \
+      const Type *row_vars = vars + row * variable_count;                      \
+      for (size_t i = 0; i < node_count; i++) {                                \
+        FormulaBatchNode node = nodes[i];                                      \
+        switch (node.opcode) {                                                 \
+        case OP_PUSH_CONSTANT:                                                 \
+          break;                                                               \
+        case OP_LOAD_VARIABLE:                                                 \
+          values[i] = row_vars[node.lhs];                                      \
+          break;                                                               \
+        case OP_NEGATE:                                                        \
+          values[i] = ops##_negate(values[node.lhs]);                          \
+          break;                                                               \
+        case OP_ADD:                                                           \
+          values[i] = ops##_add(values[node.lhs], values[node.rhs]);           \
+          break;                                                               \
+        case OP_SUBTRACT:                                                      \
+          values[i] = ops##_subtract(values[node.lhs], values[node.rhs]);      \
+          break;                                                               \
+        case OP_MULTIPLY:                                                      \
+          values[i] = ops##_multiply(values[node.lhs], values[node.rhs]);      \
+          break;                                                               \
+        case OP_DIVIDE:                                                        \
+          values[i] = ops##_divide(values[node.lhs], values[node.rhs]);        \
+          break;                                                               \
+        case OP_MODULO:                                                        \
+          values[i] = ops##_modulo(values[node.lhs], values[node.rhs]);        \
+          break;                                                               \
+        case OP_POWER:                                                         \
+          values[i] = ops##_power(values[node.lhs], values[node.rhs]);         \
+          break;                                                               \
+        case OP_CALL:                                                          \
+          values[i] = ops##_number(bytecode_functions[node.lhs].function(      \
+              ops##_to_double(values[node.rhs])));                             \
+          break;                                                               \
+        default:                                                               \
+          assert(0 && #name "(): unknown opcode");                             \
+          break;                                                               \
+        }                                                                      \
+      }                                                                        \
+                                                                               \
+      Type *row_results = results + row * formula_count;                       \
+      for (size_t f = 0; f < formula_count; f++) {                             \
+        row_results[f] = values[this->_inner_outputs[f]];                      \
+      }                                                                        \
+    }                                                                          \
+                                                                               \
+    free(values);                                                              \
+    return true;                                                               \
+  }
+
+FORMULA_BATCH_EVALUATOR(_formula_batch_evaluate_doubles, double,
+                        _formula_batch_double)
+FORMULA_BATCH_EVALUATOR(_formula_batch_evaluate_values, Value, value)
+
+bool formula_batch_evaluate_rows(const FormulaBatch *batch, const double *vars,
+                                 size_t row_count, double *results) {
+  assert(batch && "formula_batch_evaluate_rows(): arg batch was null");
+  size_t formula_count = list_get_count(batch->_inner_outputs);
+  assert((vars || formula_batch_get_variable_count(batch) == 0 ||
+          row_count == 0) &&
+         "formula_batch_evaluate_rows(): arg vars was null");
+  assert((results || formula_count == 0 || row_count == 0) &&
+         "formula_batch_evaluate_rows(): arg results was null");
+  if (row_count == 0 || formula_count == 0) {
+    return true;
+  }
+  return _formula_batch_evaluate_doubles(batch, vars, row_count, results);
+}
+
+bool formula_batch_evaluate_value_rows(const FormulaBatch *batch,
+                                       const Value *vars, size_t row_count,
+                                       Value *results) {
+  assert(batch && "formula_batch_evaluate_value_rows(): arg batch was null");
+  size_t formula_count = list_get_count(batch->_inner_outputs);
+  assert((vars || formula_batch_get_variable_count(batch) == 0 ||
+          row_count == 0) &&
+         "formula_batch_evaluate_value_rows(): arg vars was null");
+  assert((results || formula_count == 0 || row_count == 0) &&
+         "formula_batch_evaluate_value_rows(): arg results was null");
+  if (row_count == 0 || formula_count == 0) {
+    return true;
+  }
+  return _formula_batch_evaluate_values(batch, vars, row_count, results);
+}
@@ -0,0 +1,65 @@
+#ifndef FORMULA_BATCH
+#define FORMULA_BATCH
+#include "ast.h"
+#include "bytecode.h"
+#include "compiler.h"
+#include "token_list.h"
+#include "value.h"
+
+// One operation of the batch, its operands are nodes added before it.
+typedef struct FormulaBatchNode {
+  Opcode opcode; // OP_PUSH_CONSTANT ... OP_CALL
+  uint32_t lhs;  // constant, variable slot, function or first operand
+  uint32_t rhs;  // second operand, the argument of OP_CALL
+} FormulaBatchNode;
+
+// Many formulas compiled into one DAG. Every node is hash-consed: a subtree
+// that occurs in several formulas, or several times in one, becomes a single
+// node that is evaluated once per row. The operands of + and * are ordered
+// so x+y and y+x share too. Variables are numbered in the order they first
+// appear across the batch.
+typedef struct FormulaBatch {
+  FormulaBatchNode *_inner_nodes; // in evaluation order
+  uint32_t *_inner_outputs;       // the node of each formula
+  uint32_t *_inner_slots;         // node + 1 by hash, 0 is empty
+  size_t _inner_slot_mask;        // slot count - 1
+  uint32_t *_inner_node_ids;      // node of each ast node while adding
+  size_t _inner_added_node_count; // ast nodes before sharing
+  Bytecode _inner_symbols;        // only its constants and variables
+} FormulaBatch;
+
+bool formula_batch_init(FormulaBatch *batch);
+void formula_batch_destroy(FormulaBatch *batch);
+void formula_batch_clear(FormulaBatch *batch);
+// Adds ast as the next formula, its index is the formula count before.
+// first_token is the index in tokens of the first token of the expression.
+// Returns false and fills error when it does not compile, the batch is
+// unchanged then, or when out of memory, the batch is left empty then.
+bool formula_batch_add_ast(FormulaBatch *batch, const Ast *ast,
+                           TokenList *tokens, size_t first_token,
+                           CompileError *error);
+// parses and adds the expression that ends at the first EOI_TOKEN
+bool formula_batch_add_token_list(FormulaBatch *batch, TokenList *tokens,
+                                  CompileError *error);
+
+size_t formula_batch_get_formula_count(const FormulaBatch *batch);
+// nodes left after sharing, each is evaluated once per row
+size_t formula_batch_get_node_count(const FormulaBatch *batch);
+// ast nodes of all formulas added, what evaluating them apart would cost
+size_t formula_batch_get_added_node_count(const FormulaBatch *batch);
+const FormulaBatchNode *formula_batch_get_nodes(const FormulaBatch *batch);
+size_t formula_batch_get_variable_count(const FormulaBatch *batch);
+const char *formula_batch_get_variable_name(const FormulaBatch *batch,
+                                            size_t slot);
+
+// Row r of vars holds the variables of evaluation r, each row is
+// formula_batch_get_variable_count values long. results[r * formula count
+// + f] receives formula f of row r. Returns false when out of memory.
+bool formula_batch_evaluate_rows(const FormulaBatch *batch, const double *vars,
+                                 size_t row_count, double *results);
+// formula_batch_evaluate_rows with exact integers, see vm_evaluate_value
+bool formula_batch_evaluate_value_rows(const FormulaBatch *batch,
+                                       const Value *vars, size_t row_count,
+                                       Value *results);
+
+#endif
@@ -0,0 +1,216 @@
+#include "bytecode.h"
+#include "char_reader.h"
+#include "compiler.h"
+#include "formula_batch.h"
+#include "lexer.h"
+#include "test_helpers.h"
+#include "token_list.h"
+#include "vm.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool add_formula(FormulaBatch *batch, const char *input,
+                        CompileError *error) {
+  TokenList tokens = lex_string(input);
+  bool added = formula_batch_add_token_list(batch, &tokens, error);
+  token_list_distroy(&tokens);
+  return added;
+}
+
+static void test_shares_subtrees(void) {
+  FormulaBatch batch;
+  assert(formula_batch_init(&batch));
+  CompileError error;
+  assert(add_formula(&batch, "x * y + 1", &error));
+  assert(add_formula(&batch, "(y * x) * 2", &error));
+  assert(add_formula(&batch, "sqrt(x * y) - 1", &error));
+  assert(formula_batch_get_formula_count(&batch) == 3);
+  assert(formula_batch_get_added_node_count(&batch) == 16);
+  // x y (* x y) 1 (+ ...) 2 (* ... 2) (sqrt ...) (- ... 1)
+  assert(formula_batch_get_node_count(&batch) == 9);
+  assert(formula_batch_get_variable_count(&batch) == 2);
+  assert(strcmp(formula_batch_get_variable_name(&batch, 0), "x") == 0);
+  assert(strcmp(formula_batch_get_variable_name(&batch, 1), "y") == 0);
+
+  double vars[] = {3, 4, 1, 9};
+  double results[6];
+  assert(formula_batch_evaluate_rows(&batch, vars, 2, results));
+  assert(results[0] == 13 && results[1] == 24 && results[2] == sqrt(12) - 1);
+  assert(results[3] == 10 && results[4] == 18 && results[5] == 2);
+
+  formula_batch_clear(&batch);
+  assert(formula_batch_get_formula_count(&batch) == 0);
+  assert(formula_batch_get_node_count(&batch) == 0);
+  assert(add_formula(&batch, "z", &error));
+  assert(formula_batch_evaluate_rows(&batch, vars, 1, results));
+  assert(results[0] == 3);
+  formula_batch_destroy(&batch);
+}
+
+// 0 and -0 are different constants
+static void test_keeps_signed_zeros(void) {
+  FormulaBatch batch;
+  assert(formula_batch_init(&batch));
+  CompileError error;
+  assert(add_formula(&batch, "x * 0", &error));
+  assert(add_formula(&batch, "x * -0", &error));
+  assert(add_formula(&batch, "x * 0.0", &error));
+  assert(formula_batch_get_node_count(&batch) == 5);
+
+  double vars[] = {1};
+  double results[3];
+  assert(formula_batch_evaluate_rows(&batch, vars, 1, results));
+  assert(!signbit(results[0]) && signbit(results[1]) && !signbit(results[2]));
+  formula_batch_destroy(&batch);
+}
+
+static void test_errors(void) {
+  FormulaBatch batch;
+  assert(formula_batch_init(&batch));
+  CompileError error;
+  assert(add_formula(&batch, "x + 1", &error));
+  assert(!add_formula(&batch, "y + nope(x * 2)", &error));
+  assert(error.type == COMPILE_UNKNOWN_FUNCTION && error.token_index == 2);
+  assert(!add_formula(&batch, "(y", &error));
+  assert(error.type == COMPILE_PARSE_FAILED);
+  assert(formula_batch_get_formula_count(&batch) == 1);
+  assert(formula_batch_get_node_count(&batch) == 3);
+  assert(formula_batch_get_variable_count(&batch) == 1);
+  formula_batch_destroy(&batch);
+}
+
+// the value rows keep integers exact and match vm_evaluate_value
+static void test_integer_values(void) {
+  FormulaBatch batch;
+  assert(formula_batch_init(&batch));
+  CompileError error;
+  const char *inputs[] = {"x * y + 1", "(y * x) * 2 - x % 7", "x ^ 3 / y",
+                          "sqrt(x * y)"};
+  Bytecode bytecodes[4];
+  for (int f = 0; f < 4; f++) {
+    assert(add_formula(&batch, inputs[f], &error));
+    TokenList tokens = lex_string(inputs[f]);
+    assert(bytecode_init(&bytecodes[f]));
+    assert(compile_token_list(&tokens, &bytecodes[f], &error));
+    token_list_distroy(&tokens);
+  }
+
+  // rows of x, y
+  Value vars[] = {value_integer(1ll << 20), value_integer(3),
+                  value_integer(3037000500), value_integer(3037000500),
+                  value_number(2.5), value_integer(4)};
+  Value results[3][4];
+  assert(formula_batch_evaluate_value_rows(&batch, vars, 3, &results[0][0]));
+  assert(results[0][0].type == VALUE_INTEGER &&
+         results[0][0].integer == 3 * (1ll << 20) + 1);
+  assert(results[0][2].type == VALUE_NUMBER);
+  // x * y overflows int64
+  assert(results[1][0].type == VALUE_NUMBER);
+  for (int row = 0; row < 3; row++) {
+    for (int f = 0; f < 4; f++) {
+      Value x_y[] = {vars[row * 2], vars[row * 2 + 1]};
+      if (f == 1) {
+        Value swapped = x_y[0];
+        x_y[0] = x_y[1];
+        x_y[1] = swapped;
+      }
+      Value expected = vm_evaluate_value(&bytecodes[f], x_y);
+      assert(results[row][f].type == expected.type);
+      assert(value_to_double(results[row][f]) == value_to_double(expected));
+    }
+  }
+  for (int f = 0; f < 4; f++) {
+    bytecode_destroy(&bytecodes[f]);
+  }
+  formula_batch_destroy(&batch);
+}
+
+static const char *const random_operators[] = {" + ", " - ", " * ",
+                                               " / ", " % ", " ^ "};
+static const char *const random_variables[] = {"v0", "v1", "v2", "v3"};
+static const char *const random_functions[] = {"sqrt"};
+
+// every formula of the batch matches the bytecode compiled on its own
+static void test_matches_vm(void) {
+  srand(777);
+  for (int round = 0; round < 20; round++) {
+    // the formulas take parts from shared, so they have subtrees in common
+    ExpressionShape shape = {
+        random_operators, TEST_COUNT_OF(random_operators),
+        random_variables, TEST_COUNT_OF(random_variables),
+        random_functions, TEST_COUNT_OF(random_functions),
+        NULL,             0,
+        .fractions = 10, .negates = true, .mixes_brackets = false};
+    char shared[8][256];
+    const char *pieces[8];
+    for (int i = 0; i < 8; i++) {
+      shared[i][generate_expression(&shape, shared[i], 0, 3)] = '\0';
+      pieces[i] = shared[i];
+    }
+    shape.pieces = pieces;
+    shape.piece_count = 8;
+    shape.negates = false;
+
+    FormulaBatch batch;
+    assert(formula_batch_init(&batch));
+    Bytecode bytecodes[100];
+    for (int f = 0; f < 100; f++) {
+      char input[8192];
+      input[generate_expression(&shape, input, 0, 4)] = '\0';
+      TokenList tokens = lex_string(input);
+      CompileError error;
+      assert(bytecode_init(&bytecodes[f]));
+      assert(compile_token_list(&tokens, &bytecodes[f], &error));
+      assert(formula_batch_add_token_list(&batch, &tokens, &error));
+      token_list_distroy(&tokens);
+    }
+    assert(formula_batch_get_node_count(&batch) <
+           formula_batch_get_added_node_count(&batch) / 2);
+
+    double vars[3][4];
+    for (int row = 0; row < 3; row++) {
+      for (size_t slot = 0; slot < formula_batch_get_variable_count(&batch);
+           slot++) {
+        vars[row][slot] = (double)(rand() % 2000) / 100.0 - 10.0;
+      }
+    }
+    double results[3][100];
+    assert(formula_batch_evaluate_rows(&batch, &vars[0][0], 3, &results[0][0]));
+
+    for (int f = 0; f < 100; f++) {
+      for (int row = 0; row < 3; row++) {
+        double formula_vars[4];
+        for (size_t slot = 0;
+             slot < bytecode_get_variable_count(&bytecodes[f]); slot++) {
+          const char *name = bytecode_get_variable_name(&bytecodes[f], slot);
+          size_t i = 0;
+          while (strcmp(formula_batch_get_variable_name(&batch, i), name)) {
+            i++;
+          }
+          formula_vars[slot] = vars[row][i];
+        }
+        double expected = vm_evaluate(&bytecodes[f], formula_vars);
+        double actual = results[row][f];
+        assert(isnan(expected) ? isnan(actual)
+                               : memcmp(&actual, &expected,
+                                        sizeof(double)) == 0);
+      }
+      bytecode_destroy(&bytecodes[f]);
+    }
+    formula_batch_destroy(&batch);
+  }
+}
+
+int main(void) {
+  test_shares_subtrees();
+  test_keeps_signed_zeros();
+  test_errors();
+  test_integer_values();
+  test_matches_vm();
+
+  printf("All formula batch tests passed\n");
+  return 0;
+}
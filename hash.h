@@ -0,0 +1,20 @@
+#ifndef HASH
+#define HASH
+#include <stddef.h>
+#include <stdint.h>
+
+// the FNV-1a hash of no chars at all
+#define HASH_FNV1A_OFFSET 0xcbf29ce484222325u
+
+// continues the FNV-1a hash of the chars before with chars[0..count), starts
+// from HASH_FNV1A_OFFSET, cheap for the short names and inputs it hashes
+static inline uint64_t hash_fnv1a(uint64_t hash, const char *chars,
+                                  size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    hash ^= (unsigned char)chars[i];
+    hash *= 0x100000001b3u;
+  }
+  return hash;
+}
+
+#endif
@@ -0,0 +1,361 @@
+#if defined(__x86_64__) && defined(__linux__)
+#define _DEFAULT_SOURCE
+#define JIT_X86_64
+#endif
+
+#include "jit.h"
+#include "list.h"
+#include "vm.h"
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef JIT_X86_64
+#include <sys/mman.h>
+#include <unistd.h>
+
+// The value stack lives in xmm2..xmm15, stack slot i in xmm(i + 2). xmm0 and
+// xmm1 carry the arguments and the result of calls.
+#define JIT_FIRST_STACK_REGISTER 2
+#define JIT_MAX_STACK (16 - JIT_FIRST_STACK_REGISTER)
+// every xmm register is caller saved, the live stack registers are spilled
+// here around calls. A multiple of 16 keeps calls aligned.
+#define JIT_FRAME_SIZE (JIT_MAX_STACK * 8)
+
+// the constant pool follows the code, the sign mask for negation first
+#define JIT_POOL_SIGN_MASK 0
+#define JIT_POOL_CONSTANTS 16
+
+enum { JIT_RAX = 0, JIT_RBX = 3, JIT_RSP = 4, JIT_RIP_RELATIVE = 5 };
+
+enum {
+  JIT_PREFIX_F2 = 0xf2, // scalar double
+  JIT_PREFIX_66 = 0x66, // packed double
+  JIT_MOVSD_LOAD = 0x10,
+  JIT_MOVSD_STORE = 0x11,
+  JIT_MOVAPD = 0x28,
+  JIT_XORPD = 0x57,
+  JIT_ADDSD = 0x58,
+  JIT_MULSD = 0x59,
+  JIT_SUBSD = 0x5c,
+  JIT_DIVSD = 0x5e,
+};
+
+// a rip relative disp32 at offset that has to point at pool_offset
+typedef struct JitFixup {
+  size_t offset;
+  size_t pool_offset;
+} JitFixup;
+
+typedef struct JitAssembler {
+  uint8_t *code;
+  JitFixup *fixups;
+  bool failed; // out of memory
+} JitAssembler;
+
+static void _jit_emit_bytes(JitAssembler *this, const void *bytes,
+                            size_t count) {
+  uint8_t *code = list_add_many(this->code, bytes, count);
+  if (code == NULL) {
+    this->failed = true;
+    return;
+  }
+  this->code = code;
+}
+
+static void _jit_emit_byte(JitAssembler *this, uint8_t byte) {
+  _jit_emit_bytes(this, &byte, 1);
+}
+
+static void _jit_emit_u32(JitAssembler *this, uint32_t value) {
+  uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8),
+                      (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+  _jit_emit_bytes(this, bytes, 4);
+}
+
+static void _jit_emit_u64(JitAssembler *this, uint64_t value) {
+  _jit_emit_u32(this, (uint32_t)value);
+  _jit_emit_u32(this, (uint32_t)(value >> 32));
+}
+
+// prefix [rex] 0f opcode modrm, reg is an xmm register, rm an xmm register
+// (mod 3) or a general purpose base register
+static void _jit_emit_sse(JitAssembler *this, uint8_t prefix, uint8_t opcode,
+                          int reg, int mod, int rm) {
+  _jit_emit_byte(this, prefix);
+  uint8_t rex = (uint8_t)(0x40 | (reg >= 8 ? 0x4 : 0) | (rm >= 8 ? 0x1 : 0));
+  if (rex != 0x40) {
+    _jit_emit_byte(this, rex);
+  }
+  _jit_emit_byte(this, 0x0f);
+  _jit_emit_byte(this, opcode);
+  _jit_emit_byte(this, (uint8_t)((mod << 6) | ((reg & 7) << 3) | (rm & 7)));
+}
+
+static void _jit_emit_sse_registers(JitAssembler *this, uint8_t prefix,
+                                    uint8_t opcode, int dst, int src) {
+  _jit_emit_sse(this, prefix, opcode, dst, 3, src);
+}
+
+// [base + disp32], base is rbx or rsp
+static void _jit_emit_sse_memory(JitAssembler *this, uint8_t prefix,
+                                 uint8_t opcode, int reg, int base,
+                                 uint32_t disp) {
+  _jit_emit_sse(this, prefix, opcode, reg, 2, base);
+  if (base == JIT_RSP) {
+    _jit_emit_byte(this, 0x24); // sib, no index
+  }
+  _jit_emit_u32(this, disp);
+}
+
+static void _jit_emit_sse_pool(JitAssembler *this, uint8_t prefix,
+                               uint8_t opcode, int reg, size_t pool_offset) {
+  _jit_emit_sse(this, prefix, opcode, reg, 0, JIT_RIP_RELATIVE);
+  if (this->failed) {
+    return;
+  }
+
+  JitFixup fixup = {.offset = list_get_count(this->code),
+                    .pool_offset = pool_offset};
+  JitFixup *fixups = list_add(this->fixups, &fixup);
+  if (fixups == NULL) {
+    this->failed = true;
+    return;
+  }
+  this->fixups = fixups;
+  _jit_emit_u32(this, 0);
+}
+
+static int _jit_stack_register(size_t slot) {
+  return (int)slot + JIT_FIRST_STACK_REGISTER;
+}
+
+// calls function with the stack slots from first_argument on as arguments,
+// the result replaces first_argument
+static void _jit_emit_call(JitAssembler *this, uintptr_t function,
+                           size_t first_argument, size_t argument_count) {
+  for (size_t slot = 0; slot < first_argument; slot++) {
+    _jit_emit_sse_memory(this, JIT_PREFIX_F2, JIT_MOVSD_STORE,
+                         _jit_stack_register(slot), JIT_RSP,
+                         (uint32_t)(slot * 8));
+  }
+  for (size_t i = 0; i < argument_count; i++) {
+    _jit_emit_sse_registers(this, JIT_PREFIX_66, JIT_MOVAPD, (int)i,
+                            _jit_stack_register(first_argument + i));
+  }
+
+  _jit_emit_bytes(this, (uint8_t[]){0x48, 0xb8}, 2); // mov rax, imm64
+  _jit_emit_u64(this, (uint64_t)function);
+  _jit_emit_bytes(this, (uint8_t[]){0xff, 0xd0}, 2); // call rax
+
+  _jit_emit_sse_registers(this, JIT_PREFIX_66, JIT_MOVAPD,
+                          _jit_stack_register(first_argument), 0);
+  for (size_t slot = 0; slot < first_argument; slot++) {
+    _jit_emit_sse_memory(this, JIT_PREFIX_F2, JIT_MOVSD_LOAD,
+                         _jit_stack_register(slot), JIT_RSP,
+                         (uint32_t)(slot * 8));
+  }
+}
+
+static const uint8_t _jit_arithmetic_opcodes[OPCODE_COUNT] = {
+    [OP_ADD] = JIT_ADDSD,
+    [OP_SUBTRACT] = JIT_SUBSD,
+    [OP_MULTIPLY] = JIT_MULSD,
+    [OP_DIVIDE] = JIT_DIVSD,
+};
+
+// translates the stack code one instruction at a time, the stack depth of
+// every instruction is known statically so each slot maps to one register
+static bool _jit_assemble(JitAssembler *this, const Bytecode *bytecode) {
+  // push rbx; sub rsp, JIT_FRAME_SIZE; mov rbx, rdi
+  _jit_emit_bytes(this, (uint8_t[]){0x53, 0x48, 0x81, 0xec}, 4);
+  _jit_emit_u32(this, JIT_FRAME_SIZE);
+  _jit_emit_bytes(this, (uint8_t[]){0x48, 0x89, 0xfb}, 3);
+
+  const Instruction *instructions = bytecode_get_instructions(bytecode);
+  size_t count = bytecode_get_instruction_count(bytecode);
+  size_t depth = 0;
+  for (size_t i = 0; i < count && !this->failed; i++) {
+    Opcode opcode = INSTRUCTION_OPCODE(instructions[i]);
+    uint32_t operand = INSTRUCTION_OPERAND(instructions[i]);
+    switch (opcode) {
+    case OP_PUSH_CONSTANT:
+      _jit_emit_sse_pool(this, JIT_PREFIX_F2, JIT_MOVSD_LOAD,
+                         _jit_stack_register(depth),
+                         JIT_POOL_CONSTANTS + (size_t)operand * 8);
+      depth++;
+      break;
+    case OP_LOAD_VARIABLE:
+      _jit_emit_sse_memory(this, JIT_PREFIX_F2, JIT_MOVSD_LOAD,
+                           _jit_stack_register(depth), JIT_RBX,
+                           operand * 8);
+      depth++;
+      break;
+    case OP_NEGATE:
+      _jit_emit_sse_pool(this, JIT_PREFIX_66, JIT_XORPD,
+                         _jit_stack_register(depth - 1), JIT_POOL_SIGN_MASK);
+      break;
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_MULTIPLY:
+    case OP_DIVIDE:
+      _jit_emit_sse_registers(this, JIT_PREFIX_F2,
+                              _jit_arithmetic_opcodes[opcode],
+                              _jit_stack_register(depth - 2),
+                              _jit_stack_register(depth - 1));
+      depth--;
+      break;
+    case OP_MODULO:
+    case OP_POWER: {
+      double (*function)(double, double) = opcode == OP_MODULO ? fmod : pow;
+      _jit_emit_call(this, (uintptr_t)function, depth - 2, 2);
+      depth--;
+      break;
+    }
+    case OP_CALL:
+      _jit_emit_call(this, (uintptr_t)bytecode_functions[operand].function,
+                     depth - 1, 1);
+      break;
+    case OP_RETURN:
+      // movapd xmm0, xmm2; add rsp, JIT_FRAME_SIZE; pop rbx; ret
+      _jit_emit_sse_registers(this, JIT_PREFIX_66, JIT_MOVAPD, 0,
+                              _jit_stack_register(0));
+      _jit_emit_bytes(this, (uint8_t[]){0x48, 0x81, 0xc4}, 3);
+      _jit_emit_u32(this, JIT_FRAME_SIZE);
+      _jit_emit_bytes(this, (uint8_t[]){0x5b, 0xc3}, 2);
+      depth--;
+      break;
+    default:
+      return false;
+    }
+  }
+  return !this->failed;
+}
+
+// maps the code and its constant pool, patches the pool references and makes
+// the mapping executable, it is never writable and executable at once
+static bool _jit_install(JitAssembler *this, const Bytecode *bytecode,
+                         JitCode *code) {
+  size_t code_size = list_get_count(this->code);
+  size_t pool_start = (code_size + 15) & ~(size_t)15;
+  size_t constant_count = 0;
+  for (size_t i = 0; i < bytecode_get_instruction_count(bytecode); i++) {
+    Instruction instruction = bytecode_get_instructions(bytecode)[i];
+    if (INSTRUCTION_OPCODE(instruction) == OP_PUSH_CONSTANT &&
+        INSTRUCTION_OPERAND(instruction) + 1 > constant_count) {
+      constant_count = INSTRUCTION_OPERAND(instruction) + 1;
+    }
+  }
+
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  size_t size = pool_start + JIT_POOL_CONSTANTS + constant_count * 8;
+  size = (size + page_size - 1) / page_size * page_size;
+  uint8_t *memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    return false;
+  }
+
+  memcpy(memory, this->code, code_size);
+  uint64_t sign_mask[2] = {UINT64_C(1) << 63, UINT64_C(1) << 63};
+  memcpy(memory + pool_start + JIT_POOL_SIGN_MASK, sign_mask,
+         sizeof(sign_mask));
+  if (constant_count != 0) {
+    memcpy(memory + pool_start + JIT_POOL_CONSTANTS,
+           bytecode_get_constants(bytecode), constant_count * 8);
+  }
+
+  for (size_t i = 0; i < list_get_count(this->fixups); i++) {
+    JitFixup fixup = this->fixups[i];
+    int32_t disp = (int32_t)((pool_start + fixup.pool_offset) -
+                             (fixup.offset + 4));
+    memcpy(memory + fixup.offset, &disp, 4);
+  }
+
+  if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, size);
+    return false;
+  }
+  __builtin___clear_cache((char *)memory, (char *)memory + code_size);
+
+  code->_inner_memory = memory;
+  code->_inner_memory_size = size;
+  code->_inner_function = (JitFunction)(void *)memory;
+  return true;
+}
+
+static void _jit_compile_native(const Bytecode *bytecode, JitCode *code) {
+  if (bytecode_get_max_stack(bytecode) > JIT_MAX_STACK) {
+    return;
+  }
+
+  JitAssembler assembler = {.code = list(uint8_t, 256),
+                            .fixups = list(JitFixup, 16),
+                            .failed = false};
+  if (assembler.code != NULL && assembler.fixups != NULL &&
+      _jit_assemble(&assembler, bytecode)) {
+    _jit_install(&assembler, bytecode, code);
+  }
+
+  if (assembler.code != NULL) {
+    list_free(assembler.code);
+  }
+  if (assembler.fixups != NULL) {
+    list_free(assembler.fixups);
+  }
+}
+#endif
+
+bool jit_is_supported(void) {
+#ifdef JIT_X86_64
+  return true;
+#else
+  return false;
+#endif
+}
+
+void jit_compile(const Bytecode *bytecode, JitCode *code) {
+  assert(bytecode && "jit_compile(): arg bytecode was null");
+  assert(code && "jit_compile(): arg code was null");
+  assert(bytecode_get_instruction_count(bytecode) &&
+         "jit_compile(): bytecode is empty");
+  code->_inner_function = NULL;
+  code->_inner_bytecode = bytecode;
+  code->_inner_memory = NULL;
+  code->_inner_memory_size = 0;
+#ifdef JIT_X86_64
+  _jit_compile_native(bytecode, code);
+#endif
+}
+
+void jit_destroy(JitCode *code) {
+  assert(code && "jit_destroy(): arg code was null");
+#ifdef JIT_X86_64
+  if (code->_inner_memory != NULL) {
+    munmap(code->_inner_memory, code->_inner_memory_size);
+  }
+#endif
+  code->_inner_function = NULL;
+  code->_inner_bytecode = NULL;
+  code->_inner_memory = NULL;
+  code->_inner_memory_size = 0;
+}
+
+bool jit_is_native(const JitCode *code) {
+  assert(code && "jit_is_native(): arg code was null");
+  return code->_inner_function != NULL;
+}
+
+JitFunction jit_get_function(const JitCode *code) {
+  assert(code && "jit_get_function(): arg code was null");
+  return code->_inner_function;
+}
+
+double jit_evaluate(const JitCode *code, const double *vars) {
+  assert(code && "jit_evaluate(): arg code was null");
+  if (code->_inner_function != NULL) {
+    return code->_inner_function(vars);
+  }
+  return vm_evaluate(code->_inner_bytecode, vars);
+}
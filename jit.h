@@ -0,0 +1,33 @@
+#ifndef JIT
+#define JIT
+#include "bytecode.h"
+
+typedef double (*JitFunction)(const double *vars);
+
+// Native code for one Bytecode, or the Bytecode itself when the expression
+// could not be compiled to native code. The bytecode has to outlive the
+// JitCode either way. Like the Bytecode it is only read after compiling, so
+// many threads can evaluate one JitCode at the same time. The native code
+// works on SSE2 doubles only, the overflow checks of Value would need a
+// branch and a fallback per operation, so exact integers go through
+// vm_evaluate_value or eval_value_columns.
+typedef struct JitCode {
+  JitFunction _inner_function; // NULL when falling back to the interpreter
+  const Bytecode *_inner_bytecode;
+  void *_inner_memory;
+  size_t _inner_memory_size;
+} JitCode;
+
+// native code is only generated on x86-64 linux
+bool jit_is_supported(void);
+// Always succeeds. The code is native unless the platform is not supported,
+// the expression needs more registers than the code generator has or the
+// executable memory could not be mapped.
+void jit_compile(const Bytecode *bytecode, JitCode *code);
+void jit_destroy(JitCode *code);
+bool jit_is_native(const JitCode *code);
+// NULL when the code is not native
+JitFunction jit_get_function(const JitCode *code);
+double jit_evaluate(const JitCode *code, const double *vars);
+
+#endif
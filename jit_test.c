@@ -0,0 +1,142 @@
+#include "bytecode.h"
+#include "char_reader.h"
+#include "compiler.h"
+#include "jit.h"
+#include "lexer.h"
+#include "test_helpers.h"
+#include "token_list.h"
+#include "vm.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the jit runs the same IEEE operations and libm calls in the same order as
+// the interpreter, so the results have to be bit for bit equal
+static bool same_bits(double a, double b) {
+  return (isnan(a) && isnan(b)) || memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+static void assert_matches_vm(const char *input, const Bytecode *bytecode,
+                              const JitCode *code, const double *vars) {
+  double expected = vm_evaluate(bytecode, vars);
+  double actual = jit_evaluate(code, vars);
+  if (!same_bits(actual, expected)) {
+    fprintf(stderr, "jit evaluated \"%s\" to %.17g, the vm to %.17g\n", input,
+            actual, expected);
+  }
+  assert(same_bits(actual, expected));
+}
+
+static void test_native_function(void) {
+  Bytecode bytecode;
+  compile_string("x * 2 + y / 4 - -3", &bytecode);
+  JitCode code;
+  jit_compile(&bytecode, &code);
+  assert(jit_is_native(&code) == jit_is_supported());
+
+  double vars[] = {1.5, 10};
+  if (jit_is_native(&code)) {
+    JitFunction function = jit_get_function(&code);
+    assert(function(vars) == 1.5 * 2 + 10.0 / 4 + 3);
+  }
+  assert(jit_evaluate(&code, vars) == 1.5 * 2 + 10.0 / 4 + 3);
+
+  jit_destroy(&code);
+  bytecode_destroy(&bytecode);
+}
+
+static void test_calls_keep_live_registers(void) {
+  const char *input = "a + b * (c - sqrt(a) % 3 ^ b) / abs(c - 100)";
+  Bytecode bytecode;
+  compile_string(input, &bytecode);
+  JitCode code;
+  jit_compile(&bytecode, &code);
+
+  double vars[] = {16, 2.5, -7};
+  assert_matches_vm(input, &bytecode, &code, vars);
+
+  jit_destroy(&code);
+  bytecode_destroy(&bytecode);
+}
+
+static void test_deep_expression_falls_back(void) {
+  // every "1 + (" keeps one more value on the stack than the jit has
+  // registers for
+  char input[512] = "";
+  for (int i = 0; i < 20; i++) {
+    strcat(input, "x + (");
+  }
+  strcat(input, "x");
+  for (int i = 0; i < 20; i++) {
+    strcat(input, ")");
+  }
+
+  Bytecode bytecode;
+  compile_string(input, &bytecode);
+  JitCode code;
+  jit_compile(&bytecode, &code);
+  assert(!jit_is_native(&code));
+  assert(jit_get_function(&code) == NULL);
+
+  double x = 0.5;
+  assert(jit_evaluate(&code, &x) == 21 * 0.5);
+
+  jit_destroy(&code);
+  bytecode_destroy(&bytecode);
+}
+
+static const char *const random_operators[] = {" + ", " - ", " * ", " / ",
+                                               " % ", " ^ ", " ** "};
+static const char *const random_variables[] = {"v0", "v1", "v2",
+                                               "v3", "v4", "v5"};
+static const char *const random_functions[] = {"sqrt", "abs", "exp", "floor",
+                                               "sin"};
+static const ExpressionShape random_shape = {
+    random_operators, TEST_COUNT_OF(random_operators),
+    random_variables, TEST_COUNT_OF(random_variables),
+    random_functions, TEST_COUNT_OF(random_functions),
+    NULL,             0,
+    .fractions = 100, .negates = true, .mixes_brackets = false};
+
+// differential test of the jit against the interpreter
+static void test_random_expressions_match_vm(void) {
+  srand(42);
+  size_t native_count = 0;
+  for (int i = 0; i < 5000; i++) {
+    char input[8192];
+    size_t length = generate_expression(&random_shape, input, 0, 1 + rand() % 7);
+    input[length] = '\0';
+
+    Bytecode bytecode;
+    compile_string(input, &bytecode);
+    JitCode code;
+    jit_compile(&bytecode, &code);
+    native_count += jit_is_native(&code);
+
+    for (int row = 0; row < 8; row++) {
+      double vars[6];
+      for (int v = 0; v < 6; v++) {
+        vars[v] = (double)(rand() % 4001) / 100.0 - 20.0;
+      }
+      assert_matches_vm(input, &bytecode, &code, vars);
+    }
+
+    jit_destroy(&code);
+    bytecode_destroy(&bytecode);
+  }
+
+  // nearly everything this shallow fits in the registers
+  assert(!jit_is_supported() || native_count > 4900);
+}
+
+int main(void) {
+  test_native_function();
+  test_calls_keep_live_registers();
+  test_deep_expression_falls_back();
+  test_random_expressions_match_vm();
+
+  printf("All jit tests passed\n");
+  return 0;
+}
@@ -1,20 +1,24 @@
 #include "lexer.h"
+#include "char_scan.h"
 #include "list.h"
+#include "number.h"
 #include "token_list.h"
 #include <assert.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
-#include <ctype.h>
-
-typedef struct Lexer {
-  list_(Token) token_list;
-  list_(char) lexemes_container;
-  size_t current_lexeme_start_index;
-} Lexer;
+#include <string.h>
 
 typedef enum State {
   START,
-  NUMBER,
+  NUMBER,    // digits that can no longer be grouped
+  LEADING_1, // the 1 to 3 digits before the first ',' separator
+  LEADING_2,
+  LEADING_3,
+  SEPARATOR, // ',' that must be followed by 3 digits
+  GROUP_1,
+  GROUP_2,
+  GROUP_3,
   DECIMAL,
   IDENTIFIER,
   PLUS,     // +
@@ -30,1135 +34,796 @@ typedef enum State {
   RBRACKET, // ]
   LBRACE,   // {
   RBRACE,   // }
+  STATE_COUNT
 } State;
 
-static bool _lexer_init(Lexer *this) {
-  assert(this && "_lexer_init(): this arg was null");
-  assert(!this->token_list && !this->lexemes_container &&
-         "_lexer_init(): init a not distroied lexer");
-
-  this->token_list = list(Token, 25);
-  if (this->token_list == NULL) {
-    return false;
-  }
+#ifdef LEXER_STATS
+_Static_assert(STATE_COUNT == LEXER_STATE_COUNT,
+               "LEXER_STATE_COUNT does not match the State enum");
 
-  this->lexemes_container = list(char, 150);
-  if (this->lexemes_container == NULL) {
-    list_free(this->token_list);
-    return false;
-  }
+static _Thread_local LexerStats _lexer_stats;
 
-  this->current_lexeme_start_index = 0;
-  return true;
+static inline void _lexer_stats_count(State from, State to, size_t bytes) {
+  _lexer_stats.state_counts[from] += bytes;
+  _lexer_stats.transitions[from][to] += bytes;
 }
 
-static TokenList _lexer_destroy(Lexer *this) {
-  assert(this && "_lexer_destroy(): this arg was null");
-  assert(this->token_list && this->lexemes_container && "_lexer_destroy(): destroied a not init lexer");
-
-  TokenList token_list = {._inner_token_list = this->token_list,
-                          ._inner_lexemes_container = this->lexemes_container};
-
-  this->token_list = NULL;
-  this->lexemes_container = NULL;
-  return token_list;
+// the statement only exists in builds with -DLEXER_STATS
+#define LEXER_STATS_COUNT(statement) statement
+#else
+#define LEXER_STATS_COUNT(statement)
+#endif
+
+static void _lexer_reset(Lexer *this, CharReader *reader,
+                         CharReaderSpan span) {
+  this->_inner_reader = reader;
+  this->_inner_span = span;
+  this->_inner_position = span.chars;
+  this->_inner_state = START;
+  this->_inner_is_done = false;
+  this->_inner_lexeme_start = NULL;
+  this->_inner_pending_lexeme_end = NULL;
+  this->_inner_queue_head = 0;
+  this->_inner_queue_count = 0;
+  if (!this->_inner_keeps_lexemes) {
+    list_clear(this->_inner_lexemes);
+  }
+  this->_inner_lexeme_start_index = list_get_count(this->_inner_lexemes);
 }
 
-static void _lexer_add_char(Lexer *this, unsigned char c) {
-  assert(this && "_lexer_add_token(): arg this was null");
-  char *new_container = list_add(this->lexemes_container, &c);
-  if (new_container == NULL) {
-    fprintf(stderr,
-            "_lexer_add_char(): failed to add char to lexemes_container");
-    exit(1);
-  }
+static bool _lexer_init(Lexer *this, CharReader *reader, Arena *arena,
+                        bool keeps_lexemes) {
+  assert(this && "_lexer_init(): this arg was null");
+  assert(reader && "_lexer_init(): reader arg was null");
 
-  if (new_container == this->lexemes_container) {
-    return;
+  this->_inner_lexemes = list_in(arena, char, 150);
+  if (this->_inner_lexemes == NULL) {
+    return false;
   }
 
-  for (size_t i = 0; i < list_get_count(this->token_list); i++) {
-    size_t new_index = this->token_list[i].lexeme - this->lexemes_container;
-    this->token_list[i].lexeme = &new_container[new_index];
-  }
+  this->_inner_keeps_lexemes = keeps_lexemes;
+  this->_inner_symbols = NULL;
+  _lexer_reset(this, reader,
+               (CharReaderSpan){.chars = NULL, .length = 0, .is_borrowed = false});
+  return true;
+}
 
-  this->lexemes_container = new_container;
+bool lexer_init(Lexer *lexer, CharReader *reader) {
+  assert(lexer && "lexer_init(): arg lexer was null");
+  return _lexer_init(lexer, reader, NULL, false);
 }
 
-static void _lexer_add_token(Lexer *this, Token token) {
-  assert(this && "_lexer_add_token(): arg this was null");
-  this->token_list = list_add(this->token_list, &token);
-  if (this->token_list == NULL) {
-    fprintf(stderr, "_lexer_add_token(): failed to add token to token_list");
-    exit(1);
-  }
+bool lexer_init_in(Lexer *lexer, CharReader *reader, Arena *arena) {
+  assert(lexer && "lexer_init_in(): arg lexer was null");
+  assert(arena && "lexer_init_in(): arg arena was null");
+  return _lexer_init(lexer, reader, arena, false);
 }
 
-static void _lexer_cut_token(Lexer *this, TokenType cut_type) {
-  _lexer_add_char(this, '\0');
-  Token token = {
-      .type = cut_type,
-      .lexeme = &this->lexemes_container[this->current_lexeme_start_index]};
-  _lexer_add_token(this, token);
-  this->current_lexeme_start_index = list_get_count(this->lexemes_container);
+void lexer_reset(Lexer *lexer, CharReader *reader) {
+  assert(lexer && "lexer_reset(): arg lexer was null");
+  assert(reader && "lexer_reset(): arg reader was null");
+  assert(lexer->_inner_lexemes && "lexer_reset(): lexer not initialized");
+  _lexer_reset(lexer, reader,
+               (CharReaderSpan){.chars = NULL, .length = 0, .is_borrowed = false});
 }
 
-static State _lexer_start(Lexer *this, unsigned char c) {
-  if (isspace(c)) {
-    return START;
-  }
+void lexer_reset_view(Lexer *lexer, const char *chars, size_t length) {
+  assert(lexer && "lexer_reset_view(): arg lexer was null");
+  assert((chars || length == 0) && "lexer_reset_view(): arg chars was null");
+  assert(lexer->_inner_lexemes && "lexer_reset_view(): lexer not initialized");
+  _lexer_reset(lexer, NULL,
+               (CharReaderSpan){.chars = length ? chars : NULL,
+                                .length = length,
+                                .is_borrowed = true});
+}
 
-  _lexer_add_char(this, c);
-  if (c == '.') {
-    return DECIMAL;
-  }
-  if (c >= '0' && c <= '9') {
-    return NUMBER;
-  }
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    return IDENTIFIER;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
-  }
-  if (c == '*') {
-    return MULTIPLY;
-  }
-  if (c == '/') {
-    return DIVIDE;
-  }
-  if (c == '%') {
-    return MODULO;
-  }
-  if (c == '^') {
-    return POWER;
+void lexer_destroy(Lexer *lexer) {
+  assert(lexer && "lexer_destroy(): arg lexer was null");
+  if (lexer->_inner_lexemes != NULL) {
+    list_free(lexer->_inner_lexemes);
   }
-  if (c == '(') {
-    return LPAREN;
-  }
-  if (c == ')') {
-    return RPAREN;
-  }
-  if (c == '[') {
-    return LBRACKET;
-  }
-  if (c == ']') {
-    return RBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  if (c == '}') {
-    return RBRACE;
-  }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
+  lexer->_inner_lexemes = NULL;
+  lexer->_inner_reader = NULL;
 }
 
-static State _lexer_number(Lexer *this, unsigned char c) {
-  if (isspace(c)) {
-    _lexer_cut_token(this, NUMBER_TOKEN);
-    return START;
-  }
-  if (c == '.') {
-    _lexer_add_char(this, c);
-    return DECIMAL;
-  }
-  if (c >= '0' && c <= '9') {
-    _lexer_add_char(this, c);
-    return NUMBER;
+static void _lexer_append_chars(Lexer *this, const char *chars,
+                                size_t count) {
+  assert(this && "_lexer_append_chars(): arg this was null");
+  LEXER_STATS_COUNT(size_t capacity = list_get_capacity(this->_inner_lexemes));
+  char *new_lexemes = list_add_many(this->_inner_lexemes, chars, count);
+  if (new_lexemes == NULL) {
+    fprintf(stderr, "_lexer_append_chars(): failed to add chars to lexemes");
+    exit(1);
   }
+  LEXER_STATS_COUNT(if (list_get_capacity(new_lexemes) != capacity) {
+    _lexer_stats.lexeme_reallocs++;
+    if (new_lexemes != this->_inner_lexemes) {
+      _lexer_stats.lexeme_moved_bytes += list_get_count(new_lexemes) - count;
+    }
+  })
 
-  _lexer_cut_token(this, NUMBER_TOKEN);
-  _lexer_add_char(this, c);
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    return (c == 'e' || c == 'E') ? POTENTIAL_EXPONENT : IDENTIFIER;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
-  }
-  if (c == '*') {
-    return MULTIPLY;
-  }
-  if (c == '/') {
-    return DIVIDE;
-  }
-  if (c == '%') {
-    return MODULO;
-  }
-  if (c == '^') {
-    return POWER;
-  }
-  if (c == '(') {
-    return LPAREN;
-  }
-  if (c == ')') {
-    return RPAREN;
-  }
-  if (c == '[') {
-    return LBRACKET;
-  }
-  if (c == ']') {
-    return RBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  if (c == '}') {
-    return RBRACE;
-  }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
+  this->_inner_lexemes = new_lexemes;
 }
 
-static State _lexer_decimal(Lexer *this, unsigned char c) {
-  if (isspace(c)) {
-    _lexer_cut_token(this, NUMBER_TOKEN);
-    return START;
-  }
-  if (c >= '0' && c <= '9') {
-    _lexer_add_char(this, c);
-    return DECIMAL;
-  }
+static void _lexer_queue_token(Lexer *this, Token token) {
+  assert(this->_inner_queue_head + this->_inner_queue_count < 2 &&
+         "_lexer_queue_token(): token queue overflow");
+  this->_inner_queue[this->_inner_queue_head + this->_inner_queue_count] =
+      token;
+  this->_inner_queue_count++;
+}
 
-  _lexer_cut_token(this, NUMBER_TOKEN);
-  _lexer_add_char(this, c);
-  if (c == '.') {
-    return DECIMAL;
-  }
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    return (c == 'e' || c == 'E') ? POTENTIAL_EXPONENT : IDENTIFIER;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
-  }
-  if (c == '*') {
-    return MULTIPLY;
-  }
-  if (c == '/') {
-    return DIVIDE;
-  }
-  if (c == '%') {
-    return MODULO;
-  }
-  if (c == '^') {
-    return POWER;
-  }
-  if (c == '(') {
-    return LPAREN;
-  }
-  if (c == ')') {
-    return RPAREN;
-  }
-  if (c == '[') {
-    return LBRACKET;
-  }
-  if (c == ']') {
-    return RBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  if (c == '}') {
-    return RBRACE;
+// interns the lexeme of an identifier token and borrows it from the table
+static void _lexer_intern(Lexer *this, Token *token, const char *chars) {
+  uint32_t symbol;
+  if (!symbol_table_intern(this->_inner_symbols, chars, token->lexeme_length,
+                           &symbol)) {
+    fprintf(stderr, "_lexer_intern(): failed to intern identifier");
+    exit(1);
   }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
+  token->symbol = symbol;
+  token->lexeme_is_borrowed = 1;
+  token->lexeme_chars = symbol_table_get_name(this->_inner_symbols, symbol).chars;
 }
 
-static State _lexer_identifier(Lexer *this, unsigned char c) {
-  if (isspace(c)) {
-    _lexer_cut_token(this, IDENTIFIER_TOKEN);
-    return START;
-  }
-  if (c >= '0' && c <= '9') {
-    _lexer_add_char(this, c);
-    return IDENTIFIER;
-  }
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    _lexer_add_char(this, c);
-    return IDENTIFIER;
+// queues the current lexeme, which ends right before end, as a token. The
+// lexeme is borrowed when it lies entirely inside one borrowed span. Numbers
+// are converted here, while their digits are still in the cache.
+static void _lexer_cut_token(Lexer *this, TokenType cut_type,
+                             const char *end) {
+  LEXER_STATS_COUNT(_lexer_stats.cut_tokens++);
+  bool is_borrowed = this->_inner_span.is_borrowed;
+  if (this->_inner_pending_lexeme_end != NULL) {
+    end = this->_inner_pending_lexeme_end;
+    is_borrowed = true;
+    this->_inner_pending_lexeme_end = NULL;
+  }
+
+  size_t copied_count = list_get_count(this->_inner_lexemes) -
+                        this->_inner_lexeme_start_index;
+  if (is_borrowed && copied_count == 0 && this->_inner_lexeme_start != NULL) {
+    size_t length = (size_t)(end - this->_inner_lexeme_start);
+    if (length > TOKEN_MAX_LEXEME_LENGTH) {
+      fprintf(stderr, "_lexer_cut_token(): lexeme longer than 2GB");
+      exit(1);
+    }
+
+    Token token = {.type = cut_type,
+                   .lexeme_length = (uint32_t)length,
+                   .lexeme_is_borrowed = 1,
+                   .lexeme_chars = this->_inner_lexeme_start};
+    if (cut_type == NUMBER_TOKEN) {
+      token.number = number_parse(this->_inner_lexeme_start, length, 0);
+    } else if (cut_type == IDENTIFIER_TOKEN && this->_inner_symbols != NULL) {
+      _lexer_intern(this, &token, this->_inner_lexeme_start);
+    }
+    _lexer_queue_token(this, token);
+    this->_inner_lexeme_start = NULL;
+    return;
   }
 
-  _lexer_cut_token(this, IDENTIFIER_TOKEN);
-  _lexer_add_char(this, c);
-  if (c == '.') {
-    return DECIMAL;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
-  }
-  if (c == '*') {
-    return MULTIPLY;
-  }
-  if (c == '/') {
-    return DIVIDE;
-  }
-  if (c == '%') {
-    return MODULO;
-  }
-  if (c == '^') {
-    return POWER;
-  }
-  if (c == '(') {
-    return LPAREN;
-  }
-  if (c == ')') {
-    return RPAREN;
+  if (this->_inner_lexeme_start != NULL) {
+    _lexer_append_chars(this, this->_inner_lexeme_start,
+                        (size_t)(end - this->_inner_lexeme_start));
+    this->_inner_lexeme_start = NULL;
   }
-  if (c == '[') {
-    return LBRACKET;
-  }
-  if (c == ']') {
-    return RBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  if (c == '}') {
-    return RBRACE;
+
+  size_t end_index = list_get_count(this->_inner_lexemes);
+  size_t length = end_index - this->_inner_lexeme_start_index;
+  if (length > TOKEN_MAX_LEXEME_LENGTH) {
+    fprintf(stderr, "_lexer_cut_token(): lexeme longer than 2GB");
+    exit(1);
   }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
-}
 
-static State _lexer_plus(Lexer *this, unsigned char c) {
-  _lexer_cut_token(this, PLUS_TOKEN);
+  Token token = {.type = cut_type,
+                 .lexeme_length = (uint32_t)length,
+                 .lexeme_is_borrowed = 0,
+                 .lexeme_offset = this->_inner_lexeme_start_index};
+  if (cut_type == NUMBER_TOKEN) {
+    token.number = number_parse(
+        &this->_inner_lexemes[this->_inner_lexeme_start_index], length, 0);
+  } else if (cut_type == IDENTIFIER_TOKEN && this->_inner_symbols != NULL) {
+    // the table has its own copy, the scratch space is handed back
+    _lexer_intern(this, &token,
+                  &this->_inner_lexemes[this->_inner_lexeme_start_index]);
+    list_remove_range(this->_inner_lexemes, this->_inner_lexeme_start_index,
+                      length);
+    end_index = this->_inner_lexeme_start_index;
+  }
+  _lexer_queue_token(this, token);
+  this->_inner_lexeme_start_index = end_index;
+}
 
-  if (isspace(c)) {
-    return START;
-  }
+// Every (state, byte) pair maps to one packed transition:
+//   bits 0-4   next state
+//   bits 5-9   type + 1 of the token to cut before the byte, 0 for none
+//   bit 10     the byte belongs to the current lexeme
+//   bit 11     the appended byte is an INVALID_TOKEN on its own
+// The table below is generated by the preprocessor from the LEX_FROM_* rules,
+// so the whole lexer is specified in one place.
+#define LEX_STATE_MASK 0x1fu
+#define LEX_CUT_SHIFT 5
+#define LEX_CUT_MASK 0x1fu
+#define LEX_ADD 0x400u
+#define LEX_INVALID 0x800u
+
+#define LEX_T(next, cut, flags)                                                \
+  ((uint16_t)((next) | ((cut) << LEX_CUT_SHIFT) | (flags)))
+#define LEX_CUT(type) ((type) + 1)
+
+#define LEX_IS_SPACE(c)                                                        \
+  ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\v' || (c) == '\f' ||  \
+   (c) == '\r')
+#define LEX_IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+#define LEX_IS_LETTER(c)                                                       \
+  (((c) >= 'A' && (c) <= 'Z') || ((c) >= 'a' && (c) <= 'z') || (c) == '_')
+#define LEX_IS_E(c) ((c) == 'e' || (c) == 'E')
+
+// state entered when a lexeme begins with c, START when c is invalid
+#define LEX_BEGIN_STATE(c)                                                     \
+  ((c) == '.'          ? DECIMAL                                               \
+   : LEX_IS_DIGIT(c)   ? LEADING_1                                             \
+   : LEX_IS_LETTER(c)  ? IDENTIFIER                                            \
+   : (c) == '+'        ? PLUS                                                  \
+   : (c) == '-'        ? MINUS                                                 \
+   : (c) == '*'        ? MULTIPLY                                              \
+   : (c) == '/'        ? DIVIDE                                                \
+   : (c) == '%'        ? MODULO                                                \
+   : (c) == '^'        ? POWER                                                 \
+   : (c) == '('        ? LPAREN                                                \
+   : (c) == ')'        ? RPAREN                                                \
+   : (c) == '['        ? LBRACKET                                              \
+   : (c) == ']'        ? RBRACKET                                              \
+   : (c) == '{'        ? LBRACE                                                \
+   : (c) == '}'        ? RBRACE                                                \
+                       : START)
+
+// cut (may be 0), then begin a new lexeme with the non space byte c
+#define LEX_BEGIN(c, cut)                                                      \
+  (LEX_BEGIN_STATE(c) == START                                                 \
+       ? LEX_T(START, cut, LEX_ADD | LEX_INVALID)                              \
+       : LEX_T(LEX_BEGIN_STATE(c), cut, LEX_ADD))
+
+// the current token ends before c no matter what c is
+#define LEX_CUT_THEN(c, type)                                                  \
+  (LEX_IS_SPACE(c) ? LEX_T(START, LEX_CUT(type), 0)                            \
+                   : LEX_BEGIN(c, LEX_CUT(type)))
+
+#define LEX_FROM_START(c) (LEX_IS_SPACE(c) ? LEX_T(START, 0, 0) : LEX_BEGIN(c, 0))
+
+#define LEX_FROM_NUMBER(c)                                                     \
+  ((c) == '.'         ? LEX_T(DECIMAL, 0, LEX_ADD)                             \
+   : LEX_IS_DIGIT(c)  ? LEX_T(NUMBER, 0, LEX_ADD)                              \
+   : LEX_IS_E(c)      ? LEX_T(POTENTIAL_EXPONENT, LEX_CUT(NUMBER_TOKEN), LEX_ADD) \
+                      : LEX_CUT_THEN(c, NUMBER_TOKEN))
+
+// 11,222,333 and 11,222.333444: a group of up to 3 digits, then groups of
+// exactly 3 after each ','. The fraction is not grouped.
+#define LEX_FROM_GROUPED(c, digit_transition)                                  \
+  ((c) == '.'         ? LEX_T(DECIMAL, 0, LEX_ADD)                             \
+   : (c) == ','       ? LEX_T(SEPARATOR, 0, LEX_ADD)                           \
+   : LEX_IS_DIGIT(c)  ? (digit_transition)                                     \
+   : LEX_IS_E(c)      ? LEX_T(POTENTIAL_EXPONENT, LEX_CUT(NUMBER_TOKEN), LEX_ADD) \
+                      : LEX_CUT_THEN(c, NUMBER_TOKEN))
+
+#define LEX_FROM_LEADING_1(c) LEX_FROM_GROUPED(c, LEX_T(LEADING_2, 0, LEX_ADD))
+#define LEX_FROM_LEADING_2(c) LEX_FROM_GROUPED(c, LEX_T(LEADING_3, 0, LEX_ADD))
+#define LEX_FROM_LEADING_3(c) LEX_FROM_GROUPED(c, LEX_T(NUMBER, 0, LEX_ADD))
+// a 4th digit in a group ends the number like a 2nd '.' does
+#define LEX_FROM_GROUP_3(c) LEX_FROM_GROUPED(c, LEX_CUT_THEN(c, NUMBER_TOKEN))
+
+// a group cut short can not be split into tokens any more, the number so far
+// is an INVALID_TOKEN
+#define LEX_FROM_SEPARATOR(c)                                                  \
+  (LEX_IS_DIGIT(c) ? LEX_T(GROUP_1, 0, LEX_ADD) : LEX_CUT_THEN(c, INVALID_TOKEN))
+#define LEX_FROM_GROUP_1(c)                                                    \
+  (LEX_IS_DIGIT(c) ? LEX_T(GROUP_2, 0, LEX_ADD) : LEX_CUT_THEN(c, INVALID_TOKEN))
+#define LEX_FROM_GROUP_2(c)                                                    \
+  (LEX_IS_DIGIT(c) ? LEX_T(GROUP_3, 0, LEX_ADD) : LEX_CUT_THEN(c, INVALID_TOKEN))
+
+#define LEX_FROM_DECIMAL(c)                                                    \
+  (LEX_IS_DIGIT(c)    ? LEX_T(DECIMAL, 0, LEX_ADD)                             \
+   : LEX_IS_E(c)      ? LEX_T(POTENTIAL_EXPONENT, LEX_CUT(NUMBER_TOKEN), LEX_ADD) \
+                      : LEX_CUT_THEN(c, NUMBER_TOKEN))
+
+#define LEX_FROM_IDENTIFIER(c)                                                 \
+  (LEX_IS_DIGIT(c) || LEX_IS_LETTER(c) ? LEX_T(IDENTIFIER, 0, LEX_ADD)         \
+                                       : LEX_CUT_THEN(c, IDENTIFIER_TOKEN))
+
+#define LEX_FROM_MULTIPLY(c)                                                   \
+  ((c) == '*' ? LEX_T(POWER, 0, LEX_ADD) : LEX_CUT_THEN(c, MULTIPLY_TOKEN))
+
+// 'e' is an exponent only when something that can start a number follows it,
+// otherwise it is the start of an identifier
+#define LEX_FROM_POTENTIAL_EXPONENT(c)                                         \
+  (LEX_IS_SPACE(c)    ? LEX_T(START, LEX_CUT(IDENTIFIER_TOKEN), 0)             \
+   : LEX_IS_LETTER(c) ? LEX_T(IDENTIFIER, 0, LEX_ADD)                          \
+   : (c) == '/' || (c) == '%' || (c) == '*' || (c) == '^' || (c) == ')' ||     \
+           (c) == ']' || (c) == '}'                                            \
+       ? LEX_BEGIN(c, LEX_CUT(IDENTIFIER_TOKEN))                               \
+       : LEX_BEGIN(c, LEX_CUT(EXPONENT_TOKEN)))
+
+#define LEX_FROM_PLUS(c) LEX_CUT_THEN(c, PLUS_TOKEN)
+#define LEX_FROM_MINUS(c) LEX_CUT_THEN(c, MINUS_TOKEN)
+#define LEX_FROM_DIVIDE(c) LEX_CUT_THEN(c, DIVIDE_TOKEN)
+#define LEX_FROM_MODULO(c) LEX_CUT_THEN(c, MODULO_TOKEN)
+#define LEX_FROM_POWER(c) LEX_CUT_THEN(c, POWER_TOKEN)
+#define LEX_FROM_LPAREN(c) LEX_CUT_THEN(c, LPAREN_TOKEN)
+#define LEX_FROM_RPAREN(c) LEX_CUT_THEN(c, RPAREN_TOKEN)
+#define LEX_FROM_LBRACKET(c) LEX_CUT_THEN(c, LBRACKET_TOKEN)
+#define LEX_FROM_RBRACKET(c) LEX_CUT_THEN(c, RBRACKET_TOKEN)
+#define LEX_FROM_LBRACE(c) LEX_CUT_THEN(c, LBRACE_TOKEN)
+#define LEX_FROM_RBRACE(c) LEX_CUT_THEN(c, RBRACE_TOKEN)
+
+#define LEX_R4(f, c) f(c), f((c) + 1), f((c) + 2), f((c) + 3)
+#define LEX_R16(f, c)                                                          \
+  LEX_R4(f, c), LEX_R4(f, (c) + 4), LEX_R4(f, (c) + 8), LEX_R4(f, (c) + 12)
+#define LEX_R64(f, c)                                                          \
+  LEX_R16(f, c), LEX_R16(f, (c) + 16), LEX_R16(f, (c) + 32),                  \
+      LEX_R16(f, (c) + 48)
+#define LEX_ROW(f)                                                             \
+  { LEX_R64(f, 0), LEX_R64(f, 64), LEX_R64(f, 128), LEX_R64(f, 192) }
+
+static const uint16_t _lexer_transitions[STATE_COUNT][256] = {
+    [START] = LEX_ROW(LEX_FROM_START),
+    [NUMBER] = LEX_ROW(LEX_FROM_NUMBER),
+    [LEADING_1] = LEX_ROW(LEX_FROM_LEADING_1),
+    [LEADING_2] = LEX_ROW(LEX_FROM_LEADING_2),
+    [LEADING_3] = LEX_ROW(LEX_FROM_LEADING_3),
+    [SEPARATOR] = LEX_ROW(LEX_FROM_SEPARATOR),
+    [GROUP_1] = LEX_ROW(LEX_FROM_GROUP_1),
+    [GROUP_2] = LEX_ROW(LEX_FROM_GROUP_2),
+    [GROUP_3] = LEX_ROW(LEX_FROM_GROUP_3),
+    [DECIMAL] = LEX_ROW(LEX_FROM_DECIMAL),
+    [IDENTIFIER] = LEX_ROW(LEX_FROM_IDENTIFIER),
+    [PLUS] = LEX_ROW(LEX_FROM_PLUS),
+    [MINUS] = LEX_ROW(LEX_FROM_MINUS),
+    [MULTIPLY] = LEX_ROW(LEX_FROM_MULTIPLY),
+    [DIVIDE] = LEX_ROW(LEX_FROM_DIVIDE),
+    [MODULO] = LEX_ROW(LEX_FROM_MODULO),
+    [POWER] = LEX_ROW(LEX_FROM_POWER),
+    [POTENTIAL_EXPONENT] = LEX_ROW(LEX_FROM_POTENTIAL_EXPONENT),
+    [LPAREN] = LEX_ROW(LEX_FROM_LPAREN),
+    [RPAREN] = LEX_ROW(LEX_FROM_RPAREN),
+    [LBRACKET] = LEX_ROW(LEX_FROM_LBRACKET),
+    [RBRACKET] = LEX_ROW(LEX_FROM_RBRACKET),
+    [LBRACE] = LEX_ROW(LEX_FROM_LBRACE),
+    [RBRACE] = LEX_ROW(LEX_FROM_RBRACE)};
+
+// states that a run of digits, identifier chars or whitespace keeps as is,
+// with the scanner that finds where such a run ends
+static size_t (*const _lexer_run_scanners[STATE_COUNT])(const char *chars,
+                                                        size_t length) = {
+    [START] = char_scan_whitespace,
+    [NUMBER] = char_scan_digits,
+    [DECIMAL] = char_scan_digits,
+    [IDENTIFIER] = char_scan_identifier};
+
+static inline State _lexer_step(Lexer *this, State state, const char *at) {
+  uint16_t transition = _lexer_transitions[state][(unsigned char)*at];
+
+  unsigned cut = (transition >> LEX_CUT_SHIFT) & LEX_CUT_MASK;
+  if (cut) {
+    _lexer_cut_token(this, (TokenType)(cut - 1), at);
+  }
+  if ((transition & LEX_ADD) && this->_inner_lexeme_start == NULL) {
+    this->_inner_lexeme_start = at;
+  }
+  if (transition & LEX_INVALID) {
+    _lexer_cut_token(this, INVALID_TOKEN, at + 1);
+  }
+
+  LEXER_STATS_COUNT(
+      _lexer_stats_count(state, (State)(transition & LEX_STATE_MASK), 1));
+  return (State)(transition & LEX_STATE_MASK);
+}
 
-  _lexer_add_char(this, c);
-  if (c == '.') {
-    return DECIMAL;
-  }
-  if (c >= '0' && c <= '9') {
-    return NUMBER;
-  }
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    return IDENTIFIER;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
-  }
-  if (c == '*') {
-    return MULTIPLY;
-  }
-  if (c == '/') {
-    return DIVIDE;
-  }
-  if (c == '%') {
-    return MODULO;
-  }
-  if (c == '^') {
-    return POWER;
-  }
-  if (c == '(') {
-    return LPAREN;
-  }
-  if (c == ')') {
-    return RPAREN;
-  }
-  if (c == '[') {
-    return LBRACKET;
+static void _lexer_begin_span(Lexer *this, CharReaderSpan span) {
+  this->_inner_span = span;
+  this->_inner_position = span.chars;
+
+  // the lexeme left over from the previous borrowed span goes on into this
+  // one, so it can no longer be borrowed
+  if (this->_inner_pending_lexeme_end != NULL) {
+    uint16_t transition =
+        _lexer_transitions[this->_inner_state][(unsigned char)*span.chars];
+    if (((transition >> LEX_CUT_SHIFT) & LEX_CUT_MASK) == 0) {
+      _lexer_append_chars(this, this->_inner_lexeme_start,
+                          (size_t)(this->_inner_pending_lexeme_end -
+                                   this->_inner_lexeme_start));
+      this->_inner_lexeme_start = NULL;
+      this->_inner_pending_lexeme_end = NULL;
+    }
   }
-  if (c == ']') {
-    return RBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  if (c == '}') {
-    return RBRACE;
-  }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
 }
 
-static State _lexer_minus(Lexer *this, unsigned char c) {
-  _lexer_cut_token(this, MINUS_TOKEN);
+static void _lexer_end_span(Lexer *this) {
+  const char *end = this->_inner_span.chars + this->_inner_span.length;
 
-  if (isspace(c)) {
-    return START;
+  // owned spans are freed once consumed, borrowed ones stay valid
+  if (this->_inner_lexeme_start != NULL) {
+    if (this->_inner_span.is_borrowed) {
+      this->_inner_pending_lexeme_end = end;
+    } else {
+      _lexer_append_chars(this, this->_inner_lexeme_start,
+                          (size_t)(end - this->_inner_lexeme_start));
+      this->_inner_lexeme_start = NULL;
+    }
   }
 
-  _lexer_add_char(this, c);
-  if (c == '.') {
-    return DECIMAL;
-  }
-  if (c >= '0' && c <= '9') {
-    return NUMBER;
-  }
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    return IDENTIFIER;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
-  }
-  if (c == '*') {
-    return MULTIPLY;
-  }
-  if (c == '/') {
-    return DIVIDE;
-  }
-  if (c == '%') {
-    return MODULO;
+  if (this->_inner_reader != NULL) {
+    char_reader_consume(this->_inner_reader, this->_inner_span.length);
   }
-  if (c == '^') {
-    return POWER;
-  }
-  if (c == '(') {
-    return LPAREN;
-  }
-  if (c == ')') {
-    return RPAREN;
-  }
-  if (c == '[') {
-    return LBRACKET;
-  }
-  if (c == ']') {
-    return RBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  if (c == '}') {
-    return RBRACE;
-  }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
 }
 
-static State _lexer_multiply(Lexer *this, unsigned char c) {
-  if (isspace(c)) {
-    _lexer_cut_token(this, MULTIPLY_TOKEN);
-    return START;
-  }
-  if (c == '*') {
-    _lexer_add_char(this, c);
-    return POWER;
+static void _lexer_finish(Lexer *this) {
+  uint16_t transition = _lexer_transitions[this->_inner_state][' '];
+  unsigned cut = (transition >> LEX_CUT_SHIFT) & LEX_CUT_MASK;
+  if (cut) {
+    _lexer_cut_token(this, (TokenType)(cut - 1), NULL);
   }
 
-  _lexer_cut_token(this, MULTIPLY_TOKEN);
-  _lexer_add_char(this, c);
-  if (c == '.') {
-    return DECIMAL;
-  }
-  if (c >= '0' && c <= '9') {
-    return NUMBER;
-  }
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    return IDENTIFIER;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
-  }
-  if (c == '/') {
-    return DIVIDE;
-  }
-  if (c == '%') {
-    return MODULO;
-  }
-  if (c == '^') {
-    return POWER;
-  }
-  if (c == '(') {
-    return LPAREN;
-  }
-  if (c == ')') {
-    return RPAREN;
-  }
-  if (c == '[') {
-    return LBRACKET;
-  }
-  if (c == ']') {
-    return RBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  if (c == '}') {
-    return RBRACE;
-  }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
+  Token end_token = {.type = EOI_TOKEN,
+                     .lexeme_length = 0,
+                     .lexeme_is_borrowed = 0,
+                     .lexeme_offset = list_get_count(this->_inner_lexemes)};
+  _lexer_queue_token(this, end_token);
+  this->_inner_state = START;
+  this->_inner_is_done = true;
 }
 
-static State _lexer_potential_exponent(Lexer *this, unsigned char c) {
-  if (isspace(c)) {
-    _lexer_cut_token(this, IDENTIFIER_TOKEN);
-    return START;
-  }
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    _lexer_add_char(this, c);
-    return IDENTIFIER;
-  }
-  if (c == '/') {
-    _lexer_cut_token(this, IDENTIFIER_TOKEN);
-    _lexer_add_char(this, c);
-    return DIVIDE;
-  }
-  if (c == '%') {
-    _lexer_cut_token(this, IDENTIFIER_TOKEN);
-    _lexer_add_char(this, c);
-    return MODULO;
-  }
-  if (c == '*') {
-    _lexer_cut_token(this, IDENTIFIER_TOKEN);
-    _lexer_add_char(this, c);
-    return MULTIPLY;
-  }
-  if (c == '^') {
-    _lexer_cut_token(this, IDENTIFIER_TOKEN);
-    _lexer_add_char(this, c);
-    return POWER;
-  }
-  if (c == ')') {
-    _lexer_cut_token(this, IDENTIFIER_TOKEN);
-    _lexer_add_char(this, c);
-    return RPAREN;
-  }
-  if (c == ']') {
-    _lexer_cut_token(this, IDENTIFIER_TOKEN);
-    _lexer_add_char(this, c);
-    return RBRACKET;
-  }
-  if (c == '}') {
-    _lexer_cut_token(this, IDENTIFIER_TOKEN);
-    _lexer_add_char(this, c);
-    return RBRACE;
-  }
-
-  _lexer_cut_token(this, EXPONENT_TOKEN);
-  _lexer_add_char(this, c);
-  if (c == '.') {
-    return DECIMAL;
-  }
-  if (c >= '0' && c <= '9') {
-    return NUMBER;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
+// lexes until at least one token is queued
+static void _lexer_fill_queue(Lexer *this) {
+  while (this->_inner_queue_count == 0) {
+    const char *end = this->_inner_span.length == 0
+                          ? this->_inner_position
+                          : this->_inner_span.chars + this->_inner_span.length;
+    if (this->_inner_position == end) {
+      if (this->_inner_span.length != 0) {
+        _lexer_end_span(this);
+      }
+
+      CharReaderSpan span = {.chars = NULL, .length = 0, .is_borrowed = false};
+      if (this->_inner_reader != NULL) {
+        span = char_reader_peek_span(this->_inner_reader);
+      }
+      if (span.length == 0) {
+        this->_inner_span = span;
+        this->_inner_position = NULL;
+        _lexer_finish(this);
+        return;
+      }
+      _lexer_begin_span(this, span);
+      end = span.chars + span.length;
+    }
+
+    State state = (State)this->_inner_state;
+    const char *at = this->_inner_position;
+    while (at < end) {
+      state = _lexer_step(this, state, at);
+      at++;
+
+      // a run only moves `at`, the lexeme start and the state stay the same,
+      // so the rest of it can be skipped at once. Runs of one char are
+      // common and are left to the table.
+      size_t (*scan_run)(const char *, size_t) = _lexer_run_scanners[state];
+      if (scan_run != NULL && at < end &&
+          (_lexer_transitions[state][(unsigned char)*at] & ~LEX_ADD) ==
+              state) {
+        size_t run = scan_run(at, (size_t)(end - at));
+        LEXER_STATS_COUNT(_lexer_stats_count(state, state, run));
+        at += run;
+      }
+
+      if (this->_inner_queue_count != 0) {
+        break;
+      }
+    }
+    this->_inner_state = state;
+    this->_inner_position = at;
   }
-  if (c == '(') {
-    return LPAREN;
-  }
-  if (c == '[') {
-    return LBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
 }
 
-static State _lexer_divide(Lexer *this, unsigned char c) {
-  _lexer_cut_token(this, DIVIDE_TOKEN);
+bool lexer_next_token(Lexer *lexer, Token *token) {
+  assert(lexer && "lexer_next_token(): arg lexer was null");
+  assert(token && "lexer_next_token(): arg token was null");
+  assert(lexer->_inner_lexemes && "lexer_next_token(): lexer not initialized");
+
+  if (lexer->_inner_queue_count == 0) {
+    if (lexer->_inner_is_done) {
+      return false;
+    }
+
+    // the lexemes handed out so far are no longer needed, only the part of
+    // the current lexeme that was already copied is kept
+    lexer->_inner_queue_head = 0;
+    if (!lexer->_inner_keeps_lexemes) {
+      list_remove_range(lexer->_inner_lexemes, 0,
+                        lexer->_inner_lexeme_start_index);
+      lexer->_inner_lexeme_start_index = 0;
+    }
+    _lexer_fill_queue(lexer);
+  }
+
+  *token = lexer->_inner_queue[lexer->_inner_queue_head];
+  lexer->_inner_queue_head++;
+  lexer->_inner_queue_count--;
+  return true;
+}
 
-  if (isspace(c)) {
-    return START;
-  }
+void lexer_set_symbol_table(Lexer *lexer, SymbolTable *symbols) {
+  assert(lexer && "lexer_set_symbol_table(): arg lexer was null");
+  lexer->_inner_symbols = symbols;
+}
 
-  _lexer_add_char(this, c);
-  if (c == '.') {
-    return DECIMAL;
-  }
-  if (c >= '0' && c <= '9') {
-    return NUMBER;
-  }
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    return IDENTIFIER;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
-  }
-  if (c == '*') {
-    return MULTIPLY;
-  }
-  if (c == '/') {
-    return DIVIDE;
-  }
-  if (c == '%') {
-    return MODULO;
-  }
-  if (c == '^') {
-    return POWER;
+Lexeme lexer_get_lexeme(const Lexer *lexer, Token token) {
+  assert(lexer && "lexer_get_lexeme(): arg lexer was null");
+  if (token.lexeme_length == 0) {
+    return (Lexeme){.chars = NULL, .length = 0};
   }
-  if (c == '(') {
-    return LPAREN;
+  if (token.lexeme_is_borrowed) {
+    return (Lexeme){.chars = token.lexeme_chars,
+                    .length = token.lexeme_length};
   }
-  if (c == ')') {
-    return RPAREN;
-  }
-  if (c == '[') {
-    return LBRACKET;
-  }
-  if (c == ']') {
-    return RBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  if (c == '}') {
-    return RBRACE;
-  }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
-}
 
-static State _lexer_modulo(Lexer *this, unsigned char c) {
-  _lexer_cut_token(this, MODULO_TOKEN);
+  assert(token.lexeme_offset + token.lexeme_length <=
+             list_get_count(lexer->_inner_lexemes) &&
+         "lexer_get_lexeme(): lexeme is no longer in the scratch window");
+  return (Lexeme){.chars = &lexer->_inner_lexemes[token.lexeme_offset],
+                  .length = token.lexeme_length};
+}
 
-  if (isspace(c)) {
-    return START;
+static TokenList _lex_char_reader(CharReader *reader, Arena *arena,
+                                  SymbolTable *symbols) {
+  // the scratch window is kept whole and becomes the lexemes container
+  Lexer lexer;
+  if (_lexer_init(&lexer, reader, arena, true) == false) {
+    fprintf(stderr, "failed to initialize lexer");
+    exit(1);
   }
+  lexer._inner_symbols = symbols;
 
-  _lexer_add_char(this, c);
-  if (c == '.') {
-    return DECIMAL;
-  }
-  if (c >= '0' && c <= '9') {
-    return NUMBER;
-  }
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    return IDENTIFIER;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
-  }
-  if (c == '*') {
-    return MULTIPLY;
-  }
-  if (c == '/') {
-    return DIVIDE;
-  }
-  if (c == '%') {
-    return MODULO;
-  }
-  if (c == '^') {
-    return POWER;
-  }
-  if (c == '(') {
-    return LPAREN;
-  }
-  if (c == ')') {
-    return RPAREN;
-  }
-  if (c == '[') {
-    return LBRACKET;
-  }
-  if (c == ']') {
-    return RBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  if (c == '}') {
-    return RBRACE;
+  list_(Token) token_list = list_in(arena, Token, 25);
+  if (token_list == NULL) {
+    fprintf(stderr, "failed to initialize token list");
+    exit(1);
   }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
-}
-
-static State _lexer_power(Lexer *this, unsigned char c) {
-  _lexer_cut_token(this, POWER_TOKEN);
 
-  if (isspace(c)) {
-    return START;
+  Token token;
+  while (lexer_next_token(&lexer, &token)) {
+    token_list = list_add(token_list, &token);
+    if (token_list == NULL) {
+      fprintf(stderr, "lex_char_reader(): failed to add token to token_list");
+      exit(1);
+    }
   }
 
-  _lexer_add_char(this, c);
-  if (c == '.') {
-    return DECIMAL;
-  }
-  if (c >= '0' && c <= '9') {
-    return NUMBER;
-  }
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    return IDENTIFIER;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
-  }
-  if (c == '*') {
-    return MULTIPLY;
-  }
-  if (c == '/') {
-    return DIVIDE;
-  }
-  if (c == '%') {
-    return MODULO;
-  }
-  if (c == '^') {
-    return POWER;
-  }
-  if (c == '(') {
-    return LPAREN;
-  }
-  if (c == ')') {
-    return RPAREN;
-  }
-  if (c == '[') {
-    return LBRACKET;
-  }
-  if (c == ']') {
-    return RBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  if (c == '}') {
-    return RBRACE;
-  }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
+  TokenList tokens = {._inner_token_list = token_list,
+                      ._inner_lexemes_container = lexer._inner_lexemes};
+  lexer._inner_lexemes = NULL;
+  lexer_destroy(&lexer);
+  return tokens;
 }
 
-static State _lexer_lparen(Lexer *this, unsigned char c) {
-  _lexer_cut_token(this, LPAREN_TOKEN);
-
-  if (isspace(c)) {
-    return START;
+TokenColumns lex_char_reader_columns(CharReader *reader) {
+  assert(reader && "lex_char_reader_columns(): arg reader was null");
+  Lexer lexer;
+  if (_lexer_init(&lexer, reader, NULL, true) == false) {
+    fprintf(stderr, "failed to initialize lexer");
+    exit(1);
   }
 
-  _lexer_add_char(this, c);
-  if (c == '.') {
-    return DECIMAL;
-  }
-  if (c >= '0' && c <= '9') {
-    return NUMBER;
-  }
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    return IDENTIFIER;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
-  }
-  if (c == '*') {
-    return MULTIPLY;
-  }
-  if (c == '/') {
-    return DIVIDE;
-  }
-  if (c == '%') {
-    return MODULO;
-  }
-  if (c == '^') {
-    return POWER;
-  }
-  if (c == '(') {
-    return LPAREN;
-  }
-  if (c == ')') {
-    return RPAREN;
-  }
-  if (c == '[') {
-    return LBRACKET;
-  }
-  if (c == ']') {
-    return RBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  if (c == '}') {
-    return RBRACE;
+  TokenColumns columns = {._inner_types = list(uint8_t, 64),
+                          ._inner_spans = list(TokenSpan, 64),
+                          ._inner_numbers = list(double, 64)};
+  if (columns._inner_types == NULL || columns._inner_spans == NULL ||
+      columns._inner_numbers == NULL) {
+    fprintf(stderr, "failed to initialize token columns");
+    exit(1);
   }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
-}
 
-static State _lexer_rparen(Lexer *this, unsigned char c) {
-  _lexer_cut_token(this, RPAREN_TOKEN);
+  Token token;
+  while (lexer_next_token(&lexer, &token)) {
+    uint8_t type = (uint8_t)token.type;
+    TokenSpan span = {.length = token.lexeme_length,
+                      .is_borrowed = token.lexeme_is_borrowed};
+    if (token.lexeme_is_borrowed) {
+      span.chars = token.lexeme_chars;
+    } else {
+      span.offset = token.lexeme_offset;
+    }
+    uint8_t *types = list_add(columns._inner_types, &type);
+    TokenSpan *spans = types ? list_add(columns._inner_spans, &span) : NULL;
+    double *numbers =
+        spans ? list_add(columns._inner_numbers, &token.number) : NULL;
+    if (numbers == NULL) {
+      fprintf(stderr,
+              "lex_char_reader_columns(): failed to add token to columns");
+      exit(1);
+    }
+    columns._inner_types = types;
+    columns._inner_spans = spans;
+    columns._inner_numbers = numbers;
+  }
+
+  columns._inner_lexemes = lexer._inner_lexemes;
+  lexer._inner_lexemes = NULL;
+  lexer_destroy(&lexer);
+  return columns;
+}
 
-  if (isspace(c)) {
-    return START;
-  }
+TokenList lex_char_reader(CharReader *reader) {
+  assert(reader && "lex_char_reader(): arg reader was null");
+  return _lex_char_reader(reader, NULL, NULL);
+}
 
-  _lexer_add_char(this, c);
-  if (c == '.') {
-    return DECIMAL;
-  }
-  if (c >= '0' && c <= '9') {
-    return NUMBER;
-  }
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    return IDENTIFIER;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
-  }
-  if (c == '*') {
-    return MULTIPLY;
-  }
-  if (c == '/') {
-    return DIVIDE;
-  }
-  if (c == '%') {
-    return MODULO;
-  }
-  if (c == '^') {
-    return POWER;
-  }
-  if (c == '(') {
-    return LPAREN;
-  }
-  if (c == ')') {
-    return RPAREN;
-  }
-  if (c == '[') {
-    return LBRACKET;
-  }
-  if (c == ']') {
-    return RBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  if (c == '}') {
-    return RBRACE;
-  }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
+TokenList lex_char_reader_interned(CharReader *reader, SymbolTable *symbols) {
+  assert(reader && "lex_char_reader_interned(): arg reader was null");
+  assert(symbols && "lex_char_reader_interned(): arg symbols was null");
+  return _lex_char_reader(reader, NULL, symbols);
 }
 
-static State _lexer_lbracket(Lexer *this, unsigned char c) {
-  _lexer_cut_token(this, LBRACKET_TOKEN);
+TokenList lex_char_reader_in(CharReader *reader, Arena *arena) {
+  assert(reader && "lex_char_reader_in(): arg reader was null");
+  assert(arena && "lex_char_reader_in(): arg arena was null");
+  return _lex_char_reader(reader, arena, NULL);
+}
 
-  if (isspace(c)) {
-    return START;
+// lexes the input the lexer was reset to as one more expression of batch,
+// the lexemes that are copied go straight into the batch lexeme storage
+static void _lexer_lex_into_batch(Lexer *this, TokenBatch *batch) {
+  char *scratch = this->_inner_lexemes;
+  bool keeps_lexemes = this->_inner_keeps_lexemes;
+  this->_inner_lexemes = batch->_inner_lexemes;
+  this->_inner_keeps_lexemes = true;
+  this->_inner_lexeme_start_index = list_get_count(batch->_inner_lexemes);
+
+  size_t start = list_get_count(batch->_inner_tokens);
+  size_t *expression_starts = list_add(batch->_inner_expression_starts, &start);
+  if (expression_starts == NULL) {
+    fprintf(stderr, "_lexer_lex_into_batch(): failed to add expression");
+    exit(1);
   }
+  batch->_inner_expression_starts = expression_starts;
 
-  _lexer_add_char(this, c);
-  if (c == '.') {
-    return DECIMAL;
-  }
-  if (c >= '0' && c <= '9') {
-    return NUMBER;
-  }
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    return IDENTIFIER;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
-  }
-  if (c == '*') {
-    return MULTIPLY;
-  }
-  if (c == '/') {
-    return DIVIDE;
-  }
-  if (c == '%') {
-    return MODULO;
+  Token token;
+  while (lexer_next_token(this, &token)) {
+    Token *tokens = list_add(batch->_inner_tokens, &token);
+    if (tokens == NULL) {
+      fprintf(stderr, "_lexer_lex_into_batch(): failed to add token");
+      exit(1);
+    }
+    batch->_inner_tokens = tokens;
   }
-  if (c == '^') {
-    return POWER;
-  }
-  if (c == '(') {
-    return LPAREN;
-  }
-  if (c == ')') {
-    return RPAREN;
-  }
-  if (c == '[') {
-    return LBRACKET;
-  }
-  if (c == ']') {
-    return RBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  if (c == '}') {
-    return RBRACE;
-  }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
-}
 
-static State _lexer_rbracket(Lexer *this, unsigned char c) {
-  _lexer_cut_token(this, RBRACKET_TOKEN);
+  batch->_inner_lexemes = this->_inner_lexemes;
+  this->_inner_lexemes = scratch;
+  this->_inner_keeps_lexemes = keeps_lexemes;
+  this->_inner_lexeme_start_index = 0;
+}
 
-  if (isspace(c)) {
-    return START;
-  }
+void lex_batch(Lexer *lexer, const char *const *inputs,
+               const size_t *input_lengths, size_t count, TokenBatch *batch) {
+  assert(lexer && "lex_batch(): arg lexer was null");
+  assert((inputs && input_lengths) || count == 0);
+  assert(batch && "lex_batch(): arg batch was null");
 
-  _lexer_add_char(this, c);
-  if (c == '.') {
-    return DECIMAL;
+  token_batch_clear(batch);
+  for (size_t i = 0; i < count; i++) {
+    lexer_reset_view(lexer, inputs[i], input_lengths[i]);
+    _lexer_lex_into_batch(lexer, batch);
   }
-  if (c >= '0' && c <= '9') {
-    return NUMBER;
-  }
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    return IDENTIFIER;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
-  }
-  if (c == '*') {
-    return MULTIPLY;
-  }
-  if (c == '/') {
-    return DIVIDE;
-  }
-  if (c == '%') {
-    return MODULO;
-  }
-  if (c == '^') {
-    return POWER;
-  }
-  if (c == '(') {
-    return LPAREN;
-  }
-  if (c == ')') {
-    return RPAREN;
-  }
-  if (c == '[') {
-    return LBRACKET;
-  }
-  if (c == ']') {
-    return RBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  if (c == '}') {
-    return RBRACE;
-  }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
 }
 
-static State _lexer_lbrace(Lexer *this, unsigned char c) {
-  _lexer_cut_token(this, LBRACE_TOKEN);
-
-  if (isspace(c)) {
-    return START;
-  }
+void lex_batch_add(Lexer *lexer, CharReader *reader, TokenBatch *batch) {
+  assert(lexer && "lex_batch_add(): arg lexer was null");
+  assert(batch && "lex_batch_add(): arg batch was null");
+  lexer_reset(lexer, reader);
+  _lexer_lex_into_batch(lexer, batch);
+}
 
-  _lexer_add_char(this, c);
-  if (c == '.') {
-    return DECIMAL;
-  }
-  if (c >= '0' && c <= '9') {
-    return NUMBER;
-  }
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    return IDENTIFIER;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
-  }
-  if (c == '*') {
-    return MULTIPLY;
-  }
-  if (c == '/') {
-    return DIVIDE;
-  }
-  if (c == '%') {
-    return MODULO;
-  }
-  if (c == '^') {
-    return POWER;
-  }
-  if (c == '(') {
-    return LPAREN;
-  }
-  if (c == ')') {
-    return RPAREN;
-  }
-  if (c == '[') {
-    return LBRACKET;
-  }
-  if (c == ']') {
-    return RBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  if (c == '}') {
-    return RBRACE;
-  }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
+#ifdef LEXER_STATS
+static const char *const _lexer_state_names[STATE_COUNT] = {
+    [START] = "START",
+    [NUMBER] = "NUMBER",
+    [LEADING_1] = "LEADING_1",
+    [LEADING_2] = "LEADING_2",
+    [LEADING_3] = "LEADING_3",
+    [SEPARATOR] = "SEPARATOR",
+    [GROUP_1] = "GROUP_1",
+    [GROUP_2] = "GROUP_2",
+    [GROUP_3] = "GROUP_3",
+    [DECIMAL] = "DECIMAL",
+    [IDENTIFIER] = "IDENTIFIER",
+    [PLUS] = "PLUS",
+    [MINUS] = "MINUS",
+    [MULTIPLY] = "MULTIPLY",
+    [DIVIDE] = "DIVIDE",
+    [MODULO] = "MODULO",
+    [POWER] = "POWER",
+    [POTENTIAL_EXPONENT] = "POTENTIAL_EXPONENT",
+    [LPAREN] = "LPAREN",
+    [RPAREN] = "RPAREN",
+    [LBRACKET] = "LBRACKET",
+    [RBRACKET] = "RBRACKET",
+    [LBRACE] = "LBRACE",
+    [RBRACE] = "RBRACE"};
+
+void lexer_stats_get(LexerStats *stats) {
+  assert(stats && "lexer_stats_get(): arg stats was null");
+  *stats = _lexer_stats;
 }
 
-static State _lexer_rbrace(Lexer *this, unsigned char c) {
-  _lexer_cut_token(this, RBRACE_TOKEN);
+void lexer_stats_reset(void) { _lexer_stats = (LexerStats){0}; }
 
-  if (isspace(c)) {
-    return START;
-  }
+const char *lexer_stats_state_name(size_t state) {
+  assert(state < STATE_COUNT && "lexer_stats_state_name(): unknown state");
+  return _lexer_state_names[state];
+}
 
-  _lexer_add_char(this, c);
-  if (c == '.') {
-    return DECIMAL;
-  }
-  if (c >= '0' && c <= '9') {
-    return NUMBER;
-  }
-  bool is_identifier =
-      (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '_');
-  if (is_identifier) {
-    return IDENTIFIER;
-  }
-  if (c == '+') {
-    return PLUS;
-  }
-  if (c == '-') {
-    return MINUS;
-  }
-  if (c == '*') {
-    return MULTIPLY;
-  }
-  if (c == '/') {
-    return DIVIDE;
+// blank for nothing, then one shade per step of 10^(2/3) in the share
+static char _lexer_stats_shade(uint64_t count, uint64_t total) {
+  static const char shades[] = " .:-=+*#%@";
+  if (count == 0) {
+    return shades[0];
   }
-  if (c == '%') {
-    return MODULO;
+  double share = (double)count / (double)total;
+  int level = 1;
+  for (double bound = 1e-5; share > bound && level < 9; bound *= 4.6415888) {
+    level++;
   }
-  if (c == '^') {
-    return POWER;
-  }
-  if (c == '(') {
-    return LPAREN;
-  }
-  if (c == ')') {
-    return RPAREN;
-  }
-  if (c == '[') {
-    return LBRACKET;
-  }
-  if (c == ']') {
-    return RBRACKET;
-  }
-  if (c == '{') {
-    return LBRACE;
-  }
-  if (c == '}') {
-    return RBRACE;
-  }
-  _lexer_cut_token(this, INVALID_TOKEN);
-  return START;
+  return shades[level];
 }
 
-static State (*_lexer_state_functions[])(Lexer *this, unsigned char c) = {
-    [START] = _lexer_start,       [NUMBER] = _lexer_number,
-    [DECIMAL] = _lexer_decimal,   [IDENTIFIER] = _lexer_identifier,
-    [PLUS] = _lexer_plus,         [MINUS] = _lexer_minus,
-    [MULTIPLY] = _lexer_multiply, [DIVIDE] = _lexer_divide,
-    [MODULO] = _lexer_modulo,     [POWER] = _lexer_power,
-    [POTENTIAL_EXPONENT] = _lexer_potential_exponent, [LPAREN] = _lexer_lparen,
-    [RPAREN] = _lexer_rparen,     [LBRACKET] = _lexer_lbracket,
-    [RBRACKET] = _lexer_rbracket, [LBRACE] = _lexer_lbrace,
-    [RBRACE] = _lexer_rbrace};
-
-TokenList lex_char_reader(CharReader *reader) {
-  assert(reader && "lex_char_reader(): arg reader was null");
-  Lexer lexer = {0};
-  if (_lexer_init(&lexer) == false) {
-    fprintf(stderr, "failed to initialize lexer");
-    exit(1);
+void lexer_stats_print(const LexerStats *stats, FILE *out) {
+  assert(stats && "lexer_stats_print(): arg stats was null");
+  assert(out && "lexer_stats_print(): arg out was null");
+  uint64_t total = 0;
+  for (size_t state = 0; state < STATE_COUNT; state++) {
+    total += stats->state_counts[state];
+  }
+  fprintf(out,
+          "%llu bytes lexed, %llu tokens cut, %llu lexeme buffer reallocs "
+          "moving %llu bytes\n",
+          (unsigned long long)total, (unsigned long long)stats->cut_tokens,
+          (unsigned long long)stats->lexeme_reallocs,
+          (unsigned long long)stats->lexeme_moved_bytes);
+  if (total == 0) {
+    return;
   }
 
-  State state = START;
-  for (unsigned char c = char_reader_read(reader); c != '\0';
-       c = char_reader_read(reader)) {
-    state = _lexer_state_functions[state](&lexer, c);
+  // states by bytes, busiest first
+  size_t order[STATE_COUNT];
+  for (size_t i = 0; i < STATE_COUNT; i++) {
+    order[i] = i;
+    for (size_t j = i; j > 0 && stats->state_counts[order[j]] >
+                                    stats->state_counts[order[j - 1]];
+         j--) {
+      size_t swapped = order[j];
+      order[j] = order[j - 1];
+      order[j - 1] = swapped;
+    }
+  }
+  fprintf(out, "\n%-20s %14s %7s\n", "state", "bytes", "share");
+  for (size_t i = 0; i < STATE_COUNT && stats->state_counts[order[i]]; i++) {
+    uint64_t count = stats->state_counts[order[i]];
+    fprintf(out, "%-20s %14llu %6.2f%%\n", _lexer_state_names[order[i]],
+            (unsigned long long)count, 100.0 * (double)count / (double)total);
+  }
+
+  fprintf(out, "\ntransitions, rows from and columns to, \" .:-=+*#%%@\" "
+               "shades 0 to 100%% of the bytes on a log scale\n%23s", "");
+  for (size_t to = 0; to < STATE_COUNT; to++) {
+    fprintf(out, "%2zu", to);
+  }
+  fprintf(out, "\n");
+  for (size_t from = 0; from < STATE_COUNT; from++) {
+    fprintf(out, "%2zu %-20s", from, _lexer_state_names[from]);
+    for (size_t to = 0; to < STATE_COUNT; to++) {
+      fprintf(out, " %c",
+              _lexer_stats_shade(stats->transitions[from][to], total));
+    }
+    fprintf(out, "\n");
   }
-  _lexer_state_functions[state](&lexer, ' ');
-
-  Token end_token = {.lexeme = NULL, .type = EOI_TOKEN};
-  list_(Token) token_list = list_add(lexer.token_list, &end_token);
-  if (token_list == NULL) {
-    fprintf(stderr, "failed to add the EOF token");
-    exit(1);
-  }
-
-
-  lexer.token_list = token_list;
-  return _lexer_destroy(&lexer);
 }
+#endif
@@ -1,7 +1,94 @@
 #ifndef LEXER
 #define LEXER
 #include "char_reader.h"
+#include "symbol_table.h"
 #include "token_list.h"
 
+// Pull based lexer over a CharReader. Tokens that are not borrowed keep their
+// lexeme in a scratch window that is reused, so lexing takes constant memory
+// no matter how long the input is. A lexer can be reset and reused for many
+// inputs without allocating again.
+typedef struct Lexer {
+  CharReader *_inner_reader; // NULL when lexing a single view
+  CharReaderSpan _inner_span;
+  const char *_inner_position; // next char of _inner_span to lex
+  int _inner_state;
+  bool _inner_is_done;
+  bool _inner_keeps_lexemes; // the scratch window is never reused
+  char *_inner_lexemes;      // scratch window
+  size_t _inner_lexeme_start_index;
+  // start of the part of the current lexeme that is still in the input span
+  // and was not copied into the scratch window, NULL when there is none
+  const char *_inner_lexeme_start;
+  // end of the borrowed span _inner_lexeme_start points into, once that span
+  // ended
+  const char *_inner_pending_lexeme_end;
+  SymbolTable *_inner_symbols; // NULL when identifiers are not interned
+  Token _inner_queue[2]; // one char can end a token and be an INVALID_TOKEN
+  size_t _inner_queue_head;
+  size_t _inner_queue_count;
+} Lexer;
+
+bool lexer_init(Lexer *lexer, CharReader *reader);
+// the scratch window lives in arena, lexer_destroy leaves it to the arena
+bool lexer_init_in(Lexer *lexer, CharReader *reader, Arena *arena);
+void lexer_destroy(Lexer *lexer);
+// starts over on reader, the scratch window keeps its capacity
+void lexer_reset(Lexer *lexer, CharReader *reader);
+// starts over on chars[0..length), borrowed like char_reader_add_view
+void lexer_reset_view(Lexer *lexer, const char *chars, size_t length);
+// Writes the next token and returns true, the last token is EOI_TOKEN and
+// every call after it returns false. A lexeme that is not borrowed is valid
+// until the next call.
+bool lexer_next_token(Lexer *lexer, Token *token);
+// Interns every identifier from now on into symbols, NULL stops interning.
+// Their tokens carry the symbol and borrow the lexeme from symbols, so a
+// repeated identifier takes no scratch space.
+void lexer_set_symbol_table(Lexer *lexer, SymbolTable *symbols);
+Lexeme lexer_get_lexeme(const Lexer *lexer, Token token);
+
 TokenList lex_char_reader(CharReader *reader);
+// lex_char_reader into one array per token field
+TokenColumns lex_char_reader_columns(CharReader *reader);
+// lex_char_reader with the identifiers interned into symbols, which has to
+// outlive the tokens
+TokenList lex_char_reader_interned(CharReader *reader, SymbolTable *symbols);
+// tokens and copied lexemes are allocated from arena, the arena reset
+// releases them and token_list_distroy does nothing on them
+TokenList lex_char_reader_in(CharReader *reader, Arena *arena);
+// Replaces the content of batch with inputs[0..count), each lexed as its own
+// expression. Inputs are borrowed like char_reader_add_view. Neither the
+// lexer nor the batch allocate once they grew to the size of the workload.
+void lex_batch(Lexer *lexer, const char *const *inputs,
+               const size_t *input_lengths, size_t count, TokenBatch *batch);
+// lexes reader to the end as one more expression of batch
+void lex_batch_add(Lexer *lexer, CharReader *reader, TokenBatch *batch);
+
+#ifdef LEXER_STATS
+#include <stdint.h>
+#include <stdio.h>
+
+// the states of the lexer's transition table
+#define LEXER_STATE_COUNT 24
+
+// What the lexers of one thread did, counted only in builds with
+// -DLEXER_STATS. Other builds do not have these counters at all.
+typedef struct LexerStats {
+  uint64_t state_counts[LEXER_STATE_COUNT]; // bytes lexed in each state
+  // transitions[from][to] counts bytes lexed in from that led to to, runs
+  // skipped by the scanners count as from -> from for every byte
+  uint64_t transitions[LEXER_STATE_COUNT][LEXER_STATE_COUNT];
+  uint64_t cut_tokens;
+  uint64_t lexeme_reallocs;     // times the lexeme buffer grew
+  uint64_t lexeme_moved_bytes;  // copied by those growths
+} LexerStats;
+
+// the counters of the calling thread
+void lexer_stats_get(LexerStats *stats);
+void lexer_stats_reset(void);
+const char *lexer_stats_state_name(size_t state);
+// Prints the busiest states and a from x to heatmap of the transitions,
+// each cell shades the share of all lexed bytes on a log scale.
+void lexer_stats_print(const LexerStats *stats, FILE *out);
+#endif
 #endif
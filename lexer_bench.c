@@ -0,0 +1,224 @@
+#include "arena.h"
+#include "char_reader.h"
+#include "char_scan.h"
+#include "lexer.h"
+#include "token_list.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *const mixed_pieces[] = {
+    "(x12*3.25+y_7)", "/",   "(4e-2-z)",   "^",   "2",
+    "**",             "k",   " + ",        "[a-b]", "%",
+    "{c}",            " * ", "123456.789", " - ", ".5",
+    "alpha_beta_gamma", "/", "1E10",       NULL};
+
+static const char *const long_number_pieces[] = {
+    "31415926535897932384626.43383279502884197169399375105820974944",
+    " + ", "2718281828459045235360287471352662497757", "*",
+    "price_per_unit_in_the_base_currency_of_the_account", " - ", NULL};
+
+static const char *const padded_pieces[] = {
+    "x", "                                                            ", "+",
+    "\t\t\t\t\t\t\t\t\t\t\t\t\n                ", "1", NULL};
+
+// Repeats pieces until the formula is roughly target_size bytes long
+static char *generate_formula(const char *const *pieces, size_t target_size) {
+  char *formula = malloc(target_size + 256);
+  if (formula == NULL) {
+    fprintf(stderr, "generate_formula(): out of memory\n");
+    exit(1);
+  }
+
+  size_t size = 0;
+  for (size_t i = 0; size < target_size; i++) {
+    if (pieces[i] == NULL) {
+      i = 0;
+    }
+    size_t piece_size = strlen(pieces[i]);
+    memcpy(formula + size, pieces[i], piece_size);
+    size += piece_size;
+  }
+  formula[size] = '\0';
+  return formula;
+}
+
+static const char *const scan_names[] = {[CHAR_SCAN_SCALAR] = "scalar",
+                                         [CHAR_SCAN_SSE2] = "sse2",
+                                         [CHAR_SCAN_AVX2] = "avx2"};
+
+static double now_seconds(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void bench_lex(const char *name, const char *formula, bool borrow,
+                      int repeats) {
+  size_t formula_size = strlen(formula);
+  size_t token_count = 0;
+  double best = 0;
+
+  for (int r = 0; r < repeats; r++) {
+    CharReader reader = {0};
+    char_reader_init(&reader);
+    bool added = borrow ? char_reader_add_view(&reader, formula, formula_size)
+                        : char_reader_add(&reader, formula);
+    if (!added) {
+      fprintf(stderr, "bench_lex(): char_reader_add failed\n");
+      exit(1);
+    }
+
+    double start = now_seconds();
+    TokenList tokens = lex_char_reader(&reader);
+    double elapsed = now_seconds() - start;
+
+    token_count = token_list_get_count(&tokens);
+    token_list_distroy(&tokens);
+    char_reader_destroy(&reader);
+
+    if (r == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+
+  printf("%-20s %-6s %-6s %10zu bytes %9zu tokens %9.2f MB/s %7.2f ns/token\n", name,
+         borrow ? "view" : "copy",
+         scan_names[char_scan_get_implementation()], formula_size, token_count, formula_size / best / 1e6,
+         best * 1e9 / token_count);
+}
+
+// millions of tiny expressions, each lexed on its own
+static void bench_tiny_expressions(size_t count) {
+  static const char *const expressions[] = {"x*2+y", "(a-b)/c", "3.5^k",
+                                            "price*qty - discount", "1e-3*t"};
+  size_t expressions_count = sizeof(expressions) / sizeof(expressions[0]);
+  size_t lengths[sizeof(expressions) / sizeof(expressions[0])];
+  for (size_t i = 0; i < expressions_count; i++) {
+    lengths[i] = strlen(expressions[i]);
+  }
+
+  double start = now_seconds();
+  size_t token_count = 0;
+  for (size_t i = 0; i < count; i++) {
+    CharReader reader = {0};
+    char_reader_init(&reader);
+    char_reader_add_view(&reader, expressions[i % expressions_count],
+                         lengths[i % expressions_count]);
+    TokenList tokens = lex_char_reader(&reader);
+    token_count += token_list_get_count(&tokens);
+    token_list_distroy(&tokens);
+    char_reader_destroy(&reader);
+  }
+  double elapsed = now_seconds() - start;
+  printf("%-20s %-13s %10zu exprs  %9zu tokens %9.2f ns/expr\n",
+         "tiny/lex_char_reader", "", count, token_count, elapsed * 1e9 / count);
+
+  // batches of 1000 through one reused lexer and batch
+  enum { BATCH_SIZE = 1000 };
+  const char *inputs[BATCH_SIZE];
+  size_t input_lengths[BATCH_SIZE];
+  for (size_t i = 0; i < BATCH_SIZE; i++) {
+    inputs[i] = expressions[i % expressions_count];
+    input_lengths[i] = lengths[i % expressions_count];
+  }
+
+  CharReader unused_reader = {0};
+  char_reader_init(&unused_reader);
+  Lexer lexer;
+  TokenBatch batch;
+  if (!lexer_init(&lexer, &unused_reader) || !token_batch_init(&batch)) {
+    fprintf(stderr, "bench_tiny_expressions(): out of memory\n");
+    exit(1);
+  }
+
+  start = now_seconds();
+  token_count = 0;
+  for (size_t done = 0; done < count; done += BATCH_SIZE) {
+    lex_batch(&lexer, inputs, input_lengths, BATCH_SIZE, &batch);
+    TokenList tokens = token_batch_get_token_list(&batch);
+    token_count += token_list_get_count(&tokens);
+  }
+  elapsed = now_seconds() - start;
+  printf("%-20s %-13s %10zu exprs  %9zu tokens %9.2f ns/expr\n",
+         "tiny/lex_batch", "", count, token_count, elapsed * 1e9 / count);
+
+  token_batch_destroy(&batch);
+  lexer_destroy(&lexer);
+  char_reader_destroy(&unused_reader);
+}
+
+// one request adds a few copied pieces, lexes them and releases everything,
+// either through malloc/free or through one arena reset
+static void bench_requests(size_t count, bool use_arena) {
+  static const char *const pieces[] = {"price*qty", " - discount_", "rate",
+                                       "^2 + (a-b)/c", " + 123.456e-7"};
+  Arena arena;
+  if (use_arena && !arena_init(&arena, 4096)) {
+    fprintf(stderr, "bench_requests(): out of memory\n");
+    exit(1);
+  }
+
+  double start = now_seconds();
+  size_t token_count = 0;
+  for (size_t i = 0; i < count; i++) {
+    CharReader reader;
+    char_reader_init_in(&reader, use_arena ? &arena : NULL);
+    for (size_t p = 0; p < sizeof(pieces) / sizeof(pieces[0]); p++) {
+      if (!char_reader_add(&reader, pieces[p])) {
+        fprintf(stderr, "bench_requests(): char_reader_add failed\n");
+        exit(1);
+      }
+    }
+
+    TokenList tokens = use_arena ? lex_char_reader_in(&reader, &arena)
+                                 : lex_char_reader(&reader);
+    token_count += token_list_get_count(&tokens);
+    token_list_distroy(&tokens);
+    char_reader_destroy(&reader);
+    if (use_arena) {
+      arena_reset(&arena);
+    }
+  }
+  double elapsed = now_seconds() - start;
+  printf("%-20s %-13s %10zu reqs   %9zu tokens %9.2f ns/req\n",
+         use_arena ? "requests/arena" : "requests/malloc", "", count,
+         token_count, elapsed * 1e9 / count);
+
+  if (use_arena) {
+    arena_destroy(&arena);
+  }
+}
+
+int main(void) {
+  struct {
+    const char *name;
+    const char *const *pieces;
+    size_t size;
+  } corpora[] = {
+      {"mixed/1KB", mixed_pieces, 1 << 10},
+      {"mixed/1MB", mixed_pieces, 1 << 20},
+      {"mixed/16MB", mixed_pieces, 1 << 24},
+      {"long_numbers/1MB", long_number_pieces, 1 << 20},
+      {"padded/1MB", padded_pieces, 1 << 20},
+  };
+
+  for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++) {
+    char *formula = generate_formula(corpora[i].pieces, corpora[i].size);
+    int repeats = corpora[i].size > (1 << 20) ? 3 : 10;
+    for (int impl = 0; impl < CHAR_SCAN_IMPLEMENTATION_COUNT; impl++) {
+      if (!char_scan_set_implementation((CharScanImplementation)impl)) {
+        continue;
+      }
+      bench_lex(corpora[i].name, formula, false, repeats);
+      bench_lex(corpora[i].name, formula, true, repeats);
+    }
+    free(formula);
+  }
+
+  bench_tiny_expressions(2000000);
+  bench_requests(1000000, false);
+  bench_requests(1000000, true);
+  return 0;
+}
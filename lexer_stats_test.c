@@ -0,0 +1,120 @@
+#include "char_reader.h"
+#include "lexer.h"
+#include "token_list.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// built with -DLEXER_STATS, the states are looked up by name so the test
+// does not depend on the order of the State enum
+static size_t state(const char *name) {
+  for (size_t i = 0; i < LEXER_STATE_COUNT; i++) {
+    if (strcmp(lexer_stats_state_name(i), name) == 0) {
+      return i;
+    }
+  }
+  assert(0 && "state(): unknown state");
+  return 0;
+}
+
+static LexerStats lex_string(const char *input) {
+  CharReader reader;
+  char_reader_init(&reader);
+  assert(char_reader_add(&reader, input));
+  lexer_stats_reset();
+  TokenList tokens = lex_char_reader(&reader);
+  LexerStats stats;
+  lexer_stats_get(&stats);
+  token_list_distroy(&tokens);
+  char_reader_destroy(&reader);
+  return stats;
+}
+
+static void test_counts_transitions(void) {
+  LexerStats stats = lex_string("ab + 1,234");
+  size_t start = state("START");
+  size_t identifier = state("IDENTIFIER");
+  // every byte is counted once, in the state it was lexed in
+  uint64_t total = 0;
+  for (size_t from = 0; from < LEXER_STATE_COUNT; from++) {
+    uint64_t row = 0;
+    for (size_t to = 0; to < LEXER_STATE_COUNT; to++) {
+      row += stats.transitions[from][to];
+    }
+    assert(row == stats.state_counts[from]);
+    total += row;
+  }
+  assert(total == strlen("ab + 1,234"));
+  assert(stats.transitions[start][identifier] == 1);
+  assert(stats.transitions[identifier][identifier] == 1);
+  assert(stats.transitions[identifier][start] == 1);
+  assert(stats.transitions[state("LEADING_1")][state("SEPARATOR")] == 1);
+  assert(stats.transitions[state("GROUP_2")][state("GROUP_3")] == 1);
+  // ab + 1,234, the number is cut at the end of the input
+  assert(stats.cut_tokens == 3);
+  assert(stats.lexeme_reallocs == 0);
+}
+
+static void test_counts_runs(void) {
+  char input[1000];
+  memset(input, 'x', sizeof(input) - 1);
+  input[sizeof(input) - 1] = '\0';
+  LexerStats stats = lex_string(input);
+  size_t identifier = state("IDENTIFIER");
+  assert(stats.state_counts[identifier] == sizeof(input) - 2);
+  assert(stats.transitions[identifier][identifier] == sizeof(input) - 2);
+  assert(stats.cut_tokens == 1);
+}
+
+// a copied lexeme longer than the buffer makes it grow
+static void test_counts_reallocs(void) {
+  CharReader reader;
+  char_reader_init(&reader);
+  char chunk[101];
+  memset(chunk, '7', 100);
+  chunk[100] = '\0';
+  for (int i = 0; i < 10; i++) {
+    assert(char_reader_add(&reader, chunk));
+  }
+  lexer_stats_reset();
+  TokenList tokens = lex_char_reader(&reader);
+  LexerStats stats;
+  lexer_stats_get(&stats);
+  assert(token_list_get_count(&tokens) == 2);
+  assert(stats.cut_tokens == 1);
+  assert(stats.lexeme_reallocs > 0);
+  token_list_distroy(&tokens);
+  char_reader_destroy(&reader);
+
+  lexer_stats_reset();
+  lexer_stats_get(&stats);
+  assert(stats.cut_tokens == 0 && stats.lexeme_reallocs == 0);
+}
+
+static void test_print(void) {
+  LexerStats stats = lex_string("(x1 + 2.5e3) ** y");
+  FILE *out = tmpfile();
+  assert(out != NULL);
+  lexer_stats_print(&stats, out);
+  long size = ftell(out);
+  assert(size > 0);
+  char *text = malloc((size_t)size + 1);
+  rewind(out);
+  assert(fread(text, 1, (size_t)size, out) == (size_t)size);
+  text[size] = '\0';
+  assert(strstr(text, "17 bytes lexed") != NULL);
+  assert(strstr(text, "POTENTIAL_EXPONENT") != NULL);
+  free(text);
+  fclose(out);
+}
+
+int main(void) {
+  test_counts_transitions();
+  test_counts_runs();
+  test_counts_reallocs();
+  test_print();
+
+  printf("All lexer stats tests passed\n");
+  return 0;
+}
@@ -1,19 +1,31 @@
 #include "lexer.h"
+#include "arena.h"
 #include "token_list.h"
 #include "char_reader.h"
+#include "char_scan.h"
+#include "list.h"
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 typedef struct {
   TokenType type;
   const char *lexeme;
 } ExpectedToken;
 
-static void run_lex_test(const char *input, const ExpectedToken *expected, size_t expected_count) {
+static void run_lex_test_with(const char *input, bool borrow,
+                              const ExpectedToken *expected,
+                              size_t expected_count) {
   CharReader reader = {0};
   char_reader_init(&reader);
-  assert(char_reader_add(&reader, input));
+  if (borrow) {
+    assert(char_reader_add_view(&reader, input, strlen(input)));
+  } else {
+    assert(char_reader_add(&reader, input));
+  }
 
   TokenList tokens = lex_char_reader(&reader);
   size_t count = token_list_get_count(&tokens);
@@ -22,11 +34,13 @@ static void run_lex_test(const char *input, const ExpectedToken *expected, size_
   for (size_t i = 0; i < expected_count; i++) {
     Token token = token_list_get_token_at(&tokens, i);
     assert(token.type == expected[i].type);
+    Lexeme lexeme = token_list_get_lexeme(&tokens, token);
     if (expected[i].lexeme == NULL) {
-      assert(token.lexeme == NULL);
+      assert(lexeme.chars == NULL);
     } else {
-      assert(token.lexeme != NULL);
-      assert(strcmp(token.lexeme, expected[i].lexeme) == 0);
+      assert(lexeme.chars != NULL);
+      assert(lexeme.length == strlen(expected[i].lexeme));
+      assert(memcmp(lexeme.chars, expected[i].lexeme, lexeme.length) == 0);
     }
   }
 
@@ -34,6 +48,18 @@ static void run_lex_test(const char *input, const ExpectedToken *expected, size_
   char_reader_destroy(&reader);
 }
 
+static void run_lex_test(const char *input, const ExpectedToken *expected, size_t expected_count) {
+  CharScanImplementation default_implementation = char_scan_get_implementation();
+  for (int i = 0; i < CHAR_SCAN_IMPLEMENTATION_COUNT; i++) {
+    if (!char_scan_set_implementation((CharScanImplementation)i)) {
+      continue;
+    }
+    run_lex_test_with(input, false, expected, expected_count);
+    run_lex_test_with(input, true, expected, expected_count);
+  }
+  assert(char_scan_set_implementation(default_implementation));
+}
+
 static void test_simple_expression(void) {
   ExpectedToken expected[] = {
       {NUMBER_TOKEN, "1"}, {PLUS_TOKEN, "+"}, {NUMBER_TOKEN, "2"},
@@ -119,6 +145,66 @@ static void test_consecutive_dots(void) {
   run_lex_test("..", expected, sizeof(expected) / sizeof(expected[0]));
 }
 
+static void test_thousands_separators(void) {
+  ExpectedToken expected[] = {{NUMBER_TOKEN, "11,222,333"},
+                              {PLUS_TOKEN, "+"},
+                              {NUMBER_TOKEN, "11,222.333444"},
+                              {MULTIPLY_TOKEN, "*"},
+                              {NUMBER_TOKEN, "1,000"},
+                              {EXPONENT_TOKEN, "e"},
+                              {NUMBER_TOKEN, "3"},
+                              {EOI_TOKEN, NULL}};
+  run_lex_test("11,222,333 + 11,222.333444*1,000e3", expected,
+               sizeof(expected) / sizeof(expected[0]));
+}
+
+// the first group has 1 to 3 digits, every later one exactly 3
+static void test_misplaced_separators(void) {
+  ExpectedToken too_long_first[] = {{NUMBER_TOKEN, "1234"},
+                                    {INVALID_TOKEN, ","},
+                                    {NUMBER_TOKEN, "567"},
+                                    {EOI_TOKEN, NULL}};
+  run_lex_test("1234,567", too_long_first,
+               sizeof(too_long_first) / sizeof(too_long_first[0]));
+  ExpectedToken too_long_group[] = {{NUMBER_TOKEN, "1,234"},
+                                    {NUMBER_TOKEN, "5"},
+                                    {EOI_TOKEN, NULL}};
+  run_lex_test("1,2345", too_long_group,
+               sizeof(too_long_group) / sizeof(too_long_group[0]));
+  ExpectedToken too_short_group[] = {{INVALID_TOKEN, "1,23"},
+                                     {PLUS_TOKEN, "+"},
+                                     {INVALID_TOKEN, "1,"},
+                                     {INVALID_TOKEN, "1,2"},
+                                     {EOI_TOKEN, NULL}};
+  run_lex_test("1,23+1, 1,2", too_short_group,
+               sizeof(too_short_group) / sizeof(too_short_group[0]));
+  ExpectedToken grouped_fraction[] = {{NUMBER_TOKEN, "1.234"},
+                                      {INVALID_TOKEN, ","},
+                                      {NUMBER_TOKEN, "567"},
+                                      {EOI_TOKEN, NULL}};
+  run_lex_test("1.234,567", grouped_fraction,
+               sizeof(grouped_fraction) / sizeof(grouped_fraction[0]));
+}
+
+// the lexer converts numbers, lexemes copied across views included
+static void test_number_values(void) {
+  static const char *const views[] = {"1", "2,3", "45.", "5e", "7 .5+x"};
+  CharReader reader;
+  char_reader_init(&reader);
+  for (size_t i = 0; i < sizeof(views) / sizeof(views[0]); i++) {
+    assert(char_reader_add_view(&reader, views[i], strlen(views[i])));
+  }
+  TokenList tokens = lex_char_reader(&reader);
+  static const double values[] = {12345.5, 0, 7, .5, 0, 0, 0};
+  assert(token_list_get_count(&tokens) == sizeof(values) / sizeof(values[0]));
+  for (size_t i = 0; i < token_list_get_count(&tokens); i++) {
+    assert(token_list_get_token_at(&tokens, i).number == values[i]);
+  }
+  assert(token_list_get_token_at(&tokens, 1).type == EXPONENT_TOKEN);
+  token_list_distroy(&tokens);
+  char_reader_destroy(&reader);
+}
+
 static void test_exponent_with_plus_no_digits(void) {
   ExpectedToken expected[] = {{NUMBER_TOKEN, "1"},
                               {EXPONENT_TOKEN, "e"},
@@ -158,6 +244,486 @@ static void test_identifier_e_alone(void) {
   run_lex_test("e", expected, sizeof(expected) / sizeof(expected[0]));
 }
 
+static void test_power_then_multiply(void) {
+  ExpectedToken expected[] = {{POWER_TOKEN, "**"},
+                              {MULTIPLY_TOKEN, "*"},
+                              {EOI_TOKEN, NULL}};
+  run_lex_test("***", expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+static void test_e_before_closing_bracket(void) {
+  ExpectedToken expected[] = {{LPAREN_TOKEN, "("},
+                              {NUMBER_TOKEN, "2.5"},
+                              {IDENTIFIER_TOKEN, "e"},
+                              {RPAREN_TOKEN, ")"},
+                              {EOI_TOKEN, NULL}};
+  run_lex_test("(2.5e)", expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+static void test_borrowed_lexemes_point_into_view(void) {
+  const char input[] = "foo+12";
+  CharReader reader = {0};
+  char_reader_init(&reader);
+  assert(char_reader_add_view(&reader, input, strlen(input)));
+
+  TokenList tokens = lex_char_reader(&reader);
+  assert(token_list_get_count(&tokens) == 4);
+  Lexeme foo = token_list_get_lexeme(&tokens, token_list_get_token_at(&tokens, 0));
+  Lexeme twelve =
+      token_list_get_lexeme(&tokens, token_list_get_token_at(&tokens, 2));
+  assert(foo.chars == &input[0] && foo.length == 3);
+  assert(twelve.chars == &input[4] && twelve.length == 2);
+
+  token_list_distroy(&tokens);
+  char_reader_destroy(&reader);
+}
+
+static void test_lexeme_across_views_is_copied(void) {
+  const char first[] = "ab+1";
+  const char second[] = "2cd";
+  CharReader reader = {0};
+  char_reader_init(&reader);
+  assert(char_reader_add_view(&reader, first, strlen(first)));
+  assert(char_reader_add_view(&reader, second, 1));
+  assert(char_reader_add(&reader, "3"));
+  assert(char_reader_add_view(&reader, &second[1], 2));
+
+  TokenList tokens = lex_char_reader(&reader);
+  assert(token_list_get_count(&tokens) == 5);
+  Token ab = token_list_get_token_at(&tokens, 0);
+  Token number = token_list_get_token_at(&tokens, 2);
+  Token cd = token_list_get_token_at(&tokens, 3);
+  assert(ab.type == IDENTIFIER_TOKEN && ab.lexeme_is_borrowed);
+  assert(number.type == NUMBER_TOKEN && !number.lexeme_is_borrowed);
+  Lexeme lexeme = token_list_get_lexeme(&tokens, number);
+  assert(lexeme.length == 3 && memcmp(lexeme.chars, "123", 3) == 0);
+  assert(cd.type == IDENTIFIER_TOKEN && cd.lexeme_is_borrowed);
+  lexeme = token_list_get_lexeme(&tokens, cd);
+  assert(lexeme.chars == &second[1] && lexeme.length == 2);
+
+  token_list_distroy(&tokens);
+  char_reader_destroy(&reader);
+}
+
+static void test_lexeme_ending_at_view_end_is_borrowed(void) {
+  const char first[] = "ab";
+  const char second[] = "+cd";
+  CharReader reader = {0};
+  char_reader_init(&reader);
+  assert(char_reader_add_view(&reader, first, 2));
+  assert(char_reader_add_view(&reader, second, 3));
+
+  TokenList tokens = lex_char_reader(&reader);
+  assert(token_list_get_count(&tokens) == 4);
+  Lexeme ab = token_list_get_lexeme(&tokens, token_list_get_token_at(&tokens, 0));
+  Lexeme cd = token_list_get_lexeme(&tokens, token_list_get_token_at(&tokens, 2));
+  assert(ab.chars == first && ab.length == 2);
+  assert(cd.chars == &second[1] && cd.length == 2);
+
+  token_list_distroy(&tokens);
+  char_reader_destroy(&reader);
+}
+
+static void test_lex_mapped_file(void) {
+  const char *path = "lexer_test_input.tmp";
+  FILE *file = fopen(path, "wb");
+  assert(file);
+  fputs("abc + 12\n(x)", file);
+  fclose(file);
+
+  CharReader reader = {0};
+  char_reader_init(&reader);
+  assert(char_reader_add_file(&reader, path));
+  assert(char_reader_add(&reader, "*3"));
+  assert(!char_reader_add_file(&reader, "lexer_test_missing.tmp"));
+
+  ExpectedToken expected[] = {
+      {IDENTIFIER_TOKEN, "abc"}, {PLUS_TOKEN, "+"},     {NUMBER_TOKEN, "12"},
+      {LPAREN_TOKEN, "("},       {IDENTIFIER_TOKEN, "x"}, {RPAREN_TOKEN, ")"},
+      {MULTIPLY_TOKEN, "*"},     {NUMBER_TOKEN, "3"},   {EOI_TOKEN, NULL}};
+  size_t expected_count = sizeof(expected) / sizeof(expected[0]);
+
+  // the whole input is read, lexemes still point into the mapping
+  TokenList tokens = lex_char_reader(&reader);
+  assert(token_list_get_count(&tokens) == expected_count);
+  for (size_t i = 0; i < expected_count; i++) {
+    Token token = token_list_get_token_at(&tokens, i);
+    Lexeme lexeme = token_list_get_lexeme(&tokens, token);
+    assert(token.type == expected[i].type);
+    if (expected[i].lexeme != NULL) {
+      assert(lexeme.length == strlen(expected[i].lexeme));
+      assert(memcmp(lexeme.chars, expected[i].lexeme, lexeme.length) == 0);
+    }
+  }
+  assert(token_list_get_token_at(&tokens, 0).lexeme_is_borrowed);
+
+  token_list_distroy(&tokens);
+  char_reader_destroy(&reader);
+  remove(path);
+}
+
+static void test_char_reader_spans(void) {
+  CharReader reader = {0};
+  char_reader_init(&reader);
+  assert(char_reader_add(&reader, "abc"));
+  assert(char_reader_add_view(&reader, "", 0));
+  assert(char_reader_add_view(&reader, "de", 2));
+
+  CharReaderSpan span = char_reader_peek_span(&reader);
+  assert(span.length == 3 && !span.is_borrowed &&
+         memcmp(span.chars, "abc", 3) == 0);
+  char_reader_consume(&reader, 1);
+  span = char_reader_peek_span(&reader);
+  assert(span.length == 2 && memcmp(span.chars, "bc", 2) == 0);
+  char_reader_consume(&reader, 2);
+
+  span = char_reader_peek_span(&reader);
+  assert(span.length == 2 && span.is_borrowed &&
+         memcmp(span.chars, "de", 2) == 0);
+  assert(char_reader_read(&reader) == 'd');
+  assert(char_reader_read(&reader) == 'e');
+  assert(char_reader_read(&reader) == '\0');
+  assert(char_reader_peek_span(&reader).length == 0);
+
+  char_reader_destroy(&reader);
+}
+
+static void test_long_runs(void) {
+  ExpectedToken expected[] = {
+      {NUMBER_TOKEN, "12345678901234567890123456789012345678901234567890."
+                     "1234567890123456789012345678901234567890"},
+      {PLUS_TOKEN, "+"},
+      {IDENTIFIER_TOKEN, "a_very_long_identifier_that_spans_several_vectors_0"},
+      {EOI_TOKEN, NULL}};
+  run_lex_test("12345678901234567890123456789012345678901234567890."
+               "1234567890123456789012345678901234567890"
+               "                                                  \t\n+"
+               "a_very_long_identifier_that_spans_several_vectors_0     ",
+               expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+static void test_char_scan_matches_scalar(void) {
+  static const char alphabet[] = "0123456789azAZ_ \t\n\v\f\r.+@[`{\x80\xff";
+  size_t (*const scanners[])(const char *, size_t) = {
+      char_scan_digits, char_scan_identifier, char_scan_whitespace};
+  CharScanImplementation default_implementation = char_scan_get_implementation();
+  char buffer[100];
+  srand(5);
+
+  for (int round = 0; round < 20000; round++) {
+    // long runs of one class of chars, broken by a random char
+    size_t length = (size_t)(rand() % (int)sizeof(buffer));
+    char run_char = alphabet[rand() % (int)(sizeof(alphabet) - 1)];
+    for (size_t i = 0; i < length; i++) {
+      buffer[i] = rand() % 40 == 0 ? alphabet[rand() % (int)(sizeof(alphabet) - 1)]
+                                   : run_char;
+    }
+    size_t offset = length == 0 ? 0 : (size_t)rand() % length;
+
+    for (size_t s = 0; s < sizeof(scanners) / sizeof(scanners[0]); s++) {
+      assert(char_scan_set_implementation(CHAR_SCAN_SCALAR));
+      size_t expected = scanners[s](buffer + offset, length - offset);
+      for (int i = CHAR_SCAN_SCALAR + 1; i < CHAR_SCAN_IMPLEMENTATION_COUNT; i++) {
+        if (char_scan_set_implementation((CharScanImplementation)i)) {
+          assert(scanners[s](buffer + offset, length - offset) == expected);
+        }
+      }
+    }
+  }
+  assert(char_scan_set_implementation(default_implementation));
+}
+
+static void test_streaming_uses_constant_memory(void) {
+  CharReader reader = {0};
+  char_reader_init(&reader);
+  // copied chunks, so every lexeme goes through the scratch window, and
+  // "count_" crosses from one chunk into the next
+  for (int i = 0; i < 100000; i++) {
+    assert(char_reader_add(&reader, "count_"));
+    assert(char_reader_add(&reader, "1*(2.5+x) "));
+  }
+
+  Lexer lexer;
+  assert(lexer_init(&lexer, &reader));
+  const TokenType pattern[] = {IDENTIFIER_TOKEN, MULTIPLY_TOKEN, LPAREN_TOKEN,
+                               NUMBER_TOKEN,     PLUS_TOKEN,     IDENTIFIER_TOKEN,
+                               RPAREN_TOKEN};
+  size_t pattern_length = sizeof(pattern) / sizeof(pattern[0]);
+
+  Token token;
+  size_t count = 0;
+  while (lexer_next_token(&lexer, &token) && token.type != EOI_TOKEN) {
+    assert(token.type == pattern[count % pattern_length]);
+    if (count % pattern_length == 0) {
+      Lexeme lexeme = lexer_get_lexeme(&lexer, token);
+      assert(lexeme.length == 7 && memcmp(lexeme.chars, "count_1", 7) == 0);
+    }
+    count++;
+  }
+  assert(token.type == EOI_TOKEN && count == 100000 * pattern_length);
+  assert(!lexer_next_token(&lexer, &token));
+  assert(list_get_capacity(lexer._inner_lexemes) <= 150);
+
+  lexer_destroy(&lexer);
+  char_reader_destroy(&reader);
+}
+
+static void assert_batch_expression(TokenBatch *batch, size_t expression,
+                                    const ExpectedToken *expected,
+                                    size_t expected_count) {
+  TokenList tokens = token_batch_get_token_list(batch);
+  size_t start = token_batch_get_expression_start(batch, expression);
+  assert(token_batch_get_expression_token_count(batch, expression) ==
+         expected_count);
+  for (size_t i = 0; i < expected_count; i++) {
+    Token token = token_list_get_token_at(&tokens, start + i);
+    Lexeme lexeme = token_list_get_lexeme(&tokens, token);
+    assert(token.type == expected[i].type);
+    if (expected[i].lexeme == NULL) {
+      assert(lexeme.chars == NULL);
+    } else {
+      assert(lexeme.length == strlen(expected[i].lexeme));
+      assert(memcmp(lexeme.chars, expected[i].lexeme, lexeme.length) == 0);
+    }
+  }
+}
+
+static void test_lex_batch(void) {
+  const char *inputs[] = {"1+x", "", "foo (2)"};
+  size_t lengths[] = {3, 0, 7};
+  ExpectedToken first[] = {{NUMBER_TOKEN, "1"},
+                           {PLUS_TOKEN, "+"},
+                           {IDENTIFIER_TOKEN, "x"},
+                           {EOI_TOKEN, NULL}};
+  ExpectedToken second[] = {{EOI_TOKEN, NULL}};
+  ExpectedToken third[] = {{IDENTIFIER_TOKEN, "foo"}, {LPAREN_TOKEN, "("},
+                           {NUMBER_TOKEN, "2"},       {RPAREN_TOKEN, ")"},
+                           {EOI_TOKEN, NULL}};
+
+  TokenBatch batch;
+  assert(token_batch_init(&batch));
+  CharReader reader = {0};
+  char_reader_init(&reader);
+  Lexer lexer;
+  assert(lexer_init(&lexer, &reader));
+
+  for (int round = 0; round < 3; round++) {
+    lex_batch(&lexer, inputs, lengths, 3, &batch);
+    assert(token_batch_get_expression_count(&batch) == 3);
+    assert_batch_expression(&batch, 0, first, 4);
+    assert_batch_expression(&batch, 1, second, 1);
+    assert_batch_expression(&batch, 2, third, 5);
+  }
+
+  // copied lexemes land in the batch lexeme storage
+  assert(char_reader_add(&reader, "ab"));
+  assert(char_reader_add(&reader, "c*7"));
+  lex_batch_add(&lexer, &reader, &batch);
+  ExpectedToken fourth[] = {{IDENTIFIER_TOKEN, "abc"},
+                            {MULTIPLY_TOKEN, "*"},
+                            {NUMBER_TOKEN, "7"},
+                            {EOI_TOKEN, NULL}};
+  assert(token_batch_get_expression_count(&batch) == 4);
+  assert_batch_expression(&batch, 0, first, 4);
+  assert_batch_expression(&batch, 3, fourth, 4);
+
+  lexer_destroy(&lexer);
+  char_reader_destroy(&reader);
+  token_batch_destroy(&batch);
+}
+
+static void test_arena(void) {
+  Arena arena;
+  assert(arena_init(&arena, 64));
+
+  char *first = arena_alloc(&arena, 3);
+  char *second = arena_alloc(&arena, 5);
+  assert(first && second && first != second);
+  assert((uintptr_t)second % _Alignof(max_align_t) == 0);
+
+  // the latest allocation grows in place while its block has room
+  assert(arena_realloc(&arena, second, 5, 20) == second);
+  memcpy(second, "0123456789", 10);
+  char *moved = arena_realloc(&arena, second, 20, 1000);
+  assert(moved && moved != second && memcmp(moved, "0123456789", 10) == 0);
+
+  // one reset merges the blocks, the same workload then fits in one block
+  size_t capacity = arena_get_capacity(&arena);
+  assert(capacity >= 1000 + 64);
+  arena_reset(&arena);
+  assert(arena_get_capacity(&arena) >= capacity);
+  capacity = arena_get_capacity(&arena);
+  for (int round = 0; round < 3; round++) {
+    assert(arena_alloc(&arena, 3) && arena_alloc(&arena, 1000));
+    arena_reset(&arena);
+    assert(arena_get_capacity(&arena) == capacity);
+  }
+
+  arena_destroy(&arena);
+}
+
+static void test_lex_in_arena(void) {
+  Arena arena;
+  assert(arena_init(&arena, 256));
+  size_t capacity = 0;
+
+  for (int round = 0; round < 4; round++) {
+    CharReader reader;
+    char_reader_init_in(&reader, &arena);
+    assert(char_reader_add(&reader, "12"));
+    assert(char_reader_add(&reader, "3.5*alp"));
+    assert(char_reader_add(&reader, "ha_beta_gamma_delta - (x)"));
+
+    TokenList tokens = lex_char_reader_in(&reader, &arena);
+    const char *expected[] = {"123.5", "*", "alpha_beta_gamma_delta", "-",
+                              "(",     "x", ")"};
+    assert(token_list_get_count(&tokens) == 8);
+    for (size_t i = 0; i < 7; i++) {
+      Lexeme lexeme =
+          token_list_get_lexeme(&tokens, token_list_get_token_at(&tokens, i));
+      assert(lexeme.length == strlen(expected[i]));
+      assert(memcmp(lexeme.chars, expected[i], lexeme.length) == 0);
+    }
+
+    token_list_distroy(&tokens);
+    char_reader_destroy(&reader);
+    arena_reset(&arena);
+
+    // after the first round the merged block holds the whole request
+    if (round == 1) {
+      capacity = arena_get_capacity(&arena);
+    } else if (round > 1) {
+      assert(arena_get_capacity(&arena) == capacity);
+    }
+  }
+
+  arena_destroy(&arena);
+}
+
+static void test_lex_columns(void) {
+  const char *chunks[] = {"12", "3.5e+2*alp", "ha_beta - (x) % 1_000 ^ y2"};
+  CharReader list_reader, columns_reader;
+  char_reader_init(&list_reader);
+  char_reader_init(&columns_reader);
+  for (size_t i = 0; i < 3; i++) {
+    assert(char_reader_add(&list_reader, chunks[i]));
+    assert(char_reader_add(&columns_reader, chunks[i]));
+  }
+
+  TokenList tokens = lex_char_reader(&list_reader);
+  TokenColumns columns = lex_char_reader_columns(&columns_reader);
+  size_t count = token_list_get_count(&tokens);
+  assert(token_columns_get_count(&columns) == count);
+  const uint8_t *types = token_columns_get_types(&columns);
+  const double *numbers = token_columns_get_numbers(&columns);
+  assert(types[count - 1] == EOI_TOKEN);
+
+  // copied lexemes, like "123.5", and borrowed ones look the same
+  for (size_t i = 0; i < count; i++) {
+    Token token = token_list_get_token_at(&tokens, i);
+    assert(types[i] == token.type);
+    assert(numbers[i] == token.number);
+    Lexeme expected = token_list_get_lexeme(&tokens, token);
+    Lexeme lexeme = token_columns_get_lexeme(&columns, i);
+    assert(lexeme.length == expected.length);
+    assert(lexeme.length == 0 ||
+           memcmp(lexeme.chars, expected.chars, lexeme.length) == 0);
+  }
+
+  token_columns_destroy(&columns);
+  token_list_distroy(&tokens);
+  char_reader_destroy(&columns_reader);
+  char_reader_destroy(&list_reader);
+}
+
+static void test_interned_identifiers(void) {
+  SymbolTable symbols;
+  assert(symbol_table_init(&symbols));
+  CharReader reader;
+  char_reader_init(&reader);
+  // the second rate is cut by the chunks, so the lexer copies it first
+  assert(char_reader_add(&reader, "rate * x + ra"));
+  assert(char_reader_add(&reader, "te * 2 - x"));
+
+  TokenList tokens = lex_char_reader_interned(&reader, &symbols);
+  size_t identifiers[] = {0, 2, 4, 8};
+  uint32_t expected[] = {1, 2, 1, 2};
+  for (size_t i = 0; i < 4; i++) {
+    Token token = token_list_get_token_at(&tokens, identifiers[i]);
+    assert(token.type == IDENTIFIER_TOKEN);
+    assert(token.symbol == expected[i]);
+    // borrowed from the table, the copy was handed back
+    assert(token.lexeme_is_borrowed);
+    Lexeme lexeme = token_list_get_lexeme(&tokens, token);
+    assert(lexeme.chars ==
+           symbol_table_get_name(&symbols, token.symbol).chars);
+  }
+  assert(symbol_table_get_count(&symbols) == 2);
+  assert(token_list_get_token_at(&tokens, 6).number == 2);
+  token_list_distroy(&tokens);
+  char_reader_destroy(&reader);
+
+  // a lexer keeps interning into the same table across inputs
+  Lexer lexer;
+  assert(lexer_init(&lexer, &reader));
+  lexer_set_symbol_table(&lexer, &symbols);
+  lexer_reset_view(&lexer, "y+rate", 6);
+  Token token;
+  assert(lexer_next_token(&lexer, &token) && token.symbol == 3);
+  assert(lexer_next_token(&lexer, &token) && token.type == PLUS_TOKEN);
+  assert(lexer_next_token(&lexer, &token) && token.symbol == 1);
+  lexer_set_symbol_table(&lexer, NULL);
+  lexer_reset_view(&lexer, "rate", 4);
+  assert(lexer_next_token(&lexer, &token) && token.symbol == SYMBOL_NONE);
+  lexer_destroy(&lexer);
+
+  symbol_table_destroy(&symbols);
+}
+
+// lexes "x+x+...x+" with token_count tokens, returns the best cpu time
+static double time_lex_tokens(size_t token_count) {
+  size_t input_size = token_count;
+  char *input = malloc(input_size + 1);
+  assert(input);
+  for (size_t i = 0; i < input_size; i++) {
+    input[i] = i % 2 == 0 ? 'x' : '+';
+  }
+  input[input_size] = '\0';
+
+  double best = 0;
+  for (int run = 0; run < 3; run++) {
+    CharReader reader = {0};
+    char_reader_init(&reader);
+    assert(char_reader_add(&reader, input));
+
+    clock_t start = clock();
+    TokenList tokens = lex_char_reader(&reader);
+    double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    assert(token_list_get_count(&tokens) == token_count + 1);
+    Token last = token_list_get_token_at(&tokens, token_count - 1);
+    Lexeme lexeme = token_list_get_lexeme(&tokens, last);
+    assert(last.type == PLUS_TOKEN && lexeme.length == 1 &&
+           lexeme.chars[0] == '+');
+
+    token_list_distroy(&tokens);
+    char_reader_destroy(&reader);
+    if (run == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+
+  free(input);
+  return best;
+}
+
+static void test_lexing_scales_linearly(void) {
+  double half = time_lex_tokens(500000);
+  double full = time_lex_tokens(1000000);
+  // linear growth doubles the time, leave room for timer noise
+  assert(full < half * 3 + 0.01);
+}
+
 int main(void) {
   test_simple_expression();
   test_decimal_zero();
@@ -177,6 +743,25 @@ int main(void) {
   test_identifier_e_alone();
   test_only_whitespace();
   test_consecutive_dots();
+  test_thousands_separators();
+  test_misplaced_separators();
+  test_number_values();
+  test_power_then_multiply();
+  test_e_before_closing_bracket();
+  test_borrowed_lexemes_point_into_view();
+  test_lexeme_across_views_is_copied();
+  test_lexeme_ending_at_view_end_is_borrowed();
+  test_char_reader_spans();
+  test_lex_mapped_file();
+  test_long_runs();
+  test_char_scan_matches_scalar();
+  test_streaming_uses_constant_memory();
+  test_lex_batch();
+  test_arena();
+  test_lex_in_arena();
+  test_lex_columns();
+  test_interned_identifiers();
+  test_lexing_scales_linearly();
 
   printf("All lexer tests passed\n");
   return 0;
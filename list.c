@@ -1,17 +1,21 @@
+#include "list.h"
+#include "arena.h"
+#include "memory.h"
 #include <assert.h>
-#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 
 // on 64 bit systems
 //  0                   1                   2                   3
 //  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4
 // +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-// |   item_size   |     count     |    capacity   |   list start  | ....
+// |   item_size   |     count     |    capacity   |     arena     | list start
 // +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
 typedef struct list_header {
   size_t item_size;
   size_t count;
   size_t capacity;
+  Arena *arena; // NULL for lists on the heap
 } list_header;
 
 static size_t _list_max_capacity(size_t item_size) {
@@ -32,7 +36,15 @@ static void *_list_resize(void *list, size_t new_capacity) {
 
   size_t new_mem_block_size =
       sizeof(list_header) + (header->item_size * new_capacity);
-  list_header *new_header = realloc(header, new_mem_block_size);
+  list_header *new_header;
+  if (header->arena != NULL) {
+    size_t mem_block_size =
+        sizeof(list_header) + (header->item_size * header->capacity);
+    new_header = arena_realloc(header->arena, header, mem_block_size,
+                               new_mem_block_size);
+  } else {
+    new_header = memory_realloc(header, new_mem_block_size);
+  }
   if (new_header == NULL) {
     return NULL;
   }
@@ -46,6 +58,11 @@ static void *_list_resize(void *list, size_t new_capacity) {
 }
 
 void *list_alloc(size_t item_size_bytes, size_t init_capacity) {
+  return list_alloc_in(NULL, item_size_bytes, init_capacity);
+}
+
+void *list_alloc_in(Arena *arena, size_t item_size_bytes,
+                    size_t init_capacity) {
   assert(item_size_bytes && "why would you create zero bytes item list??");
   if (item_size_bytes == 0) {
     return NULL;
@@ -57,7 +74,8 @@ void *list_alloc(size_t item_size_bytes, size_t init_capacity) {
 
   size_t mem_block_size =
       sizeof(list_header) + (item_size_bytes * init_capacity);
-  list_header *header = malloc(mem_block_size);
+  list_header *header = arena != NULL ? arena_alloc(arena, mem_block_size)
+                                      : memory_alloc(mem_block_size);
   if (header == NULL) {
     return NULL;
   }
@@ -65,13 +83,16 @@ void *list_alloc(size_t item_size_bytes, size_t init_capacity) {
   header->item_size = item_size_bytes;
   header->capacity = init_capacity;
   header->count = 0;
+  header->arena = arena;
   return header + 1;
 }
 
 void list_free(void *list) {
   assert(list && "list_free(): parameter list was null");
   list_header *header = ((list_header *)list) - 1;
-  free(header);
+  if (header->arena == NULL) {
+    memory_free(header);
+  }
 }
 
 size_t list_get_count(const void *list) {
@@ -121,3 +142,58 @@ void *list_add(void *list, const void *item_ref) {
   new_header->count++;
   return new_list;
 }
+
+
+void *list_add_many(void *list, const void *items, size_t items_count) {
+  assert(list && "list_add_many(): parameter list was null");
+  assert((items || items_count == 0) &&
+         "list_add_many(): parameter items was null");
+  list_header *header = ((list_header *)list) - 1;
+  if (items_count == 0) {
+    return list;
+  }
+
+  size_t max_capacity = _list_max_capacity(header->item_size);
+  if (items_count > max_capacity - header->count) {
+    return NULL;
+  }
+
+  size_t required_capacity = header->count + items_count;
+  if (required_capacity > header->capacity) {
+    size_t new_capacity = header->capacity == 0 ? 1 : header->capacity;
+    while (new_capacity < required_capacity) {
+      new_capacity = new_capacity > max_capacity / 2 ? max_capacity
+                                                     : new_capacity * 2;
+    }
+
+    list = _list_resize(list, new_capacity);
+    if (list == NULL) {
+      return NULL;
+    }
+    header = ((list_header *)list) - 1;
+  }
+
+  void *dest = (char *)list + (header->count * header->item_size);
+  memcpy(dest, items, items_count * header->item_size);
+  header->count += items_count;
+  return list;
+}
+
+void list_remove_range(void *list, size_t index, size_t items_count) {
+  assert(list && "list_remove_range(): parameter list was null");
+  list_header *header = ((list_header *)list) - 1;
+  assert(index <= header->count && items_count <= header->count - index &&
+         "list_remove_range(): range out of bounds");
+
+  char *dest = (char *)list + (index * header->item_size);
+  size_t moved_count = header->count - index - items_count;
+  memmove(dest, dest + (items_count * header->item_size),
+          moved_count * header->item_size);
+  header->count -= items_count;
+}
+
+void list_clear(void *list) {
+  assert(list && "list_clear(): parameter list was null");
+  list_header *header = ((list_header *)list) - 1;
+  header->count = 0;
+}
\ No newline at end of file
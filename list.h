@@ -2,13 +2,24 @@
 #define LIST
 #include <stddef.h>
 
+typedef struct Arena Arena;
+
 #define list(type, capacity) ((type*)list_alloc(sizeof(type), (capacity)))
+// a list that grows inside arena, list_free does nothing on it and the arena
+// releases it on reset
+#define list_in(arena, type, capacity)                                         \
+  ((type*)list_alloc_in((arena), sizeof(type), (capacity)))
 #define list_(type) type*
 
 void *list_alloc(size_t item_size_bytes, size_t init_capacity);
+void *list_alloc_in(Arena *arena, size_t item_size_bytes,
+                    size_t init_capacity);
 void list_free(void *list);
 size_t list_get_count(const void *list);
 size_t list_get_capacity(const void *list);
 void *list_add(void *list, const void *item_ref);
+void *list_add_many(void *list, const void *items, size_t items_count);
+void list_remove_range(void *list, size_t index, size_t items_count);
+void list_clear(void *list);
 
 #endif
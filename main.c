@@ -1,9 +1,10 @@
 #include "char_reader.h"
 #include "lexer.h"
+#include "memory.h"
 #include "token_list.h"
-#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 static char *token_type_names[] = {
     [NUMBER_TOKEN] =
@@ -26,24 +27,100 @@ static char *token_type_names[] = {
     [INVALID_TOKEN] = "INVALID_TOKEN",
     [EOI_TOKEN] = "EOI_TOKEN"};
 
+static void print_memory_stats(const char *name, const MemoryStats *stats) {
+  fprintf(stderr,
+          "%s: %zu allocations, %zu reallocations, %zu frees, %zu bytes "
+          "current, %zu bytes peak, %zu bytes moved by realloc\n",
+          name, stats->allocations, stats->reallocations, stats->frees,
+          stats->current_bytes, stats->peak_bytes, stats->moved_bytes);
+}
+
 int main(int argc, const char *argv[]) {
+  // "--stats" before anything is allocated, so every block is counted, a
+  // path after "--file" is a path even when it reads "--stats"
+  bool print_stats = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--file") == 0) {
+      i++;
+    } else if (strcmp(argv[i], "--stats") == 0) {
+      print_stats = true;
+      memory_set_allocator(&memory_counting_allocator);
+      break;
+    }
+  }
+
   CharReader reader = {0};
   char_reader_init(&reader);
 
+  // every argument is part of the expression, "--file <path>" adds the
+  // contents of the file instead and "--stats" prints what lexing allocated
+  // to stderr, and the lexer stats in builds with -DLEXER_STATS
+  bool is_first = true;
   for (int i = 1; i < argc; i++) {
-    assert(char_reader_add(&reader, argv[i]));
-    if (i < argc - 1) {
-      assert(char_reader_add(&reader, " "));
+    bool is_file = strcmp(argv[i], "--file") == 0;
+    if (is_file && i + 1 == argc) {
+      fprintf(stderr, "usage: %s [--stats] [expression | --file <path>]...\n",
+              argv[0]);
+      char_reader_destroy(&reader);
+      return 1;
+    }
+    if (!is_file && strcmp(argv[i], "--stats") == 0) {
+      continue;
+    }
+    if (!is_first && !char_reader_add_view(&reader, " ", 1)) {
+      fprintf(stderr, "out of memory\n");
+      char_reader_destroy(&reader);
+      return 1;
+    }
+    is_first = false;
+
+    if (is_file) {
+      i++;
+      if (!char_reader_add_file(&reader, argv[i])) {
+        fprintf(stderr, "failed to read file \"%s\"\n", argv[i]);
+        char_reader_destroy(&reader);
+        return 1;
+      }
+      continue;
+    }
+
+    // argv outlives the reader and the tokens, no need to copy it
+    if (!char_reader_add_view(&reader, argv[i], strlen(argv[i]))) {
+      fprintf(stderr, "out of memory\n");
+      char_reader_destroy(&reader);
+      return 1;
     }
   }
 
+  memory_begin_request();
   TokenList tokens = lex_char_reader(&reader);
+  MemoryStats lex_stats;
+  memory_get_request_stats(&lex_stats);
+
   for (size_t i = 0; i < token_list_get_count(&tokens); i++) {
     Token token = token_list_get_token_at(&tokens, i);
-    printf("{ type:\"%s\", lexeme:\"%s\" }\n", token_type_names[token.type],
-           token.lexeme ? token.lexeme : "[NULL]");
+    Lexeme lexeme = token_list_get_lexeme(&tokens, token);
+    if (lexeme.chars == NULL) {
+      lexeme = (Lexeme){.chars = "[NULL]", .length = 6};
+    }
+
+    printf("{ type:\"%s\", lexeme:\"%.*s\" }\n", token_type_names[token.type],
+           (int)lexeme.length, lexeme.chars);
   }
 
   token_list_distroy(&tokens);
   char_reader_destroy(&reader);
+
+  if (print_stats) {
+    MemoryStats total_stats;
+    memory_get_stats(&total_stats);
+    print_memory_stats("lex_char_reader", &lex_stats);
+    print_memory_stats("total", &total_stats);
+#ifdef LEXER_STATS
+    LexerStats lexer_stats;
+    lexer_stats_get(&lexer_stats);
+    fprintf(stderr, "\n");
+    lexer_stats_print(&lexer_stats, stderr);
+#endif
+  }
 }
@@ -0,0 +1,190 @@
+#include "memory.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+static void *_memory_libc_alloc(void *context, size_t size) {
+  (void)context;
+  return malloc(size);
+}
+
+static void *_memory_libc_realloc(void *context, void *ptr, size_t size) {
+  (void)context;
+  return realloc(ptr, size);
+}
+
+static void _memory_libc_free(void *context, void *ptr) {
+  (void)context;
+  free(ptr);
+}
+
+static const MemoryAllocator _memory_libc_allocator = {
+    _memory_libc_alloc, _memory_libc_realloc, _memory_libc_free, NULL};
+
+static MemoryAllocator _memory_allocator = {
+    _memory_libc_alloc, _memory_libc_realloc, _memory_libc_free, NULL};
+
+void memory_set_allocator(const MemoryAllocator *allocator) {
+  assert((allocator == NULL || (allocator->alloc && allocator->realloc &&
+                                allocator->free)) &&
+         "memory_set_allocator(): allocator is missing a function");
+  _memory_allocator = allocator != NULL ? *allocator : _memory_libc_allocator;
+}
+
+void *memory_alloc(size_t size) {
+  return _memory_allocator.alloc(_memory_allocator.context, size);
+}
+
+void *memory_realloc(void *ptr, size_t size) {
+  return _memory_allocator.realloc(_memory_allocator.context, ptr, size);
+}
+
+void memory_free(void *ptr) {
+  _memory_allocator.free(_memory_allocator.context, ptr);
+}
+
+// the size of the block in front of it, padded so the block stays aligned
+// like malloc
+typedef union MemoryHeader {
+  size_t size;
+  max_align_t alignment;
+} MemoryHeader;
+
+static atomic_size_t _memory_allocations;
+static atomic_size_t _memory_reallocations;
+static atomic_size_t _memory_frees;
+static atomic_size_t _memory_current_bytes;
+static atomic_size_t _memory_peak_bytes;
+static atomic_size_t _memory_moved_bytes;
+
+// the request of the calling thread, current may go below zero when it
+// frees what an earlier request allocated
+typedef struct MemoryRequest {
+  size_t allocations;
+  size_t reallocations;
+  size_t frees;
+  int64_t current_bytes;
+  int64_t peak_bytes;
+  size_t moved_bytes;
+} MemoryRequest;
+
+static _Thread_local MemoryRequest _memory_request;
+
+static void _memory_count_bytes(size_t added, size_t removed) {
+  size_t current;
+  if (added >= removed) {
+    current = atomic_fetch_add_explicit(&_memory_current_bytes,
+                                        added - removed,
+                                        memory_order_relaxed) +
+              (added - removed);
+  } else {
+    current = atomic_fetch_sub_explicit(&_memory_current_bytes,
+                                        removed - added,
+                                        memory_order_relaxed) -
+              (removed - added);
+  }
+  size_t peak =
+      atomic_load_explicit(&_memory_peak_bytes, memory_order_relaxed);
+  while (current > peak &&
+         !atomic_compare_exchange_weak_explicit(&_memory_peak_bytes, &peak,
+                                                current, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+  }
+
+  _memory_request.current_bytes += (int64_t)added - (int64_t)removed;
+  if (_memory_request.current_bytes > _memory_request.peak_bytes) {
+    _memory_request.peak_bytes = _memory_request.current_bytes;
+  }
+}
+
+static void *_memory_counting_alloc(void *context, size_t size) {
+  (void)context;
+  if (size > SIZE_MAX - sizeof(MemoryHeader)) {
+    return NULL;
+  }
+  MemoryHeader *header = malloc(sizeof(MemoryHeader) + size);
+  if (header == NULL) {
+    return NULL;
+  }
+
+  header->size = size;
+  atomic_fetch_add_explicit(&_memory_allocations, 1, memory_order_relaxed);
+  _memory_request.allocations++;
+  _memory_count_bytes(size, 0);
+  return header + 1;
+}
+
+static void *_memory_counting_realloc(void *context, void *ptr, size_t size) {
+  if (ptr == NULL) {
+    return _memory_counting_alloc(context, size);
+  }
+  if (size > SIZE_MAX - sizeof(MemoryHeader)) {
+    return NULL;
+  }
+  MemoryHeader *header = (MemoryHeader *)ptr - 1;
+  size_t old_size = header->size;
+  MemoryHeader *new_header = realloc(header, sizeof(MemoryHeader) + size);
+  if (new_header == NULL) {
+    return NULL;
+  }
+
+  new_header->size = size;
+  atomic_fetch_add_explicit(&_memory_reallocations, 1, memory_order_relaxed);
+  _memory_request.reallocations++;
+  if (new_header != header) {
+    size_t moved = old_size < size ? old_size : size;
+    atomic_fetch_add_explicit(&_memory_moved_bytes, moved,
+                              memory_order_relaxed);
+    _memory_request.moved_bytes += moved;
+  }
+  _memory_count_bytes(size, old_size);
+  return new_header + 1;
+}
+
+static void _memory_counting_free(void *context, void *ptr) {
+  (void)context;
+  if (ptr == NULL) {
+    return;
+  }
+  MemoryHeader *header = (MemoryHeader *)ptr - 1;
+  atomic_fetch_add_explicit(&_memory_frees, 1, memory_order_relaxed);
+  _memory_request.frees++;
+  _memory_count_bytes(0, header->size);
+  free(header);
+}
+
+const MemoryAllocator memory_counting_allocator = {
+    _memory_counting_alloc, _memory_counting_realloc, _memory_counting_free,
+    NULL};
+
+void memory_get_stats(MemoryStats *stats) {
+  assert(stats && "memory_get_stats(): arg stats was null");
+  stats->allocations =
+      atomic_load_explicit(&_memory_allocations, memory_order_relaxed);
+  stats->reallocations =
+      atomic_load_explicit(&_memory_reallocations, memory_order_relaxed);
+  stats->frees = atomic_load_explicit(&_memory_frees, memory_order_relaxed);
+  stats->current_bytes =
+      atomic_load_explicit(&_memory_current_bytes, memory_order_relaxed);
+  stats->peak_bytes =
+      atomic_load_explicit(&_memory_peak_bytes, memory_order_relaxed);
+  stats->moved_bytes =
+      atomic_load_explicit(&_memory_moved_bytes, memory_order_relaxed);
+}
+
+void memory_begin_request(void) {
+  _memory_request = (MemoryRequest){0};
+}
+
+void memory_get_request_stats(MemoryStats *stats) {
+  assert(stats && "memory_get_request_stats(): arg stats was null");
+  stats->allocations = _memory_request.allocations;
+  stats->reallocations = _memory_request.reallocations;
+  stats->frees = _memory_request.frees;
+  stats->current_bytes = _memory_request.current_bytes > 0
+                             ? (size_t)_memory_request.current_bytes
+                             : 0;
+  stats->peak_bytes = (size_t)_memory_request.peak_bytes;
+  stats->moved_bytes = _memory_request.moved_bytes;
+}
@@ -0,0 +1,43 @@
+#ifndef MEMORY
+#define MEMORY
+#include <stddef.h>
+
+// Where lists, char readers and arenas get their heap memory from. The
+// functions behave like malloc, realloc and free, context is passed to each.
+typedef struct MemoryAllocator {
+  void *(*alloc)(void *context, size_t size);
+  void *(*realloc)(void *context, void *ptr, size_t size);
+  void (*free)(void *context, void *ptr);
+  void *context;
+} MemoryAllocator;
+
+typedef struct MemoryStats {
+  size_t allocations;
+  size_t reallocations;
+  size_t frees;
+  size_t current_bytes; // allocated and not freed yet
+  size_t peak_bytes;    // the highest current_bytes
+  size_t moved_bytes;   // copied by reallocations that returned a new block
+} MemoryStats;
+
+// Counts every call and byte in the stats below and gets the memory from
+// malloc. Sizes are kept in a small header before each block.
+extern const MemoryAllocator memory_counting_allocator;
+
+// NULL goes back to malloc, realloc and free. Memory has to be freed by the
+// allocator it came from, so set it before anything is allocated, and before
+// other threads start.
+void memory_set_allocator(const MemoryAllocator *allocator);
+void *memory_alloc(size_t size);
+void *memory_realloc(void *ptr, size_t size);
+void memory_free(void *ptr);
+
+// what memory_counting_allocator counted since the program started
+void memory_get_stats(MemoryStats *stats);
+// Starts a new request on the calling thread, its stats count from zero.
+// current_bytes of a request is what it allocated minus what it freed, 0
+// when it freed more than it allocated.
+void memory_begin_request(void);
+void memory_get_request_stats(MemoryStats *stats);
+
+#endif
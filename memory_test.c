@@ -0,0 +1,159 @@
+#include "arena.h"
+#include "char_reader.h"
+#include "lexer.h"
+#include "list.h"
+#include "memory.h"
+#include "token_list.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct CallCounts {
+  size_t allocs;
+  size_t reallocs;
+  size_t frees;
+} CallCounts;
+
+static void *counting_alloc(void *context, size_t size) {
+  ((CallCounts *)context)->allocs++;
+  return malloc(size);
+}
+
+static void *counting_realloc(void *context, void *ptr, size_t size) {
+  ((CallCounts *)context)->reallocs++;
+  return realloc(ptr, size);
+}
+
+static void counting_free(void *context, void *ptr) {
+  ((CallCounts *)context)->frees++;
+  free(ptr);
+}
+
+// lists, readers and arenas all go through the allocator that is set
+static void test_custom_allocator(void) {
+  CallCounts counts = {0};
+  MemoryAllocator allocator = {counting_alloc, counting_realloc,
+                               counting_free, &counts};
+  memory_set_allocator(&allocator);
+
+  int *numbers = list(int, 1);
+  assert(numbers != NULL);
+  for (int i = 0; i < 100; i++) {
+    numbers = list_add(numbers, &i);
+    assert(numbers != NULL);
+  }
+  list_free(numbers);
+  assert(counts.allocs == 1 && counts.reallocs == 7 && counts.frees == 1);
+
+  CharReader reader;
+  char_reader_init(&reader);
+  assert(char_reader_add(&reader, "x + 1"));
+  char_reader_destroy(&reader);
+  assert(counts.allocs == 3 && counts.frees == 3);
+
+  Arena arena;
+  assert(arena_init(&arena, 64));
+  assert(arena_alloc(&arena, 1000) != NULL);
+  arena_destroy(&arena);
+  assert(counts.allocs == counts.frees);
+
+  memory_set_allocator(NULL);
+  void *block = memory_alloc(16);
+  assert(block != NULL);
+  memory_free(block);
+  assert(counts.allocs == counts.frees && counts.frees == 5);
+}
+
+static void test_counting_allocator(void) {
+  memory_set_allocator(&memory_counting_allocator);
+  MemoryStats before;
+  memory_get_stats(&before);
+  memory_begin_request();
+
+  char *block = memory_alloc(100);
+  assert(block != NULL);
+  memset(block, 'x', 100);
+  // a bigger block in between keeps the realloc from growing in place
+  char *blocker = memory_alloc(1000);
+  char *grown = memory_realloc(block, 100000);
+  assert(grown != NULL && grown[99] == 'x');
+  MemoryStats stats;
+  memory_get_request_stats(&stats);
+  assert(stats.allocations == 2 && stats.reallocations == 1);
+  assert(stats.frees == 0);
+  assert(stats.current_bytes == 101000 && stats.peak_bytes == 101000);
+  assert(stats.moved_bytes == 0 || stats.moved_bytes == 100);
+
+  memory_free(blocker);
+  grown = memory_realloc(grown, 10);
+  assert(grown != NULL);
+  memory_free(grown);
+  memory_free(NULL);
+  memory_get_request_stats(&stats);
+  assert(stats.allocations == 2 && stats.reallocations == 2);
+  assert(stats.frees == 2);
+  assert(stats.current_bytes == 0 && stats.peak_bytes == 101000);
+
+  MemoryStats after;
+  memory_get_stats(&after);
+  assert(after.allocations == before.allocations + 2);
+  assert(after.reallocations == before.reallocations + 2);
+  assert(after.frees == before.frees + 2);
+  assert(after.current_bytes == before.current_bytes);
+  assert(after.peak_bytes >= before.current_bytes + 101000);
+
+  // a new request starts from zero, freeing older blocks does not wrap
+  char *older = memory_alloc(64);
+  memory_begin_request();
+  memory_free(older);
+  memory_get_request_stats(&stats);
+  assert(stats.allocations == 0 && stats.frees == 1);
+  assert(stats.current_bytes == 0 && stats.peak_bytes == 0);
+  memory_set_allocator(NULL);
+}
+
+// what one lex_char_reader call costs, and that it all comes back
+static void test_lexing_stats(void) {
+  memory_set_allocator(&memory_counting_allocator);
+  MemoryStats before;
+  memory_get_stats(&before);
+
+  CharReader reader;
+  char_reader_init(&reader);
+  char input[4096];
+  for (size_t i = 0; i < sizeof(input) - 1; i++) {
+    input[i] = "x1 + "[i % 5];
+  }
+  input[sizeof(input) - 1] = '\0';
+  assert(char_reader_add(&reader, input));
+
+  memory_begin_request();
+  TokenList tokens = lex_char_reader(&reader);
+  MemoryStats stats;
+  memory_get_request_stats(&stats);
+  // the token list grows by doubling, so a few reallocations at most
+  assert(stats.allocations > 0 && stats.allocations < 10);
+  assert(stats.reallocations > 0 && stats.reallocations < 20);
+  assert(stats.current_bytes >=
+         token_list_get_count(&tokens) * sizeof(Token));
+  assert(stats.peak_bytes >= stats.current_bytes);
+
+  token_list_distroy(&tokens);
+  char_reader_destroy(&reader);
+  MemoryStats after;
+  memory_get_stats(&after);
+  assert(after.current_bytes == before.current_bytes);
+  assert(after.allocations + after.reallocations >
+         before.allocations + before.reallocations);
+  memory_set_allocator(NULL);
+}
+
+int main(void) {
+  test_custom_allocator();
+  test_counting_allocator();
+  test_lexing_stats();
+
+  printf("All memory tests passed\n");
+  return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef NUMBER_PARSE
+#define NUMBER_PARSE
+#include <stddef.h>
+#include <stdint.h>
+
+// exponents beyond this turn every literal into 0 or inf, larger ones can be
+// clamped to it
+#define NUMBER_MAX_EXPONENT 1000000000000000000LL
+
+// Converts the digits of chars[0..length) times 10^exponent to the nearest
+// double, ties to even, the way strtod would but without it. chars is a
+// NUMBER_TOKEN lexeme: digits with at most one '.' and ',' between groups of
+// digits, a lexeme without digits is 0. exponent is within
+// +-NUMBER_MAX_EXPONENT.
+//
+// Up to 19 significant digits fit one uint64_t. Those that are exact in a
+// double with a power of ten below 10^23 take one multiplication or
+// division, any other is rounded with one or two 128 bit products against a
+// table of powers of five (Eisel-Lemire). Longer literals whose digits past
+// the 19th can decide the rounding are compared with the halfway point
+// between their two candidates in big integer arithmetic.
+double number_parse(const char *chars, size_t length, int64_t exponent);
+
+#endif
@@ -0,0 +1,149 @@
+#include "number.h"
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// strtod is correctly rounded in the c libraries the tests run on, it is the
+// reference
+static void run_number_test(const char *chars, int64_t exponent) {
+  char text[4096];
+  int length = snprintf(text, sizeof(text), "%se%lld", chars,
+                        (long long)exponent);
+  assert(length > 0 && (size_t)length < sizeof(text));
+  // strtod does not know separators
+  size_t kept = 0;
+  for (int i = 0; i < length; i++) {
+    if (text[i] != ',') {
+      text[kept++] = text[i];
+    }
+  }
+  text[kept] = '\0';
+
+  double expected = strtod(text, NULL);
+  double actual = number_parse(chars, strlen(chars), exponent);
+  if (memcmp(&actual, &expected, sizeof(double)) != 0) {
+    fprintf(stderr, "\"%s\" e%lld parsed to %.17g, expected %.17g\n", chars,
+            (long long)exponent, actual, expected);
+  }
+  assert(memcmp(&actual, &expected, sizeof(double)) == 0);
+}
+
+static void test_simple(void) {
+  assert(number_parse("0", 1, 0) == 0);
+  assert(number_parse(".", 1, 0) == 0);
+  assert(number_parse("000.000", 7, 5) == 0);
+  assert(number_parse("123", 3, 0) == 123);
+  assert(number_parse("123.313", 7, 0) == 123.313);
+  assert(number_parse(".3123", 5, 0) == .3123);
+  assert(number_parse("0.1231", 6, 0) == 0.1231);
+  assert(number_parse("1.", 2, 0) == 1);
+  assert(number_parse("11,222,333", 10, 0) == 11222333);
+  assert(number_parse("11,222.333444", 13, 0) == 11222.333444);
+  assert(number_parse("1", 1, -3) == 1e-3);
+  assert(number_parse("2.5", 3, 10) == 2.5e10);
+  assert(number_parse("18446744073709551615", 20, 0) == 18446744073709551615.0);
+  assert(number_parse("1", 1, NUMBER_MAX_EXPONENT) == INFINITY);
+  assert(number_parse("1", 1, -NUMBER_MAX_EXPONENT) == 0);
+  run_number_test("0.1", 0);
+  run_number_test("12", 30);
+  run_number_test("123456789012345678", 0);
+  run_number_test("9007199254740993", 0);
+  run_number_test("9007199254740995", 0);
+}
+
+static void test_limits(void) {
+  run_number_test("1.7976931348623157", 308);
+  run_number_test("1.7976931348623158", 308);
+  run_number_test("1.7976931348623159", 308);
+  run_number_test("2.2250738585072011", -308);
+  run_number_test("2.2250738585072012", -308);
+  run_number_test("4.9406564584124654", -324);
+  run_number_test("2.4703282292062327", -324);
+  run_number_test("2.4703282292062328", -324);
+  run_number_test("1", -343);
+  run_number_test("1", 309);
+  run_number_test("0.000000000000000000000000000001", 330);
+}
+
+// Literals exactly halfway between two doubles and right next to that,
+// only the digits far behind the 19th decide them. long double holds the
+// halfway points of doubles exactly where it has 64 bits of mantissa.
+static void test_halfway_points(void) {
+#if LDBL_MANT_DIG >= 64
+  srand(99);
+  for (int i = 0; i < 3000; i++) {
+    uint64_t bits = ((uint64_t)rand() << 40) ^ ((uint64_t)rand() << 20) ^
+                    (uint64_t)rand();
+    bits &= 0x7fefffffffffffffu;
+    double lower;
+    memcpy(&lower, &bits, sizeof(lower));
+    long double halfway =
+        ((long double)lower + (long double)nextafter(lower, INFINITY)) / 2;
+
+    char digits[1200];
+    int length = snprintf(digits, sizeof(digits), "%.1100Le", halfway);
+    assert(length > 0 && (size_t)length < sizeof(digits));
+    char *e = strchr(digits, 'e');
+    int64_t exponent = strtoll(e + 1, NULL, 10);
+    *e = '\0';
+    // trailing zeros only make the literal longer
+    while (e[-1] == '0') {
+      *--e = '\0';
+    }
+    run_number_test(digits, exponent);
+
+    size_t end = strlen(digits);
+    memcpy(digits + end, "0001", 5);
+    run_number_test(digits, exponent);
+    digits[end] = '\0';
+    // one less in the last digit
+    for (size_t c = end; c-- > 0;) {
+      if (digits[c] == '.') {
+        continue;
+      }
+      if (digits[c] != '0') {
+        digits[c]--;
+        break;
+      }
+      digits[c] = '9';
+    }
+    run_number_test(digits, exponent);
+  }
+#endif
+}
+
+static void test_random(void) {
+  srand(7);
+  for (int i = 0; i < 200000; i++) {
+    char digits[1400];
+    size_t length = 0;
+    size_t count = 1 + (size_t)(rand() % (i % 10 == 0 ? 900 : 25));
+    size_t point = (size_t)rand() % (count + 1);
+    bool grouped = point > 3 && rand() % 4 == 0;
+    for (size_t d = 0; d < count; d++) {
+      if (d == point) {
+        digits[length++] = '.';
+      }
+      if (grouped && d != 0 && d < point && (point - d) % 3 == 0) {
+        digits[length++] = ',';
+      }
+      digits[length++] = (char)('0' + (d == 0 ? 1 + rand() % 9 : rand() % 10));
+    }
+    digits[length] = '\0';
+    run_number_test(digits, rand() % 700 - 350 - (int64_t)point);
+  }
+}
+
+int main(void) {
+  test_simple();
+  test_limits();
+  test_halfway_points();
+  test_random();
+
+  printf("All number tests passed\n");
+  return 0;
+}
@@ -0,0 +1,310 @@
+#include "optimizer.h"
+#include "bytecode.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+// what the optimizer found out about one node of the input
+typedef struct OptimizerNode {
+  uint32_t alias;       // the node that stands for this one, itself if kept
+  uint32_t new_index;   // index in the result when live
+  int power;            // expanded exponent, 0 when not expanded
+  bool is_constant;     // replaced by value
+  bool is_live;         // part of the result
+  bool has_unknown_call; // the subtree calls a function bytecode lacks
+  double value;
+} OptimizerNode;
+
+typedef struct Optimizer {
+  const AstNode *nodes;
+  OptimizerNode *infos;
+  TokenList *tokens;
+  size_t first_token;
+  OptimizeStats *stats;
+} Optimizer;
+
+static bool _optimizer_find_function(Optimizer *this, const AstNode *node,
+                                     uint32_t *function) {
+  Token token = token_list_get_token_at(this->tokens,
+                                        this->first_token + node->token_index);
+  Lexeme name = token_list_get_lexeme(this->tokens, token);
+  return bytecode_find_function(name.chars, name.length, function);
+}
+
+static double _optimizer_apply(AstNodeType type, double lhs, double rhs) {
+  switch (type) {
+  case AST_ADD:
+    return lhs + rhs;
+  case AST_SUBTRACT:
+    return lhs - rhs;
+  case AST_MULTIPLY:
+    return lhs * rhs;
+  case AST_DIVIDE:
+    return lhs / rhs;
+  case AST_MODULO:
+    return fmod(lhs, rhs);
+  default:
+    assert(type == AST_POWER && "_optimizer_apply(): not a binary node");
+    return pow(lhs, rhs);
+  }
+}
+
+static bool _optimizer_is(const OptimizerNode *info, double value) {
+  return info->is_constant && info->value == value &&
+         signbit(info->value) == signbit(value);
+}
+
+static void _optimizer_fold(Optimizer *this, OptimizerNode *info,
+                            double value) {
+  info->is_constant = true;
+  info->value = value;
+  this->stats->folded_nodes++;
+}
+
+static void _optimizer_alias(Optimizer *this, OptimizerNode *info,
+                             uint32_t alias) {
+  info->alias = alias;
+  this->stats->identities++;
+}
+
+static void _optimizer_analyze_binary(Optimizer *this, uint32_t index) {
+  const AstNode *node = &this->nodes[index];
+  OptimizerNode *info = &this->infos[index];
+  uint32_t lhs = this->infos[node->binary.lhs].alias;
+  uint32_t rhs = this->infos[node->binary.rhs].alias;
+  const OptimizerNode *left = &this->infos[lhs];
+  const OptimizerNode *right = &this->infos[rhs];
+  info->has_unknown_call = left->has_unknown_call || right->has_unknown_call;
+  if (left->is_constant && right->is_constant) {
+    _optimizer_fold(this, info,
+                    _optimizer_apply(node->type, left->value, right->value));
+    return;
+  }
+
+  switch (node->type) {
+  case AST_MULTIPLY:
+    if (_optimizer_is(right, 1)) {
+      _optimizer_alias(this, info, lhs);
+    } else if (_optimizer_is(left, 1)) {
+      _optimizer_alias(this, info, rhs);
+    }
+    break;
+  case AST_DIVIDE:
+    if (_optimizer_is(right, 1)) {
+      _optimizer_alias(this, info, lhs);
+    }
+    break;
+  case AST_SUBTRACT:
+    if (_optimizer_is(right, 0.0)) {
+      _optimizer_alias(this, info, lhs);
+    }
+    break;
+  case AST_ADD:
+    if (_optimizer_is(right, -0.0)) {
+      _optimizer_alias(this, info, lhs);
+    } else if (_optimizer_is(left, -0.0)) {
+      _optimizer_alias(this, info, rhs);
+    }
+    break;
+  case AST_POWER:
+    // pow(x, 0) and pow(1, y) are 1 even for NaN
+    if (_optimizer_is(right, 1)) {
+      _optimizer_alias(this, info, lhs);
+    } else if ((_optimizer_is(right, 0.0) || _optimizer_is(right, -0.0)) &&
+               !left->has_unknown_call) {
+      info->is_constant = true;
+      info->value = 1;
+      this->stats->identities++;
+    } else if (_optimizer_is(left, 1) && !right->has_unknown_call) {
+      info->is_constant = true;
+      info->value = 1;
+      this->stats->identities++;
+    } else if (right->is_constant &&
+               this->nodes[lhs].type == AST_VARIABLE &&
+               right->value == trunc(right->value) && right->value >= 2 &&
+               right->value <= OPTIMIZER_MAX_POWER_CHAIN) {
+      info->power = (int)right->value;
+      this->stats->expanded_powers++;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+// fills the infos front to back, children before their parents
+static void _optimizer_analyze(Optimizer *this, size_t count) {
+  for (uint32_t index = 0; index < count; index++) {
+    const AstNode *node = &this->nodes[index];
+    OptimizerNode *info = &this->infos[index];
+    *info = (OptimizerNode){.alias = index};
+    uint32_t operand;
+    uint32_t function;
+    switch (node->type) {
+    case AST_NUMBER:
+      info->is_constant = true;
+      info->value = node->number;
+      break;
+    case AST_VARIABLE:
+      break;
+    case AST_NEGATE:
+      operand = this->infos[node->operand].alias;
+      info->has_unknown_call = this->infos[operand].has_unknown_call;
+      if (this->infos[operand].is_constant) {
+        _optimizer_fold(this, info, -this->infos[operand].value);
+      } else if (this->nodes[operand].type == AST_NEGATE) {
+        _optimizer_alias(this, info,
+                         this->infos[this->nodes[operand].operand].alias);
+      }
+      break;
+    case AST_CALL:
+      operand = this->infos[node->operand].alias;
+      if (!_optimizer_find_function(this, node, &function)) {
+        info->has_unknown_call = true;
+      } else if (this->infos[operand].is_constant) {
+        _optimizer_fold(
+            this, info,
+            bytecode_functions[function].function(this->infos[operand].value));
+      } else {
+        info->has_unknown_call = this->infos[operand].has_unknown_call;
+      }
+      break;
+    default:
+      assert(ast_node_is_binary(node->type) &&
+             "_optimizer_analyze(): unknown node type");
+      _optimizer_analyze_binary(this, index);
+      break;
+    }
+  }
+}
+
+// marks what the result needs back to front, parents before their children,
+// and returns the node count of the result
+static size_t _optimizer_mark_live(Optimizer *this, uint32_t root) {
+  size_t count = 0;
+  this->infos[this->infos[root].alias].is_live = true;
+  for (uint32_t index = root + 1; index-- > 0;) {
+    const AstNode *node = &this->nodes[index];
+    OptimizerNode *info = &this->infos[index];
+    if (!info->is_live) {
+      continue;
+    }
+    if (info->is_constant) {
+      count++;
+    } else if (info->power != 0) {
+      // n copies of x and n - 1 products
+      count += (size_t)(2 * info->power - 1);
+    } else if (node->type == AST_NEGATE || node->type == AST_CALL) {
+      this->infos[this->infos[node->operand].alias].is_live = true;
+      count++;
+    } else if (ast_node_is_binary(node->type)) {
+      this->infos[this->infos[node->binary.lhs].alias].is_live = true;
+      this->infos[this->infos[node->binary.rhs].alias].is_live = true;
+      count++;
+    } else {
+      count++;
+    }
+  }
+  return count;
+}
+
+static uint32_t _optimizer_push(AstNode *out, size_t *count, AstNode node) {
+  out[*count] = node;
+  return (uint32_t)(*count)++;
+}
+
+// writes the live nodes front to back, which keeps children before parents
+static void _optimizer_emit(Optimizer *this, size_t input_count,
+                            AstNode *out) {
+  size_t count = 0;
+  for (uint32_t index = 0; index < input_count; index++) {
+    AstNode node = this->nodes[index];
+    OptimizerNode *info = &this->infos[index];
+    if (!info->is_live) {
+      continue;
+    }
+
+    if (info->is_constant) {
+      node = (AstNode){.type = AST_NUMBER,
+                       .token_index = node.token_index,
+                       .number = info->value};
+    } else if (info->power != 0) {
+      AstNode base = this->nodes[this->infos[node.binary.lhs].alias];
+      uint32_t product = _optimizer_push(out, &count, base);
+      for (int i = 1; i < info->power; i++) {
+        uint32_t factor = _optimizer_push(out, &count, base);
+        product = _optimizer_push(
+            out, &count,
+            (AstNode){.type = AST_MULTIPLY,
+                      .token_index = node.token_index,
+                      .binary = {.lhs = product, .rhs = factor}});
+      }
+      info->new_index = product;
+      continue;
+    } else if (node.type == AST_NEGATE || node.type == AST_CALL) {
+      node.operand = this->infos[this->infos[node.operand].alias].new_index;
+    } else if (ast_node_is_binary(node.type)) {
+      node.binary.lhs =
+          this->infos[this->infos[node.binary.lhs].alias].new_index;
+      node.binary.rhs =
+          this->infos[this->infos[node.binary.rhs].alias].new_index;
+    }
+    info->new_index = _optimizer_push(out, &count, node);
+  }
+}
+
+bool optimize_ast(Ast *ast, TokenList *tokens, size_t first_token,
+                  OptimizeStats *stats) {
+  assert(ast && "optimize_ast(): arg ast was null");
+  assert(tokens && "optimize_ast(): arg tokens was null");
+  assert(stats && "optimize_ast(): arg stats was null");
+  size_t count = ast_get_node_count(ast);
+  *stats = (OptimizeStats){.node_count_before = count,
+                           .node_count_after = count};
+  if (count == 0) {
+    return true;
+  }
+
+  OptimizerNode *infos = malloc(count * sizeof(OptimizerNode));
+  if (infos == NULL) {
+    ast_clear(ast);
+    return false;
+  }
+  Optimizer optimizer = {.nodes = ast_get_node(ast, 0),
+                         .infos = infos,
+                         .tokens = tokens,
+                         .first_token = first_token,
+                         .stats = stats};
+  _optimizer_analyze(&optimizer, count);
+  size_t new_count = _optimizer_mark_live(&optimizer, ast_get_root(ast));
+
+  AstNode *out = malloc(new_count * sizeof(AstNode));
+  if (out == NULL) {
+    free(infos);
+    ast_clear(ast);
+    return false;
+  }
+  _optimizer_emit(&optimizer, count, out);
+
+  for (size_t i = 0; i < count; i++) {
+    if (!infos[i].is_live) {
+      stats->eliminated_nodes++;
+    } else if (infos[i].power != 0) {
+      stats->expanded_nodes += (size_t)(2 * infos[i].power - 2);
+    }
+  }
+  stats->node_count_after = new_count;
+  free(infos);
+
+  ast_clear(ast);
+  bool added = true;
+  for (size_t i = 0; i < new_count && added; i++) {
+    uint32_t index;
+    added = ast_add_node(ast, out[i], &index);
+  }
+  free(out);
+  if (!added) {
+    ast_clear(ast);
+  }
+  return added;
+}
@@ -0,0 +1,34 @@
+#ifndef OPTIMIZER
+#define OPTIMIZER
+#include "ast.h"
+#include "token_list.h"
+
+// x ^ n with a variable x and an integer n from 2 up to this size becomes a
+// chain of multiplications. Negative n stay pow, 1 / (x * ... * x) would
+// overflow to inf and give 0 where pow still has a result.
+#define OPTIMIZER_MAX_POWER_CHAIN 8
+
+typedef struct OptimizeStats {
+  size_t node_count_before;
+  size_t node_count_after;
+  size_t eliminated_nodes; // nodes of the input missing from the result
+  size_t folded_nodes;     // operations replaced by their constant result
+  size_t identities;       // x*1 x/1 x-0 x+(-0) x^1 x^0 1^x --x
+  size_t expanded_powers;
+  size_t expanded_nodes; // nodes the power chains add beyond the power node,
+                         // after = before - eliminated + expanded
+} OptimizeStats;
+
+// Rewrites ast into an equivalent expression between parsing and compiling.
+// Subtrees without variables are folded with the functions the vm uses and
+// only identities that hold for every IEEE value are applied, x+0 is kept
+// as -0+0 is +0. Subtrees with calls of unknown functions are never dropped,
+// so they still fail to compile. Power chains may differ from pow in the
+// last bits, and at the edges of the range in where they overflow to inf
+// or underflow to 0. first_token is the index in tokens of the first token of the
+// expression, the names of calls are looked up there. Returns false when out
+// of memory, ast is left empty then.
+bool optimize_ast(Ast *ast, TokenList *tokens, size_t first_token,
+                  OptimizeStats *stats);
+
+#endif
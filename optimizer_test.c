@@ -0,0 +1,228 @@
+#include "ast.h"
+#include "bytecode.h"
+#include "char_reader.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "test_helpers.h"
+#include "token_list.h"
+#include "vm.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const node_names[AST_NODE_TYPE_COUNT] = {
+    [AST_NEGATE] = "neg",   [AST_ADD] = "+",    [AST_SUBTRACT] = "-",
+    [AST_MULTIPLY] = "*",   [AST_DIVIDE] = "/", [AST_MODULO] = "%",
+    [AST_POWER] = "^",      [AST_CALL] = "call"};
+
+// writes the subtree of index as an s-expression, "(+ 1 (* x 2))"
+static void write_node(const Ast *ast, TokenList *tokens, uint32_t index,
+                       char *out, size_t *length) {
+  const AstNode *node = ast_get_node(ast, index);
+  Lexeme name;
+  switch (node->type) {
+  case AST_NUMBER:
+    *length += (size_t)sprintf(out + *length, "%g", node->number);
+    return;
+  case AST_VARIABLE:
+    name = token_list_get_lexeme(
+        tokens, token_list_get_token_at(tokens, node->token_index));
+    *length += (size_t)sprintf(out + *length, "%.*s", (int)name.length,
+                               name.chars);
+    return;
+  case AST_NEGATE:
+  case AST_CALL:
+    assert(node->operand < index);
+    if (node->type == AST_CALL) {
+      name = token_list_get_lexeme(
+          tokens, token_list_get_token_at(tokens, node->token_index));
+      *length += (size_t)sprintf(out + *length, "(%.*s ", (int)name.length,
+                                 name.chars);
+    } else {
+      *length += (size_t)sprintf(out + *length, "(neg ");
+    }
+    write_node(ast, tokens, node->operand, out, length);
+    break;
+  default:
+    assert(ast_node_is_binary(node->type));
+    assert(node->binary.lhs < index && node->binary.rhs < index);
+    *length += (size_t)sprintf(out + *length, "(%s ", node_names[node->type]);
+    write_node(ast, tokens, node->binary.lhs, out, length);
+    out[(*length)++] = ' ';
+    write_node(ast, tokens, node->binary.rhs, out, length);
+    break;
+  }
+  out[(*length)++] = ')';
+  out[*length] = '\0';
+}
+
+static OptimizeStats run_optimize_test(const char *input,
+                                       const char *expected) {
+  TokenList tokens = lex_string(input);
+  Ast ast;
+  assert(ast_init(&ast));
+  ParseError error;
+  assert(parse_token_list(&tokens, &ast, &error));
+
+  OptimizeStats stats;
+  assert(optimize_ast(&ast, &tokens, 0, &stats));
+  assert(stats.node_count_after == ast_get_node_count(&ast));
+  char out[512];
+  size_t length = 0;
+  write_node(&ast, &tokens, ast_get_root(&ast), out, &length);
+  out[length] = '\0';
+  if (strcmp(out, expected) != 0) {
+    fprintf(stderr, "\"%s\" optimized to %s, expected %s\n", input, out,
+            expected);
+  }
+  assert(strcmp(out, expected) == 0);
+
+  ast_destroy(&ast);
+  token_list_distroy(&tokens);
+  return stats;
+}
+
+static void test_folding(void) {
+  OptimizeStats stats = run_optimize_test("(2*3.5)^2", "49");
+  assert(stats.node_count_before == 5 && stats.node_count_after == 1);
+  assert(stats.eliminated_nodes == 4 && stats.folded_nodes == 2);
+
+  run_optimize_test("x + 2 * 3", "(+ x 6)");
+  run_optimize_test("-(1 - 3) % 3", "2");
+  run_optimize_test("sqrt(16) * x", "(* 4 x)");
+  run_optimize_test("x * sqrt(y)", "(* x (sqrt y))");
+  run_optimize_test("1 / 0", "inf");
+}
+
+static void test_identities(void) {
+  OptimizeStats stats = run_optimize_test("x * 1 + 1 * y", "(+ x y)");
+  assert(stats.identities == 2 && stats.eliminated_nodes == 4);
+
+  run_optimize_test("x / (3 - 2)", "x");
+  run_optimize_test("x - 0", "x");
+  run_optimize_test("x + -0", "x");
+  run_optimize_test("-0 + x", "x");
+  run_optimize_test("x ^ 1", "x");
+  run_optimize_test("(x + y) ^ 0", "1");
+  run_optimize_test("1 ^ x", "1");
+  run_optimize_test("--x", "x");
+  run_optimize_test("---x", "(neg x)");
+  // -0 + 0 is +0, 1 / x and 0 - x flip the sign of x
+  run_optimize_test("x + 0", "(+ x 0)");
+  run_optimize_test("0 + x", "(+ 0 x)");
+  run_optimize_test("1 / x", "(/ 1 x)");
+  run_optimize_test("0 - x", "(- 0 x)");
+  run_optimize_test("x * 0", "(* x 0)");
+}
+
+static void test_power_chains(void) {
+  OptimizeStats stats = run_optimize_test("x ^ 3", "(* (* x x) x)");
+  assert(stats.expanded_powers == 1 && stats.node_count_after == 5);
+  assert(stats.eliminated_nodes == 2 && stats.expanded_nodes == 4);
+  run_optimize_test("x ** -2", "(^ x -2)");
+  run_optimize_test("y ^ (1 + 1)", "(* y y)");
+  run_optimize_test("x ^ 0.5", "(^ x 0.5)");
+  run_optimize_test("x ^ 9", "(^ x 9)");
+  run_optimize_test("(x + 1) ^ 2", "(^ (+ x 1) 2)");
+}
+
+// calls of unknown functions must still fail to compile
+static void test_keeps_unknown_calls(void) {
+  run_optimize_test("nope(2) ^ 0", "(^ (nope 2) 0)");
+  run_optimize_test("1 ^ nope(x)", "(^ 1 (nope x))");
+
+  TokenList tokens = lex_string("nope(2) * 1 + 0 * 3");
+  Bytecode bytecode;
+  assert(bytecode_init(&bytecode));
+  CompileError error;
+  OptimizeStats stats;
+  assert(!compile_token_list_optimized(&tokens, &bytecode, &error, &stats));
+  assert(error.type == COMPILE_UNKNOWN_FUNCTION && error.token_index == 0);
+  bytecode_destroy(&bytecode);
+  token_list_distroy(&tokens);
+}
+
+static double evaluate(const Bytecode *bytecode, const double *values) {
+  double vars[4];
+  for (size_t slot = 0; slot < bytecode_get_variable_count(bytecode); slot++) {
+    vars[slot] = values[bytecode_get_variable_name(bytecode, slot)[1] - '0'];
+  }
+  return vm_evaluate(bytecode, vars);
+}
+
+// random expressions over the variables v0..v3 that are rich in the constants
+// the optimizer looks for
+static const char *const random_operators[] = {" + ", " - ", " * ", " / ",
+                                               " % ", " ^ ", "**"};
+static const char *const random_variables[] = {"v0", "v1", "v2", "v3"};
+static const char *const random_functions[] = {"sqrt"};
+static const char *const random_constants[] = {"0",  "1",  "2",   "3",   "-0",
+                                               "-1", "-2", "0.5", "2.5", "9"};
+static const ExpressionShape random_shape = {
+    random_operators, TEST_COUNT_OF(random_operators),
+    random_variables, TEST_COUNT_OF(random_variables),
+    random_functions, TEST_COUNT_OF(random_functions),
+    random_constants, TEST_COUNT_OF(random_constants),
+    .fractions = 100, .negates = true, .mixes_brackets = false};
+
+// optimized and plain bytecode agree bit for bit, up to the rounding of
+// expanded powers
+static void test_matches_unoptimized(void) {
+  srand(4321);
+  for (int i = 0; i < 5000; i++) {
+    char input[4096];
+    size_t length = generate_expression(&random_shape, input, 0, 6);
+    input[length] = '\0';
+
+    TokenList tokens = lex_string(input);
+    Bytecode plain;
+    Bytecode optimized;
+    assert(bytecode_init(&plain) && bytecode_init(&optimized));
+    CompileError error;
+    OptimizeStats stats;
+    assert(compile_token_list(&tokens, &plain, &error));
+    assert(compile_token_list_optimized(&tokens, &optimized, &error, &stats));
+    assert(stats.node_count_before - stats.eliminated_nodes +
+               stats.expanded_nodes ==
+           stats.node_count_after);
+    assert(bytecode_get_instruction_count(&optimized) <=
+               bytecode_get_instruction_count(&plain) ||
+           stats.expanded_powers > 0);
+
+    double values[4];
+    for (int v = 0; v < 4; v++) {
+      values[v] = (double)(rand() % 2000) / 100.0 - 10.0;
+    }
+    double expected = evaluate(&plain, values);
+    double actual = evaluate(&optimized, values);
+    bool same = isnan(expected) ? isnan(actual)
+                : stats.expanded_powers > 0
+                    ? actual == expected ||
+                          fabs(actual - expected) <= 1e-12 * fabs(expected)
+                    : memcmp(&actual, &expected, sizeof(double)) == 0;
+    if (!same) {
+      fprintf(stderr, "\"%s\" evaluated to %.17g optimized, %.17g plain\n",
+              input, actual, expected);
+    }
+    assert(same);
+
+    bytecode_destroy(&optimized);
+    bytecode_destroy(&plain);
+    token_list_distroy(&tokens);
+  }
+}
+
+int main(void) {
+  test_folding();
+  test_identities();
+  test_power_chains();
+  test_keeps_unknown_calls();
+  test_matches_unoptimized();
+
+  printf("All optimizer tests passed\n");
+  return 0;
+}
@@ -0,0 +1,268 @@
+#include "parallel.h"
+#include "arena.h"
+#include "char_reader.h"
+#include "columns.h"
+#include "lexer.h"
+#include "parser.h"
+#include "vm.h"
+#include <assert.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// what one thread reuses from chunk to chunk
+typedef struct ParallelScratch {
+  CharReader unused_reader;
+  Lexer lexer;
+  TokenBatch batch;
+  Ast ast;
+  Bytecode bytecode;
+  Arena arena; // the variable values of one expression
+} ParallelScratch;
+
+typedef struct ParallelExpressions {
+  ParallelScratch *scratches;
+  const char *const *expressions;
+  const size_t *expression_lengths;
+  const char *const *names;
+  const double *values;
+  size_t name_count;
+  ParallelResult *results;
+} ParallelExpressions;
+
+static bool _parallel_scratch_init(ParallelScratch *scratch) {
+  char_reader_init(&scratch->unused_reader);
+  if (!lexer_init(&scratch->lexer, &scratch->unused_reader)) {
+    return false;
+  }
+  if (!token_batch_init(&scratch->batch)) {
+    lexer_destroy(&scratch->lexer);
+    return false;
+  }
+  if (!ast_init(&scratch->ast)) {
+    token_batch_destroy(&scratch->batch);
+    lexer_destroy(&scratch->lexer);
+    return false;
+  }
+  if (!bytecode_init(&scratch->bytecode)) {
+    ast_destroy(&scratch->ast);
+    token_batch_destroy(&scratch->batch);
+    lexer_destroy(&scratch->lexer);
+    return false;
+  }
+  if (!arena_init(&scratch->arena, 1024)) {
+    bytecode_destroy(&scratch->bytecode);
+    ast_destroy(&scratch->ast);
+    token_batch_destroy(&scratch->batch);
+    lexer_destroy(&scratch->lexer);
+    return false;
+  }
+  return true;
+}
+
+static void _parallel_scratch_destroy(ParallelScratch *scratch) {
+  arena_destroy(&scratch->arena);
+  bytecode_destroy(&scratch->bytecode);
+  ast_destroy(&scratch->ast);
+  token_batch_destroy(&scratch->batch);
+  lexer_destroy(&scratch->lexer);
+  char_reader_destroy(&scratch->unused_reader);
+}
+
+// the value of every variable of bytecode, NULL when out of memory
+static const double *_parallel_bind(const ParallelExpressions *job,
+                                    const Bytecode *bytecode, Arena *arena) {
+  size_t variable_count = bytecode_get_variable_count(bytecode);
+  double *vars = arena_alloc(arena, (variable_count + 1) * sizeof(double));
+  if (vars == NULL) {
+    return NULL;
+  }
+
+  for (size_t slot = 0; slot < variable_count; slot++) {
+    const char *name = bytecode_get_variable_name(bytecode, slot);
+    vars[slot] = NAN;
+    for (size_t i = 0; i < job->name_count; i++) {
+      if (strcmp(job->names[i], name) == 0) {
+        vars[slot] = job->values[i];
+        break;
+      }
+    }
+  }
+  return vars;
+}
+
+static void _parallel_evaluate_expression(const ParallelExpressions *job,
+                                          ParallelScratch *scratch,
+                                          size_t expression,
+                                          ParallelResult *result) {
+  TokenList tokens = token_batch_get_token_list(&scratch->batch);
+  size_t first_token =
+      token_batch_get_expression_start(&scratch->batch, expression);
+  CompileError *error = &result->error;
+  result->value = NAN;
+
+  if (!parse_token_batch_expression(&scratch->batch, expression,
+                                    &scratch->ast, &error->parse_error)) {
+    error->parse_error.token_index -= first_token;
+    error->type = COMPILE_PARSE_FAILED;
+    error->token_index = error->parse_error.token_index;
+    return;
+  }
+  if (!compile_ast(&scratch->ast, &tokens, first_token, &scratch->bytecode,
+                   error)) {
+    error->token_index -= first_token;
+    return;
+  }
+
+  const double *vars = _parallel_bind(job, &scratch->bytecode, &scratch->arena);
+  if (vars == NULL) {
+    error->type = COMPILE_OUT_OF_MEMORY;
+    error->token_index = 0;
+    return;
+  }
+  error->type = COMPILE_OK;
+  error->token_index = 0;
+  result->value = vm_evaluate(&scratch->bytecode, vars);
+  arena_reset(&scratch->arena);
+}
+
+static void _parallel_expressions_task(void *context, size_t worker,
+                                       size_t begin, size_t end) {
+  const ParallelExpressions *job = context;
+  ParallelScratch *scratch = &job->scratches[worker];
+  lex_batch(&scratch->lexer, job->expressions + begin,
+            job->expression_lengths + begin, end - begin, &scratch->batch);
+  for (size_t i = begin; i < end; i++) {
+    _parallel_evaluate_expression(job, scratch, i - begin, &job->results[i]);
+  }
+}
+
+bool parallel_evaluate_expressions(ThreadPool *pool,
+                                   const char *const *expressions,
+                                   const size_t *expression_lengths,
+                                   size_t count, const char *const *names,
+                                   const double *values, size_t name_count,
+                                   ParallelResult *results) {
+  assert(pool && "parallel_evaluate_expressions(): arg pool was null");
+  assert((expressions || count == 0) &&
+         "parallel_evaluate_expressions(): arg expressions was null");
+  assert((expression_lengths || count == 0) &&
+         "parallel_evaluate_expressions(): arg expression_lengths was null");
+  assert(((names && values) || name_count == 0) &&
+         "parallel_evaluate_expressions(): arg names or values was null");
+  assert((results || count == 0) &&
+         "parallel_evaluate_expressions(): arg results was null");
+  size_t thread_count = thread_pool_get_thread_count(pool);
+  ParallelScratch *scratches = malloc(thread_count * sizeof(ParallelScratch));
+  if (scratches == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < thread_count; i++) {
+    if (!_parallel_scratch_init(&scratches[i])) {
+      while (i-- > 0) {
+        _parallel_scratch_destroy(&scratches[i]);
+      }
+      free(scratches);
+      return false;
+    }
+  }
+
+  ParallelExpressions job = {
+      .scratches = scratches,
+      .expressions = expressions,
+      .expression_lengths = expression_lengths,
+      .names = names,
+      .values = values,
+      .name_count = name_count,
+      .results = results,
+  };
+  thread_pool_run(pool, count, PARALLEL_EXPRESSION_GRAIN,
+                  _parallel_expressions_task, &job);
+
+  for (size_t i = 0; i < thread_count; i++) {
+    _parallel_scratch_destroy(&scratches[i]);
+  }
+  free(scratches);
+  return true;
+}
+
+typedef struct ParallelRows {
+  const Bytecode *bytecode;
+  const double *vars;
+  const double **cols;
+  const double **worker_cols; // variable_count pointers per thread
+  size_t variable_count;
+  double *out;
+  atomic_bool failed;
+} ParallelRows;
+
+static void _parallel_rows_task(void *context, size_t worker, size_t begin,
+                                size_t end) {
+  (void)worker;
+  ParallelRows *job = context;
+  const double *vars = job->vars;
+  if (job->variable_count > 0) {
+    vars += begin * job->variable_count;
+  }
+  vm_evaluate_rows(job->bytecode, vars, end - begin, job->out + begin);
+}
+
+void parallel_evaluate_rows(ThreadPool *pool, const Bytecode *bytecode,
+                            const double *vars, size_t row_count,
+                            double *out) {
+  assert(pool && "parallel_evaluate_rows(): arg pool was null");
+  assert(bytecode && "parallel_evaluate_rows(): arg bytecode was null");
+  assert((out || row_count == 0) &&
+         "parallel_evaluate_rows(): arg out was null");
+  ParallelRows job = {
+      .bytecode = bytecode,
+      .vars = vars,
+      .variable_count = bytecode_get_variable_count(bytecode),
+      .out = out,
+  };
+  thread_pool_run(pool, row_count, PARALLEL_ROW_GRAIN, _parallel_rows_task,
+                  &job);
+}
+
+static void _parallel_columns_task(void *context, size_t worker, size_t begin,
+                                   size_t end) {
+  ParallelRows *job = context;
+  const double **cols = NULL;
+  if (job->variable_count > 0) {
+    cols = job->worker_cols + worker * job->variable_count;
+    for (size_t i = 0; i < job->variable_count; i++) {
+      cols[i] = job->cols[i] + begin;
+    }
+  }
+  if (!eval_columns(job->bytecode, cols, end - begin, job->out + begin)) {
+    atomic_store_explicit(&job->failed, true, memory_order_relaxed);
+  }
+}
+
+bool parallel_eval_columns(ThreadPool *pool, const Bytecode *compiled,
+                           const double *cols[], size_t nrows, double *out) {
+  assert(pool && "parallel_eval_columns(): arg pool was null");
+  assert(compiled && "parallel_eval_columns(): arg compiled was null");
+  assert((out || nrows == 0) && "parallel_eval_columns(): arg out was null");
+  size_t variable_count = bytecode_get_variable_count(compiled);
+  ParallelRows job = {
+      .bytecode = compiled,
+      .cols = cols,
+      .variable_count = variable_count,
+      .out = out,
+  };
+  atomic_init(&job.failed, false);
+  if (variable_count > 0) {
+    job.worker_cols = malloc(thread_pool_get_thread_count(pool) *
+                             variable_count * sizeof(const double *));
+    if (job.worker_cols == NULL) {
+      return false;
+    }
+  }
+
+  thread_pool_run(pool, nrows, PARALLEL_ROW_GRAIN, _parallel_columns_task,
+                  &job);
+  free(job.worker_cols);
+  return !atomic_load_explicit(&job.failed, memory_order_relaxed);
+}
@@ -0,0 +1,34 @@
+#ifndef PARALLEL
+#define PARALLEL
+#include "bytecode.h"
+#include "compiler.h"
+#include "thread_pool.h"
+
+// expressions lexed, compiled and evaluated by one thread at a time
+#define PARALLEL_EXPRESSION_GRAIN 64
+// rows evaluated by one thread at a time, a multiple of COLUMNS_BLOCK_ROWS
+#define PARALLEL_ROW_GRAIN 4096
+
+typedef struct ParallelResult {
+  double value;       // NAN when the expression did not compile
+  CompileError error; // token_index is relative to the expression
+} ParallelResult;
+
+// Lexes, compiles and evaluates every expressions[i], expression_lengths[i]
+// chars borrowed like char_reader_add_view, into results[i]. A variable
+// called names[j] has the value values[j], any other variable is NAN. Returns
+// false when out of memory before starting, results is untouched then.
+bool parallel_evaluate_expressions(ThreadPool *pool,
+                                   const char *const *expressions,
+                                   const size_t *expression_lengths,
+                                   size_t count, const char *const *names,
+                                   const double *values, size_t name_count,
+                                   ParallelResult *results);
+// vm_evaluate_rows split across the pool
+void parallel_evaluate_rows(ThreadPool *pool, const Bytecode *bytecode,
+                            const double *vars, size_t row_count, double *out);
+// eval_columns split across the pool, false when out of memory
+bool parallel_eval_columns(ThreadPool *pool, const Bytecode *compiled,
+                           const double *cols[], size_t nrows, double *out);
+
+#endif
@@ -0,0 +1,157 @@
+#include "bytecode.h"
+#include "char_reader.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "parallel.h"
+#include "thread_pool.h"
+#include "token_list.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define EXPRESSION_COUNT 400000
+#define ROW_COUNT (1 << 22)
+
+static const char *const templates[] = {
+    "(x12*3.25+y_7)/(4e-2-z)^2 + %d",
+    "sqrt(abs(price * quantity - %d.5)) %% 7",
+    "{a - b} * [c + d] / (e + %d) ** 0.5",
+    "sin(x) * cos(y) + tan(z / %d)",
+};
+static const char *const names[] = {"x12", "y_7", "z", "price", "quantity",
+                                    "a",   "b",   "c", "d",     "e",
+                                    "x",   "y"};
+static const double values[] = {1.5, 2, 0.25, 19.99, 3, 4, 5, 6, 7, 8, 0.5, 1};
+
+static double now_seconds(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void *checked_malloc(size_t size) {
+  void *ptr = malloc(size);
+  if (ptr == NULL) {
+    fprintf(stderr, "checked_malloc(): out of memory\n");
+    exit(1);
+  }
+  return ptr;
+}
+
+// the time of the fastest of three runs
+static double bench_expressions(ThreadPool *pool, const char **expressions,
+                                const size_t *lengths,
+                                ParallelResult *results) {
+  double best = 1e300;
+  for (int repeat = 0; repeat < 3; repeat++) {
+    double start = now_seconds();
+    if (!parallel_evaluate_expressions(pool, expressions, lengths,
+                                       EXPRESSION_COUNT, names, values,
+                                       sizeof(names) / sizeof(names[0]),
+                                       results)) {
+      fprintf(stderr, "bench_expressions(): out of memory\n");
+      exit(1);
+    }
+    double elapsed = now_seconds() - start;
+    best = elapsed < best ? elapsed : best;
+  }
+  return best;
+}
+
+static double bench_columns(ThreadPool *pool, const Bytecode *bytecode,
+                            const double **cols, double *out) {
+  double best = 1e300;
+  for (int repeat = 0; repeat < 3; repeat++) {
+    double start = now_seconds();
+    if (!parallel_eval_columns(pool, bytecode, cols, ROW_COUNT, out)) {
+      fprintf(stderr, "bench_columns(): out of memory\n");
+      exit(1);
+    }
+    double elapsed = now_seconds() - start;
+    best = elapsed < best ? elapsed : best;
+  }
+  return best;
+}
+
+// usage: parallel_bench.exe [max threads], the default is every cpu
+int main(int argc, const char *argv[]) {
+  size_t max_threads = thread_pool_default_thread_count();
+  if (argc > 1) {
+    max_threads = (size_t)strtoul(argv[1], NULL, 10);
+    max_threads = max_threads > 0 ? max_threads : 1;
+  }
+
+  char (*inputs)[64] = checked_malloc(EXPRESSION_COUNT * sizeof(*inputs));
+  const char **expressions = checked_malloc(EXPRESSION_COUNT * sizeof(char *));
+  size_t *lengths = checked_malloc(EXPRESSION_COUNT * sizeof(size_t));
+  ParallelResult *results =
+      checked_malloc(EXPRESSION_COUNT * sizeof(ParallelResult));
+  for (size_t i = 0; i < EXPRESSION_COUNT; i++) {
+    lengths[i] = (size_t)snprintf(inputs[i], sizeof(inputs[i]),
+                                  templates[i % 4], (int)(i % 1000));
+    expressions[i] = inputs[i];
+  }
+
+  CharReader reader;
+  char_reader_init(&reader);
+  Bytecode bytecode;
+  CompileError error;
+  if (!char_reader_add(&reader, "x * y - z / 3 + sqrt(abs(x)) * 0.5") ||
+      !bytecode_init(&bytecode)) {
+    fprintf(stderr, "main(): out of memory\n");
+    return 1;
+  }
+  TokenList tokens = lex_char_reader(&reader);
+  if (!compile_token_list(&tokens, &bytecode, &error)) {
+    fprintf(stderr, "main(): the column expression did not compile\n");
+    return 1;
+  }
+  double *columns = checked_malloc(3 * (size_t)ROW_COUNT * sizeof(double));
+  double *out = checked_malloc((size_t)ROW_COUNT * sizeof(double));
+  for (size_t i = 0; i < 3 * (size_t)ROW_COUNT; i++) {
+    columns[i] = (double)(i % 1013) / 8.0 - 60;
+  }
+  const double *cols[] = {columns, columns + ROW_COUNT,
+                          columns + 2 * (size_t)ROW_COUNT};
+
+  printf("%8s %14s %8s %14s %8s %8s\n", "threads", "exprs/s", "speedup",
+         "rows/s", "speedup", "steals");
+  double expressions_base = 0;
+  double columns_base = 0;
+  for (size_t threads = 1;; threads *= 2) {
+    threads = threads < max_threads ? threads : max_threads;
+    ThreadPool pool;
+    if (!thread_pool_init(&pool, threads)) {
+      fprintf(stderr, "main(): could not start %zu threads\n", threads);
+      return 1;
+    }
+
+    double expressions_time =
+        bench_expressions(&pool, expressions, lengths, results);
+    double columns_time = bench_columns(&pool, &bytecode, cols, out);
+    if (threads == 1) {
+      expressions_base = expressions_time;
+      columns_base = columns_time;
+    }
+    printf("%8zu %14.0f %7.2fx %14.0f %7.2fx %8zu\n", threads,
+           EXPRESSION_COUNT / expressions_time,
+           expressions_base / expressions_time, ROW_COUNT / columns_time,
+           columns_base / columns_time, thread_pool_get_steal_count(&pool));
+    thread_pool_destroy(&pool);
+    if (threads == max_threads) {
+      break;
+    }
+  }
+
+  free(columns);
+  free(out);
+  bytecode_destroy(&bytecode);
+  token_list_distroy(&tokens);
+  char_reader_destroy(&reader);
+  free(inputs);
+  free(expressions);
+  free(lengths);
+  free(results);
+  return 0;
+}
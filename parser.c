@@ -0,0 +1,274 @@
+#include "parser.h"
+#include "number.h"
+#include <assert.h>
+#include <string.h>
+
+// the tokens are read from tokens or, when it is set, from columns
+typedef struct Parser {
+  TokenList *tokens;
+  const TokenColumns *columns;
+  size_t start; // first token of the expression
+  size_t position;
+  size_t depth;
+  Ast *ast;
+  ParseError *error;
+} Parser;
+
+#define PARSER_UNARY_PRECEDENCE 3
+
+static const struct {
+  uint8_t precedence; // 0 for tokens that are not binary operators
+  bool is_right_associative;
+  AstNodeType type;
+} _parser_binary_operators[EOI_TOKEN + 1] = {
+    [PLUS_TOKEN] = {1, false, AST_ADD},
+    [MINUS_TOKEN] = {1, false, AST_SUBTRACT},
+    [MULTIPLY_TOKEN] = {2, false, AST_MULTIPLY},
+    [DIVIDE_TOKEN] = {2, false, AST_DIVIDE},
+    [MODULO_TOKEN] = {2, false, AST_MODULO},
+    [POWER_TOKEN] = {4, true, AST_POWER},
+};
+
+static const TokenType _parser_closing_brackets[EOI_TOKEN + 1] = {
+    [LPAREN_TOKEN] = RPAREN_TOKEN,
+    [LBRACKET_TOKEN] = RBRACKET_TOKEN,
+    [LBRACE_TOKEN] = RBRACE_TOKEN,
+};
+
+// most lookups only need the type, with columns that reads a single byte
+static inline TokenType _parser_peek(Parser *this) {
+  size_t index = this->start + this->position;
+  return this->columns != NULL
+             ? (TokenType)this->columns->_inner_types[index]
+             : this->tokens->_inner_token_list[index].type;
+}
+
+static double _parser_get_number(Parser *this, size_t position) {
+  size_t index = this->start + position;
+  return this->columns != NULL ? this->columns->_inner_numbers[index]
+                               : this->tokens->_inner_token_list[index].number;
+}
+
+static Lexeme _parser_get_lexeme(Parser *this, size_t position) {
+  size_t index = this->start + position;
+  return this->columns != NULL
+             ? token_columns_get_lexeme(this->columns, index)
+             : token_list_get_lexeme(this->tokens,
+                                     this->tokens->_inner_token_list[index]);
+}
+
+// never moves past the EOI_TOKEN, so peeking always stays in bounds
+static inline void _parser_advance(Parser *this) {
+  assert(_parser_peek(this) != EOI_TOKEN &&
+         "_parser_advance(): advanced past the end of the expression");
+  this->position++;
+}
+
+static bool _parser_fail(Parser *this, ParseErrorType type) {
+  this->error->type = type;
+  this->error->token_index = this->start + this->position;
+  return false;
+}
+
+static bool _parser_add_node(Parser *this, AstNode node, uint32_t *index) {
+  if (!ast_add_node(this->ast, node, index)) {
+    return _parser_fail(this, PARSE_OUT_OF_MEMORY);
+  }
+  return true;
+}
+
+static bool _parser_is_closing_bracket(TokenType type) {
+  return type == RPAREN_TOKEN || type == RBRACKET_TOKEN ||
+         type == RBRACE_TOKEN || type == EOI_TOKEN;
+}
+
+static bool _parser_expect(Parser *this, TokenType type) {
+  TokenType found = _parser_peek(this);
+  if (found == type) {
+    _parser_advance(this);
+    return true;
+  }
+  return _parser_fail(this, _parser_is_closing_bracket(found)
+                                ? PARSE_UNMATCHED_BRACKET
+                                : PARSE_UNEXPECTED_TOKEN);
+}
+
+// NUMBER [EXPONENT [+-] NUMBER], the lexer splits 1e-3 into four tokens and
+// converted the mantissa already. With an exponent the mantissa digits are
+// converted again together with it, scaling the rounded mantissa would round
+// twice.
+static bool _parser_parse_number(Parser *this, uint32_t *index) {
+  AstNode node = {.type = AST_NUMBER, .token_index = (uint32_t)this->position};
+  size_t mantissa = this->position;
+  node.number = _parser_get_number(this, mantissa);
+  _parser_advance(this);
+
+  if (_parser_peek(this) == EXPONENT_TOKEN) {
+    _parser_advance(this);
+    bool is_negative = false;
+    TokenType sign_type = _parser_peek(this);
+    if (sign_type == PLUS_TOKEN || sign_type == MINUS_TOKEN) {
+      is_negative = sign_type == MINUS_TOKEN;
+      _parser_advance(this);
+    }
+
+    Lexeme digits_lexeme = _parser_get_lexeme(this, this->position);
+    if (_parser_peek(this) != NUMBER_TOKEN ||
+        memchr(digits_lexeme.chars, '.', digits_lexeme.length) != NULL ||
+        memchr(digits_lexeme.chars, ',', digits_lexeme.length) != NULL) {
+      return _parser_fail(this, PARSE_INVALID_NUMBER);
+    }
+    double digits = _parser_get_number(this, this->position);
+    int64_t exponent = digits < (double)NUMBER_MAX_EXPONENT
+                           ? (int64_t)digits
+                           : NUMBER_MAX_EXPONENT;
+    Lexeme mantissa_lexeme = _parser_get_lexeme(this, mantissa);
+    node.number = number_parse(mantissa_lexeme.chars, mantissa_lexeme.length,
+                               is_negative ? -exponent : exponent);
+    _parser_advance(this);
+  }
+
+  return _parser_add_node(this, node, index);
+}
+
+static bool _parser_parse_expression(Parser *this, int min_precedence,
+                                     uint32_t *index);
+
+static bool _parser_parse_operand(Parser *this, uint32_t *index) {
+  TokenType type = _parser_peek(this);
+  uint32_t token_index = (uint32_t)this->position;
+  AstNode node = {.token_index = token_index};
+
+  switch (type) {
+  case NUMBER_TOKEN:
+    return _parser_parse_number(this, index);
+  case IDENTIFIER_TOKEN:
+    _parser_advance(this);
+    if (_parser_peek(this) != LPAREN_TOKEN) {
+      node.type = AST_VARIABLE;
+      return _parser_add_node(this, node, index);
+    }
+
+    _parser_advance(this);
+    node.type = AST_CALL;
+    return _parser_parse_expression(this, 1, &node.operand) &&
+           _parser_expect(this, RPAREN_TOKEN) &&
+           _parser_add_node(this, node, index);
+  case MINUS_TOKEN:
+    _parser_advance(this);
+    node.type = AST_NEGATE;
+    return _parser_parse_expression(this, PARSER_UNARY_PRECEDENCE,
+                                    &node.operand) &&
+           _parser_add_node(this, node, index);
+  case LPAREN_TOKEN:
+  case LBRACKET_TOKEN:
+  case LBRACE_TOKEN:
+    _parser_advance(this);
+    return _parser_parse_expression(this, 1, index) &&
+           _parser_expect(this, _parser_closing_brackets[type]);
+  default:
+    return _parser_fail(this, PARSE_UNEXPECTED_TOKEN);
+  }
+}
+
+// precedence climbing, parses operators that bind at least as tight as
+// min_precedence
+static bool _parser_parse_expression(Parser *this, int min_precedence,
+                                     uint32_t *index) {
+  if (++this->depth > PARSE_MAX_DEPTH) {
+    return _parser_fail(this, PARSE_TOO_DEEP);
+  }
+
+  uint32_t lhs;
+  if (!_parser_parse_operand(this, &lhs)) {
+    return false;
+  }
+
+  for (;;) {
+    TokenType type = _parser_peek(this);
+    int precedence = _parser_binary_operators[type].precedence;
+    if (precedence == 0 || precedence < min_precedence) {
+      break;
+    }
+
+    AstNode node = {.type = _parser_binary_operators[type].type,
+                    .token_index = (uint32_t)this->position};
+    _parser_advance(this);
+    int rhs_precedence =
+        _parser_binary_operators[type].is_right_associative
+            ? precedence
+            : precedence + 1;
+    node.binary.lhs = lhs;
+    if (!_parser_parse_expression(this, rhs_precedence, &node.binary.rhs) ||
+        !_parser_add_node(this, node, &lhs)) {
+      return false;
+    }
+  }
+
+  this->depth--;
+  *index = lhs;
+  return true;
+}
+
+static bool _parser_parse(TokenList *tokens, const TokenColumns *columns,
+                          size_t start, size_t count, Ast *ast,
+                          ParseError *error) {
+  Parser parser = {.tokens = tokens,
+                   .columns = columns,
+                   .start = start,
+                   .position = 0,
+                   .depth = 0,
+                   .ast = ast,
+                   .error = error};
+  ast_clear(ast);
+  error->type = PARSE_OK;
+  error->token_index = start;
+
+  // token indices of the nodes are 32 bits
+  if (count > AST_MAX_NODE_COUNT) {
+    return _parser_fail(&parser, PARSE_OUT_OF_MEMORY);
+  }
+
+  uint32_t root;
+  bool parsed = _parser_parse_expression(&parser, 1, &root);
+  if (parsed && _parser_peek(&parser) != EOI_TOKEN) {
+    parsed = _parser_fail(&parser,
+                          _parser_is_closing_bracket(_parser_peek(&parser))
+                              ? PARSE_UNMATCHED_BRACKET
+                              : PARSE_UNEXPECTED_TOKEN);
+  }
+
+  if (!parsed) {
+    ast_clear(ast);
+  }
+  return parsed;
+}
+
+bool parse_token_list(TokenList *tokens, Ast *ast, ParseError *error) {
+  assert(tokens && "parse_token_list(): arg tokens was null");
+  assert(ast && "parse_token_list(): arg ast was null");
+  assert(error && "parse_token_list(): arg error was null");
+  return _parser_parse(tokens, NULL, 0, token_list_get_count(tokens), ast,
+                       error);
+}
+
+bool parse_token_columns(const TokenColumns *columns, Ast *ast,
+                         ParseError *error) {
+  assert(columns && "parse_token_columns(): arg columns was null");
+  assert(ast && "parse_token_columns(): arg ast was null");
+  assert(error && "parse_token_columns(): arg error was null");
+  return _parser_parse(NULL, columns, 0, token_columns_get_count(columns), ast,
+                       error);
+}
+
+bool parse_token_batch_expression(TokenBatch *batch, size_t expression,
+                                  Ast *ast, ParseError *error) {
+  assert(batch && "parse_token_batch_expression(): arg batch was null");
+  assert(ast && "parse_token_batch_expression(): arg ast was null");
+  assert(error && "parse_token_batch_expression(): arg error was null");
+  TokenList tokens = token_batch_get_token_list(batch);
+  return _parser_parse(&tokens, NULL,
+                       token_batch_get_expression_start(batch, expression),
+                       token_batch_get_expression_token_count(batch, expression),
+                       ast, error);
+}
@@ -0,0 +1,42 @@
+#ifndef PARSER
+#define PARSER
+#include "ast.h"
+#include "token_list.h"
+
+// Operators from loosest to tightest binding:
+//   + -          left associative
+//   * / %        left associative
+//   unary -
+//   ^ **         right associative, 2^-x is 2^(-x) and -x^2 is -(x^2)
+// Operands are numbers (1.5 1e-3 .5), variables, calls of one argument
+// (name(expression)) and expressions in (), [] or {}.
+typedef enum ParseErrorType {
+  PARSE_OK,
+  PARSE_UNEXPECTED_TOKEN,  // the token can not start or continue the expression
+  PARSE_UNMATCHED_BRACKET, // a closing bracket of another kind, or none
+  PARSE_INVALID_NUMBER,    // an exponent without digits, like 1e+x
+  PARSE_TOO_DEEP,          // nested deeper than PARSE_MAX_DEPTH
+  PARSE_OUT_OF_MEMORY,
+} ParseErrorType;
+
+#define PARSE_MAX_DEPTH 1000
+
+typedef struct ParseError {
+  ParseErrorType type;
+  size_t token_index; // the token the error was found at
+} ParseError;
+
+// Replaces the nodes of ast with the expression that ends at the first
+// EOI_TOKEN of tokens. The token_index of every node is relative to the first
+// token of the expression, the tokens have to outlive the ast to look up
+// variable and call names. Returns false and fills error when the tokens are
+// not one valid expression, ast is left empty then.
+bool parse_token_list(TokenList *tokens, Ast *ast, ParseError *error);
+// parse_token_list over columns, the lexemes of the nodes are looked up with
+// token_columns_get_lexeme
+bool parse_token_columns(const TokenColumns *columns, Ast *ast,
+                         ParseError *error);
+bool parse_token_batch_expression(TokenBatch *batch, size_t expression,
+                                  Ast *ast, ParseError *error);
+
+#endif
@@ -0,0 +1,327 @@
+#include "ast.h"
+#include "char_reader.h"
+#include "lexer.h"
+#include "parser.h"
+#include "test_helpers.h"
+#include "token_list.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const node_names[AST_NODE_TYPE_COUNT] = {
+    [AST_NEGATE] = "neg",   [AST_ADD] = "+",    [AST_SUBTRACT] = "-",
+    [AST_MULTIPLY] = "*",   [AST_DIVIDE] = "/", [AST_MODULO] = "%",
+    [AST_POWER] = "^",      [AST_CALL] = "call"};
+
+// writes the subtree of index as an s-expression, "(+ 1 (* x 2))"
+static void write_node(const Ast *ast, TokenList *tokens, uint32_t index,
+                       char *out, size_t *length) {
+  const AstNode *node = ast_get_node(ast, index);
+  Lexeme name;
+  switch (node->type) {
+  case AST_NUMBER:
+    *length += (size_t)sprintf(out + *length, "%g", node->number);
+    return;
+  case AST_VARIABLE:
+    name = token_list_get_lexeme(
+        tokens, token_list_get_token_at(tokens, node->token_index));
+    *length += (size_t)sprintf(out + *length, "%.*s", (int)name.length,
+                               name.chars);
+    return;
+  case AST_NEGATE:
+  case AST_CALL:
+    assert(node->operand < index);
+    if (node->type == AST_CALL) {
+      name = token_list_get_lexeme(
+          tokens, token_list_get_token_at(tokens, node->token_index));
+      *length += (size_t)sprintf(out + *length, "(%.*s ", (int)name.length,
+                                 name.chars);
+    } else {
+      *length += (size_t)sprintf(out + *length, "(neg ");
+    }
+    write_node(ast, tokens, node->operand, out, length);
+    break;
+  default:
+    assert(ast_node_is_binary(node->type));
+    assert(node->binary.lhs < index && node->binary.rhs < index);
+    *length += (size_t)sprintf(out + *length, "(%s ", node_names[node->type]);
+    write_node(ast, tokens, node->binary.lhs, out, length);
+    out[(*length)++] = ' ';
+    write_node(ast, tokens, node->binary.rhs, out, length);
+    break;
+  }
+  out[(*length)++] = ')';
+  out[*length] = '\0';
+}
+
+static void run_parse_test(const char *input, const char *expected) {
+  TokenList tokens = lex_string(input);
+  Ast ast;
+  assert(ast_init(&ast));
+
+  ParseError error;
+  bool parsed = parse_token_list(&tokens, &ast, &error);
+  if (!parsed) {
+    fprintf(stderr, "failed to parse \"%s\": error %d at token %zu\n", input,
+            (int)error.type, error.token_index);
+  }
+  assert(parsed && error.type == PARSE_OK);
+
+  char out[512];
+  size_t length = 0;
+  write_node(&ast, &tokens, ast_get_root(&ast), out, &length);
+  out[length] = '\0';
+  if (strcmp(out, expected) != 0) {
+    fprintf(stderr, "\"%s\" parsed as %s, expected %s\n", input, out,
+            expected);
+  }
+  assert(strcmp(out, expected) == 0);
+
+  ast_destroy(&ast);
+  token_list_distroy(&tokens);
+}
+
+static void run_parse_error_test(const char *input, ParseErrorType type,
+                                 size_t token_index) {
+  TokenList tokens = lex_string(input);
+  Ast ast;
+  assert(ast_init(&ast));
+
+  ParseError error;
+  assert(!parse_token_list(&tokens, &ast, &error));
+  assert(error.type == type);
+  assert(error.token_index == token_index);
+  assert(ast_get_node_count(&ast) == 0);
+
+  ast_destroy(&ast);
+  token_list_distroy(&tokens);
+}
+
+static void test_precedence(void) {
+  run_parse_test("1 + 2 * 3", "(+ 1 (* 2 3))");
+  run_parse_test("1 * 2 + 3", "(+ (* 1 2) 3)");
+  run_parse_test("a % b * c / d", "(/ (* (% a b) c) d)");
+  run_parse_test("x ^ 2 * 3", "(* (^ x 2) 3)");
+}
+
+static void test_left_associativity(void) {
+  run_parse_test("a - b - c", "(- (- a b) c)");
+  run_parse_test("a / b / c", "(/ (/ a b) c)");
+}
+
+static void test_power_is_right_associative(void) {
+  run_parse_test("a ^ b ^ c", "(^ a (^ b c))");
+  run_parse_test("a ** b ** c", "(^ a (^ b c))");
+  run_parse_test("a ** b ^ c", "(^ a (^ b c))");
+}
+
+static void test_unary_minus(void) {
+  run_parse_test("-x", "(neg x)");
+  run_parse_test("-x ^ 2", "(neg (^ x 2))");
+  run_parse_test("2 ^ -x", "(^ 2 (neg x))");
+  run_parse_test("-a * b", "(* (neg a) b)");
+  run_parse_test("a - -b", "(- a (neg b))");
+  run_parse_test("--a", "(neg (neg a))");
+}
+
+static void test_brackets(void) {
+  run_parse_test("(a + b) * c", "(* (+ a b) c)");
+  run_parse_test("[a - b] / {c + d}", "(/ (- a b) (+ c d))");
+  run_parse_test("({[x]})", "x");
+}
+
+static void test_calls(void) {
+  run_parse_test("sqrt(x + 1) * 2", "(* (sqrt (+ x 1)) 2)");
+  run_parse_test("f(g(x))", "(f (g x))");
+}
+
+static double parse_number(const char *input) {
+  TokenList tokens = lex_string(input);
+  Ast ast;
+  assert(ast_init(&ast));
+  ParseError error;
+  assert(parse_token_list(&tokens, &ast, &error));
+  const AstNode *root = ast_get_node(&ast, ast_get_root(&ast));
+  assert(root->type == AST_NUMBER);
+  double value = root->number;
+  ast_destroy(&ast);
+  token_list_distroy(&tokens);
+  return value;
+}
+
+static void test_numbers(void) {
+  run_parse_test("1.5", "1.5");
+  run_parse_test(".", "0");
+  run_parse_test("1e3", "1000");
+  run_parse_test("25e-1 + 1E+2", "(+ 2.5 100)");
+  run_parse_test("1,000 + 1,000.5e-3", "(+ 1000 1.0005)");
+  // the mantissa and the exponent are rounded once, together
+  assert(parse_number("0.1e1") == 1);
+  assert(parse_number("123456789012345678901e-20") == 1.23456789012345678901);
+  assert(parse_number("2.2250738585072011e-308") == 2.2250738585072011e-308);
+  assert(parse_number("1.7976931348623158e+308") == 1.7976931348623158e+308);
+  assert(parse_number("1e400") == HUGE_VAL);
+  assert(parse_number("1e99999999999999999999999") == HUGE_VAL);
+  assert(parse_number("1e-99999999999999999999999") == 0);
+}
+
+static void test_parse_errors(void) {
+  run_parse_error_test("", PARSE_UNEXPECTED_TOKEN, 0);
+  run_parse_error_test("1 +", PARSE_UNEXPECTED_TOKEN, 2);
+  run_parse_error_test("1 2", PARSE_UNEXPECTED_TOKEN, 1);
+  run_parse_error_test("1 $ 2", PARSE_UNEXPECTED_TOKEN, 1);
+  run_parse_error_test("(1]", PARSE_UNMATCHED_BRACKET, 2);
+  run_parse_error_test("(1", PARSE_UNMATCHED_BRACKET, 2);
+  run_parse_error_test("1)", PARSE_UNMATCHED_BRACKET, 1);
+  run_parse_error_test("f[x]", PARSE_UNEXPECTED_TOKEN, 1);
+  run_parse_error_test("1e+x", PARSE_INVALID_NUMBER, 3);
+  run_parse_error_test("1e2.5", PARSE_INVALID_NUMBER, 2);
+  run_parse_error_test("1e1,000", PARSE_INVALID_NUMBER, 2);
+  run_parse_error_test("2.5e2x", PARSE_UNEXPECTED_TOKEN, 3);
+}
+
+static void test_nesting_limit(void) {
+  size_t depth = PARSE_MAX_DEPTH + 10;
+  char *input = malloc(depth * 2 + 2);
+  assert(input);
+  memset(input, '(', depth);
+  input[depth] = 'x';
+  memset(input + depth + 1, ')', depth);
+  input[depth * 2 + 1] = '\0';
+
+  TokenList tokens = lex_string(input);
+  Ast ast;
+  assert(ast_init(&ast));
+  ParseError error;
+  assert(!parse_token_list(&tokens, &ast, &error));
+  assert(error.type == PARSE_TOO_DEEP);
+
+  ast_destroy(&ast);
+  token_list_distroy(&tokens);
+  free(input);
+}
+
+static void test_flat_layout(void) {
+  TokenList tokens = lex_string("a + b * c - d");
+  Ast ast;
+  assert(ast_init(&ast));
+  ParseError error;
+  assert(parse_token_list(&tokens, &ast, &error));
+
+  // postfix order: a b c * + d -
+  AstNodeType expected[] = {AST_VARIABLE, AST_VARIABLE, AST_VARIABLE,
+                            AST_MULTIPLY, AST_ADD,      AST_VARIABLE,
+                            AST_SUBTRACT};
+  assert(ast_get_node_count(&ast) == 7);
+  for (uint32_t i = 0; i < 7; i++) {
+    assert(ast_get_node(&ast, i)->type == expected[i]);
+  }
+  assert(ast_get_root(&ast) == 6);
+  assert(sizeof(AstNode) == 16);
+
+  ast_destroy(&ast);
+  token_list_distroy(&tokens);
+}
+
+// parses input from a TokenList and from TokenColumns, both give the same
+// nodes or the same error
+static void run_parse_columns_test(const char *input) {
+  TokenList tokens = lex_string(input);
+  CharReader reader;
+  char_reader_init(&reader);
+  assert(char_reader_add(&reader, input));
+  TokenColumns columns = lex_char_reader_columns(&reader);
+
+  Ast list_ast, columns_ast;
+  assert(ast_init(&list_ast) && ast_init(&columns_ast));
+  ParseError list_error, columns_error;
+  bool parsed = parse_token_list(&tokens, &list_ast, &list_error);
+  assert(parse_token_columns(&columns, &columns_ast, &columns_error) ==
+         parsed);
+  assert(columns_error.type == list_error.type);
+  assert(columns_error.token_index == list_error.token_index);
+
+  size_t count = ast_get_node_count(&list_ast);
+  assert(ast_get_node_count(&columns_ast) == count);
+  assert(count == 0 || ast_get_root(&columns_ast) == ast_get_root(&list_ast));
+  for (size_t i = 0; i < count; i++) {
+    const AstNode *expected = ast_get_node(&list_ast, (uint32_t)i);
+    const AstNode *node = ast_get_node(&columns_ast, (uint32_t)i);
+    assert(node->type == expected->type);
+    assert(node->token_index == expected->token_index);
+    if (node->type == AST_NUMBER) {
+      assert(node->number == expected->number ||
+             (isnan(node->number) && isnan(expected->number)));
+    }
+  }
+
+  ast_destroy(&columns_ast);
+  ast_destroy(&list_ast);
+  token_columns_destroy(&columns);
+  char_reader_destroy(&reader);
+  token_list_distroy(&tokens);
+}
+
+static void test_parse_token_columns(void) {
+  run_parse_columns_test("a + b * c - d");
+  run_parse_columns_test("-x ^ 2 ** -y % sin(z)");
+  run_parse_columns_test("[1.5e3 + {2E-2}] * .5");
+  run_parse_columns_test("1e400 + 2e+5");
+  run_parse_columns_test("(1 + 2]");
+  run_parse_columns_test("1e+x");
+  run_parse_columns_test("a b");
+  run_parse_columns_test("");
+}
+
+static void test_parse_batch_expressions(void) {
+  const char *inputs[] = {"x * 2", "(1", "-y ^ 2"};
+  size_t lengths[] = {5, 2, 6};
+  TokenBatch batch;
+  assert(token_batch_init(&batch));
+  CharReader reader;
+  char_reader_init(&reader);
+  Lexer lexer;
+  assert(lexer_init(&lexer, &reader));
+  lex_batch(&lexer, inputs, lengths, 3, &batch);
+
+  Ast ast;
+  assert(ast_init(&ast));
+  ParseError error;
+  assert(parse_token_batch_expression(&batch, 0, &ast, &error));
+  assert(ast_get_node_count(&ast) == 3);
+  assert(ast_get_node(&ast, 2)->type == AST_MULTIPLY);
+
+  // error token indices are indices into the batch
+  assert(!parse_token_batch_expression(&batch, 1, &ast, &error));
+  assert(error.type == PARSE_UNMATCHED_BRACKET && error.token_index == 6);
+
+  assert(parse_token_batch_expression(&batch, 2, &ast, &error));
+  const AstNode *root = ast_get_node(&ast, ast_get_root(&ast));
+  assert(root->type == AST_NEGATE);
+  assert(ast_get_node(&ast, root->operand)->type == AST_POWER);
+
+  ast_destroy(&ast);
+  lexer_destroy(&lexer);
+  char_reader_destroy(&reader);
+  token_batch_destroy(&batch);
+}
+
+int main(void) {
+  test_precedence();
+  test_left_associativity();
+  test_power_is_right_associative();
+  test_unary_minus();
+  test_brackets();
+  test_calls();
+  test_numbers();
+  test_parse_errors();
+  test_nesting_limit();
+  test_flat_layout();
+  test_parse_token_columns();
+  test_parse_batch_expressions();
+
+  printf("All parser tests passed\n");
+  return 0;
+}
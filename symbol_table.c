@@ -0,0 +1,163 @@
+#include "symbol_table.h"
+#include "hash.h"
+#include "list.h"
+#include "memory.h"
+#include <assert.h>
+#include <string.h>
+
+#define SYMBOL_TABLE_INITIAL_SLOTS 64
+#define SYMBOL_TABLE_ARENA_BLOCK 4096
+
+// FNV-1a with a final mix, names are short so the loop stays cheap
+static uint64_t _symbol_table_hash(const char *name, size_t length) {
+  uint64_t hash = hash_fnv1a(HASH_FNV1A_OFFSET, name, length);
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdu;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// returns the slot that holds the name or the empty slot where it belongs
+static size_t _symbol_table_probe(const SymbolTable *this, const char *name,
+                                  size_t length, uint64_t hash) {
+  size_t mask = this->_inner_slot_mask;
+  size_t slot = hash & mask;
+  for (uint32_t symbol; (symbol = this->_inner_slots[slot]) != SYMBOL_NONE;
+       slot = (slot + 1) & mask) {
+    Lexeme existing = this->_inner_names[symbol - 1];
+    if (this->_inner_hashes[symbol - 1] == hash && existing.length == length &&
+        memcmp(existing.chars, name, length) == 0) {
+      break;
+    }
+  }
+  return slot;
+}
+
+static uint32_t *_symbol_table_alloc_slots(size_t slot_count) {
+  uint32_t *slots = memory_alloc(slot_count * sizeof(uint32_t));
+  if (slots != NULL) {
+    memset(slots, 0, slot_count * sizeof(uint32_t));
+  }
+  return slots;
+}
+
+// doubles the slots once they are half full
+static bool _symbol_table_grow(SymbolTable *this) {
+  size_t count = list_get_count(this->_inner_names);
+  size_t slot_count = this->_inner_slot_mask + 1;
+  if ((count + 1) * 2 <= slot_count) {
+    return true;
+  }
+
+  uint32_t *slots = _symbol_table_alloc_slots(slot_count * 2);
+  if (slots == NULL) {
+    return false;
+  }
+  memory_free(this->_inner_slots);
+  this->_inner_slots = slots;
+  this->_inner_slot_mask = slot_count * 2 - 1;
+  for (size_t i = 0; i < count; i++) {
+    size_t slot = this->_inner_hashes[i] & this->_inner_slot_mask;
+    while (slots[slot] != SYMBOL_NONE) {
+      slot = (slot + 1) & this->_inner_slot_mask;
+    }
+    slots[slot] = (uint32_t)(i + 1);
+  }
+  return true;
+}
+
+bool symbol_table_init(SymbolTable *symbols) {
+  assert(symbols && "symbol_table_init(): arg symbols was null");
+  *symbols = (SymbolTable){0};
+  symbols->_inner_slots = _symbol_table_alloc_slots(SYMBOL_TABLE_INITIAL_SLOTS);
+  symbols->_inner_slot_mask = SYMBOL_TABLE_INITIAL_SLOTS - 1;
+  symbols->_inner_names = list(Lexeme, SYMBOL_TABLE_INITIAL_SLOTS / 2);
+  symbols->_inner_hashes = list(uint64_t, SYMBOL_TABLE_INITIAL_SLOTS / 2);
+  bool has_arena = arena_init(&symbols->_inner_arena, SYMBOL_TABLE_ARENA_BLOCK);
+  if (symbols->_inner_slots == NULL || symbols->_inner_names == NULL ||
+      symbols->_inner_hashes == NULL || !has_arena) {
+    symbol_table_destroy(symbols);
+    return false;
+  }
+  return true;
+}
+
+void symbol_table_destroy(SymbolTable *symbols) {
+  assert(symbols && "symbol_table_destroy(): arg symbols was null");
+  memory_free(symbols->_inner_slots);
+  if (symbols->_inner_names != NULL) {
+    list_free(symbols->_inner_names);
+  }
+  if (symbols->_inner_hashes != NULL) {
+    list_free(symbols->_inner_hashes);
+  }
+  arena_destroy(&symbols->_inner_arena);
+  *symbols = (SymbolTable){0};
+}
+
+bool symbol_table_intern(SymbolTable *symbols, const char *name,
+                         size_t length, uint32_t *symbol) {
+  assert(symbols && "symbol_table_intern(): arg symbols was null");
+  assert((name || length == 0) && "symbol_table_intern(): arg name was null");
+  assert(symbol && "symbol_table_intern(): arg symbol was null");
+  uint64_t hash = _symbol_table_hash(name, length);
+  size_t slot = _symbol_table_probe(symbols, name, length, hash);
+  if (symbols->_inner_slots[slot] != SYMBOL_NONE) {
+    *symbol = symbols->_inner_slots[slot];
+    return true;
+  }
+
+  size_t count = list_get_count(symbols->_inner_names);
+  if (count >= UINT32_MAX - 1 || !_symbol_table_grow(symbols)) {
+    return false;
+  }
+  char *chars = arena_alloc(&symbols->_inner_arena, length);
+  if (chars == NULL) {
+    return false;
+  }
+  memcpy(chars, name, length);
+
+  // a failure takes the name out again, the chars stay in the arena
+  Lexeme interned = {.chars = chars, .length = length};
+  Lexeme *names = list_add(symbols->_inner_names, &interned);
+  if (names == NULL) {
+    return false;
+  }
+  symbols->_inner_names = names;
+  uint64_t *hashes = list_add(symbols->_inner_hashes, &hash);
+  if (hashes == NULL) {
+    list_remove_range(symbols->_inner_names, count, 1);
+    return false;
+  }
+  symbols->_inner_hashes = hashes;
+
+  // growing moved the slots, probe again for the empty one
+  slot = _symbol_table_probe(symbols, name, length, hash);
+  symbols->_inner_slots[slot] = (uint32_t)(count + 1);
+  *symbol = (uint32_t)(count + 1);
+  return true;
+}
+
+bool symbol_table_find(const SymbolTable *symbols, const char *name,
+                       size_t length, uint32_t *symbol) {
+  assert(symbols && "symbol_table_find(): arg symbols was null");
+  assert((name || length == 0) && "symbol_table_find(): arg name was null");
+  assert(symbol && "symbol_table_find(): arg symbol was null");
+  size_t slot = _symbol_table_probe(symbols, name, length,
+                                    _symbol_table_hash(name, length));
+  *symbol = symbols->_inner_slots[slot];
+  return *symbol != SYMBOL_NONE;
+}
+
+size_t symbol_table_get_count(const SymbolTable *symbols) {
+  assert(symbols && "symbol_table_get_count(): arg symbols was null");
+  return list_get_count(symbols->_inner_names);
+}
+
+Lexeme symbol_table_get_name(const SymbolTable *symbols, uint32_t symbol) {
+  assert(symbols && "symbol_table_get_name(): arg symbols was null");
+  assert(symbol != SYMBOL_NONE &&
+         symbol <= list_get_count(symbols->_inner_names) &&
+         "symbol_table_get_name(): unknown symbol");
+  return symbols->_inner_names[symbol - 1];
+}
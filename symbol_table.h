@@ -0,0 +1,39 @@
+#ifndef SYMBOL_TABLE
+#define SYMBOL_TABLE
+#include "arena.h"
+#include "token_list.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// the symbol of tokens whose identifier was not interned
+#define SYMBOL_NONE 0u
+
+// Gives every distinct name a 32-bit symbol, counting up from 1, so names
+// can be compared and bound by their symbol instead of their chars. The
+// chars of each name are copied once into an arena where they never move,
+// so the names handed out stay valid until the table is destroyed. Lookups
+// probe an open addressing table keyed by a hash of the chars.
+typedef struct SymbolTable {
+  uint32_t *_inner_slots; // the symbol of each slot, SYMBOL_NONE when empty
+  size_t _inner_slot_mask; // slot count - 1
+  Lexeme *_inner_names;    // the name of symbol i is at i - 1
+  uint64_t *_inner_hashes; // kept to compare and to regrow without rehashing
+  Arena _inner_arena;      // the chars of the names
+} SymbolTable;
+
+bool symbol_table_init(SymbolTable *symbols);
+void symbol_table_destroy(SymbolTable *symbols);
+// Writes the symbol of name[0..length), adding it when it is new. Returns
+// false when out of memory.
+bool symbol_table_intern(SymbolTable *symbols, const char *name,
+                         size_t length, uint32_t *symbol);
+// returns false when name[0..length) was never interned
+bool symbol_table_find(const SymbolTable *symbols, const char *name,
+                       size_t length, uint32_t *symbol);
+// the number of symbols, the largest symbol
+size_t symbol_table_get_count(const SymbolTable *symbols);
+// not NUL terminated, valid until the table is destroyed
+Lexeme symbol_table_get_name(const SymbolTable *symbols, uint32_t symbol);
+
+#endif
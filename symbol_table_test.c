@@ -0,0 +1,77 @@
+#include "symbol_table.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+static uint32_t intern(SymbolTable *symbols, const char *name) {
+  uint32_t symbol;
+  assert(symbol_table_intern(symbols, name, strlen(name), &symbol));
+  return symbol;
+}
+
+static void test_intern(void) {
+  SymbolTable symbols;
+  assert(symbol_table_init(&symbols));
+  assert(symbol_table_get_count(&symbols) == 0);
+
+  uint32_t x = intern(&symbols, "x");
+  uint32_t price = intern(&symbols, "price");
+  assert(x == 1 && price == 2);
+  assert(intern(&symbols, "x") == x);
+  assert(intern(&symbols, "price") == price);
+  assert(symbol_table_get_count(&symbols) == 2);
+
+  // only the chars given count, not what follows them
+  uint32_t symbol;
+  assert(symbol_table_intern(&symbols, "xyz", 1, &symbol) && symbol == x);
+  assert(symbol_table_intern(&symbols, "pricey", 5, &symbol) &&
+         symbol == price);
+  assert(intern(&symbols, "pric") == 3);
+
+  Lexeme name = symbol_table_get_name(&symbols, price);
+  assert(name.length == 5 && memcmp(name.chars, "price", 5) == 0);
+
+  assert(symbol_table_find(&symbols, "x", 1, &symbol) && symbol == x);
+  assert(!symbol_table_find(&symbols, "y", 1, &symbol));
+  assert(symbol == SYMBOL_NONE);
+
+  symbol_table_destroy(&symbols);
+}
+
+// growing the slots and the arena keeps every symbol and name in place
+static void test_many_symbols(void) {
+  SymbolTable symbols;
+  assert(symbol_table_init(&symbols));
+  const char *first_chars = NULL;
+
+  char name[32];
+  for (uint32_t i = 0; i < 20000; i++) {
+    sprintf(name, "var_%u", i);
+    assert(intern(&symbols, name) == i + 1);
+    if (i == 0) {
+      first_chars = symbol_table_get_name(&symbols, 1).chars;
+    }
+  }
+  assert(symbol_table_get_count(&symbols) == 20000);
+  assert(symbol_table_get_name(&symbols, 1).chars == first_chars);
+
+  for (uint32_t i = 0; i < 20000; i++) {
+    sprintf(name, "var_%u", i);
+    uint32_t symbol;
+    assert(symbol_table_find(&symbols, name, strlen(name), &symbol));
+    assert(symbol == i + 1);
+    Lexeme interned = symbol_table_get_name(&symbols, symbol);
+    assert(interned.length == strlen(name));
+    assert(memcmp(interned.chars, name, interned.length) == 0);
+  }
+
+  symbol_table_destroy(&symbols);
+}
+
+int main(void) {
+  test_intern();
+  test_many_symbols();
+
+  printf("All symbol table tests passed\n");
+  return 0;
+}
@@ -0,0 +1,102 @@
+#ifndef TEST_HELPERS
+#define TEST_HELPERS
+#include "bytecode.h"
+#include "char_reader.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "token_list.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Helpers the tests share, every function is static inline so a test that
+// does not use one compiles without warnings.
+
+static inline TokenList lex_string(const char *input) {
+  CharReader reader;
+  char_reader_init(&reader);
+  assert(char_reader_add(&reader, input));
+  TokenList tokens = lex_char_reader(&reader);
+  char_reader_destroy(&reader);
+  return tokens;
+}
+
+// initializes bytecode with input, which has to compile
+static inline void compile_string(const char *input, Bytecode *bytecode) {
+  TokenList tokens = lex_string(input);
+  assert(bytecode_init(bytecode));
+  CompileError error;
+  assert(compile_token_list(&tokens, bytecode, &error));
+  token_list_distroy(&tokens);
+}
+
+// What generate_expression builds expressions from. Tables with a count of 0
+// are left out.
+typedef struct ExpressionShape {
+  const char *const *operators; // binary operators with their spacing
+  size_t operator_count;
+  const char *const *variables;
+  size_t variable_count;
+  const char *const *functions; // called with one argument
+  size_t function_count;
+  const char *const *pieces; // inserted in parentheses as operands
+  size_t piece_count;
+  int fractions;       // numbers are 0.0 up to 9.(fractions - 1)
+  bool negates;        // unary minus in front of operands
+  bool mixes_brackets; // binary operations also go in [] and {}
+} ExpressionShape;
+
+#define TEST_COUNT_OF(array) (sizeof(array) / sizeof((array)[0]))
+
+// Appends a random expression of at most depth nested operations to
+// out[length..] and returns the new length, out is not NUL terminated.
+// Numbers, variables and pieces are the operands, rand() picks everything.
+static inline size_t generate_expression(const ExpressionShape *shape,
+                                         char *out, size_t length,
+                                         int depth) {
+  int operands = 2 + (shape->piece_count > 0);
+  int operations = 2 + shape->negates + (shape->function_count > 0);
+  int choice = depth <= 0 ? rand() % operands : rand() % (operands + operations);
+
+  if (choice == 0) {
+    return length + (size_t)sprintf(out + length, "%d.%d", rand() % 10,
+                                    rand() % shape->fractions);
+  }
+  if (choice == 1) {
+    return length + (size_t)sprintf(
+                        out + length, "%s",
+                        shape->variables[(size_t)rand() % shape->variable_count]);
+  }
+  if (choice == 2 && shape->piece_count > 0) {
+    return length + (size_t)sprintf(
+                        out + length, "(%s)",
+                        shape->pieces[(size_t)rand() % shape->piece_count]);
+  }
+
+  choice -= operands;
+  if (shape->negates && choice-- == 0) {
+    out[length++] = '-';
+    return generate_expression(shape, out, length, depth - 1);
+  }
+  if (shape->function_count > 0 && choice-- == 0) {
+    length += (size_t)sprintf(
+        out + length, "%s(",
+        shape->functions[(size_t)rand() % shape->function_count]);
+    length = generate_expression(shape, out, length, depth - 1);
+    out[length++] = ')';
+    return length;
+  }
+
+  int bracket = shape->mixes_brackets ? rand() % 3 : 0;
+  out[length++] = "([{"[bracket];
+  length = generate_expression(shape, out, length, depth - 1);
+  length += (size_t)sprintf(
+      out + length, "%s",
+      shape->operators[(size_t)rand() % shape->operator_count]);
+  length = generate_expression(shape, out, length, depth - 1);
+  out[length++] = ")]}"[bracket];
+  return length;
+}
+
+#endif
@@ -0,0 +1,223 @@
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L
+#define THREAD_POOL_POSIX
+#endif
+
+#include "thread_pool.h"
+#include <assert.h>
+#include <stdlib.h>
+
+#ifdef THREAD_POOL_POSIX
+#include <unistd.h>
+#endif
+
+// The deque of one thread, chunks [front, back) of the current job. The
+// owner takes from the front, thieves cut off the back half.
+typedef struct ThreadPoolWorker {
+  pthread_mutex_t mutex;
+  size_t front;
+  size_t back;
+  ThreadPool *pool;
+  size_t index;
+  pthread_t thread;
+  char padding[64]; // keeps the deques of two threads off one cache line
+} ThreadPoolWorker;
+
+size_t thread_pool_default_thread_count(void) {
+#ifdef THREAD_POOL_POSIX
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  if (count > 0) {
+    return (size_t)count;
+  }
+#endif
+  return 1;
+}
+
+static bool _thread_pool_take(ThreadPoolWorker *worker, size_t *chunk) {
+  pthread_mutex_lock(&worker->mutex);
+  bool taken = worker->front < worker->back;
+  if (taken) {
+    *chunk = worker->front++;
+  }
+  pthread_mutex_unlock(&worker->mutex);
+  return taken;
+}
+
+// moves the back half of the first other deque that is not empty into the
+// empty deque of thief
+static bool _thread_pool_steal(ThreadPool *pool, ThreadPoolWorker *thief) {
+  size_t thread_count = pool->_inner_thread_count;
+  for (size_t offset = 1; offset < thread_count; offset++) {
+    ThreadPoolWorker *victim =
+        &pool->_inner_workers[(thief->index + offset) % thread_count];
+    pthread_mutex_lock(&victim->mutex);
+    size_t available = victim->back - victim->front;
+    size_t back = victim->back;
+    victim->back -= (available + 1) / 2;
+    size_t front = victim->back;
+    pthread_mutex_unlock(&victim->mutex);
+    if (available == 0) {
+      continue;
+    }
+
+    pthread_mutex_lock(&thief->mutex);
+    thief->front = front;
+    thief->back = back;
+    pthread_mutex_unlock(&thief->mutex);
+    atomic_fetch_add_explicit(&pool->_inner_steal_count, 1,
+                              memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+// Returns once no deque has chunks left. Chunks another thief is moving at
+// that moment are run by that thief.
+static void _thread_pool_work(ThreadPool *pool, ThreadPoolWorker *worker) {
+  size_t grain = pool->_inner_grain;
+  size_t item_count = pool->_inner_item_count;
+  do {
+    size_t chunk;
+    while (_thread_pool_take(worker, &chunk)) {
+      size_t begin = chunk * grain;
+      size_t end = item_count - begin < grain ? item_count : begin + grain;
+      pool->_inner_task(pool->_inner_context, worker->index, begin, end);
+    }
+  } while (_thread_pool_steal(pool, worker));
+}
+
+static void *_thread_pool_thread(void *argument) {
+  ThreadPoolWorker *worker = argument;
+  ThreadPool *pool = worker->pool;
+  size_t generation = 0;
+
+  pthread_mutex_lock(&pool->_inner_mutex);
+  for (;;) {
+    while (!pool->_inner_is_stopping && pool->_inner_generation == generation) {
+      pthread_cond_wait(&pool->_inner_job_ready, &pool->_inner_mutex);
+    }
+    if (pool->_inner_is_stopping) {
+      break;
+    }
+    generation = pool->_inner_generation;
+    pthread_mutex_unlock(&pool->_inner_mutex);
+
+    _thread_pool_work(pool, worker);
+
+    pthread_mutex_lock(&pool->_inner_mutex);
+    if (--pool->_inner_busy_threads == 0) {
+      pthread_cond_signal(&pool->_inner_job_done);
+    }
+  }
+  pthread_mutex_unlock(&pool->_inner_mutex);
+  return NULL;
+}
+
+// stops and joins the helper threads [1, started)
+static void _thread_pool_stop(ThreadPool *pool, size_t started) {
+  pthread_mutex_lock(&pool->_inner_mutex);
+  pool->_inner_is_stopping = true;
+  pthread_cond_broadcast(&pool->_inner_job_ready);
+  pthread_mutex_unlock(&pool->_inner_mutex);
+  for (size_t i = 1; i < started; i++) {
+    pthread_join(pool->_inner_workers[i].thread, NULL);
+  }
+  for (size_t i = 0; i < pool->_inner_thread_count; i++) {
+    pthread_mutex_destroy(&pool->_inner_workers[i].mutex);
+  }
+  pthread_cond_destroy(&pool->_inner_job_done);
+  pthread_cond_destroy(&pool->_inner_job_ready);
+  pthread_mutex_destroy(&pool->_inner_mutex);
+  free(pool->_inner_workers);
+  pool->_inner_workers = NULL;
+}
+
+bool thread_pool_init(ThreadPool *pool, size_t thread_count) {
+  assert(pool && "thread_pool_init(): arg pool was null");
+  if (thread_count == 0) {
+    thread_count = thread_pool_default_thread_count();
+  }
+
+  *pool = (ThreadPool){0};
+  pool->_inner_workers = calloc(thread_count, sizeof(ThreadPoolWorker));
+  if (pool->_inner_workers == NULL) {
+    return false;
+  }
+  pool->_inner_thread_count = thread_count;
+  atomic_init(&pool->_inner_steal_count, 0);
+  pthread_mutex_init(&pool->_inner_mutex, NULL);
+  pthread_cond_init(&pool->_inner_job_ready, NULL);
+  pthread_cond_init(&pool->_inner_job_done, NULL);
+  for (size_t i = 0; i < thread_count; i++) {
+    pthread_mutex_init(&pool->_inner_workers[i].mutex, NULL);
+    pool->_inner_workers[i].pool = pool;
+    pool->_inner_workers[i].index = i;
+  }
+
+  for (size_t i = 1; i < thread_count; i++) {
+    if (pthread_create(&pool->_inner_workers[i].thread, NULL,
+                       _thread_pool_thread, &pool->_inner_workers[i]) != 0) {
+      _thread_pool_stop(pool, i);
+      return false;
+    }
+  }
+  return true;
+}
+
+void thread_pool_destroy(ThreadPool *pool) {
+  assert(pool && "thread_pool_destroy(): arg pool was null");
+  if (pool->_inner_workers != NULL) {
+    _thread_pool_stop(pool, pool->_inner_thread_count);
+  }
+}
+
+size_t thread_pool_get_thread_count(const ThreadPool *pool) {
+  assert(pool && "thread_pool_get_thread_count(): arg pool was null");
+  return pool->_inner_thread_count;
+}
+
+size_t thread_pool_get_steal_count(ThreadPool *pool) {
+  assert(pool && "thread_pool_get_steal_count(): arg pool was null");
+  return atomic_load_explicit(&pool->_inner_steal_count, memory_order_relaxed);
+}
+
+void thread_pool_run(ThreadPool *pool, size_t item_count, size_t grain,
+                     ThreadPoolTask task, void *context) {
+  assert(pool && "thread_pool_run(): arg pool was null");
+  assert(task && "thread_pool_run(): arg task was null");
+  assert(grain > 0 && "thread_pool_run(): arg grain was 0");
+  if (item_count == 0) {
+    return;
+  }
+
+  size_t chunk_count = item_count / grain + (item_count % grain != 0);
+  size_t thread_count = pool->_inner_thread_count;
+  size_t share = chunk_count / thread_count;
+  size_t rest = chunk_count % thread_count;
+
+  pthread_mutex_lock(&pool->_inner_mutex);
+  pool->_inner_task = task;
+  pool->_inner_context = context;
+  pool->_inner_item_count = item_count;
+  pool->_inner_grain = grain;
+  // thread i starts with the i-th run of neighbouring chunks
+  for (size_t i = 0; i < thread_count; i++) {
+    ThreadPoolWorker *worker = &pool->_inner_workers[i];
+    pthread_mutex_lock(&worker->mutex);
+    worker->front = i * share + (i < rest ? i : rest);
+    worker->back = worker->front + share + (i < rest);
+    pthread_mutex_unlock(&worker->mutex);
+  }
+  pool->_inner_busy_threads = thread_count - 1;
+  pool->_inner_generation++;
+  pthread_cond_broadcast(&pool->_inner_job_ready);
+  pthread_mutex_unlock(&pool->_inner_mutex);
+
+  _thread_pool_work(pool, &pool->_inner_workers[0]);
+
+  pthread_mutex_lock(&pool->_inner_mutex);
+  while (pool->_inner_busy_threads > 0) {
+    pthread_cond_wait(&pool->_inner_job_done, &pool->_inner_mutex);
+  }
+  pthread_mutex_unlock(&pool->_inner_mutex);
+}
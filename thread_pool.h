@@ -0,0 +1,51 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// runs items [begin, end) of a job on the thread with index worker, worker is
+// below thread_pool_get_thread_count so it can pick per-thread scratch space
+typedef void (*ThreadPoolTask)(void *context, size_t worker, size_t begin,
+                               size_t end);
+
+// Fixed set of threads that split jobs between them. The items of a job are
+// cut into chunks and every thread gets a deque of neighbouring chunks. A
+// thread takes chunks from the front of its own deque and, once that is
+// empty, steals the back half of the next deque that has any left, so uneven
+// chunks still keep every core busy. The thread calling thread_pool_run is
+// worker 0 and works on the job too.
+typedef struct ThreadPool {
+  struct ThreadPoolWorker *_inner_workers;
+  size_t _inner_thread_count;
+  pthread_mutex_t _inner_mutex; // guards the fields below but the counter
+  pthread_cond_t _inner_job_ready;
+  pthread_cond_t _inner_job_done;
+  size_t _inner_generation; // counts the jobs, threads wait for it to change
+  size_t _inner_busy_threads; // helper threads that did not finish the job
+  bool _inner_is_stopping;
+  ThreadPoolTask _inner_task;
+  void *_inner_context;
+  size_t _inner_item_count;
+  size_t _inner_grain;
+  atomic_size_t _inner_steal_count;
+} ThreadPool;
+
+// the number of cpus that are online, at least 1
+size_t thread_pool_default_thread_count(void);
+// thread_count 0 means thread_pool_default_thread_count(). Returns false when
+// the threads could not be started.
+bool thread_pool_init(ThreadPool *pool, size_t thread_count);
+void thread_pool_destroy(ThreadPool *pool);
+size_t thread_pool_get_thread_count(const ThreadPool *pool);
+// chunks taken from another thread's deque since the pool started, the
+// workers keep counting while it is read so pool is not const
+size_t thread_pool_get_steal_count(ThreadPool *pool);
+// Calls task on chunks of at most grain items until [0, item_count) is
+// covered and returns once every call returned. One job runs at a time, the
+// task must not call thread_pool_run on the same pool.
+void thread_pool_run(ThreadPool *pool, size_t item_count, size_t grain,
+                     ThreadPoolTask task, void *context);
+
+#endif
@@ -0,0 +1,212 @@
+#include "bytecode.h"
+#include "char_reader.h"
+#include "columns.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "parallel.h"
+#include "test_helpers.h"
+#include "thread_pool.h"
+#include "token_list.h"
+#include "vm.h"
+#include <assert.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct CoverageJob {
+  atomic_int *calls; // per item
+  size_t thread_count;
+  size_t grain;
+} CoverageJob;
+
+static void coverage_task(void *context, size_t worker, size_t begin,
+                          size_t end) {
+  CoverageJob *job = context;
+  assert(worker < job->thread_count);
+  assert(begin < end && end - begin <= job->grain);
+  for (size_t i = begin; i < end; i++) {
+    atomic_fetch_add(&job->calls[i], 1);
+  }
+}
+
+static void test_every_item_runs_once(void) {
+  size_t thread_counts[] = {1, 2, 3, 8};
+  size_t item_counts[] = {0, 1, 7, 1000, 12345};
+  size_t grains[] = {1, 3, 64, 100000};
+  for (size_t t = 0; t < sizeof(thread_counts) / sizeof(size_t); t++) {
+    ThreadPool pool;
+    assert(thread_pool_init(&pool, thread_counts[t]));
+    assert(thread_pool_get_thread_count(&pool) == thread_counts[t]);
+
+    for (size_t n = 0; n < sizeof(item_counts) / sizeof(size_t); n++) {
+      for (size_t g = 0; g < sizeof(grains) / sizeof(size_t); g++) {
+        atomic_int *calls = calloc(item_counts[n] + 1, sizeof(atomic_int));
+        assert(calls);
+        CoverageJob job = {calls, thread_counts[t], grains[g]};
+        thread_pool_run(&pool, item_counts[n], grains[g], coverage_task, &job);
+        for (size_t i = 0; i < item_counts[n]; i++) {
+          assert(atomic_load(&calls[i]) == 1);
+        }
+        free(calls);
+      }
+    }
+    thread_pool_destroy(&pool);
+  }
+}
+
+static void test_default_thread_count(void) {
+  ThreadPool pool;
+  assert(thread_pool_init(&pool, 0));
+  assert(thread_pool_get_thread_count(&pool) ==
+         thread_pool_default_thread_count());
+  assert(thread_pool_get_thread_count(&pool) >= 1);
+  thread_pool_destroy(&pool);
+}
+
+// every item of the first chunks of thread 0 is slow, the other threads
+// have to steal them for the job to be split
+static void uneven_task(void *context, size_t worker, size_t begin,
+                        size_t end) {
+  (void)context;
+  (void)worker;
+  volatile double sink = 0;
+  for (size_t i = begin; i < end; i++) {
+    size_t spins = i < 16 ? 1000000 : 10;
+    for (size_t k = 0; k < spins; k++) {
+      sink += 1;
+    }
+  }
+}
+
+static void test_uneven_work_gets_stolen(void) {
+  ThreadPool pool;
+  assert(thread_pool_init(&pool, 4));
+  thread_pool_run(&pool, 64, 1, uneven_task, NULL);
+  assert(thread_pool_get_steal_count(&pool) > 0);
+  thread_pool_destroy(&pool);
+}
+
+static bool same_bits(double a, double b) {
+  return (isnan(a) && isnan(b)) || memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+static void test_expressions_keep_input_order(void) {
+  const char *const templates[] = {"x + %d",      "sqrt(%d) * y", "%d ^ 2 - z",
+                                   "(x * %d",     "%d $ 1",       "abs(-%d)",
+                                   "unknown(%d)", "w + %d"};
+  const char *const names[] = {"x", "y", "z"};
+  const double values[] = {1.5, -2, 0.25};
+  size_t count = 1000;
+  char (*inputs)[32] = malloc(count * sizeof(*inputs));
+  const char **expressions = malloc(count * sizeof(char *));
+  size_t *lengths = malloc(count * sizeof(size_t));
+  ParallelResult *results = malloc(count * sizeof(ParallelResult));
+  assert(inputs && expressions && lengths && results);
+  for (size_t i = 0; i < count; i++) {
+    lengths[i] = (size_t)sprintf(inputs[i], templates[i % 8], (int)i);
+    expressions[i] = inputs[i];
+  }
+
+  size_t thread_counts[] = {1, 3, 8};
+  for (size_t t = 0; t < sizeof(thread_counts) / sizeof(size_t); t++) {
+    ThreadPool pool;
+    assert(thread_pool_init(&pool, thread_counts[t]));
+    assert(parallel_evaluate_expressions(&pool, expressions, lengths, count,
+                                         names, values, 3, results));
+    for (size_t i = 0; i < count; i++) {
+      // the same expression alone
+      CharReader reader;
+      char_reader_init(&reader);
+      assert(char_reader_add_view(&reader, expressions[i], lengths[i]));
+      TokenList tokens = lex_char_reader(&reader);
+      Bytecode bytecode;
+      assert(bytecode_init(&bytecode));
+      CompileError error;
+      bool compiled = compile_token_list(&tokens, &bytecode, &error);
+      assert(compiled == (results[i].error.type == COMPILE_OK));
+      if (compiled) {
+        double vars[3];
+        for (size_t slot = 0; slot < bytecode_get_variable_count(&bytecode);
+             slot++) {
+          size_t name;
+          for (name = 0; name < 3; name++) {
+            if (strcmp(bytecode_get_variable_name(&bytecode, slot),
+                       names[name]) == 0) {
+              break;
+            }
+          }
+          vars[slot] = name < 3 ? values[name] : NAN;
+        }
+        assert(same_bits(results[i].value, vm_evaluate(&bytecode, vars)));
+      } else {
+        assert(isnan(results[i].value));
+        assert(results[i].error.type == error.type);
+        assert(results[i].error.token_index == error.token_index);
+      }
+      bytecode_destroy(&bytecode);
+      token_list_distroy(&tokens);
+      char_reader_destroy(&reader);
+    }
+    thread_pool_destroy(&pool);
+  }
+
+  assert(results[1].value == sqrt(1) * -2);
+  assert(results[3].error.type == COMPILE_PARSE_FAILED);
+  assert(results[6].error.type == COMPILE_UNKNOWN_FUNCTION);
+  assert(isnan(results[7].value)); // w is not bound
+
+  free(inputs);
+  free(expressions);
+  free(lengths);
+  free(results);
+}
+
+static void test_rows_and_columns(void) {
+  Bytecode bytecode;
+  compile_string("x * y - z / 3 + x % 2", &bytecode);
+  size_t row_count = 3 * PARALLEL_ROW_GRAIN + 17;
+  double *rows = malloc(row_count * 3 * sizeof(double));
+  double *columns = malloc(row_count * 3 * sizeof(double));
+  double *expected = malloc(row_count * sizeof(double));
+  double *out = malloc(row_count * sizeof(double));
+  assert(rows && columns && expected && out);
+  for (size_t row = 0; row < row_count; row++) {
+    for (size_t v = 0; v < 3; v++) {
+      double value = (double)((row * 7 + v * 13) % 101) / 4.0 - 12;
+      rows[row * 3 + v] = value;
+      columns[v * row_count + row] = value;
+    }
+  }
+  const double *cols[] = {columns, columns + row_count,
+                          columns + 2 * row_count};
+  vm_evaluate_rows(&bytecode, rows, row_count, expected);
+
+  ThreadPool pool;
+  assert(thread_pool_init(&pool, 4));
+  memset(out, 0, row_count * sizeof(double));
+  parallel_evaluate_rows(&pool, &bytecode, rows, row_count, out);
+  assert(memcmp(out, expected, row_count * sizeof(double)) == 0);
+  memset(out, 0, row_count * sizeof(double));
+  assert(parallel_eval_columns(&pool, &bytecode, cols, row_count, out));
+  assert(memcmp(out, expected, row_count * sizeof(double)) == 0);
+  thread_pool_destroy(&pool);
+
+  free(rows);
+  free(columns);
+  free(expected);
+  free(out);
+  bytecode_destroy(&bytecode);
+}
+
+int main(void) {
+  test_every_item_runs_once();
+  test_default_thread_count();
+  test_uneven_work_gets_stolen();
+  test_expressions_keep_input_order();
+  test_rows_and_columns();
+
+  printf("All thread pool tests passed\n");
+  return 0;
+}
@@ -19,3 +19,138 @@ size_t token_list_get_count(TokenList *token_list) {
   assert(token_list && "token_list_get_count(): arg token_list was null");
   return list_get_count(token_list->_inner_token_list);
 }
+
+Lexeme token_list_get_lexeme(TokenList *token_list, Token token) {
+  assert(token_list && "token_list_get_lexeme(): arg token_list was null");
+  if (token.lexeme_length == 0) {
+    return (Lexeme){.chars = NULL, .length = 0};
+  }
+  if (token.lexeme_is_borrowed) {
+    return (Lexeme){.chars = token.lexeme_chars,
+                    .length = token.lexeme_length};
+  }
+
+  assert(token.lexeme_offset + token.lexeme_length <=
+             list_get_count(token_list->_inner_lexemes_container) &&
+         "token_list_get_lexeme(): lexeme out of bounds");
+  return (Lexeme){
+      .chars = &token_list->_inner_lexemes_container[token.lexeme_offset],
+      .length = token.lexeme_length};
+}
+
+void token_columns_destroy(TokenColumns *columns) {
+  assert(columns && "token_columns_destroy(): arg columns was null");
+  list_free(columns->_inner_types);
+  list_free(columns->_inner_spans);
+  list_free(columns->_inner_numbers);
+  list_free(columns->_inner_lexemes);
+  columns->_inner_types = NULL;
+  columns->_inner_spans = NULL;
+  columns->_inner_numbers = NULL;
+  columns->_inner_lexemes = NULL;
+}
+
+size_t token_columns_get_count(const TokenColumns *columns) {
+  assert(columns && "token_columns_get_count(): arg columns was null");
+  return list_get_count(columns->_inner_types);
+}
+
+const uint8_t *token_columns_get_types(const TokenColumns *columns) {
+  assert(columns && "token_columns_get_types(): arg columns was null");
+  return columns->_inner_types;
+}
+
+const double *token_columns_get_numbers(const TokenColumns *columns) {
+  assert(columns && "token_columns_get_numbers(): arg columns was null");
+  return columns->_inner_numbers;
+}
+
+Lexeme token_columns_get_lexeme(const TokenColumns *columns, size_t index) {
+  assert(columns && "token_columns_get_lexeme(): arg columns was null");
+  assert(index < list_get_count(columns->_inner_spans) &&
+         "token_columns_get_lexeme(): index out of bounds");
+  TokenSpan span = columns->_inner_spans[index];
+  if (span.length == 0) {
+    return (Lexeme){.chars = NULL, .length = 0};
+  }
+  if (span.is_borrowed) {
+    return (Lexeme){.chars = span.chars, .length = span.length};
+  }
+
+  assert(span.offset + span.length <= list_get_count(columns->_inner_lexemes) &&
+         "token_columns_get_lexeme(): lexeme out of bounds");
+  return (Lexeme){.chars = &columns->_inner_lexemes[span.offset],
+                  .length = span.length};
+}
+
+bool token_batch_init(TokenBatch *batch) {
+  assert(batch && "token_batch_init(): arg batch was null");
+  return token_batch_init_in(batch, NULL);
+}
+
+bool token_batch_init_in(TokenBatch *batch, Arena *arena) {
+  assert(batch && "token_batch_init_in(): arg batch was null");
+  batch->_inner_tokens = list_in(arena, Token, 64);
+  batch->_inner_lexemes = list_in(arena, char, 256);
+  batch->_inner_expression_starts = list_in(arena, size_t, 16);
+  if (batch->_inner_tokens == NULL || batch->_inner_lexemes == NULL ||
+      batch->_inner_expression_starts == NULL) {
+    token_batch_destroy(batch);
+    return false;
+  }
+  return true;
+}
+
+void token_batch_destroy(TokenBatch *batch) {
+  assert(batch && "token_batch_destroy(): arg batch was null");
+  if (batch->_inner_tokens != NULL) {
+    list_free(batch->_inner_tokens);
+  }
+  if (batch->_inner_lexemes != NULL) {
+    list_free(batch->_inner_lexemes);
+  }
+  if (batch->_inner_expression_starts != NULL) {
+    list_free(batch->_inner_expression_starts);
+  }
+  batch->_inner_tokens = NULL;
+  batch->_inner_lexemes = NULL;
+  batch->_inner_expression_starts = NULL;
+}
+
+void token_batch_clear(TokenBatch *batch) {
+  assert(batch && "token_batch_clear(): arg batch was null");
+  list_clear(batch->_inner_tokens);
+  list_clear(batch->_inner_lexemes);
+  list_clear(batch->_inner_expression_starts);
+}
+
+size_t token_batch_get_expression_count(TokenBatch *batch) {
+  assert(batch && "token_batch_get_expression_count(): arg batch was null");
+  return list_get_count(batch->_inner_expression_starts);
+}
+
+size_t token_batch_get_expression_start(TokenBatch *batch, size_t expression) {
+  assert(batch && "token_batch_get_expression_start(): arg batch was null");
+  assert(expression < list_get_count(batch->_inner_expression_starts) &&
+         "token_batch_get_expression_start(): expression out of bounds");
+  return batch->_inner_expression_starts[expression];
+}
+
+size_t token_batch_get_expression_token_count(TokenBatch *batch,
+                                              size_t expression) {
+  assert(batch &&
+         "token_batch_get_expression_token_count(): arg batch was null");
+  size_t expression_count = list_get_count(batch->_inner_expression_starts);
+  assert(expression < expression_count &&
+         "token_batch_get_expression_token_count(): expression out of bounds");
+  size_t end = expression + 1 == expression_count
+                   ? list_get_count(batch->_inner_tokens)
+                   : batch->_inner_expression_starts[expression + 1];
+  return end - batch->_inner_expression_starts[expression];
+}
+
+TokenList token_batch_get_token_list(TokenBatch *batch) {
+  assert(batch && "token_batch_get_token_list(): arg batch was null");
+  return (TokenList){._inner_token_list = batch->_inner_tokens,
+                     ._inner_lexemes_container = batch->_inner_lexemes};
+}
\ No newline at end of file
@@ -1,6 +1,10 @@
 #ifndef TOKEN_LIST
 #define TOKEN_LIST
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+typedef struct Arena Arena;
 
 typedef enum TokenType {
   NUMBER_TOKEN,     // 123 123.313 .3123 0.1231 11,222,333 11,222.333444
@@ -22,18 +26,87 @@ typedef enum TokenType {
   EOI_TOKEN
 } TokenType;
 
+// lexemes live in the token list lexeme storage and are referenced by offset,
+// so growing the storage never has to touch the emitted tokens. Lexemes read
+// from a borrowed CharReader buffer point straight into that buffer instead.
+#define TOKEN_MAX_LEXEME_LENGTH 0x7fffffffu
+
 typedef struct Token {
-  const TokenType type;
-  const char *lexeme;
+  TokenType type;
+  uint32_t lexeme_length : 31;
+  uint32_t lexeme_is_borrowed : 1;
+  union {
+    size_t lexeme_offset;
+    const char *lexeme_chars; // when lexeme_is_borrowed
+  };
+  union {
+    double number;   // the value of a NUMBER_TOKEN, 0 for other tokens
+    uint32_t symbol; // of an IDENTIFIER_TOKEN lexed with a SymbolTable
+  };
 } Token;
 
+// not NUL terminated, chars is NULL for tokens without a lexeme (EOI_TOKEN)
+typedef struct Lexeme {
+  const char *chars;
+  size_t length;
+} Lexeme;
+
 typedef struct TokenList {
   const Token *_inner_token_list;
   const char *_inner_lexemes_container;
 } TokenList;
 
+// The lexeme of a token in TokenColumns, like the lexeme fields of a Token
+typedef struct TokenSpan {
+  union {
+    size_t offset;
+    const char *chars; // when is_borrowed
+  };
+  uint32_t length : 31;
+  uint32_t is_borrowed : 1;
+} TokenSpan;
+
+// The same tokens as a TokenList with one array per field. A scan that only
+// looks at the types, like matching brackets or climbing precedences, reads
+// one byte per token instead of a whole Token.
+typedef struct TokenColumns {
+  uint8_t *_inner_types;   // the TokenType of each token
+  TokenSpan *_inner_spans;
+  double *_inner_numbers;  // the value of each NUMBER_TOKEN, 0 for others
+  char *_inner_lexemes;    // the copied lexemes the spans refer to
+} TokenColumns;
+
+// Tokens of many expressions in one token array and one lexeme storage, every
+// expression ends with its own EOI_TOKEN. Clearing keeps the capacity, so a
+// batch can be refilled without allocating.
+typedef struct TokenBatch {
+  Token *_inner_tokens;
+  char *_inner_lexemes;
+  size_t *_inner_expression_starts; // index of the first token of each
+} TokenBatch;
+
 void token_list_distroy(TokenList *token_list);
 Token token_list_get_token_at(TokenList *token_list, size_t index);
 size_t token_list_get_count(TokenList *token_list);
+Lexeme token_list_get_lexeme(TokenList *token_list, Token token);
+
+void token_columns_destroy(TokenColumns *columns);
+size_t token_columns_get_count(const TokenColumns *columns);
+const uint8_t *token_columns_get_types(const TokenColumns *columns);
+const double *token_columns_get_numbers(const TokenColumns *columns);
+Lexeme token_columns_get_lexeme(const TokenColumns *columns, size_t index);
+
+bool token_batch_init(TokenBatch *batch);
+// the batch storage grows inside arena and is released by its reset
+bool token_batch_init_in(TokenBatch *batch, Arena *arena);
+void token_batch_destroy(TokenBatch *batch);
+void token_batch_clear(TokenBatch *batch);
+size_t token_batch_get_expression_count(TokenBatch *batch);
+// the tokens of expression are [start, start + count) of the batch token list
+size_t token_batch_get_expression_start(TokenBatch *batch, size_t expression);
+size_t token_batch_get_expression_token_count(TokenBatch *batch,
+                                              size_t expression);
+// a view of every token in the batch, it must not be distroied
+TokenList token_batch_get_token_list(TokenBatch *batch);
 
 #endif
@@ -0,0 +1,27 @@
+#include "value.h"
+#include <stdbool.h>
+
+Value value_power(Value base, Value exponent) {
+  if (base.type == VALUE_INTEGER && exponent.type == VALUE_INTEGER &&
+      exponent.integer >= 0) {
+    int64_t result = 1;
+    int64_t square = base.integer;
+    uint64_t bits = (uint64_t)exponent.integer;
+    bool overflowed = false;
+    // once square overflows with bits left, the result would overflow too
+    // because |base| is at least 2 then
+    while (bits != 0 && !overflowed) {
+      if (bits & 1) {
+        overflowed = __builtin_mul_overflow(result, square, &result);
+      }
+      bits >>= 1;
+      if (bits != 0 && !overflowed) {
+        overflowed = __builtin_mul_overflow(square, square, &square);
+      }
+    }
+    if (!overflowed) {
+      return value_integer(result);
+    }
+  }
+  return value_number(pow(value_to_double(base), value_to_double(exponent)));
+}
@@ -0,0 +1,110 @@
+#ifndef VALUE
+#define VALUE
+#include <math.h>
+#include <stdint.h>
+
+typedef enum ValueType {
+  VALUE_INTEGER,
+  VALUE_NUMBER, // a double
+} ValueType;
+
+// A number that stays an exact int64 while it can. + - * % and ^ with a
+// non-negative exponent keep two integers in integers, / does when it
+// divides exactly. Any other result, one that overflows, or any operation on
+// a double gives a double, and a double stays one.
+typedef struct Value {
+  ValueType type;
+  union {
+    int64_t integer;
+    double number;
+  };
+} Value;
+
+// doubles up to this magnitude hold every integer exactly
+#define VALUE_MAX_EXACT_DOUBLE 9007199254740992.0
+
+static inline Value value_integer(int64_t integer) {
+  return (Value){.type = VALUE_INTEGER, .integer = integer};
+}
+
+static inline Value value_number(double number) {
+  return (Value){.type = VALUE_NUMBER, .number = number};
+}
+
+// an integer when number is one of at most VALUE_MAX_EXACT_DOUBLE in
+// magnitude, -0 stays a double
+static inline Value value_from_double(double number) {
+  if (number >= -VALUE_MAX_EXACT_DOUBLE && number <= VALUE_MAX_EXACT_DOUBLE &&
+      (double)(int64_t)number == number && (number != 0 || !signbit(number))) {
+    return value_integer((int64_t)number);
+  }
+  return value_number(number);
+}
+
+static inline double value_to_double(Value value) {
+  return value.type == VALUE_INTEGER ? (double)value.integer : value.number;
+}
+
+static inline Value value_negate(Value value) {
+  if (value.type == VALUE_INTEGER && value.integer != INT64_MIN) {
+    return value_integer(-value.integer);
+  }
+  return value_number(-value_to_double(value));
+}
+
+static inline Value value_add(Value lhs, Value rhs) {
+  int64_t result;
+  if (lhs.type == VALUE_INTEGER && rhs.type == VALUE_INTEGER &&
+      !__builtin_add_overflow(lhs.integer, rhs.integer, &result)) {
+    return value_integer(result);
+  }
+  return value_number(value_to_double(lhs) + value_to_double(rhs));
+}
+
+static inline Value value_subtract(Value lhs, Value rhs) {
+  int64_t result;
+  if (lhs.type == VALUE_INTEGER && rhs.type == VALUE_INTEGER &&
+      !__builtin_sub_overflow(lhs.integer, rhs.integer, &result)) {
+    return value_integer(result);
+  }
+  return value_number(value_to_double(lhs) - value_to_double(rhs));
+}
+
+static inline Value value_multiply(Value lhs, Value rhs) {
+  int64_t result;
+  if (lhs.type == VALUE_INTEGER && rhs.type == VALUE_INTEGER &&
+      !__builtin_mul_overflow(lhs.integer, rhs.integer, &result)) {
+    return value_integer(result);
+  }
+  return value_number(value_to_double(lhs) * value_to_double(rhs));
+}
+
+// an integer when rhs divides lhs, x / 0 gives an infinity or NAN
+static inline Value value_divide(Value lhs, Value rhs) {
+  if (lhs.type == VALUE_INTEGER && rhs.type == VALUE_INTEGER &&
+      rhs.integer != 0) {
+    // INT64_MIN / -1 overflows, value_negate promotes it
+    if (rhs.integer == -1) {
+      return value_negate(lhs);
+    }
+    if (lhs.integer % rhs.integer == 0) {
+      return value_integer(lhs.integer / rhs.integer);
+    }
+  }
+  return value_number(value_to_double(lhs) / value_to_double(rhs));
+}
+
+// has the sign of lhs like fmod, x % 0 is NAN
+static inline Value value_modulo(Value lhs, Value rhs) {
+  if (lhs.type == VALUE_INTEGER && rhs.type == VALUE_INTEGER &&
+      rhs.integer != 0) {
+    // INT64_MIN % -1 overflows in C although the remainder is 0
+    return value_integer(rhs.integer == -1 ? 0 : lhs.integer % rhs.integer);
+  }
+  return value_number(fmod(value_to_double(lhs), value_to_double(rhs)));
+}
+
+// squares and multiplies while both stay in int64, pow otherwise
+Value value_power(Value base, Value exponent);
+
+#endif
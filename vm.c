@@ -0,0 +1,235 @@
+#include "vm.h"
+#include <assert.h>
+#include <math.h>
+
+// gcc and clang take the address of a label, which lets every instruction
+// jump straight to the next handler instead of going back to one switch
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO
+#endif
+
+// the runners below dispatch with these, the labels are the handler names
+#ifdef VM_COMPUTED_GOTO
+#define VM_CASE(opcode, label) label:
+#define VM_DISPATCH()                                                          \
+  instruction = *ip++;                                                         \
+  goto *handlers[INSTRUCTION_OPCODE(instruction)]
+#define VM_NEXT() VM_DISPATCH()
+#define VM_HANDLERS                                                            \
+  static const void *const handlers[OPCODE_COUNT] = {                          \
+      [OP_PUSH_CONSTANT] = &&op_push_constant,                                 \
+      [OP_LOAD_VARIABLE] = &&op_load_variable,                                 \
+      [OP_NEGATE] = &&op_negate,                                               \
+      [OP_ADD] = &&op_add,                                                     \
+      [OP_SUBTRACT] = &&op_subtract,                                           \
+      [OP_MULTIPLY] = &&op_multiply,                                           \
+      [OP_DIVIDE] = &&op_divide,                                               \
+      [OP_MODULO] = &&op_modulo,                                               \
+      [OP_POWER] = &&op_power,                                                 \
+      [OP_CALL] = &&op_call,                                                   \
+      [OP_RETURN] = &&op_return,                                               \
+  }
+
+#else
+#define VM_CASE(opcode, label) case opcode:
+#define VM_NEXT() continue
+#endif
+
+// the top of the stack lives in top, stack[1..count] holds the rest
+static inline double _vm_run(const Instruction *instructions,
+                             const double *constants, const double *vars) {
+  double stack[BYTECODE_MAX_STACK + 1];
+  size_t count = 0;
+  double top = 0;
+  const Instruction *ip = instructions;
+  Instruction instruction;
+
+#ifdef VM_COMPUTED_GOTO
+  VM_HANDLERS;
+  VM_DISPATCH();
+#else
+  for (;;) {
+    instruction = *ip++;
+    switch (INSTRUCTION_OPCODE(instruction)) {
+#endif
+
+  VM_CASE(OP_PUSH_CONSTANT, op_push_constant) {
+    stack[++count] = top;
+    top = constants[INSTRUCTION_OPERAND(instruction)];
+    VM_NEXT();
+  }
+  VM_CASE(OP_LOAD_VARIABLE, op_load_variable) {
+    stack[++count] = top;
+    top = vars[INSTRUCTION_OPERAND(instruction)];
+    VM_NEXT();
+  }
+  VM_CASE(OP_NEGATE, op_negate) {
+    top = -top;
+    VM_NEXT();
+  }
+  VM_CASE(OP_ADD, op_add) {
+    top = stack[count--] + top;
+    VM_NEXT();
+  }
+  VM_CASE(OP_SUBTRACT, op_subtract) {
+    top = stack[count--] - top;
+    VM_NEXT();
+  }
+  VM_CASE(OP_MULTIPLY, op_multiply) {
+    top = stack[count--] * top;
+    VM_NEXT();
+  }
+  VM_CASE(OP_DIVIDE, op_divide) {
+    top = stack[count--] / top;
+    VM_NEXT();
+  }
+  VM_CASE(OP_MODULO, op_modulo) {
+    top = fmod(stack[count--], top);
+    VM_NEXT();
+  }
+  VM_CASE(OP_POWER, op_power) {
+    top = pow(stack[count--], top);
+    VM_NEXT();
+  }
+  VM_CASE(OP_CALL, op_call) {
+    top = bytecode_functions[INSTRUCTION_OPERAND(instruction)].function(top);
+    VM_NEXT();
+  }
+  VM_CASE(OP_RETURN, op_return) {
+    return top;
+  }
+
+#ifndef VM_COMPUTED_GOTO
+    default:
+      assert(0 && "_vm_run(): unknown opcode");
+      return NAN;
+    }
+  }
+#endif
+}
+
+// _vm_run over values, constants become integers when they hold one
+static inline Value _vm_run_values(const Instruction *instructions,
+                                   const double *constants,
+                                   const Value *vars) {
+  Value stack[BYTECODE_MAX_STACK + 1];
+  size_t count = 0;
+  Value top = value_integer(0);
+  const Instruction *ip = instructions;
+  Instruction instruction;
+
+#ifdef VM_COMPUTED_GOTO
+  VM_HANDLERS;
+  VM_DISPATCH();
+#else
+  for (;;) {
+    instruction = *ip++;
+    switch (INSTRUCTION_OPCODE(instruction)) {
+#endif
+
+  VM_CASE(OP_PUSH_CONSTANT, op_push_constant) {
+    stack[++count] = top;
+    top = value_from_double(constants[INSTRUCTION_OPERAND(instruction)]);
+    VM_NEXT();
+  }
+  VM_CASE(OP_LOAD_VARIABLE, op_load_variable) {
+    stack[++count] = top;
+    top = vars[INSTRUCTION_OPERAND(instruction)];
+    VM_NEXT();
+  }
+  VM_CASE(OP_NEGATE, op_negate) {
+    top = value_negate(top);
+    VM_NEXT();
+  }
+  VM_CASE(OP_ADD, op_add) {
+    top = value_add(stack[count--], top);
+    VM_NEXT();
+  }
+  VM_CASE(OP_SUBTRACT, op_subtract) {
+    top = value_subtract(stack[count--], top);
+    VM_NEXT();
+  }
+  VM_CASE(OP_MULTIPLY, op_multiply) {
+    top = value_multiply(stack[count--], top);
+    VM_NEXT();
+  }
+  VM_CASE(OP_DIVIDE, op_divide) {
+    top = value_divide(stack[count--], top);
+    VM_NEXT();
+  }
+  VM_CASE(OP_MODULO, op_modulo) {
+    top = value_modulo(stack[count--], top);
+    VM_NEXT();
+  }
+  VM_CASE(OP_POWER, op_power) {
+    top = value_power(stack[count--], top);
+    VM_NEXT();
+  }
+  VM_CASE(OP_CALL, op_call) {
+    top = value_number(bytecode_functions[INSTRUCTION_OPERAND(instruction)]
+                           .function(value_to_double(top)));
+    VM_NEXT();
+  }
+  VM_CASE(OP_RETURN, op_return) {
+    return top;
+  }
+
+#ifndef VM_COMPUTED_GOTO
+    default:
+      assert(0 && "_vm_run_values(): unknown opcode");
+      return value_number(NAN);
+    }
+  }
+#endif
+}
+
+double vm_evaluate(const Bytecode *bytecode, const double *vars) {
+  assert(bytecode && "vm_evaluate(): arg bytecode was null");
+  assert((vars || bytecode_get_variable_count(bytecode) == 0) &&
+         "vm_evaluate(): arg vars was null");
+  assert(bytecode_get_instruction_count(bytecode) &&
+         "vm_evaluate(): bytecode is empty");
+  return _vm_run(bytecode_get_instructions(bytecode),
+                 bytecode_get_constants(bytecode), vars);
+}
+
+void vm_evaluate_rows(const Bytecode *bytecode, const double *vars,
+                      size_t row_count, double *out) {
+  assert(bytecode && "vm_evaluate_rows(): arg bytecode was null");
+  assert((out || row_count == 0) && "vm_evaluate_rows(): arg out was null");
+  assert(bytecode_get_instruction_count(bytecode) &&
+         "vm_evaluate_rows(): bytecode is empty");
+  const Instruction *instructions = bytecode_get_instructions(bytecode);
+  const double *constants = bytecode_get_constants(bytecode);
+  size_t row_length = bytecode_get_variable_count(bytecode);
+  for (size_t row = 0; row < row_count; row++) {
+    const double *row_vars = row_length ? vars + row * row_length : vars;
+    out[row] = _vm_run(instructions, constants, row_vars);
+  }
+}
+
+Value vm_evaluate_value(const Bytecode *bytecode, const Value *vars) {
+  assert(bytecode && "vm_evaluate_value(): arg bytecode was null");
+  assert((vars || bytecode_get_variable_count(bytecode) == 0) &&
+         "vm_evaluate_value(): arg vars was null");
+  assert(bytecode_get_instruction_count(bytecode) &&
+         "vm_evaluate_value(): bytecode is empty");
+  return _vm_run_values(bytecode_get_instructions(bytecode),
+                        bytecode_get_constants(bytecode), vars);
+}
+
+void vm_evaluate_value_rows(const Bytecode *bytecode, const Value *vars,
+                            size_t row_count, Value *out) {
+  assert(bytecode && "vm_evaluate_value_rows(): arg bytecode was null");
+  assert((out || row_count == 0) &&
+         "vm_evaluate_value_rows(): arg out was null");
+  assert(bytecode_get_instruction_count(bytecode) &&
+         "vm_evaluate_value_rows(): bytecode is empty");
+  const Instruction *instructions = bytecode_get_instructions(bytecode);
+  const double *constants = bytecode_get_constants(bytecode);
+  size_t row_length = bytecode_get_variable_count(bytecode);
+  for (size_t row = 0; row < row_count; row++) {
+    const Value *row_vars = row_length ? vars + row * row_length : vars;
+    out[row] = _vm_run_values(instructions, constants, row_vars);
+  }
+}
@@ -0,0 +1,20 @@
+#ifndef VM
+#define VM
+#include "bytecode.h"
+#include "value.h"
+
+// Evaluates bytecode with vars[i] as the value of variable i. Only reads the
+// bytecode, so any number of threads can evaluate the same bytecode.
+double vm_evaluate(const Bytecode *bytecode, const double *vars);
+// row r of vars holds the variables of evaluation r, each row is
+// bytecode_get_variable_count values long
+void vm_evaluate_rows(const Bytecode *bytecode, const double *vars,
+                      size_t row_count, double *out);
+// Evaluates with exact integers while they fit in int64, see Value. Constants
+// that hold an integer of at most VALUE_MAX_EXACT_DOUBLE in magnitude are
+// integers, function calls always give a double.
+Value vm_evaluate_value(const Bytecode *bytecode, const Value *vars);
+void vm_evaluate_value_rows(const Bytecode *bytecode, const Value *vars,
+                            size_t row_count, Value *out);
+
+#endif
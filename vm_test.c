@@ -0,0 +1,341 @@
+#include "ast.h"
+#include "bytecode.h"
+#include "char_reader.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "parser.h"
+#include "symbol_table.h"
+#include "test_helpers.h"
+#include "token_list.h"
+#include "vm.h"
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool same_value(double actual, double expected) {
+  if (isnan(expected)) {
+    return isnan(actual);
+  }
+  return actual == expected ||
+         fabs(actual - expected) <= 1e-12 * fabs(expected);
+}
+
+// vars are given in the order the variables first appear in input
+static void run_eval_test(const char *input, const double *vars,
+                          double expected) {
+  TokenList tokens = lex_string(input);
+  Bytecode bytecode;
+  assert(bytecode_init(&bytecode));
+  CompileError error;
+  bool compiled = compile_token_list(&tokens, &bytecode, &error);
+  if (!compiled) {
+    fprintf(stderr, "failed to compile \"%s\": error %d at token %zu\n", input,
+            (int)error.type, error.token_index);
+  }
+  assert(compiled);
+
+  double actual = vm_evaluate(&bytecode, vars);
+  if (!same_value(actual, expected)) {
+    fprintf(stderr, "\"%s\" evaluated to %.17g, expected %.17g\n", input,
+            actual, expected);
+  }
+  assert(same_value(actual, expected));
+
+  bytecode_destroy(&bytecode);
+  token_list_distroy(&tokens);
+}
+
+static void test_arithmetic(void) {
+  run_eval_test("1 + 2 * 3", NULL, 7);
+  run_eval_test("(1 + 2) * 3", NULL, 9);
+  run_eval_test("7 % 4 - 10 / 4", NULL, 3 - 2.5);
+  run_eval_test("2 ^ 3 ^ 2", NULL, 512);
+  run_eval_test("2 ** -1", NULL, 0.5);
+  run_eval_test("-2 ^ 2", NULL, -4);
+  run_eval_test("-7.5 % 2", NULL, fmod(-7.5, 2));
+  run_eval_test("1 / 0", NULL, INFINITY);
+  run_eval_test("[1.5e2 - .5] * {2}", NULL, 299);
+}
+
+static void test_variables(void) {
+  double vars[] = {3, 4};
+  run_eval_test("sqrt(x * x + y ^ 2)", vars, 5);
+  run_eval_test("x - y - x", vars, -4);
+  double one[] = {0.25};
+  run_eval_test("sin(t) ^ 2 + cos(t) ^ 2", one, 1);
+  run_eval_test("abs(-t) + floor(t * 10)", one, 2.25);
+}
+
+// vars are given in the order the variables first appear in input
+static Value evaluate_values(const char *input, const Value *vars) {
+  TokenList tokens = lex_string(input);
+  Bytecode bytecode;
+  assert(bytecode_init(&bytecode));
+  CompileError error;
+  assert(compile_token_list(&tokens, &bytecode, &error));
+  Value value = vm_evaluate_value(&bytecode, vars);
+  bytecode_destroy(&bytecode);
+  token_list_distroy(&tokens);
+  return value;
+}
+
+static void run_integer_test(const char *input, const Value *vars,
+                             int64_t expected) {
+  Value actual = evaluate_values(input, vars);
+  if (actual.type != VALUE_INTEGER || actual.integer != expected) {
+    fprintf(stderr, "\"%s\" evaluated to %.17g, expected integer %lld\n",
+            input, value_to_double(actual), (long long)expected);
+  }
+  assert(actual.type == VALUE_INTEGER && actual.integer == expected);
+}
+
+static void run_promoted_test(const char *input, const Value *vars,
+                              double expected) {
+  Value actual = evaluate_values(input, vars);
+  if (actual.type != VALUE_NUMBER || !same_value(actual.number, expected)) {
+    fprintf(stderr, "\"%s\" evaluated to %.17g, expected double %.17g\n",
+            input, value_to_double(actual), expected);
+  }
+  assert(actual.type == VALUE_NUMBER && same_value(actual.number, expected));
+}
+
+static void test_integer_values(void) {
+  run_integer_test("1 + 2 * 3 - 4", NULL, 3);
+  run_integer_test("8 / -2", NULL, -4);
+  run_integer_test("-7 % 3 + 7 % -3", NULL, -1 + 1);
+  run_integer_test("(-3) ^ 3 + 0 ^ 0 + 1 ^ 1000000", NULL, -27 + 1 + 1);
+  run_integer_test("2.0 * 3", NULL, 6);
+  // integers have no -0
+  run_integer_test("-0 * 5", NULL, 0);
+  // exact past the 53 bits of a double
+  run_integer_test("2 ^ 62 + 1 - 2 ^ 62", NULL, 1);
+  run_integer_test("3 ^ 39", NULL, 4052555153018976267);
+  Value big[] = {value_integer(INT64_MAX - 1)};
+  Value min[] = {value_integer(INT64_MIN)};
+  run_integer_test("x + 1", big, INT64_MAX);
+  run_integer_test("y % -1 + y / y", min, 1);
+
+  run_promoted_test("7 / 2", NULL, 3.5);
+  run_promoted_test("1 / 0", NULL, INFINITY);
+  run_promoted_test("7 % 0", NULL, NAN);
+  run_promoted_test("2 ^ -1", NULL, 0.5);
+  run_promoted_test("2 ^ 63", NULL, 9223372036854775808.0);
+  run_promoted_test("(-2) ^ 64", NULL, 18446744073709551616.0);
+  run_promoted_test("1.5 * 2", NULL, 3);
+  run_promoted_test("sqrt(16) + 1", NULL, 5);
+  run_promoted_test("x + 2", big, 9223372036854775808.0);
+  run_promoted_test("x * 2", big, 18446744073709551612.0);
+  run_promoted_test("y - 1", min, -9223372036854775808.0);
+  run_promoted_test("-y", min, 9223372036854775808.0);
+  run_promoted_test("y / -1", min, 9223372036854775808.0);
+  // once a double, the result stays one
+  run_promoted_test("(x + 2) - 2", big, 9223372036854775808.0);
+}
+
+static void test_integer_rows(void) {
+  TokenList tokens = lex_string("a * b - 1");
+  Bytecode bytecode;
+  assert(bytecode_init(&bytecode));
+  CompileError error;
+  assert(compile_token_list(&tokens, &bytecode, &error));
+  // rows of a, b
+  Value vars[] = {value_integer(3),         value_integer(4),
+                  value_number(0.5),        value_integer(4),
+                  value_integer(1ll << 40), value_integer(1ll << 30)};
+  Value out[3];
+  vm_evaluate_value_rows(&bytecode, vars, 3, out);
+  assert(out[0].type == VALUE_INTEGER && out[0].integer == 11);
+  assert(out[1].type == VALUE_NUMBER && out[1].number == 1);
+  assert(out[2].type == VALUE_NUMBER && out[2].number == 0x1p70);
+  bytecode_destroy(&bytecode);
+  token_list_distroy(&tokens);
+}
+
+static void test_variable_slots(void) {
+  TokenList tokens = lex_string("b * a + b - c");
+  Bytecode bytecode;
+  assert(bytecode_init(&bytecode));
+  CompileError error;
+  assert(compile_token_list(&tokens, &bytecode, &error));
+
+  assert(bytecode_get_variable_count(&bytecode) == 3);
+  assert(strcmp(bytecode_get_variable_name(&bytecode, 0), "b") == 0);
+  assert(strcmp(bytecode_get_variable_name(&bytecode, 1), "a") == 0);
+  assert(strcmp(bytecode_get_variable_name(&bytecode, 2), "c") == 0);
+  size_t slot;
+  assert(bytecode_find_variable(&bytecode, "c", &slot) && slot == 2);
+  assert(!bytecode_find_variable(&bytecode, "d", &slot));
+  assert(bytecode_get_max_stack(&bytecode) == 2);
+
+  // rows of b, a, c
+  double vars[] = {1, 2, 3, 10, 20, 30};
+  double out[2];
+  vm_evaluate_rows(&bytecode, vars, 2, out);
+  assert(out[0] == 1 * 2 + 1 - 3);
+  assert(out[1] == 10 * 20 + 10 - 30);
+
+  bytecode_destroy(&bytecode);
+  token_list_distroy(&tokens);
+}
+
+// symbols are bound to the same slots as names, whatever their numbers are
+static void test_interned_variable_slots(void) {
+  SymbolTable symbols;
+  assert(symbol_table_init(&symbols));
+  uint32_t symbol;
+  assert(symbol_table_intern(&symbols, "c", 1, &symbol) && symbol == 1);
+
+  const char *inputs[] = {"b * a + b - c", "c * c + sqrt(b) - c"};
+  double vars[][3] = {{1, 2, 3}, {3, 16, 0}};
+  double expected[] = {1 * 2 + 1 - 3, 3 * 3 + 4 - 3};
+  for (size_t i = 0; i < 2; i++) {
+    CharReader reader;
+    char_reader_init(&reader);
+    assert(char_reader_add(&reader, inputs[i]));
+    TokenList tokens = lex_char_reader_interned(&reader, &symbols);
+    Bytecode bytecode;
+    assert(bytecode_init(&bytecode));
+    CompileError error;
+    assert(compile_token_list(&tokens, &bytecode, &error));
+
+    assert(bytecode_get_variable_count(&bytecode) == (i == 0 ? 3 : 2));
+    assert(strcmp(bytecode_get_variable_name(&bytecode, 0),
+                  i == 0 ? "b" : "c") == 0);
+    assert(vm_evaluate(&bytecode, vars[i]) == expected[i]);
+
+    bytecode_destroy(&bytecode);
+    token_list_distroy(&tokens);
+    char_reader_destroy(&reader);
+  }
+
+  assert(symbol_table_get_count(&symbols) == 4); // c b a sqrt
+  symbol_table_destroy(&symbols);
+}
+
+static void run_compile_error_test(const char *input, CompileErrorType type,
+                                   size_t token_index) {
+  TokenList tokens = lex_string(input);
+  Bytecode bytecode;
+  assert(bytecode_init(&bytecode));
+  CompileError error;
+  assert(!compile_token_list(&tokens, &bytecode, &error));
+  assert(error.type == type);
+  assert(error.token_index == token_index);
+  assert(bytecode_get_instruction_count(&bytecode) == 0);
+  bytecode_destroy(&bytecode);
+  token_list_distroy(&tokens);
+}
+
+static void test_compile_errors(void) {
+  run_compile_error_test("1 + (2", COMPILE_PARSE_FAILED, 4);
+  run_compile_error_test("x + nope(2)", COMPILE_UNKNOWN_FUNCTION, 2);
+}
+
+// tree walking reference evaluator over the variables v0..v9, the value of
+// vN is values[N]
+static double evaluate_node(const Ast *ast, TokenList *tokens, uint32_t index,
+                            const double *values) {
+  const AstNode *node = ast_get_node(ast, index);
+  Lexeme name;
+  switch (node->type) {
+  case AST_NUMBER:
+    return node->number;
+  case AST_VARIABLE:
+    name = token_list_get_lexeme(
+        tokens, token_list_get_token_at(tokens, node->token_index));
+    return values[name.chars[1] - '0'];
+  case AST_NEGATE:
+    return -evaluate_node(ast, tokens, node->operand, values);
+  case AST_CALL:
+    return sqrt(evaluate_node(ast, tokens, node->operand, values));
+  default:
+    break;
+  }
+
+  double lhs = evaluate_node(ast, tokens, node->binary.lhs, values);
+  double rhs = evaluate_node(ast, tokens, node->binary.rhs, values);
+  switch (node->type) {
+  case AST_ADD:
+    return lhs + rhs;
+  case AST_SUBTRACT:
+    return lhs - rhs;
+  case AST_MULTIPLY:
+    return lhs * rhs;
+  case AST_DIVIDE:
+    return lhs / rhs;
+  case AST_MODULO:
+    return fmod(lhs, rhs);
+  default:
+    return pow(lhs, rhs);
+  }
+}
+
+static const char *const random_operators[] = {" + ", " - ", " * ", " / ",
+                                               " % ", " ^ ", "**"};
+static const char *const random_variables[] = {"v0", "v1", "v2", "v3"};
+static const char *const random_functions[] = {"sqrt"};
+static const ExpressionShape random_shape = {
+    random_operators, TEST_COUNT_OF(random_operators),
+    random_variables, TEST_COUNT_OF(random_variables),
+    random_functions, TEST_COUNT_OF(random_functions),
+    NULL,             0,
+    .fractions = 100, .negates = true, .mixes_brackets = true};
+
+static void test_matches_tree_walker(void) {
+  srand(1234);
+  for (int i = 0; i < 2000; i++) {
+    char input[4096];
+    size_t length = generate_expression(&random_shape, input, 0, 6);
+    input[length] = '\0';
+
+    TokenList tokens = lex_string(input);
+    Ast ast;
+    assert(ast_init(&ast));
+    ParseError parse_error;
+    assert(parse_token_list(&tokens, &ast, &parse_error));
+    Bytecode bytecode;
+    assert(bytecode_init(&bytecode));
+    CompileError error;
+    assert(compile_ast(&ast, &tokens, 0, &bytecode, &error));
+
+    double values[4];
+    for (int v = 0; v < 4; v++) {
+      values[v] = (double)(rand() % 2000) / 100.0 - 10.0;
+    }
+    double vars[4];
+    for (size_t slot = 0; slot < bytecode_get_variable_count(&bytecode);
+         slot++) {
+      vars[slot] = values[bytecode_get_variable_name(&bytecode, slot)[1] - '0'];
+    }
+
+    double expected =
+        evaluate_node(&ast, &tokens, ast_get_root(&ast), values);
+    double actual = vm_evaluate(&bytecode, vars);
+    if (!same_value(actual, expected)) {
+      fprintf(stderr, "\"%s\" evaluated to %.17g, expected %.17g\n", input,
+              actual, expected);
+    }
+    assert(same_value(actual, expected));
+
+    bytecode_destroy(&bytecode);
+    ast_destroy(&ast);
+    token_list_distroy(&tokens);
+  }
+}
+
+int main(void) {
+  test_arithmetic();
+  test_variables();
+  test_integer_values();
+  test_integer_rows();
+  test_variable_slots();
+  test_interned_variable_slots();
+  test_compile_errors();
+  test_matches_tree_walker();
+
+  printf("All vm tests passed\n");
+  return 0;
+}